@@ -18,6 +18,7 @@
  */
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -52,6 +53,7 @@ typedef unsigned int uint;
 typedef uint bitmap_t; /*! Bit-maps, using the range of 1<<0 to 1<<16 (inclusive). */
 
 typedef struct {
+	uint32_t refs; // number of leaves (in any trie) pointing to this key
 	uint32_t len; // 32 bits are enough for key lengths; probably even 16 bits would be.
 	char chars[];
 } tkey_t;
@@ -87,6 +89,8 @@ typedef union node node_t;
  *
  * \note The branch nodes are never allocated individually, but they are
  *   always part of either the root node or the twigs array of the parent.
+ *   Each twigs array is preceded by a twigs_hdr_t with its reference count,
+ *   so that copy-on-write tries may share whole subtries (see trie_cow()).
  */
 typedef struct {
 	#if FLAGS_HACK
@@ -105,6 +109,12 @@ union node {
 	branch_t branch;
 };
 
+/*! \brief Allocation unit of a twigs array. */
+typedef struct {
+	uint32_t refs; /*!< Number of branches (in any trie) pointing to the twigs. */
+	node_t twigs[];
+} twigs_hdr_t;
+
 struct trie {
 	node_t root; // undefined when weight == 0, see empty_root()
 	size_t weight;
@@ -211,6 +221,100 @@ static node_t* twig(node_t *t, uint i)
 		max = bitmap_weight(t->branch.bitmap);	\
 	} while(0)
 
+/*! \brief Get the header of a twigs array. */
+static twigs_hdr_t* twigs_hdr(node_t *twigs)
+{
+	return (twigs_hdr_t *)((char *)twigs - offsetof(twigs_hdr_t, twigs));
+}
+
+/*! \brief Allocate a new, unshared twigs array for \a count children. */
+static node_t* twigs_alloc(knot_mm_t *mm, uint count)
+{
+	twigs_hdr_t *h = mm_alloc(mm, sizeof(twigs_hdr_t) + sizeof(node_t) * count);
+	if (unlikely(!h))
+		return NULL;
+	h->refs = 1;
+	return h->twigs;
+}
+
+/*! \brief Resize an unshared twigs array. */
+static node_t* twigs_realloc(knot_mm_t *mm, node_t *twigs, uint count, uint prev_count)
+{
+	assert(twigs_hdr(twigs)->refs == 1);
+	twigs_hdr_t *h = mm_realloc(mm, twigs_hdr(twigs),
+	                            sizeof(twigs_hdr_t) + sizeof(node_t) * count,
+	                            sizeof(twigs_hdr_t) + sizeof(node_t) * prev_count);
+	return h == NULL ? NULL : h->twigs;
+}
+
+/*! \brief Free an unshared twigs array. */
+static void twigs_free(knot_mm_t *mm, node_t *twigs)
+{
+	assert(twigs_hdr(twigs)->refs == 1);
+	mm_free(mm, twigs_hdr(twigs));
+}
+
+/*! \brief Drop a reference to a leaf key, freeing it if it was the last one. */
+static void key_unref(knot_mm_t *mm, tkey_t *key)
+{
+	assert(key->refs > 0);
+	if (--key->refs == 0)
+		mm_free(mm, key);
+}
+
+/*! \brief Take another reference to whatever the node points to. */
+static void node_ref(node_t *t)
+{
+	if (isbranch(t))
+		++twigs_hdr(t->branch.twigs)->refs;
+	else
+		++t->leaf.key->refs;
+}
+
+/*!
+ * \brief Make sure the twigs of branch \a t aren't shared with another trie.
+ *
+ * A shared twigs array is replaced by a private copy; the children themselves
+ * stay shared, as they gain a reference from the copy.
+ *
+ * \return KNOT_EOK or KNOT_ENOMEM.
+ */
+static int cow_unshare(node_t *t, knot_mm_t *mm)
+{
+	assert(isbranch(t));
+	twigs_hdr_t *h = twigs_hdr(t->branch.twigs);
+	if (likely(h->refs == 1))
+		return KNOT_EOK;
+	uint cc = bitmap_weight(t->branch.bitmap);
+	node_t *twigs = twigs_alloc(mm, cc);
+	if (unlikely(!twigs))
+		return KNOT_ENOMEM;
+	memcpy(twigs, t->branch.twigs, sizeof(node_t) * cc);
+	for (uint i = 0; i < cc; ++i)
+		node_ref(twigs + i);
+	--h->refs;
+	t->branch.twigs = twigs;
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Unshare all twigs arrays on the path ns_find_branch() would take.
+ *
+ * \return KNOT_EOK or KNOT_ENOMEM.
+ */
+static int cow_unshare_path(trie_t *tbl, const char *key, uint32_t len)
+{
+	assert(tbl->weight);
+	node_t *t = &tbl->root;
+	while (isbranch(t)) {
+		ERR_RETURN(cow_unshare(t, &tbl->mm));
+		bitmap_t b = twigbit(t, key, len);
+		uint i = hastwig(t, b) ? twigoff(t, b) : 0;
+		t = twig(t, i);
+	}
+	return KNOT_EOK;
+}
+
 /*! \brief Simple string comparator. */
 static int key_cmp(const char *k1, uint32_t k1_len, const char *k2, uint32_t k2_len)
 {
@@ -244,17 +348,24 @@ trie_t* trie_create(knot_mm_t *mm)
 	return trie;
 }
 
-/*! \brief Free anything under the trie node, except for the passed pointer itself. */
+/*!
+ * \brief Free anything under the trie node, except for the passed pointer itself.
+ *
+ * Parts shared with other tries are only dereferenced.
+ */
 static void clear_trie(node_t *trie, knot_mm_t *mm)
 {
 	if (!isbranch(trie)) {
-		mm_free(mm, trie->leaf.key);
+		key_unref(mm, trie->leaf.key);
 	} else {
 		branch_t *b = &trie->branch;
+		twigs_hdr_t *h = twigs_hdr(b->twigs);
+		if (--h->refs > 0)
+			return;
 		int len = bitmap_weight(b->bitmap);
 		for (int i = 0; i < len; ++i)
 			clear_trie(b->twigs + i, mm);
-		mm_free(mm, b->twigs);
+		mm_free(mm, h);
 	}
 }
 
@@ -277,6 +388,18 @@ void trie_clear(trie_t *tbl)
 	tbl->weight = 0;
 }
 
+trie_t* trie_cow(trie_t *tbl)
+{
+	assert(tbl);
+	trie_t *cow = mm_alloc(&tbl->mm, sizeof(trie_t));
+	if (cow == NULL)
+		return NULL;
+	*cow = *tbl;
+	if (cow->weight)
+		node_ref(&cow->root);
+	return cow;
+}
+
 size_t trie_weight(const trie_t *tbl)
 {
 	assert(tbl);
@@ -301,6 +424,67 @@ trie_val_t* trie_get_try(trie_t *tbl, const char *key, uint32_t len)
 	return &t->leaf.val;
 }
 
+/*! \brief Test if the leaf key is a prefix of the given key. */
+static bool leaf_is_prefix(node_t *t, const char *key, uint32_t len)
+{
+	assert(!isbranch(t));
+	tkey_t *lkey = t->leaf.key;
+	return lkey->len <= len && memcmp(lkey->chars, key, lkey->len) == 0;
+}
+
+trie_val_t* trie_get_lpm(trie_t *tbl, const char *key, uint32_t len,
+                         uint32_t *match_len)
+{
+	assert(tbl);
+	if (!tbl->weight)
+		return NULL;
+	node_t *best = NULL;
+	node_t *t = &tbl->root;
+	while (isbranch(t)) {
+		__builtin_prefetch(t->branch.twigs);
+		uint32_t i = t->branch.index;
+		// All keys below are at least i bytes long.
+		if (i > len)
+			break;
+		// The end-of-string twig holds the only key of length i.
+		if (hastwig(t, 1 << 0)) {
+			node_t *eos = twig(t, 0);
+			if (leaf_is_prefix(eos, key, len))
+				best = eos;
+		}
+		bitmap_t b = twigbit(t, key, len);
+		if (!hastwig(t, b))
+			break;
+		t = twig(t, twigoff(t, b));
+	}
+	if (!isbranch(t) && leaf_is_prefix(t, key, len))
+		best = t;
+	if (best == NULL)
+		return NULL;
+	if (match_len != NULL)
+		*match_len = best->leaf.key->len;
+	return &best->leaf.val;
+}
+
+trie_val_t* trie_get_cow(trie_t *tbl, const char *key, uint32_t len)
+{
+	assert(tbl);
+	if (!tbl->weight)
+		return NULL;
+	node_t *t = &tbl->root;
+	while (isbranch(t)) {
+		bitmap_t b = twigbit(t, key, len);
+		if (!hastwig(t, b))
+			return NULL;
+		if (unlikely(cow_unshare(t, &tbl->mm)))
+			return NULL;
+		t = twig(t, twigoff(t, b));
+	}
+	if (key_cmp(key, len, t->leaf.key->chars, t->leaf.key->len) != 0)
+		return NULL;
+	return &t->leaf.val;
+}
+
 int trie_del(trie_t *tbl, const char *key, uint32_t len, trie_val_t *val)
 {
 	assert(tbl);
@@ -314,12 +498,13 @@ int trie_del(trie_t *tbl, const char *key, uint32_t len, trie_val_t *val)
 		b = twigbit(t, key, len);
 		if (!hastwig(t, b))
 			return KNOT_ENOENT;
+		ERR_RETURN(cow_unshare(t, &tbl->mm));
 		p = &t->branch;
 		t = twig(t, twigoff(t, b));
 	}
 	if (key_cmp(key, len, t->leaf.key->chars, t->leaf.key->len) != 0)
 		return KNOT_ENOENT;
-	mm_free(&tbl->mm, t->leaf.key);
+	key_unref(&tbl->mm, t->leaf.key);
 	if (val != NULL)
 		*val = t->leaf.val; // we return trie_val_t directly when deleting
 	--tbl->weight;
@@ -336,13 +521,12 @@ int trie_del(trie_t *tbl, const char *key, uint32_t len, trie_val_t *val)
 	if (cc == 2) { // collapse binary node p: move the other child to this node
 		node_t *twigs = p->twigs;
 		(*(node_t *)p) = twigs[1 - ci]; // it might be a leaf or branch
-		mm_free(&tbl->mm, twigs);
+		twigs_free(&tbl->mm, twigs);
 		return KNOT_EOK;
 	}
 	memmove(p->twigs + ci, p->twigs + ci + 1, sizeof(node_t) * (cc - ci - 1));
 	p->bitmap &= ~b;
-	node_t *twigs = mm_realloc(&tbl->mm, p->twigs, sizeof(node_t) * (cc - 1),
-	                           sizeof(node_t) * cc);
+	node_t *twigs = twigs_realloc(&tbl->mm, p->twigs, cc - 1, cc);
 	if (likely(twigs != NULL))
 		p->twigs = twigs;
 		/* We can ignore mm_realloc failure, only beware that next time
@@ -464,7 +648,7 @@ static int ns_find_branch(nstack_t *ns, const char *key, uint32_t len,
 	}
 	info->index = index;
 	if (first)
-		*first = lkey->len > index ? lkey->chars[index] : -256;
+		*first = lkey->len > index ? (byte)lkey->chars[index] : -256;
 	// Find flags: which half-byte has matched.
 	uint flags;
 	if (index == len && len == lkey->len) { // found equivalent key
@@ -605,27 +789,22 @@ static int ns_next_leaf(nstack_t *ns)
 	} while (true);
 }
 
-int trie_get_leq(trie_t *tbl, const char *key, uint32_t len, trie_val_t **val)
+/*!
+ * \brief Advance the node stack to the leaf less or equal to the key.
+ *
+ * \return KNOT_EOK for exact match, 1 for previous, KNOT_ENOENT for not-found,
+ *         or KNOT_E*.
+ */
+static int ns_get_leq(nstack_t *ns, const char *key, uint32_t len)
 {
-	assert(tbl && val);
-	*val = NULL; // so on failure we can just return;
-	if (tbl->weight == 0)
-		return KNOT_ENOENT;
-	{ // Intentionally un-indented; until end of function, to bound cleanup attr.
 	// First find a key with longest-matching prefix
-	__attribute__((cleanup(ns_cleanup)))
-		nstack_t ns_local;
-	ns_init(&ns_local, tbl);
-	nstack_t *ns = &ns_local;
 	branch_t bp;
 	int un_leaf; // first unmatched character in the leaf
 	ERR_RETURN(ns_find_branch(ns, key, len, &bp, &un_leaf));
-	int un_key = bp.index < len ? key[bp.index] : -256;
+	int un_key = bp.index < len ? (byte)key[bp.index] : -256;
 	node_t *t = ns->stack[ns->len - 1];
-	if (bp.flags == 0) { // found exact match
-		*val = &t->leaf.val;
+	if (bp.flags == 0) // found exact match
 		return KNOT_EOK;
-	}
 	// Get t: the last node on matching path
 	if (isbranch(t) && t->branch.index == bp.index && t->branch.flags == bp.flags) {
 		// t is OK
@@ -656,8 +835,24 @@ int trie_get_leq(trie_t *tbl, const char *key, uint32_t len, trie_val_t **val)
 	}
 success:
 	assert(!isbranch(ns->stack[ns->len - 1]));
-	*val = &ns->stack[ns->len - 1]->leaf.val;
 	return 1;
+}
+
+int trie_get_leq(trie_t *tbl, const char *key, uint32_t len, trie_val_t **val)
+{
+	assert(tbl && val);
+	*val = NULL; // so on failure we can just return;
+	if (tbl->weight == 0)
+		return KNOT_ENOENT;
+	{ // Intentionally un-indented; until end of function, to bound cleanup attr.
+	__attribute__((cleanup(ns_cleanup)))
+		nstack_t ns_local;
+	ns_init(&ns_local, tbl);
+	nstack_t *ns = &ns_local;
+	int ret = ns_get_leq(ns, key, len);
+	if (ret == KNOT_EOK || ret == 1)
+		*val = &ns->stack[ns->len - 1]->leaf.val;
+	return ret;
 	}
 }
 
@@ -670,6 +865,7 @@ static int mk_leaf(node_t *leaf, const char *key, uint32_t len, knot_mm_t *mm)
 	#endif
 	if (unlikely(!k))
 		return KNOT_ENOMEM;
+	k->refs = 1;
 	k->len = len;
 	memcpy(k->chars, key, len);
 	leaf->leaf = (leaf_t){
@@ -700,6 +896,8 @@ trie_val_t* trie_get_ins(trie_t *tbl, const char *key, uint32_t len)
 	nstack_t *ns = &ns_local;
 	branch_t bp; // branch-point: index and flags signifying the longest common prefix
 	int k2; // the first unmatched character in the leaf
+	if (unlikely(cow_unshare_path(tbl, key, len)))
+		return NULL;
 	if (unlikely(ns_find_branch(ns, key, len, &bp, &k2)))
 		return NULL;
 	node_t *t = ns->stack[ns->len - 1];
@@ -714,8 +912,7 @@ trie_val_t* trie_get_ins(trie_t *tbl, const char *key, uint32_t len)
 		bitmap_t b1 = twigbit(t, key, len);
 		assert(!hastwig(t, b1));
 		uint s, m; TWIGOFFMAX(s, m, t, b1); // new child position and original child count
-		node_t *twigs = mm_realloc(&tbl->mm, t->branch.twigs,
-				sizeof(node_t) * (m + 1), sizeof(node_t) * m);
+		node_t *twigs = twigs_realloc(&tbl->mm, t->branch.twigs, m + 1, m);
 		if (unlikely(!twigs))
 			goto err_leaf;
 		memmove(twigs + s + 1, twigs + s, sizeof(node_t) * (m - s));
@@ -733,7 +930,7 @@ trie_val_t* trie_get_ins(trie_t *tbl, const char *key, uint32_t len)
 				assert(hastwig(pt, twigbit(pt, key, len)));
 			}
 		#endif
-		node_t *twigs = mm_alloc(&tbl->mm, sizeof(node_t) * 2);
+		node_t *twigs = twigs_alloc(&tbl->mm, 2);
 		if (unlikely(!twigs))
 			goto err_leaf;
 		node_t t2 = *t; // Save before overwriting t.
@@ -774,6 +971,50 @@ int trie_apply(trie_t *tbl, int (*f)(trie_val_t *, void *), void *d)
 	return apply_trie(&tbl->root, f, d);
 }
 
+/*! \brief Like apply_trie(), but unshare every twigs array on the way. */
+static int apply_trie_cow(node_t *t, int (*f)(trie_val_t *, void *), void *d,
+                          knot_mm_t *mm)
+{
+	assert(t);
+	if (!isbranch(t))
+		return f(&t->leaf.val, d);
+	ERR_RETURN(cow_unshare(t, mm));
+	int child_count = bitmap_weight(t->branch.bitmap);
+	for (int i = 0; i < child_count; ++i)
+		ERR_RETURN(apply_trie_cow(twig(t, i), f, d, mm));
+	return KNOT_EOK;
+}
+
+int trie_apply_cow(trie_t *tbl, int (*f)(trie_val_t *, void *), void *d)
+{
+	assert(tbl && f);
+	if (!tbl->weight)
+		return KNOT_EOK;
+	return apply_trie_cow(&tbl->root, f, d, &tbl->mm);
+}
+
+/*! \brief Like apply_trie(), but skip the twigs arrays shared with another trie. */
+static int apply_trie_unshared(node_t *t, int (*f)(trie_val_t *, void *), void *d)
+{
+	assert(t);
+	if (!isbranch(t))
+		return f(&t->leaf.val, d);
+	if (twigs_hdr(t->branch.twigs)->refs > 1)
+		return KNOT_EOK;
+	int child_count = bitmap_weight(t->branch.bitmap);
+	for (int i = 0; i < child_count; ++i)
+		ERR_RETURN(apply_trie_unshared(twig(t, i), f, d));
+	return KNOT_EOK;
+}
+
+int trie_apply_unshared(trie_t *tbl, int (*f)(trie_val_t *, void *), void *d)
+{
+	assert(tbl && f);
+	if (!tbl->weight)
+		return KNOT_EOK;
+	return apply_trie_unshared(&tbl->root, f, d);
+}
+
 /* These are all thin wrappers around static Tns* functions. */
 trie_it_t* trie_it_begin(trie_t *tbl)
 {
@@ -792,13 +1033,117 @@ trie_it_t* trie_it_begin(trie_t *tbl)
 	return it;
 }
 
+trie_it_t* trie_it_begin_prefix(trie_t *tbl, const char *prefix, uint32_t len)
+{
+	assert(tbl);
+	trie_it_t *it = malloc(sizeof(nstack_t));
+	if (!it)
+		return NULL;
+	ns_init(it, tbl);
+	// Descend to the subtrie holding all the keys with the prefix.
+	while (it->len > 0) {
+		node_t *t = it->stack[it->len - 1];
+		if (!isbranch(t) || t->branch.index >= len)
+			break;
+		bitmap_t b = twigbit(t, prefix, len);
+		if (!hastwig(t, b)) {
+			it->len = 0;
+			break;
+		}
+		if (ns_longer(it))
+			goto fail;
+		it->stack[it->len++] = twig(t, twigoff(t, b));
+	}
+	if (it->len == 0)
+		return it;
+	if (ns_first_leaf(it))
+		goto fail;
+	// The skipped parts of the keys are the same in the whole subtrie.
+	tkey_t *key = it->stack[it->len - 1]->leaf.key;
+	if (key->len < len || memcmp(key->chars, prefix, len) != 0)
+		it->len = 0;
+	return it;
+fail:
+	ns_cleanup(it);
+	free(it);
+	return NULL;
+}
+
+trie_it_t* trie_it_begin_leq(trie_t *tbl, const char *key, uint32_t len)
+{
+	assert(tbl);
+	trie_it_t *it = malloc(sizeof(nstack_t));
+	if (!it)
+		return NULL;
+	ns_init(it, tbl);
+	if (it->len == 0)
+		return it;
+	int ret = ns_get_leq(it, key, len);
+	if (ret == KNOT_ENOENT) {
+		it->len = 0;
+	} else if (ret != KNOT_EOK && ret != 1) {
+		ns_cleanup(it);
+		free(it);
+		return NULL;
+	}
+	return it;
+}
+
+/*!
+ * \brief Re-find the current leaf if some twigs array on its path was unshared.
+ *
+ * The stack below an unshared branch points into the original twigs array,
+ * which is still alive as it's shared, but it isn't a child of the branch.
+ *
+ * \return KNOT_EOK or KNOT_ENOMEM.
+ */
+static int ns_refresh(nstack_t *ns)
+{
+	for (uint32_t i = 1; i < ns->len; ++i) {
+		node_t *p = ns->stack[i - 1];
+		node_t *t = ns->stack[i];
+		if (t >= p->branch.twigs &&
+		    t < p->branch.twigs + bitmap_weight(p->branch.bitmap))
+			continue;
+		tkey_t *key = ns->stack[ns->len - 1]->leaf.key;
+		branch_t bp;
+		ns->len = i;
+		ERR_RETURN(ns_find_branch(ns, key->chars, key->len, &bp, NULL));
+		assert(bp.flags == 0);
+		break;
+	}
+	return KNOT_EOK;
+}
+
 void trie_it_next(trie_it_t *it)
 {
 	assert(it && it->len);
-	if (ns_next_leaf(it) != KNOT_EOK)
+	if (ns_refresh(it) != KNOT_EOK || ns_next_leaf(it) != KNOT_EOK)
 		it->len = 0;
 }
 
+trie_it_t* trie_it_clone(const trie_it_t *it)
+{
+	assert(it);
+	trie_it_t *copy = malloc(sizeof(nstack_t));
+	if (!copy)
+		return NULL;
+	copy->len = it->len;
+	if (it->stack == it->stack_init) {
+		copy->stack = copy->stack_init;
+		copy->alen = it->alen;
+	} else {
+		copy->stack = malloc(it->alen * sizeof(node_t *));
+		if (!copy->stack) {
+			free(copy);
+			return NULL;
+		}
+		copy->alen = it->alen;
+	}
+	memcpy(copy->stack, it->stack, it->len * sizeof(node_t *));
+	return copy;
+}
+
 bool trie_it_finished(trie_it_t *it)
 {
 	assert(it);
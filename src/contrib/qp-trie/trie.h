@@ -28,6 +28,9 @@
  *   the structure copies the contents of the passed keys
  * - values are void* pointers, typically you get an ephemeral pointer to it
  * - key lengths are limited by 2^32-1 ATM
+ * - a trie can be cloned by trie_cow() in O(1); the clones share all
+ *   structure until it's modified, so that the modifications of one clone
+ *   copy only the touched paths and never affect the other clones
  */
 
 /*! \brief Element value. */
@@ -45,6 +48,21 @@ trie_t* trie_create(knot_mm_t *mm);
 /*! \brief Free a trie instance. */
 void trie_free(trie_t *tbl);
 
+/*!
+ * \brief Create a copy-on-write clone of a trie.
+ *
+ * The clone shares all nodes and keys with the original, the values are
+ * copied (shallowly). Both tries are fully independent afterwards: they may
+ * be modified and freed in any order, each trie_get_ins() or trie_del() only
+ * copies the path to the touched key.
+ *
+ * \note The values obtained by trie_get_try(), trie_get_leq(), trie_apply()
+ *       or by the iterator must be treated read-only in a shared trie.
+ *       Use trie_get_cow() or trie_apply_cow() to modify values in place.
+ * \note Modifications of tries sharing some nodes must not run concurrently.
+ */
+trie_t* trie_cow(trie_t *tbl);
+
 /*! \brief Clear a trie instance (make it empty). */
 void trie_clear(trie_t *tbl);
 
@@ -54,6 +72,28 @@ size_t trie_weight(const trie_t *tbl);
 /*! \brief Search the trie, returning NULL on failure. */
 trie_val_t* trie_get_try(trie_t *tbl, const char *key, uint32_t len);
 
+/*!
+ * \brief Search for the longest key which is a prefix of the given key.
+ *
+ * The search is a single descent, no matter how many keys are prefixes
+ * of the searched one.
+ *
+ * \param tbl        Trie.
+ * \param key        Searched key.
+ * \param len        Key length.
+ * \param match_len  Optional output length of the matching key.
+ * \return The value of the longest matching key or NULL if none.
+ */
+trie_val_t* trie_get_lpm(trie_t *tbl, const char *key, uint32_t len,
+                         uint32_t *match_len);
+
+/*!
+ * \brief Search the trie, returning NULL on failure.
+ *
+ * Unlike trie_get_try(), the returned value is never shared with another trie.
+ */
+trie_val_t* trie_get_cow(trie_t *tbl, const char *key, uint32_t len);
+
 /*! \brief Search the trie, inserting NULL trie_val_t on failure. */
 trie_val_t* trie_get_ins(trie_t *tbl, const char *key, uint32_t len);
 
@@ -76,6 +116,27 @@ int trie_get_leq(trie_t *tbl, const char *key, uint32_t len, trie_val_t **val);
  */
 int trie_apply(trie_t *tbl, int (*f)(trie_val_t *, void *), void *d);
 
+/*!
+ * \brief Apply a function to every trie_val_t, in order, unsharing the whole trie.
+ *
+ * The values passed to the function are never shared with another trie.
+ *
+ * \return KNOT_EOK if success or KNOT_E*.
+ */
+int trie_apply_cow(trie_t *tbl, int (*f)(trie_val_t *, void *), void *d);
+
+/*!
+ * \brief Apply a function to the trie_val_t not shared with another trie, in order.
+ *
+ * Only the leaves reachable without passing a shared twigs array are visited,
+ * i.e. the ones on the paths copied since the last trie_cow(), together with
+ * their siblings. In the original trie, these are the leaves on the paths
+ * the clone has copied.
+ *
+ * \return KNOT_EOK if success or KNOT_E* if error.
+ */
+int trie_apply_unshared(trie_t *tbl, int (*f)(trie_val_t *, void *), void *d);
+
 /*!
  * \brief Remove an item, returning KNOT_EOK if succeeded or KNOT_ENOENT if not found.
  *
@@ -86,14 +147,37 @@ int trie_del(trie_t *tbl, const char *key, uint32_t len, trie_val_t *val);
 /*! \brief Create a new iterator pointing to the first element (if any). */
 trie_it_t* trie_it_begin(trie_t *tbl);
 
+/*!
+ * \brief Create a new iterator pointing to the first key with the given prefix.
+ *
+ * The keys with the prefix are consecutive, the iteration continues past
+ * them to the rest of the trie. The iterator is finished if there is none.
+ */
+trie_it_t* trie_it_begin_prefix(trie_t *tbl, const char *prefix, uint32_t len);
+
+/*!
+ * \brief Create a new iterator pointing to the less-or-equal element.
+ *
+ * The iterator is finished if all the keys are greater.
+ */
+trie_it_t* trie_it_begin_leq(trie_t *tbl, const char *key, uint32_t len);
+
 /*!
  * \brief Advance the iterator to the next element.
  *
  * Iteration is in ascending lexicographical order.
  * In particular, the empty string would be considered as the very first.
+ * The values may be touched by trie_get_cow() during the iteration.
  */
 void trie_it_next(trie_it_t *it);
 
+/*!
+ * \brief Create a new iterator pointing to the same element as the given one.
+ *
+ * The copy is advanced independently of the original iterator.
+ */
+trie_it_t* trie_it_clone(const trie_it_t *it);
+
 /*! \brief Test if the iterator has gone past the last element. */
 bool trie_it_finished(trie_it_t *it);
 
@@ -153,6 +153,25 @@ int dnssec_nsec3_hash(const dnssec_binary_t *data,
 		      const dnssec_nsec3_params_t *params,
 		      dnssec_binary_t *hash);
 
+/*!
+ * Compute NSEC3 hashes for multiple data items at once.
+ *
+ * The hashing context is set up only once for the whole batch, which makes
+ * the function cheaper than repeated dnssec_nsec3_hash() calls.
+ *
+ * \todo Input data must be converted to lowercase!
+ *
+ * \param[in]  data    Array of data to be hashed (usually domain names).
+ * \param[in]  count   Number of items in the data and hashes arrays.
+ * \param[in]  params  NSEC3 parameters.
+ * \param[out] hashes  Computed hashes (will be allocated or resized).
+ *
+ * \return Error code, DNSSEC_EOK if successful.
+ */
+int dnssec_nsec3_hash_batch(const dnssec_binary_t *data, size_t count,
+			    const dnssec_nsec3_params_t *params,
+			    dnssec_binary_t *hashes);
+
 /*!
  * Get length of raw NSEC3 hash for a given algorithm.
  *
@@ -25,36 +25,26 @@
 #include "wire.h"
 
 /*!
- * Compute NSEC3 hash for given data and algorithm.
+ * Compute NSEC3 hash for given data using an initialized digest context.
  *
  * \see RFC 5155
  *
  * \todo Input data should be converted to lowercase.
  */
-static int nsec3_hash(gnutls_digest_algorithm_t algorithm, int iterations,
+static int nsec3_hash(gnutls_hash_hd_t digest, int hash_size, int iterations,
 		      const dnssec_binary_t *salt, const dnssec_binary_t *data,
 		      dnssec_binary_t *hash)
 {
+	assert(digest);
 	assert(salt);
 	assert(data);
 	assert(hash);
 
-	int hash_size = gnutls_hash_get_len(algorithm);
-	if (hash_size <= 0) {
-		return DNSSEC_NSEC3_HASHING_ERROR;
-	}
-
 	int result = dnssec_binary_resize(hash, hash_size);
 	if (result != DNSSEC_EOK) {
 		return result;
 	}
 
-	_cleanup_hash_ gnutls_hash_hd_t digest = NULL;
-	result = gnutls_hash_init(&digest, algorithm);
-	if (result < 0) {
-		return DNSSEC_NSEC3_HASHING_ERROR;
-	}
-
 	const uint8_t *in = data->data;
 	size_t in_size = data->size;
 
@@ -99,7 +89,18 @@ int dnssec_nsec3_hash(const dnssec_binary_t *data,
 		      const dnssec_nsec3_params_t *params,
 		      dnssec_binary_t *hash)
 {
-	if (!data || !params || !hash) {
+	return dnssec_nsec3_hash_batch(data, 1, params, hash);
+}
+
+/*!
+ * Compute NSEC3 hashes for a batch of data.
+ */
+_public_
+int dnssec_nsec3_hash_batch(const dnssec_binary_t *data, size_t count,
+			    const dnssec_nsec3_params_t *params,
+			    dnssec_binary_t *hashes)
+{
+	if (!data || !params || !hashes) {
 		return DNSSEC_EINVAL;
 	}
 
@@ -108,7 +109,27 @@ int dnssec_nsec3_hash(const dnssec_binary_t *data,
 		return DNSSEC_INVALID_NSEC3_ALGORITHM;
 	}
 
-	return nsec3_hash(algorithm, params->iterations, &params->salt, data, hash);
+	int hash_size = gnutls_hash_get_len(algorithm);
+	if (hash_size <= 0) {
+		return DNSSEC_NSEC3_HASHING_ERROR;
+	}
+
+	// One digest context is shared by the whole batch.
+	_cleanup_hash_ gnutls_hash_hd_t digest = NULL;
+	int result = gnutls_hash_init(&digest, algorithm);
+	if (result < 0) {
+		return DNSSEC_NSEC3_HASHING_ERROR;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		result = nsec3_hash(digest, hash_size, params->iterations,
+				    &params->salt, &data[i], &hashes[i]);
+		if (result != DNSSEC_EOK) {
+			return result;
+		}
+	}
+
+	return DNSSEC_EOK;
 }
 
 /*!
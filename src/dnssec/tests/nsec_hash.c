@@ -82,6 +82,32 @@ static void test_hashing(void)
 	   "valid hash");
 
 	dnssec_binary_free(&hash);
+
+	const dnssec_binary_t batch[] = {
+		dname,
+		{ .size = 4, .data = (uint8_t *) "\x02""cz" },
+		dname,
+	};
+	dnssec_binary_t hashes[3] = { { 0 } };
+
+	result = dnssec_nsec3_hash_batch(batch, 3, &params, hashes);
+	ok(result == DNSSEC_EOK, "dnssec_nsec3_hash_batch()");
+
+	ok(hashes[0].size == expected.size && hashes[0].data != NULL &&
+	   memcmp(hashes[0].data, expected.data, expected.size) == 0 &&
+	   hashes[2].size == expected.size && hashes[2].data != NULL &&
+	   memcmp(hashes[2].data, expected.data, expected.size) == 0,
+	   "valid batch hashes");
+
+	result = dnssec_nsec3_hash(&batch[1], &params, &hash);
+	ok(result == DNSSEC_EOK && hash.size == hashes[1].size &&
+	   memcmp(hash.data, hashes[1].data, hash.size) == 0,
+	   "batch hash matches single hash");
+
+	dnssec_binary_free(&hash);
+	for (int i = 0; i < 3; i++) {
+		dnssec_binary_free(&hashes[i]);
+	}
 }
 
 static void test_clear(void)
@@ -15,6 +15,7 @@
  */
 
 #include <sys/time.h>
+#include <time.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -24,39 +25,195 @@
 #include "knot/server/dthreads.h"
 #include "knot/common/evsched.h"
 
-/*! \brief Some implementations of timercmp >= are broken, this is for compat.*/
-static inline int timercmp_ge(struct timeval *a, struct timeval *b) {
-	return timercmp(a, b, >) || timercmp(a, b, ==);
+#define WHEEL_MASK	(EVSCHED_WHEEL_SLOTS - 1)
+#define WHEEL_EXPIRED	EVSCHED_WHEEL_LEVELS /* Level of the expired events. */
+#define WHEEL_NEVER	UINT64_MAX
+
+/* The wheel runs on the monotonic clock if the condition variable can use it. */
+#if defined(HAVE_CLOCK_GETTIME) && defined(HAVE_PTHREAD_CONDATTR_SETCLOCK)
+#define EVSCHED_MONOTONIC
+#endif
+
+/*! \brief Get current time in milliseconds. */
+static uint64_t time_now_ms(void)
+{
+#ifdef EVSCHED_MONOTONIC
+	struct timespec ts = { 0 };
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#else
+	struct timeval tv = { 0 };
+	gettimeofday(&tv, NULL);
+
+	return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+#endif
+}
+
+static unsigned level_shift(unsigned level)
+{
+	return level * EVSCHED_WHEEL_BITS;
+}
+
+/*! \brief Insert the event into the wheel level and slot covering its time. */
+static void wheel_insert(evsched_t *sched, event_t *ev)
+{
+	/* Overdue events are processed with the next millisecond. */
+	uint64_t expires = (ev->expires > sched->wheel_time) ? ev->expires : sched->wheel_time;
+
+	/* The event slot on a level is cascaded before or at the event time. */
+	unsigned level = 0;
+	uint64_t diff = 0;
+	for (; level < EVSCHED_WHEEL_LEVELS; level++) {
+		unsigned shift = level_shift(level);
+		diff = (expires >> shift) - (sched->wheel_time >> shift);
+		if (diff < EVSCHED_WHEEL_SLOTS) {
+			break;
+		}
+	}
+
+	/* Beyond the wheel, cascaded again from the last slot. */
+	if (level == EVSCHED_WHEEL_LEVELS) {
+		level = EVSCHED_WHEEL_LEVELS - 1;
+		diff = EVSCHED_WHEEL_SLOTS - 1;
+	}
+
+	unsigned slot = ((sched->wheel_time >> level_shift(level)) + diff) & WHEEL_MASK;
+	add_tail(&sched->wheel[level][slot], &ev->n);
+	sched->occupied[level] |= (uint64_t)1 << slot;
+	ev->level = level;
+	ev->slot = slot;
 }
 
-static int compare_event_heap_nodes(void *e1, void *e2)
+/*! \brief Remove the event from the wheel or from the expired events. */
+static void wheel_remove(evsched_t *sched, event_t *ev)
 {
-	if (timercmp(&((event_t *)e1)->tv, &((event_t *)e2)->tv, <)) return -1;
-	if (timercmp(&((event_t *)e1)->tv, &((event_t *)e2)->tv, >)) return 1;
-	return 0;
+	if (ev->level < 0) {
+		return;
+	}
+
+	rem_node(&ev->n);
+	if (ev->level < WHEEL_EXPIRED &&
+	    EMPTY_LIST(sched->wheel[ev->level][ev->slot])) {
+		sched->occupied[ev->level] &= ~((uint64_t)1 << ev->slot);
+	}
+	ev->level = -1;
 }
 
 /*!
- * \brief Get time T (now) + dt miliseconds.
+ * \brief Get the next millisecond when an event expires or a non-empty slot
+ *        is cascaded.
  */
-static struct timeval timeval_in(uint32_t dt)
+static uint64_t wheel_next(evsched_t *sched)
 {
-	struct timeval tv = { 0 };
-	gettimeofday(&tv, NULL);
+	uint64_t next = WHEEL_NEVER;
 
-	/* Add number of seconds. */
-	tv.tv_sec += dt / 1000;
+	for (unsigned level = 0; level < EVSCHED_WHEEL_LEVELS; level++) {
+		uint64_t occupied = sched->occupied[level];
+		if (occupied == 0) {
+			continue;
+		}
 
-	/* Add the number of microseconds. */
-	tv.tv_usec += (dt % 1000) * 1000;
+		/* Rotate the bitmap so that the current slot is the lowest bit. */
+		unsigned shift = level_shift(level);
+		uint64_t base = sched->wheel_time >> shift;
+		unsigned current = base & WHEEL_MASK;
+		occupied = (occupied >> current) |
+		           (current > 0 ? occupied << (EVSCHED_WHEEL_SLOTS - current) : 0);
 
-	/* Check for overflow. */
-	while (tv.tv_usec > 999999) {
-		tv.tv_sec += 1;
-		tv.tv_usec -= 1 * 1000 * 1000;
+		uint64_t when = (base + __builtin_ctzll(occupied)) << shift;
+		if (when < sched->wheel_time) {
+			when = sched->wheel_time;
+		}
+		if (when < next) {
+			next = when;
+		}
 	}
 
-	return tv;
+	return next;
+}
+
+/*! \brief Process one millisecond of the wheel, collect the expired events. */
+static void wheel_tick(evsched_t *sched, uint64_t tick)
+{
+	sched->wheel_time = tick;
+
+	/* Cascade the slots of the higher levels starting at this tick. */
+	for (unsigned level = 1; level < EVSCHED_WHEEL_LEVELS; level++) {
+		unsigned shift = level_shift(level);
+		if ((tick & (((uint64_t)1 << shift) - 1)) != 0) {
+			break;
+		}
+
+		list_t *slot = &sched->wheel[level][(tick >> shift) & WHEEL_MASK];
+		event_t *ev;
+		WALK_LIST_FIRST(ev, *slot) {
+			wheel_remove(sched, ev);
+			wheel_insert(sched, ev);
+		}
+	}
+
+	list_t *slot = &sched->wheel[0][tick & WHEEL_MASK];
+	event_t *ev;
+	WALK_LIST_FIRST(ev, *slot) {
+		wheel_remove(sched, ev);
+		add_tail(&sched->expired, &ev->n);
+		ev->level = WHEEL_EXPIRED;
+	}
+
+	sched->wheel_time = tick + 1;
+}
+
+/*!
+ * \brief Move the wheel back to the current time if the clock went backwards.
+ *
+ * The pending events keep their remaining time, so that they don't wait for
+ * the clock to catch up.
+ */
+static bool wheel_rebase(evsched_t *sched, uint64_t now)
+{
+	/* The wheel is normally at most one millisecond ahead. */
+	if (now + 1 >= sched->wheel_time) {
+		return false;
+	}
+
+	uint64_t step = sched->wheel_time - now;
+
+	list_t pending;
+	init_list(&pending);
+	for (unsigned level = 0; level < EVSCHED_WHEEL_LEVELS; level++) {
+		for (unsigned slot = 0; slot < EVSCHED_WHEEL_SLOTS; slot++) {
+			event_t *ev;
+			WALK_LIST_FIRST(ev, sched->wheel[level][slot]) {
+				wheel_remove(sched, ev);
+				add_tail(&pending, &ev->n);
+			}
+		}
+	}
+
+	sched->wheel_time = now;
+
+	event_t *ev;
+	WALK_LIST_FIRST(ev, pending) {
+		rem_node(&ev->n);
+		ev->expires = (ev->expires > step) ? ev->expires - step : 0;
+		wheel_insert(sched, ev);
+	}
+
+	return true;
+}
+
+/*! \brief Advance the wheel up to the given time, skipping the idle periods. */
+static void wheel_advance(evsched_t *sched, uint64_t now)
+{
+	while (sched->wheel_time <= now) {
+		uint64_t next = wheel_next(sched);
+		if (next > now) {
+			sched->wheel_time = now + 1;
+			break;
+		}
+		wheel_tick(sched, next);
+	}
 }
 
 /*! \brief Event scheduler loop. */
@@ -68,33 +225,34 @@ static int evsched_run(dthread_t *thread)
 	}
 
 	/* Run event loop. */
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 	while (!dt_is_cancelled(thread)) {
-		if (EMPTY_HEAP(&sched->heap)) {
-			pthread_cond_wait(&sched->notify, &sched->heap_lock);
+		/* Dispatch all the expired events at once. */
+		uint64_t now = time_now_ms();
+		(void)wheel_rebase(sched, now);
+		wheel_advance(sched, now);
+		if (!EMPTY_LIST(sched->expired)) {
+			event_t *ev;
+			WALK_LIST_FIRST(ev, sched->expired) {
+				wheel_remove(sched, ev);
+				ev->cb(ev);
+			}
 			continue;
 		}
 
-		/* Get current time. */
-		struct timeval dt;
-		gettimeofday(&dt, 0);
-
-		/* Get next event. */
-		event_t *ev = *((event_t**)HHEAD(&sched->heap));
-		assert(ev != NULL);
-
-		if (timercmp_ge(&dt, &ev->tv)) {
-			heap_delmin(&sched->heap);
-			ev->cb(ev);
+		/* Wait for next event or interrupt. Unlock calendar. */
+		sched->wakeup = wheel_next(sched);
+		if (sched->wakeup == WHEEL_NEVER) {
+			pthread_cond_wait(&sched->notify, &sched->lock);
 		} else {
-			/* Wait for next event or interrupt. Unlock calendar. */
 			struct timespec ts;
-			ts.tv_sec = ev->tv.tv_sec;
-			ts.tv_nsec = ev->tv.tv_usec * 1000L;
-			pthread_cond_timedwait(&sched->notify, &sched->heap_lock, &ts);
+			ts.tv_sec = sched->wakeup / 1000;
+			ts.tv_nsec = (sched->wakeup % 1000) * 1000000L;
+			pthread_cond_timedwait(&sched->notify, &sched->lock, &ts);
 		}
+		sched->wakeup = 0;
 	}
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 
 	return KNOT_EOK;
 }
@@ -105,9 +263,23 @@ int evsched_init(evsched_t *sched, void *ctx)
 	sched->ctx = ctx;
 
 	/* Initialize event calendar. */
-	pthread_mutex_init(&sched->heap_lock, 0);
+	pthread_mutex_init(&sched->lock, 0);
+#ifdef EVSCHED_MONOTONIC
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&sched->notify, &attr);
+	pthread_condattr_destroy(&attr);
+#else
 	pthread_cond_init(&sched->notify, 0);
-	heap_init(&sched->heap, compare_event_heap_nodes, 0);
+#endif
+	for (unsigned level = 0; level < EVSCHED_WHEEL_LEVELS; level++) {
+		for (unsigned slot = 0; slot < EVSCHED_WHEEL_SLOTS; slot++) {
+			init_list(&sched->wheel[level][slot]);
+		}
+	}
+	init_list(&sched->expired);
+	sched->wheel_time = time_now_ms();
 
 	sched->thread = dt_create(1, evsched_run, NULL, sched);
 
@@ -126,16 +298,20 @@ void evsched_deinit(evsched_t *sched)
 	}
 
 	/* Deinitialize event calendar. */
-	pthread_mutex_destroy(&sched->heap_lock);
+	pthread_mutex_destroy(&sched->lock);
 	pthread_cond_destroy(&sched->notify);
 
-	while (!EMPTY_HEAP(&sched->heap)) {
-		event_t *e = (event_t *)*HHEAD(&sched->heap);
-		heap_delmin(&sched->heap);
-		evsched_event_free(e);
+	event_t *ev, *nxt;
+	for (unsigned level = 0; level < EVSCHED_WHEEL_LEVELS; level++) {
+		for (unsigned slot = 0; slot < EVSCHED_WHEEL_SLOTS; slot++) {
+			WALK_LIST_DELSAFE(ev, nxt, sched->wheel[level][slot]) {
+				evsched_event_free(ev);
+			}
+		}
+	}
+	WALK_LIST_DELSAFE(ev, nxt, sched->expired) {
+		evsched_event_free(ev);
 	}
-
-	heap_deinit(&sched->heap);
 
 	if (sched->thread != NULL) {
 		dt_delete(&sched->thread);
@@ -163,7 +339,7 @@ event_t *evsched_event_create(evsched_t *sched, event_cb_t cb, void *data)
 	e->sched = sched;
 	e->cb = cb;
 	e->data = data;
-	e->hpos.pos=0;
+	e->level = -1;
 
 	return e;
 }
@@ -183,26 +359,27 @@ int evsched_schedule(event_t *ev, uint32_t dt)
 		return KNOT_EINVAL;
 	}
 
-	struct timeval new_time = timeval_in(dt);
+	uint64_t now = time_now_ms();
+	uint64_t new_time = now + dt;
 
 	evsched_t *sched = ev->sched;
 
 	/* Lock calendar. */
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 
-	ev->tv = new_time;
+	/* Replace the timer if already scheduled. */
+	wheel_remove(sched, ev);
+	bool rebased = wheel_rebase(sched, now);
+	ev->expires = new_time;
+	wheel_insert(sched, ev);
 
-	/* Make sure it's not already enqueued. */
-	int found = heap_find(&sched->heap, (heap_val_t *)ev);
-	if (found > 0) {
-		heap_replace(&sched->heap, found, (heap_val_t *)ev);
-	} else {
-		heap_insert(&sched->heap, (heap_val_t *)ev);
+	/* Wake up the scheduler only if the event is due before its wakeup. */
+	if (rebased || ev->expires < sched->wakeup) {
+		pthread_cond_signal(&sched->notify);
 	}
 
 	/* Unlock calendar. */
-	pthread_cond_signal(&sched->notify);
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 
 	return KNOT_EOK;
 }
@@ -216,19 +393,15 @@ int evsched_cancel(event_t *ev)
 	evsched_t *sched = ev->sched;
 
 	/* Lock calendar. */
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 
-	int found = heap_find(&sched->heap, (heap_val_t *)ev);
-	if (found > 0) {
-		heap_delete(&sched->heap, found);
-	}
+	wheel_remove(sched, ev);
 
 	/* Unlock calendar. */
-	pthread_cond_signal(&sched->notify);
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 
 	/* Reset event timer. */
-	memset(&ev->tv, 0, sizeof(struct timeval));
+	ev->expires = 0;
 
 	return KNOT_EOK;
 }
@@ -240,10 +413,10 @@ void evsched_start(evsched_t *sched)
 
 void evsched_stop(evsched_t *sched)
 {
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 	dt_stop(sched->thread);
 	pthread_cond_signal(&sched->notify);
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 }
 
 void evsched_join(evsched_t *sched)
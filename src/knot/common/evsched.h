@@ -25,7 +25,14 @@
 #include <sys/time.h>
 
 #include "knot/server/dthreads.h"
-#include "contrib/ucw/heap.h"
+#include "contrib/ucw/lists.h"
+
+/*! \brief Number of timer wheel levels. */
+#define EVSCHED_WHEEL_LEVELS	6
+/*! \brief Number of bits of the slot index in one timer wheel level. */
+#define EVSCHED_WHEEL_BITS	6
+/*! \brief Number of slots in one timer wheel level. */
+#define EVSCHED_WHEEL_SLOTS	(1 << EVSCHED_WHEEL_BITS)
 
 /* Forward decls. */
 struct evsched;
@@ -50,8 +57,10 @@ typedef void (*event_cb_t)(struct event *);
  * \brief Event structure.
  */
 typedef struct event {
-	struct heap_val hpos;
-	struct timeval tv; /*!< Event scheduled time. */
+	node_t n;          /*!< Node in the timer wheel slot or the expired list. */
+	uint64_t expires;  /*!< Event scheduled time (milliseconds, monotonic clock). */
+	int level;         /*!< Timer wheel level, -1 if not scheduled. */
+	unsigned slot;     /*!< Timer wheel slot. */
 	void *data;        /*!< Usable data ptr. */
 	event_cb_t cb;     /*!< Event callback. */
 	struct evsched *sched; /*!< Scheduler for this event. */
@@ -59,12 +68,22 @@ typedef struct event {
 
 /*!
  * \brief Event scheduler structure.
+ *
+ * The events are kept in a hierarchical timer wheel with a resolution of one
+ * millisecond. Each level covers EVSCHED_WHEEL_SLOTS times longer period than
+ * the previous one and its slots are cascaded to the lower levels when the
+ * wheel time reaches them. Expired events are collected and dispatched
+ * in batches.
  */
 typedef struct evsched {
 	volatile bool running;     /*!< True if running. */
-	pthread_mutex_t heap_lock; /*!< Event heap locking. */
-	pthread_cond_t notify;     /*!< Event heap notification. */
-	struct heap heap;          /*!< Event heap. */
+	pthread_mutex_t lock;      /*!< Timer wheel locking. */
+	pthread_cond_t notify;     /*!< Timer wheel notification. */
+	list_t wheel[EVSCHED_WHEEL_LEVELS][EVSCHED_WHEEL_SLOTS]; /*!< Timer wheel slots. */
+	uint64_t occupied[EVSCHED_WHEEL_LEVELS]; /*!< Bitmaps of non-empty slots. */
+	uint64_t wheel_time;       /*!< Next millisecond to be processed. */
+	uint64_t wakeup;           /*!< Time the scheduler thread sleeps until. */
+	list_t expired;            /*!< Expired events to be dispatched. */
 	void *ctx;                 /*!< Scheduler context. */
 	dt_unit_t *thread;
 } evsched_t;
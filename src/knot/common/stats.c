@@ -24,6 +24,7 @@
 #include "knot/common/stats.h"
 #include "knot/common/log.h"
 #include "knot/nameserver/query_module.h"
+#include "knot/worker/pool.h"
 
 struct {
 	bool active_dumper;
@@ -51,15 +52,43 @@ uint64_t server_zone_count(server_t *server)
 	return knot_zonedb_size(server->zone_db);
 }
 
+/*! \brief Define a getter of a background worker metric of a priority class. */
+#define WORKER_STATS_VAL(prio_name, prio, metric) \
+static uint64_t server_bg_##prio_name##_##metric(server_t *server) \
+{ \
+	worker_pool_stats_t worker_stats; \
+	worker_pool_stats(server->workers, prio, &worker_stats); \
+	return worker_stats.metric; \
+}
+
+#define WORKER_STATS_VALS(prio_name, prio) \
+	WORKER_STATS_VAL(prio_name, prio, queued) \
+	WORKER_STATS_VAL(prio_name, prio, executed) \
+	WORKER_STATS_VAL(prio_name, prio, wait_usec) \
+	WORKER_STATS_VAL(prio_name, prio, wait_max_usec)
+
+WORKER_STATS_VALS(high,   WORKER_PRIO_HIGH)
+WORKER_STATS_VALS(normal, WORKER_PRIO_NORMAL)
+WORKER_STATS_VALS(low,    WORKER_PRIO_LOW)
+
+#define WORKER_STATS_ITEMS(prio_name) \
+	{ "bg-"#prio_name"-queued",        server_bg_##prio_name##_queued }, \
+	{ "bg-"#prio_name"-executed",      server_bg_##prio_name##_executed }, \
+	{ "bg-"#prio_name"-wait-usec",     server_bg_##prio_name##_wait_usec }, \
+	{ "bg-"#prio_name"-wait-max-usec", server_bg_##prio_name##_wait_max_usec }
+
 const stats_item_t server_stats[] = {
 	{ "zone-count", server_zone_count },
+	WORKER_STATS_ITEMS(high),
+	WORKER_STATS_ITEMS(normal),
+	WORKER_STATS_ITEMS(low),
 	{ 0 }
 };
 
-static void dump_counters(FILE *fd, int level, mod_ctr_t *ctr)
+static void dump_counters(FILE *fd, int level, knotd_mod_t *mod, mod_ctr_t *ctr)
 {
 	for (uint32_t j = 0; j < ctr->count; j++) {
-		uint64_t counter = ATOMIC_GET(ctr->counters[j]);
+		uint64_t counter = mod_stats_get(mod, ctr, j);
 
 		// Skip empty counters.
 		if (counter == 0) {
@@ -109,19 +138,19 @@ static void dump_modules(dump_ctx_t *ctx)
 		// Dump module counters.
 		DUMP_STR(ctx->fd, level, "%s", mod->id->name + 1, "");
 		for (int i = 0; i < mod->stats_count; i++) {
-			mod_ctr_t *ctr = mod->stats + i;
+			mod_ctr_t *ctr = mod->stats_info + i;
 			if (ctr->name == NULL) {
 				// Empty counter.
 				continue;
 			}
 			if (ctr->count == 1) {
 				// Simple counter.
-				uint64_t counter = ATOMIC_GET(ctr->counter);
+				uint64_t counter = mod_stats_get(mod, ctr, 0);
 				DUMP_CTR(ctx->fd, level + 1, "%s", ctr->name, counter);
 			} else {
 				// Array of counters.
 				DUMP_STR(ctx->fd, level + 1, "%s", ctr->name, "");
-				dump_counters(ctx->fd, level + 2, ctr);
+				dump_counters(ctx->fd, level + 2, mod, ctr);
 			}
 		}
 	}
@@ -20,6 +20,7 @@
 #include "knot/conf/base.h"
 #include "knot/conf/confdb.h"
 #include "knot/conf/module.h"
+#include "knot/conf/snapshot.h"
 #include "knot/conf/tools.h"
 #include "knot/common/log.h"
 #include "knot/nameserver/query_module.h"
@@ -398,6 +399,8 @@ void conf_free(
 		mm_free(conf->mm, conf->io.zones);
 	}
 
+	conf_snapshot_free(conf);
+
 	conf_mod_load_purge(conf, false);
 	conf_deactivate_modules(conf->query_modules, &conf->query_plan);
 	mm_free(conf->mm, conf->query_modules);
@@ -697,6 +700,11 @@ int conf_import(
 	// Update cached values.
 	init_cache(conf);
 
+	// Update the zone snapshot if used.
+	if (conf->snapshot != NULL && conf_snapshot_build(conf) != KNOT_EOK) {
+		conf_snapshot_free(conf);
+	}
+
 	// Reset the filename.
 	free(conf->filename);
 	conf->filename = NULL;
@@ -127,6 +127,9 @@ typedef struct {
 		conf_val_t srv_nsid;
 	} cache;
 
+	/*! Compiled per-zone configuration (server configuration only). */
+	struct conf_snapshot *snapshot;
+
 	/*! List of dynamically loaded modules. */
 	mod_dynarray_t modules;
 	/*! List of old schemas (lazy freed). */
@@ -32,6 +32,7 @@
 #define C_ACTION		"\x06""action"
 #define C_ADDR			"\x07""address"
 #define C_ALG			"\x09""algorithm"
+#define C_ANSWER_CACHE		"\x0C""answer-cache"
 #define C_ANY			"\x03""any"
 #define C_APPEND		"\x06""append"
 #define C_ASYNC_START		"\x0B""async-start"
@@ -40,8 +41,11 @@
 #define C_CHILD_RECORDS		"\x13""cds-cdnskey-publish"
 #define C_CHK_INTERVAL		"\x0E""check-interval"
 #define C_COMMENT		"\x07""comment"
+#define C_COMPACT_CONTENTS	"\x10""compact-contents"
 #define C_CONFIG		"\x06""config"
 #define C_CTL			"\x07""control"
+#define C_DDNS_BATCH_DELAY	"\x10""ddns-batch-delay"
+#define C_DDNS_BATCH_SIZE	"\x0F""ddns-batch-size"
 #define C_DDNS_MASTER		"\x0B""ddns-master"
 #define C_DENY			"\x04""deny"
 #define C_DISABLE_ANY		"\x0B""disable-any"
@@ -55,9 +59,11 @@
 #define C_IDENT			"\x08""identity"
 #define C_INCL			"\x07""include"
 #define C_IXFR_DIFF		"\x15""ixfr-from-differences" /* obsolete */
+#define C_JOURNAL_COMPRESSION	"\x13""journal-compression"
 #define C_JOURNAL_CONTENT	"\x0F""journal-content"
 #define C_JOURNAL_DB		"\x0A""journal-db"
 #define C_JOURNAL_DB_MODE	"\x0F""journal-db-mode"
+#define C_JOURNAL_DB_SHARDS	"\x11""journal-db-shards"
 #define C_KASP_DB		"\x07""kasp-db"
 #define C_KEY			"\x03""key"
 #define C_KEYSTORE		"\x08""keystore"
@@ -66,6 +72,7 @@
 #define C_KSK_SHARED		"\x0a""ksk-shared"
 #define C_KSK_SIZE		"\x08""ksk-size"
 #define C_LISTEN		"\x06""listen"
+#define C_LOAD_THREADS	"\x0C""load-threads"
 #define C_LOG			"\x03""log"
 #define C_MANUAL		"\x06""manual"
 #define C_MASTER		"\x06""master"
@@ -103,6 +110,7 @@
 #define C_SEM_CHECKS		"\x0F""semantic-checks"
 #define C_SERIAL_POLICY		"\x0D""serial-policy"
 #define C_SERVER		"\x06""server"
+#define C_SIGNING_THREADS	"\x0F""signing-threads"
 #define C_SINGLE_TYPE_SIGNING	"\x13""single-type-signing"
 #define C_SRV			"\x06""server"
 #define C_STATS			"\x0A""statistics"
@@ -120,8 +128,10 @@
 #define C_USER			"\x04""user"
 #define C_VERSION		"\x07""version"
 #define C_VIA			"\x03""via"
+#define C_XFR_CACHE		"\x09""xfr-cache"
 #define C_ZONE			"\x04""zone"
 #define C_ZONEFILE_LOAD		"\x0D""zonefile-load"
+#define C_ZONEFILE_SNAPSHOT	"\x11""zonefile-snapshot"
 #define C_ZONEFILE_SYNC		"\x0D""zonefile-sync"
 #define C_ZSK_LIFETIME		"\x0C""zsk-lifetime"
 #define C_ZSK_SIZE		"\x08""zsk-size"
@@ -0,0 +1,245 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "knot/conf/snapshot.h"
+#include "knot/conf/conf.h"
+#include "libknot/libknot.h"
+#include "contrib/mempattern.h"
+#include "contrib/qp-trie/trie.h"
+#include "contrib/ucw/mempool.h"
+
+struct conf_snapshot {
+	/*! Memory context of all the compiled items. */
+	knot_mm_t mm;
+	/*! Compiled zones indexed by the zone name. */
+	trie_t *zones;
+	/*! Compiled ACL rules indexed by the ACL identifier. */
+	trie_t *acls;
+};
+
+static void snapshot_free(
+	struct conf_snapshot *snap)
+{
+	if (snap == NULL) {
+		return;
+	}
+
+	trie_free(snap->zones);
+	trie_free(snap->acls);
+	mp_delete(snap->mm.ctx);
+	free(snap);
+}
+
+static int compile_acl(
+	conf_t *conf,
+	knot_mm_t *mm,
+	conf_val_t *id,
+	conf_snap_acl_t *out)
+{
+	conf_val_t val = conf_id_get(conf, C_ACL, C_ADDR, id);
+	out->addr_count = conf_val_count(&val);
+	if (out->addr_count > 0) {
+		out->addrs = mm_alloc(mm, out->addr_count * sizeof(*out->addrs));
+		if (out->addrs == NULL) {
+			return KNOT_ENOMEM;
+		}
+		for (size_t i = 0; i < out->addr_count; i++) {
+			conf_snap_addr_t *addr = &out->addrs[i];
+			addr->min = conf_addr_range(&val, &addr->max, &addr->prefix);
+			conf_val_next(&val);
+		}
+	}
+
+	val = conf_id_get(conf, C_ACL, C_KEY, id);
+	out->key_count = conf_val_count(&val);
+	if (out->key_count > 0) {
+		out->keys = mm_alloc(mm, out->key_count * sizeof(*out->keys));
+		if (out->keys == NULL) {
+			return KNOT_ENOMEM;
+		}
+		for (size_t i = 0; i < out->key_count; i++) {
+			knot_tsig_key_t *key = &out->keys[i];
+
+			key->name = knot_dname_copy(conf_dname(&val), mm);
+			if (key->name == NULL) {
+				return KNOT_ENOMEM;
+			}
+
+			conf_val_t alg = conf_id_get(conf, C_KEY, C_ALG, &val);
+			key->algorithm = conf_opt(&alg);
+
+			size_t secret_len;
+			conf_val_t secret = conf_id_get(conf, C_KEY, C_SECRET, &val);
+			const uint8_t *secret_data = conf_bin(&secret, &secret_len);
+			key->secret.size = secret_len;
+			key->secret.data = mm_alloc(mm, secret_len);
+			if (key->secret.data == NULL && secret_len > 0) {
+				return KNOT_ENOMEM;
+			}
+			if (secret_len > 0) {
+				memcpy(key->secret.data, secret_data, secret_len);
+			}
+
+			conf_val_next(&val);
+		}
+	}
+
+	val = conf_id_get(conf, C_ACL, C_ACTION, id);
+	while (val.code == KNOT_EOK) {
+		out->actions |= 1 << conf_opt(&val);
+		conf_val_next(&val);
+	}
+
+	val = conf_id_get(conf, C_ACL, C_DENY, id);
+	out->deny = conf_bool(&val);
+
+	return KNOT_EOK;
+}
+
+static const conf_snap_acl_t *get_acl(
+	conf_t *conf,
+	struct conf_snapshot *snap,
+	conf_val_t *id)
+{
+	conf_val(id);
+
+	trie_val_t *val = trie_get_ins(snap->acls, (const char *)id->data, id->len);
+	if (val == NULL) {
+		return NULL;
+	} else if (*val != NULL) {
+		return *val;
+	}
+
+	conf_snap_acl_t *acl = mm_alloc(&snap->mm, sizeof(*acl));
+	if (acl == NULL) {
+		return NULL;
+	}
+	memset(acl, 0, sizeof(*acl));
+
+	if (compile_acl(conf, &snap->mm, id, acl) != KNOT_EOK) {
+		return NULL;
+	}
+
+	*val = acl;
+
+	return acl;
+}
+
+static int compile_zone(
+	conf_t *conf,
+	struct conf_snapshot *snap,
+	const knot_dname_t *name)
+{
+	conf_snap_zone_t *zone = mm_alloc(&snap->mm, sizeof(*zone));
+	if (zone == NULL) {
+		return KNOT_ENOMEM;
+	}
+	memset(zone, 0, sizeof(*zone));
+
+	conf_val_t val = conf_zone_get(conf, C_ACL, name);
+	zone->acl_count = conf_val_count(&val);
+	if (zone->acl_count > 0) {
+		zone->acl = mm_alloc(&snap->mm, zone->acl_count * sizeof(*zone->acl));
+		if (zone->acl == NULL) {
+			return KNOT_ENOMEM;
+		}
+		for (size_t i = 0; i < zone->acl_count; i++) {
+			zone->acl[i] = get_acl(conf, snap, &val);
+			if (zone->acl[i] == NULL) {
+				return KNOT_ENOMEM;
+			}
+			conf_val_next(&val);
+		}
+	}
+
+	val = conf_zone_get(conf, C_MASTER, name);
+	zone->master_count = conf_val_count(&val);
+
+	val = conf_zone_get(conf, C_DISABLE_ANY, name);
+	zone->disable_any = conf_bool(&val);
+
+	trie_val_t *zone_val = trie_get_ins(snap->zones, (const char *)name,
+	                                    knot_dname_size(name));
+	if (zone_val == NULL) {
+		return KNOT_ENOMEM;
+	}
+	*zone_val = zone;
+
+	return KNOT_EOK;
+}
+
+int conf_snapshot_build(
+	conf_t *conf)
+{
+	if (conf == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	struct conf_snapshot *snap = calloc(1, sizeof(*snap));
+	if (snap == NULL) {
+		return KNOT_ENOMEM;
+	}
+	mm_ctx_mempool(&snap->mm, MM_DEFAULT_BLKSIZE);
+
+	snap->zones = trie_create(&snap->mm);
+	snap->acls = trie_create(&snap->mm);
+	if (snap->zones == NULL || snap->acls == NULL) {
+		snapshot_free(snap);
+		return KNOT_ENOMEM;
+	}
+
+	for (conf_iter_t iter = conf_iter(conf, C_ZONE); iter.code == KNOT_EOK;
+	     conf_iter_next(conf, &iter)) {
+		conf_val_t id = conf_iter_id(conf, &iter);
+		int ret = compile_zone(conf, snap, conf_dname(&id));
+		if (ret != KNOT_EOK) {
+			conf_iter_finish(conf, &iter);
+			snapshot_free(snap);
+			return ret;
+		}
+	}
+
+	snapshot_free(conf->snapshot);
+	conf->snapshot = snap;
+
+	return KNOT_EOK;
+}
+
+void conf_snapshot_free(
+	conf_t *conf)
+{
+	if (conf == NULL) {
+		return;
+	}
+
+	snapshot_free(conf->snapshot);
+	conf->snapshot = NULL;
+}
+
+const conf_snap_zone_t *conf_snapshot_zone(
+	conf_t *conf,
+	const knot_dname_t *zone)
+{
+	if (conf == NULL || conf->snapshot == NULL || zone == NULL) {
+		return NULL;
+	}
+
+	trie_val_t *val = trie_get_try(conf->snapshot->zones, (const char *)zone,
+	                               knot_dname_size(zone));
+	return (val != NULL) ? *val : NULL;
+}
@@ -0,0 +1,106 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \file
+ *
+ * Compiled per-zone configuration snapshot.
+ *
+ * The snapshot is built once for the server configuration and holds decoded
+ * zone items needed by the query processing, so that it doesn't have to
+ * access the configuration database.
+ *
+ * \addtogroup config
+ *
+ * @{
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <sys/socket.h>
+
+#include "libknot/tsig.h"
+#include "knot/conf/base.h"
+
+/*! Compiled address (network or range) match. */
+typedef struct {
+	/*! Network address or range minimum. */
+	struct sockaddr_storage min;
+	/*! Range maximum (AF_UNSPEC if network). */
+	struct sockaddr_storage max;
+	/*! Network prefix length. */
+	int prefix;
+} conf_snap_addr_t;
+
+/*! Compiled ACL rule. */
+typedef struct {
+	/*! Address matches (empty means any address). */
+	conf_snap_addr_t *addrs;
+	size_t addr_count;
+	/*! TSIG keys including secrets (empty means no key). */
+	knot_tsig_key_t *keys;
+	size_t key_count;
+	/*! Bitmap of allowed actions (1 << action). */
+	unsigned actions;
+	/*! Deny indication. */
+	bool deny;
+} conf_snap_acl_t;
+
+/*! Compiled zone configuration. */
+typedef struct {
+	/*! Zone ACL rules in the configuration order. */
+	const conf_snap_acl_t **acl;
+	size_t acl_count;
+	/*! Number of zone masters. */
+	size_t master_count;
+	/*! Disable ANY query type flag. */
+	bool disable_any;
+} conf_snap_zone_t;
+
+/*!
+ * Builds (or rebuilds) the configuration snapshot for all configured zones.
+ *
+ * \param[in] conf  Configuration.
+ *
+ * \return Error code, KNOT_EOK if success.
+ */
+int conf_snapshot_build(
+	conf_t *conf
+);
+
+/*!
+ * Frees the configuration snapshot.
+ *
+ * \param[in] conf  Configuration.
+ */
+void conf_snapshot_free(
+	conf_t *conf
+);
+
+/*!
+ * Gets the compiled zone configuration.
+ *
+ * \param[in] conf  Configuration.
+ * \param[in] zone  Zone name.
+ *
+ * \return Compiled zone configuration or NULL if not available.
+ */
+const conf_snap_zone_t *conf_snapshot_zone(
+	conf_t *conf,
+	const knot_dname_t *zone
+);
+
+/*! @} */
@@ -421,6 +421,7 @@ int check_template(
 	CHECK_DFLT(C_MAX_TIMER_DB_SIZE, "timer database maximum size");
 	CHECK_DFLT(C_JOURNAL_DB, "journal database path");
 	CHECK_DFLT(C_JOURNAL_DB_MODE, "journal database mode");
+	CHECK_DFLT(C_JOURNAL_DB_SHARDS, "journal database shards");
 	CHECK_DFLT(C_MAX_JOURNAL_DB_SIZE, "journal database maximum size");
 	CHECK_DFLT(C_KASP_DB, "KASP database path");
 	CHECK_DFLT(C_MAX_KASP_DB_SIZE, "KASP database maximum size");
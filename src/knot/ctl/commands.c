@@ -1022,13 +1022,14 @@ static int zone_purge(zone_t *zone, ctl_args_t *args)
 	return KNOT_EOK;
 }
 
-static int send_stats_ctr(mod_ctr_t *ctr, ctl_args_t *args, knot_ctl_data_t *data)
+static int send_stats_ctr(knotd_mod_t *mod, mod_ctr_t *ctr, ctl_args_t *args,
+                          knot_ctl_data_t *data)
 {
 	char index[128];
 	char value[32];
 
 	if (ctr->count == 1) {
-		uint64_t counter = ATOMIC_GET(ctr->counter);
+		uint64_t counter = mod_stats_get(mod, ctr, 0);
 		int ret = snprintf(value, sizeof(value), "%"PRIu64, counter);
 		if (ret <= 0 || ret >= sizeof(value)) {
 			return KNOT_ESPACE;
@@ -1046,7 +1047,7 @@ static int send_stats_ctr(mod_ctr_t *ctr, ctl_args_t *args, knot_ctl_data_t *dat
 		                          CTL_FLAG_FORCE);
 
 		for (uint32_t i = 0; i < ctr->count; i++) {
-			uint64_t counter = ATOMIC_GET(ctr->counters[i]);
+			uint64_t counter = mod_stats_get(mod, ctr, i);
 
 			// Skip empty counters.
 			if (counter == 0 && !force) {
@@ -1124,7 +1125,7 @@ static int modules_stats(list_t *query_modules, ctl_args_t *args, knot_dname_t *
 		data[KNOT_CTL_IDX_SECTION] = mod->id->name + 1;
 
 		for (int i = 0; i < mod->stats_count; i++) {
-			mod_ctr_t *ctr = mod->stats + i;
+			mod_ctr_t *ctr = mod->stats_info + i;
 
 			// Skip empty counter.
 			if (ctr->name == NULL) {
@@ -1153,7 +1154,7 @@ static int modules_stats(list_t *query_modules, ctl_args_t *args, knot_dname_t *
 			data[KNOT_CTL_IDX_ITEM] = ctr->name;
 
 			// Send the counters.
-			int ret = send_stats_ctr(ctr, args, &data);
+			int ret = send_stats_ctr(mod, ctr, args, &data);
 			if (ret != KNOT_EOK) {
 				return ret;
 			}
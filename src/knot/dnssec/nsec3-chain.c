@@ -26,6 +26,9 @@
 #include "contrib/macros.h"
 #include "contrib/wire_ctx.h"
 
+/*! \brief Number of owner names hashed at once during chain creation. */
+#define NSEC3_HASH_BATCH 64
+
 /* - NSEC3 node comparison -------------------------------------------------- */
 
 /*!
@@ -125,10 +128,14 @@ static int copy_signatures(zone_tree_t *from, zone_tree_t *to)
 
 	assert(to);
 
-	trie_it_t *it = trie_it_begin(from);
+	zone_tree_it_t it = { 0 };
+	int ret = zone_tree_it_begin(from, &it);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
 
-	for (/* NOP */; !trie_it_finished(it); trie_it_next(it)) {
-		zone_node_t *node_from = (zone_node_t *)*trie_it_val(it);
+	for (/* NOP */; !zone_tree_it_finished(&it); zone_tree_it_next(&it)) {
+		zone_node_t *node_from = zone_tree_it_val(&it);
 
 		zone_node_t *node_to = zone_tree_get(to, node_from->owner);
 		if (node_to == NULL) {
@@ -139,15 +146,14 @@ static int copy_signatures(zone_tree_t *from, zone_tree_t *to)
 			continue;
 		}
 
-		int ret = shallow_copy_signature(node_from, node_to);
+		ret = shallow_copy_signature(node_from, node_to);
 		if (ret != KNOT_EOK) {
-			trie_it_free(it);
-			return ret;
+			break;
 		}
 	}
 
-	trie_it_free(it);
-	return KNOT_EOK;
+	zone_tree_it_free(&it);
+	return ret;
 }
 
 /*!
@@ -158,9 +164,10 @@ static void free_nsec3_tree(zone_tree_t *nodes)
 {
 	assert(nodes);
 
-	trie_it_t *it = trie_it_begin(nodes);
-	for (/* NOP */; !trie_it_finished(it); trie_it_next(it)) {
-		zone_node_t *node = (zone_node_t *)*trie_it_val(it);
+	zone_tree_it_t it = { 0 };
+	(void)zone_tree_it_begin(nodes, &it);
+	for (/* NOP */; !zone_tree_it_finished(&it); zone_tree_it_next(&it)) {
+		zone_node_t *node = zone_tree_it_val(&it);
 		// newly allocated NSEC3 nodes
 		knot_rdataset_t *nsec3 = node_rdataset(node, KNOT_RRTYPE_NSEC3);
 		knot_rdataset_t *rrsig = node_rdataset(node, KNOT_RRTYPE_RRSIG);
@@ -169,7 +176,7 @@ static void free_nsec3_tree(zone_tree_t *nodes)
 		node_free(&node, NULL);
 	}
 
-	trie_it_free(it);
+	zone_tree_it_free(&it);
 	zone_tree_free(&nodes);
 }
 
@@ -319,30 +326,25 @@ static zone_node_t *create_nsec3_node(const knot_dname_t *owner,
 /*!
  * \brief Create new NSEC3 node for given regular node.
  *
- * \param node       Node for which the NSEC3 node is created.
- * \param apex       Zone apex node.
- * \param params     NSEC3 hash function parameters.
- * \param ttl        TTL of the new NSEC3 node.
- * \param apex_cds   Hint to guess apex node type bitmap: false=just DNSKEY, true=DNSKEY,CDS,CDNSKEY.
+ * \param node         Node for which the NSEC3 node is created.
+ * \param nsec3_owner  Hashed owner name of the NSEC3 node.
+ * \param apex         Zone apex node.
+ * \param params       NSEC3 hash function parameters.
+ * \param ttl          TTL of the new NSEC3 node.
  *
  * \return Error code, KNOT_EOK if successful.
  */
 static zone_node_t *create_nsec3_node_for_node(const zone_node_t *node,
+                                               const knot_dname_t *nsec3_owner,
                                                zone_node_t *apex,
                                                const dnssec_nsec3_params_t *params,
                                                uint32_t ttl)
 {
 	assert(node);
+	assert(nsec3_owner);
 	assert(apex);
 	assert(params);
 
-	uint8_t nsec3_owner[KNOT_DNAME_MAXLEN];
-	int ret = knot_create_nsec3_owner(nsec3_owner, sizeof(nsec3_owner),
-	                                  node->owner, apex->owner, params);
-	if (ret != KNOT_EOK) {
-		return NULL;
-	}
-
 	dnssec_nsec_bitmap_t *rr_types = dnssec_nsec_bitmap_new();
 	if (!rr_types) {
 		return NULL;
@@ -475,6 +477,55 @@ static int connect_nsec3_nodes2(zone_node_t *a, zone_node_t *b,
 	return ret;
 }
 
+/*!
+ * \brief Create NSEC3 nodes for a batch of regular nodes.
+ *
+ * The owner names are hashed at once to share the hashing context.
+ */
+static int create_nsec3_nodes_batch(zone_node_t **nodes, size_t count,
+                                    const zone_contents_t *zone,
+                                    const dnssec_nsec3_params_t *params,
+                                    uint32_t ttl, zone_tree_t *nsec3_nodes)
+{
+	assert(count <= NSEC3_HASH_BATCH);
+
+	dnssec_binary_t names[NSEC3_HASH_BATCH] = { { 0 } };
+	dnssec_binary_t hashes[NSEC3_HASH_BATCH] = { { 0 } };
+	for (size_t i = 0; i < count; i++) {
+		names[i].data = nodes[i]->owner;
+		names[i].size = knot_dname_size(nodes[i]->owner);
+	}
+
+	int ret = dnssec_nsec3_hash_batch(names, count, params, hashes);
+	ret = knot_error_from_libdnssec(ret);
+
+	for (size_t i = 0; ret == KNOT_EOK && i < count; i++) {
+		uint8_t nsec3_owner[KNOT_DNAME_MAXLEN];
+		ret = knot_nsec3_hash_to_dname(nsec3_owner, sizeof(nsec3_owner),
+		                               hashes[i].data, hashes[i].size,
+		                               zone->apex->owner);
+		if (ret != KNOT_EOK) {
+			break;
+		}
+
+		zone_node_t *nsec3_node;
+		nsec3_node = create_nsec3_node_for_node(nodes[i], nsec3_owner,
+		                                        zone->apex, params, ttl);
+		if (!nsec3_node) {
+			ret = KNOT_ENOMEM;
+			break;
+		}
+
+		ret = zone_tree_insert(nsec3_nodes, &nsec3_node);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		dnssec_binary_free(&hashes[i]);
+	}
+
+	return ret;
+}
+
 /*!
  * \brief Create NSEC3 node for each regular node in the zone.
  *
@@ -499,9 +550,13 @@ static int create_nsec3_nodes(const zone_contents_t *zone,
 
 	int result = KNOT_EOK;
 
-	trie_it_t *it = trie_it_begin(zone->nodes);
-	while (!trie_it_finished(it)) {
-		zone_node_t *node = (zone_node_t *)*trie_it_val(it);
+	zone_node_t *batch[NSEC3_HASH_BATCH];
+	size_t batch_count = 0;
+
+	zone_tree_it_t it = { 0 };
+	result = zone_tree_it_begin(zone->nodes, &it);
+	while (result == KNOT_EOK && !zone_tree_it_finished(&it)) {
+		zone_node_t *node = zone_tree_it_val(&it);
 
 		/*!
 		 * Remove possible NSEC from the node. (Do not allow both NSEC
@@ -512,30 +567,36 @@ static int create_nsec3_nodes(const zone_contents_t *zone,
 			break;
 		}
 		if (node_rrtype_exists(node, KNOT_RRTYPE_NSEC)) {
+			result = zone_tree_touch(zone->nodes, node);
+			if (result != KNOT_EOK) {
+				break;
+			}
 			node->flags |= NODE_FLAGS_REMOVED_NSEC;
 		}
 		if (node->flags & NODE_FLAGS_NONAUTH || node->flags & NODE_FLAGS_EMPTY) {
-			trie_it_next(it);
+			zone_tree_it_next(&it);
 			continue;
 		}
 
-		zone_node_t *nsec3_node;
-		nsec3_node = create_nsec3_node_for_node(node, zone->apex,
-							params, ttl);
-		if (!nsec3_node) {
-			result = KNOT_ENOMEM;
-			break;
-		}
-
-		result = zone_tree_insert(nsec3_nodes, nsec3_node);
-		if (result != KNOT_EOK) {
-			break;
+		batch[batch_count++] = node;
+		if (batch_count == NSEC3_HASH_BATCH) {
+			result = create_nsec3_nodes_batch(batch, batch_count, zone,
+			                                  params, ttl, nsec3_nodes);
+			batch_count = 0;
+			if (result != KNOT_EOK) {
+				break;
+			}
 		}
 
-		trie_it_next(it);
+		zone_tree_it_next(&it);
 	}
 
-	trie_it_free(it);
+	zone_tree_it_free(&it);
+
+	if (result == KNOT_EOK && batch_count > 0) {
+		result = create_nsec3_nodes_batch(batch, batch_count, zone,
+		                                  params, ttl, nsec3_nodes);
+	}
 
 	return result;
 }
@@ -611,7 +672,8 @@ static int fix_nsec3_for_node(zone_update_t *update, const dnssec_nsec3_params_t
 
 	// add NSEC3 with correct bitmap
 	if (add_nsec3 && ret == KNOT_EOK) {
-		zone_node_t *new_nsec3_n = create_nsec3_node_for_node(new_n, update->new_cont->apex, params, ttl);
+		zone_node_t *new_nsec3_n = create_nsec3_node_for_node(new_n, for_node_hashed,
+		                                                      update->new_cont->apex, params, ttl);
 		if (new_nsec3_n == NULL) {
 			return KNOT_ENOMEM;
 		}
@@ -651,21 +713,25 @@ static int fix_nsec3_nodes(zone_update_t *update, const dnssec_nsec3_params_t *p
 
 	int ret = KNOT_EOK;
 
-	trie_it_t *rem_it = trie_it_begin(update->change.remove->nodes);
-	while (!trie_it_finished(rem_it) && ret == KNOT_EOK) {
-		zone_node_t *n = (zone_node_t *)*trie_it_val(rem_it);
+	zone_tree_it_t rem_it = { 0 };
+	ret = zone_tree_it_begin(update->change.remove->nodes, &rem_it);
+	while (ret == KNOT_EOK && !zone_tree_it_finished(&rem_it)) {
+		zone_node_t *n = zone_tree_it_val(&rem_it);
 		ret = fix_nsec3_for_node(update, params, ttl, opt_out, chgset, n->owner);
-		trie_it_next(rem_it);
+		zone_tree_it_next(&rem_it);
 	}
-	trie_it_free(rem_it);
+	zone_tree_it_free(&rem_it);
 
-	trie_it_t *add_it = trie_it_begin(update->change.add->nodes);
-	while (!trie_it_finished(add_it) && ret == KNOT_EOK) {
-		zone_node_t *n = (zone_node_t *)*trie_it_val(add_it);
+	zone_tree_it_t add_it = { 0 };
+	if (ret == KNOT_EOK) {
+		ret = zone_tree_it_begin(update->change.add->nodes, &add_it);
+	}
+	while (ret == KNOT_EOK && !zone_tree_it_finished(&add_it)) {
+		zone_node_t *n = zone_tree_it_val(&add_it);
 		ret = fix_nsec3_for_node(update, params, ttl, opt_out, chgset, n->owner);
-		trie_it_next(add_it);
+		zone_tree_it_next(&add_it);
 	}
-	trie_it_free(add_it);
+	zone_tree_it_free(&add_it);
 
 	return ret;
 }
@@ -686,6 +752,14 @@ static bool nsec3_is_empty(zone_node_t *node, bool opt_out)
 	return knot_nsec_empty_nsec_and_rrsigs_in_node(node) || nsec3_opt_out(node, opt_out);
 }
 
+/*!
+ * \brief Context of the empty nodes marking.
+ */
+typedef struct {
+	zone_tree_t *nodes;
+	bool opt_out;
+} mark_empty_ctx_t;
+
 /*!
  * \brief Marks node and its parents as empty if NSEC3 should not be generated
  *        for them.
@@ -695,23 +769,33 @@ static bool nsec3_is_empty(zone_node_t *node, bool opt_out)
  */
 static int nsec3_mark_empty(zone_node_t **node_p, void *data)
 {
+	mark_empty_ctx_t *ctx = data;
 	zone_node_t *node = *node_p;
 
-	if (!(node->flags & NODE_FLAGS_EMPTY) && nsec3_is_empty(node, (data != NULL))) {
+	if (!(node->flags & NODE_FLAGS_EMPTY) && nsec3_is_empty(node, ctx->opt_out)) {
 		/*!
 		 * Mark this node and all parent nodes that meet the same
 		 * criteria as empty.
 		 */
+		int ret = zone_tree_touch(ctx->nodes, node);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
 		node->flags |= NODE_FLAGS_EMPTY;
 
-		if (node->parent) {
+		zone_node_t *parent = node_parent(node);
+		if (parent) {
 			/* We must decrease the parent's children count,
 			 * but only temporarily! It must be set back right after
 			 * the operation
 			 */
-			node->parent->children--;
+			ret = zone_tree_touch(ctx->nodes, parent);
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
+			parent->children--;
 			/* Recurse using the parent node */
-			return nsec3_mark_empty(&node->parent, data);
+			return nsec3_mark_empty(&parent, data);
 		}
 	}
 
@@ -723,7 +807,8 @@ static int nsec3_mark_empty(zone_node_t **node_p, void *data)
  *        count if the node was marked as empty.
  *
  * The children count of node's parent is increased if this node was marked as
- * empty, as it was previously decreased in the \a nsec3_mark_empty() function.
+ * empty, as it was previously decreased in the \a nsec3_mark_empty() function,
+ * which also touched both the nodes.
  */
 static int nsec3_reset(zone_node_t **node_p, void *data)
 {
@@ -734,7 +819,7 @@ static int nsec3_reset(zone_node_t **node_p, void *data)
 		/* If node was marked as empty, increase its parent's children
 		 * count.
 		 */
-		node->parent->children++;
+		node_parent(node)->children++;
 		/* Clear the 'empty' flag. */
 		node->flags &= ~NODE_FLAGS_EMPTY;
 	}
@@ -772,7 +857,8 @@ int knot_nsec3_create_chain(const zone_contents_t *zone,
 	 * The flag will be removed when the node is encountered during NSEC3
 	 * creation procedure.
 	 */
-	result = zone_tree_apply(zone->nodes, nsec3_mark_empty, (opt_out ? (void *)zone : NULL));
+	mark_empty_ctx_t mark_ctx = { zone->nodes, opt_out };
+	result = zone_tree_walk(zone->nodes, nsec3_mark_empty, &mark_ctx);
 	if (result != KNOT_EOK) {
 		free_nsec3_tree(nsec3_nodes);
 		return result;
@@ -789,7 +875,7 @@ int knot_nsec3_create_chain(const zone_contents_t *zone,
 	 * so that flags and children count are back to normal before further
 	 * processing.
 	 */
-	result = zone_tree_apply(zone->nodes, nsec3_reset, NULL);
+	result = zone_tree_walk(zone->nodes, nsec3_reset, NULL);
 	if (result != KNOT_EOK) {
 		free_nsec3_tree(nsec3_nodes);
 		return result;
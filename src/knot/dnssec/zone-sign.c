@@ -15,6 +15,8 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include <sys/types.h>
 
 #include "dnssec/error.h"
@@ -548,6 +550,11 @@ typedef struct node_sign_args {
 	const kdnssec_ctx_t *dnssec_ctx;
 	changeset_t *changeset;
 	knot_time_t expires_at;
+	zone_tree_it_t *it;  /*!< Position of the range to be signed. */
+	size_t count;        /*!< Number of nodes in the range. */
+	zone_keyset_t keys;  /*!< Thread-local zone keys (signing contexts). */
+	pthread_t thread;    /*!< Signing thread. */
+	int result;          /*!< Signing result. */
 } node_sign_args_t;
 
 /*!
@@ -571,16 +578,84 @@ static int sign_node(zone_node_t **node, void *data)
 		return KNOT_EOK;
 	}
 
-	int result = sign_node_rrsets(*node, args->zone_keys, args->dnssec_ctx,
-	                              args->changeset, &args->expires_at);
-	(*node)->flags &= ~NODE_FLAGS_REMOVED_NSEC;
+	return sign_node_rrsets(*node, args->zone_keys, args->dnssec_ctx,
+	                        args->changeset, &args->expires_at);
+}
 
-	return result;
+/*!
+ * \brief Clear the flag of a signed node marked as having NSEC removed.
+ *
+ * \param node  Node to be cleared.
+ * \param data  Zone tree of the node.
+ */
+static int clear_removed_nsec(zone_node_t **node, void *data)
+{
+	zone_tree_t *tree = data;
+
+	if (!((*node)->flags & NODE_FLAGS_REMOVED_NSEC) ||
+	    (*node)->rrset_count == 0 || (*node)->flags & NODE_FLAGS_NONAUTH) {
+		return KNOT_EOK;
+	}
+
+	int ret = zone_tree_touch(tree, *node);
+	if (ret == KNOT_EOK) {
+		(*node)->flags &= ~NODE_FLAGS_REMOVED_NSEC;
+	}
+
+	return ret;
+}
+
+/*!
+ * \brief Sign one range of a zone tree (thread function).
+ */
+static void *sign_range(void *data)
+{
+	node_sign_args_t *args = data;
+
+	args->result = zone_tree_it_apply(args->it, args->count, sign_node, args);
+
+	return NULL;
+}
+
+/*!
+ * \brief Create zone keys sharing the keys, with private signing contexts.
+ */
+static int keyset_clone_ctx(const zone_keyset_t *from, zone_keyset_t *to)
+{
+	to->keys = calloc(from->count, sizeof(zone_key_t));
+	if (to->keys == NULL) {
+		return KNOT_ENOMEM;
+	}
+	to->count = from->count;
+
+	for (size_t i = 0; i < from->count; i++) {
+		to->keys[i] = from->keys[i];
+		to->keys[i].ctx = NULL;
+		int ret = dnssec_sign_new(&to->keys[i].ctx, from->keys[i].key);
+		if (ret != DNSSEC_EOK) {
+			return knot_error_from_libdnssec(ret);
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static void keyset_clone_free(zone_keyset_t *keys)
+{
+	for (size_t i = 0; i < keys->count; i++) {
+		dnssec_sign_free(keys->keys[i].ctx);
+	}
+	free(keys->keys);
 }
 
 /*!
  * \brief Update RRSIGs in a given zone tree by updating changeset.
  *
+ * The tree is split into ranges of the same size, each range is signed
+ * by a separate thread into its own changeset, starting at the first node
+ * of the range. The changesets are merged afterwards. The nodes are changed
+ * only after the signing, so that they are touched by a single thread.
+ *
  * \param tree        Zone tree to be signed.
  * \param zone_keys   Zone keys.
  * \param policy      DNSSEC policy.
@@ -599,15 +674,94 @@ static int zone_tree_sign(zone_tree_t *tree,
 	assert(dnssec_ctx);
 	assert(changeset);
 
-	node_sign_args_t args = {
-		.zone_keys = zone_keys,
-		.dnssec_ctx = dnssec_ctx,
-		.changeset = changeset,
-		.expires_at = knot_time_add(dnssec_ctx->now, dnssec_ctx->policy->rrsig_lifetime),
-	};
+	knot_time_t expires = knot_time_add(dnssec_ctx->now,
+	                                    dnssec_ctx->policy->rrsig_lifetime);
+
+	size_t count = zone_tree_count(tree);
+	size_t threads = MAX(dnssec_ctx->policy->signing_threads, 1);
+	threads = MIN(threads, MAX(count, 1));
+
+	/* Single thread signs directly into the changeset. */
+	if (threads == 1) {
+		node_sign_args_t args = {
+			.zone_keys = zone_keys,
+			.dnssec_ctx = dnssec_ctx,
+			.changeset = changeset,
+			.expires_at = expires,
+		};
+
+		int result = zone_tree_walk(tree, sign_node, &args);
+		if (result == KNOT_EOK) {
+			result = zone_tree_walk(tree, clear_removed_nsec, tree);
+		}
+		*expires_at = args.expires_at;
+
+		return result;
+	}
+
+	node_sign_args_t *args = calloc(threads, sizeof(*args));
+	zone_tree_it_t *its = calloc(threads, sizeof(*its));
+	int result = (args == NULL || its == NULL) ? KNOT_ENOMEM :
+	             zone_tree_split(tree, threads, its);
+	if (result != KNOT_EOK) {
+		free(args);
+		free(its);
+		return result;
+	}
+
+	/* Prepare the ranges. */
+	size_t started = 0;
+	for (size_t i = 0; i < threads; i++) {
+		args[i].it = &its[i];
+		args[i].count = count * (i + 1) / threads - count * i / threads;
+		args[i].dnssec_ctx = dnssec_ctx;
+		args[i].expires_at = expires;
+
+		args[i].changeset = changeset_new(changeset->add->apex->owner);
+		if (args[i].changeset == NULL) {
+			result = KNOT_ENOMEM;
+			break;
+		}
+
+		result = keyset_clone_ctx(zone_keys, &args[i].keys);
+		if (result != KNOT_EOK) {
+			break;
+		}
+		args[i].zone_keys = &args[i].keys;
+
+		if (pthread_create(&args[i].thread, NULL, sign_range, &args[i]) != 0) {
+			result = KNOT_ENOMEM;
+			break;
+		}
+		started++;
+	}
+
+	/* Wait for the signing threads. */
+	for (size_t i = 0; i < started; i++) {
+		pthread_join(args[i].thread, NULL);
+		if (result == KNOT_EOK) {
+			result = args[i].result;
+		}
+	}
+
+	/* Merge the results, keep the range order. */
+	for (size_t i = 0; i < threads; i++) {
+		if (result == KNOT_EOK) {
+			result = changeset_merge(changeset, args[i].changeset, 0);
+			expires = knot_time_min(expires, args[i].expires_at);
+		}
+		changeset_free(args[i].changeset);
+		keyset_clone_free(&args[i].keys);
+		zone_tree_it_free(&its[i]);
+	}
+	free(args);
+	free(its);
+
+	if (result == KNOT_EOK) {
+		result = zone_tree_walk(tree, clear_removed_nsec, tree);
+	}
 
-	int result = zone_tree_apply(tree, sign_node, &args);
-	*expires_at = args.expires_at;
+	*expires_at = expires;
 
 	return result;
 }
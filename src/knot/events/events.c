@@ -34,20 +34,21 @@ typedef struct event_info {
 	zone_event_type_t type;
 	const zone_event_cb callback;
 	const char *name;
+	worker_prio_t prio;
 } event_info_t;
 
 static const event_info_t EVENT_INFO[] = {
-	{ ZONE_EVENT_LOAD,         event_load,        "load" },
-	{ ZONE_EVENT_REFRESH,      event_refresh,     "refresh" },
-	{ ZONE_EVENT_UPDATE,       event_update,      "update" },
-	{ ZONE_EVENT_EXPIRE,       event_expire,      "expiration" },
-	{ ZONE_EVENT_FLUSH,        event_flush,       "journal flush" },
-	{ ZONE_EVENT_NOTIFY,       event_notify,      "notify" },
-	{ ZONE_EVENT_DNSSEC,       event_dnssec,      "DNSSEC re-sign" },
-	{ ZONE_EVENT_UFREEZE,      event_ufreeze,     "update freeze" },
-	{ ZONE_EVENT_UTHAW,        event_uthaw,       "update thaw" },
-	{ ZONE_EVENT_NSEC3RESALT,  event_nsec3resalt, "NSEC3 resalt" },
-	{ ZONE_EVENT_PARENT_DS_Q,  event_parent_ds_q, "parent DS query" },
+	{ ZONE_EVENT_LOAD,         event_load,        "load",            WORKER_PRIO_LOW },
+	{ ZONE_EVENT_REFRESH,      event_refresh,     "refresh",         WORKER_PRIO_LOW },
+	{ ZONE_EVENT_UPDATE,       event_update,      "update",          WORKER_PRIO_NORMAL },
+	{ ZONE_EVENT_EXPIRE,       event_expire,      "expiration",      WORKER_PRIO_HIGH },
+	{ ZONE_EVENT_FLUSH,        event_flush,       "journal flush",   WORKER_PRIO_NORMAL },
+	{ ZONE_EVENT_NOTIFY,       event_notify,      "notify",          WORKER_PRIO_NORMAL },
+	{ ZONE_EVENT_DNSSEC,       event_dnssec,      "DNSSEC re-sign",  WORKER_PRIO_LOW },
+	{ ZONE_EVENT_UFREEZE,      event_ufreeze,     "update freeze",   WORKER_PRIO_HIGH },
+	{ ZONE_EVENT_UTHAW,        event_uthaw,       "update thaw",     WORKER_PRIO_HIGH },
+	{ ZONE_EVENT_NSEC3RESALT,  event_nsec3resalt, "NSEC3 resalt",    WORKER_PRIO_LOW },
+	{ ZONE_EVENT_PARENT_DS_Q,  event_parent_ds_q, "parent DS query", WORKER_PRIO_LOW },
 	{ 0 }
 };
 
@@ -188,6 +189,27 @@ static void reschedule(zone_events_t *events)
 	pthread_mutex_unlock(&events->reschedule_lock);
 }
 
+/*!
+ * \brief Assign the next planned event to a worker, with its priority class.
+ *
+ * User-triggered events are prioritized over the planned ones.
+ *
+ * \note Must be called with locked events.
+ */
+static void event_assign(zone_events_t *events)
+{
+	zone_event_type_t type = get_next_event(events);
+	if (!valid_event(type)) {
+		events->task.prio = WORKER_PRIO_NORMAL;
+	} else if (events->forced[type]) {
+		events->task.prio = WORKER_PRIO_HIGH;
+	} else {
+		events->task.prio = get_event_info(type)->prio;
+	}
+
+	worker_pool_assign(events->pool, &events->task);
+}
+
 /*!
  * \brief Zone event wrapper, expected to be called from a worker thread.
  *
@@ -252,7 +274,7 @@ static void event_dispatch(event_t *event)
 	pthread_mutex_lock(&events->mx);
 	if (!events->running && !events->frozen) {
 		events->running = true;
-		worker_pool_assign(events->pool, &events->task);
+		event_assign(events);
 	}
 	pthread_mutex_unlock(&events->mx);
 }
@@ -374,7 +396,7 @@ void zone_events_enqueue(zone_t *zone, zone_event_type_t type)
 	    (!events->ufrozen || !ufreeze_applies(type))) {
 		events->running = true;
 		event_set_time(events, type, ZONE_EVENT_IMMEDIATE);
-		worker_pool_assign(events->pool, &events->task);
+		event_assign(events);
 		pthread_mutex_unlock(&events->mx);
 		return;
 	}
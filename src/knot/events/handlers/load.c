@@ -25,6 +25,7 @@
 #include "knot/events/replan.h"
 #include "knot/zone/zone-diff.h"
 #include "knot/zone/zone-load.h"
+#include "knot/zone/zone-snapshot.h"
 #include "knot/zone/zone.h"
 #include "knot/zone/zonefile.h"
 
@@ -61,9 +62,18 @@ int event_load(conf_t *conf, zone_t *zone)
 		char *filename = conf_zonefile(conf, zone->name);
 		ret = zonefile_exists(filename, &mtime);
 		bool zonefile_unchanged = (zone->zonefile.exists && zone->zonefile.mtime == mtime);
+		// Snapshot must describe the file as it was before parsing.
+		struct stat zf_stat;
+		bool zf_stat_ok = (stat(filename, &zf_stat) == 0);
 		free(filename);
 		if (ret == KNOT_EOK) {
-			ret = zone_load_contents(conf, zone->name, &zf_conts);
+			ret = zone_snapshot_load(conf, zone->name, &zf_conts);
+			if (ret == KNOT_ENOENT) {
+				ret = zone_load_contents(conf, zone->name, &zf_conts);
+				if (ret == KNOT_EOK && zf_stat_ok) {
+					(void)zone_snapshot_store(conf, zone->name, zf_conts, &zf_stat);
+				}
+			}
 		}
 		if (ret != KNOT_EOK) {
 			zf_conts = NULL;
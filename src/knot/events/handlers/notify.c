@@ -15,6 +15,7 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
 
 #include "knot/common/log.h"
 #include "knot/conf/conf.h"
@@ -76,51 +77,90 @@ static const knot_layer_api_t NOTIFY_API = {
 	ns_log(priority, zone, LOG_OPERATION_NOTIFY, LOG_DIRECTION_OUT, remote, \
 	       fmt, ## __VA_ARGS__)
 
-static int send_notify(conf_t *conf, zone_t *zone, const knot_rrset_t *soa,
-                       const conf_remote_t *slave, int timeout)
+/*! \brief NOTIFY exchange with one slave address. */
+struct notify_slot {
+	conf_remote_t slave;
+	size_t remote;
+	struct notify_data data;
+};
+
+/*!
+ * \brief Send NOTIFY to the slave addresses concurrently.
+ *
+ * \param results  Output results for each slot.
+ */
+static int send_notifies(conf_t *conf, zone_t *zone, const knot_rrset_t *soa,
+                         struct notify_slot *slots, int *results, size_t count,
+                         int timeout)
 {
-	struct notify_data data = {
-		.zone = zone->name,
-		.soa = soa,
-		.remote = (struct sockaddr *)&slave->addr,
-	};
+	struct knot_requestor *requestors = calloc(count, sizeof(*requestors));
+	struct knot_request **reqs = calloc(count, sizeof(*reqs));
+	if (requestors == NULL || reqs == NULL) {
+		free(requestors);
+		free(reqs);
+		return KNOT_ENOMEM;
+	}
 
-	query_edns_data_init(&data.edns, conf, zone->name, slave->addr.ss_family);
+	// Only the initialized requestors are cleared.
+	size_t ready = 0;
+	int ret = KNOT_EOK;
+	for (size_t i = 0; i < count && ret == KNOT_EOK; i++) {
+		conf_remote_t *slave = &slots[i].slave;
+		slots[i].data = (struct notify_data) {
+			.zone = zone->name,
+			.soa = soa,
+			.remote = (struct sockaddr *)&slave->addr,
+		};
+		query_edns_data_init(&slots[i].data.edns, conf, zone->name,
+		                     slave->addr.ss_family);
+
+		ret = knot_requestor_init(&requestors[i], &NOTIFY_API, &slots[i].data, NULL);
+		if (ret != KNOT_EOK) {
+			break;
+		}
+		ready = i + 1;
 
-	struct knot_requestor requestor = { 0 };
-	knot_requestor_init(&requestor, &NOTIFY_API, &data, NULL);
+		knot_pkt_t *pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+		if (!pkt) {
+			ret = KNOT_ENOMEM;
+			break;
+		}
 
-	knot_pkt_t *pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
-	if (!pkt) {
-		knot_requestor_clear(&requestor);
-		return KNOT_ENOMEM;
+		const struct sockaddr *dst = (struct sockaddr *)&slave->addr;
+		const struct sockaddr *src = (struct sockaddr *)&slave->via;
+		reqs[i] = knot_request_make(NULL, dst, src, pkt, &slave->key, 0);
+		if (!reqs[i]) {
+			knot_pkt_free(&pkt);
+			ret = KNOT_ENOMEM;
+		}
 	}
 
-	const struct sockaddr *dst = (struct sockaddr *)&slave->addr;
-	const struct sockaddr *src = (struct sockaddr *)&slave->via;
-	struct knot_request *req = knot_request_make(NULL, dst, src, pkt, &slave->key, 0);
-	if (!req) {
-		knot_request_free(req, NULL);
-		knot_requestor_clear(&requestor);
-		return KNOT_ENOMEM;
+	if (ret == KNOT_EOK) {
+		ret = knot_requestor_exec_multi(requestors, reqs, results, count,
+		                                timeout);
 	}
 
-	int ret = knot_requestor_exec(&requestor, req, timeout);
-
-	if (ret == KNOT_EOK) {
-		NOTIFY_LOG(LOG_INFO, zone->name, dst,
-			   "serial %u", knot_soa_serial(&soa->rrs));
-	} else if (knot_pkt_ext_rcode(req->resp) == 0) {
-		NOTIFY_LOG(LOG_WARNING, zone->name, dst,
-		           "failed (%s)", knot_strerror(ret));
-	} else {
-		NOTIFY_LOG(LOG_WARNING, zone->name, dst,
-		           "server responded with error '%s'",
-		           knot_pkt_ext_rcode_name(req->resp));
+	for (size_t i = 0; i < count && ret == KNOT_EOK; i++) {
+		const struct sockaddr *dst = slots[i].data.remote;
+		if (results[i] == KNOT_EOK) {
+			NOTIFY_LOG(LOG_INFO, zone->name, dst,
+			           "serial %u", knot_soa_serial(&soa->rrs));
+		} else if (knot_pkt_ext_rcode(reqs[i]->resp) == 0) {
+			NOTIFY_LOG(LOG_WARNING, zone->name, dst,
+			           "failed (%s)", knot_strerror(results[i]));
+		} else {
+			NOTIFY_LOG(LOG_WARNING, zone->name, dst,
+			           "server responded with error '%s'",
+			           knot_pkt_ext_rcode_name(reqs[i]->resp));
+		}
 	}
 
-	knot_request_free(req, NULL);
-	knot_requestor_clear(&requestor);
+	for (size_t i = 0; i < ready; i++) {
+		knot_request_free(reqs[i], NULL);
+		knot_requestor_clear(&requestors[i]);
+	}
+	free(requestors);
+	free(reqs);
 
 	return ret;
 }
@@ -137,22 +177,66 @@ int event_notify(conf_t *conf, zone_t *zone)
 	int timeout = conf->cache.srv_tcp_reply_timeout * 1000;
 	knot_rrset_t soa = node_rrset(zone->contents->apex, KNOT_RRTYPE_SOA);
 
-	// send NOTIFY to each remote, use working address
 	conf_val_t notify = conf_zone_get(conf, C_NOTIFY, zone->name);
-	while (notify.code == KNOT_EOK) {
+	size_t count = conf_val_count(&notify);
+	if (count == 0) {
+		return KNOT_EOK;
+	}
+
+	conf_val_t *remotes = calloc(count, sizeof(*remotes));
+	size_t *addr_count = calloc(count, sizeof(*addr_count));
+	bool *done = calloc(count, sizeof(*done));
+	struct notify_slot *slots = calloc(count, sizeof(*slots));
+	int *results = calloc(count, sizeof(*results));
+	if (!remotes || !addr_count || !done || !slots || !results) {
+		free(remotes);
+		free(addr_count);
+		free(done);
+		free(slots);
+		free(results);
+		return KNOT_ENOMEM;
+	}
+
+	for (size_t r = 0; r < count && notify.code == KNOT_EOK; r++) {
+		remotes[r] = notify;
 		conf_val_t addr = conf_id_get(conf, C_RMT, C_ADDR, &notify);
-		size_t addr_count = conf_val_count(&addr);
+		addr_count[r] = conf_val_count(&addr);
+		conf_val_next(&notify);
+	}
 
-		for (int i = 0; i < addr_count; i++) {
-			conf_remote_t slave = conf_remote(conf, &notify, i);
-			int ret = send_notify(conf, zone, &soa, &slave, timeout);
-			if (ret == KNOT_EOK) {
-				break;
+	// send NOTIFY to all remotes at once, try next address of failed ones
+	for (size_t i = 0; ; i++) {
+		size_t n = 0;
+		for (size_t r = 0; r < count; r++) {
+			if (!done[r] && i < addr_count[r]) {
+				slots[n].slave = conf_remote(conf, &remotes[r], i);
+				slots[n].remote = r;
+				n++;
 			}
 		}
+		if (n == 0) {
+			break;
+		}
 
-		conf_val_next(&notify);
+		int ret = send_notifies(conf, zone, &soa, slots, results, n, timeout);
+		if (ret != KNOT_EOK) {
+			log_zone_error(zone->name, "NOTIFY, failed (%s)",
+			               knot_strerror(ret));
+			break;
+		}
+
+		for (size_t j = 0; j < n; j++) {
+			if (results[j] == KNOT_EOK) {
+				done[slots[j].remote] = true;
+			}
+		}
 	}
 
+	free(remotes);
+	free(addr_count);
+	free(done);
+	free(slots);
+	free(results);
+
 	return KNOT_EOK;
 }
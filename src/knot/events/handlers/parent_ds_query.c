@@ -15,6 +15,7 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
 
 #include "knot/common/log.h"
 #include "knot/conf/conf.h"
@@ -125,54 +126,94 @@ static const knot_layer_api_t ds_query_api = {
 	.finish = NULL,
 };
 
-static int try_ds(conf_t *conf, zone_t *zone, const conf_remote_t *parent, zone_key_t *key)
-{
-	// TODO: Abstract interface to issue DNS queries. This is almost copy-pasted.
+/*! \brief DS query to one parent address. */
+struct ds_query_slot {
+	conf_remote_t parent;
+	size_t remote;
+	struct ds_query_data data;
+};
 
+/*!
+ * \brief Query the parent addresses for DS concurrently.
+ *
+ * \param results  Output results for each slot.
+ */
+static int try_ds(conf_t *conf, zone_t *zone, struct ds_query_slot *slots,
+                  int *results, size_t count, zone_key_t *key)
+{
 	assert(zone);
-	assert(parent);
-
-	struct ds_query_data data = {
-		.zone = zone,
-		.conf = conf,
-		.remote = (struct sockaddr *)&parent->addr,
-		.key = key,
-		.ds_ok = false,
-		.result_logged = false,
-	};
+	assert(slots);
 
-	struct knot_requestor requestor;
-	knot_requestor_init(&requestor, &ds_query_api, &data, NULL);
-
-	knot_pkt_t *pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
-	if (!pkt) {
-		knot_requestor_clear(&requestor);
+	struct knot_requestor *requestors = calloc(count, sizeof(*requestors));
+	struct knot_request **reqs = calloc(count, sizeof(*reqs));
+	if (requestors == NULL || reqs == NULL) {
+		free(requestors);
+		free(reqs);
 		return KNOT_ENOMEM;
 	}
 
-	const struct sockaddr *dst = (struct sockaddr *)&parent->addr;
-	const struct sockaddr *src = (struct sockaddr *)&parent->via;
-	struct knot_request *req = knot_request_make(NULL, dst, src, pkt, &parent->key, 0);
-	if (!req) {
-		knot_request_free(req, NULL);
-		knot_requestor_clear(&requestor);
-		return KNOT_ENOMEM;
+	// Only the initialized requestors are cleared.
+	size_t ready = 0;
+	int ret = KNOT_EOK;
+	for (size_t i = 0; i < count && ret == KNOT_EOK; i++) {
+		conf_remote_t *parent = &slots[i].parent;
+		slots[i].data = (struct ds_query_data) {
+			.zone = zone,
+			.conf = conf,
+			.remote = (struct sockaddr *)&parent->addr,
+			.key = key,
+			.ds_ok = false,
+			.result_logged = false,
+		};
+
+		ret = knot_requestor_init(&requestors[i], &ds_query_api, &slots[i].data, NULL);
+		if (ret != KNOT_EOK) {
+			break;
+		}
+		ready = i + 1;
+
+		knot_pkt_t *pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+		if (!pkt) {
+			ret = KNOT_ENOMEM;
+			break;
+		}
+
+		const struct sockaddr *dst = (struct sockaddr *)&parent->addr;
+		const struct sockaddr *src = (struct sockaddr *)&parent->via;
+		reqs[i] = knot_request_make(NULL, dst, src, pkt, &parent->key, 0);
+		if (!reqs[i]) {
+			knot_pkt_free(&pkt);
+			ret = KNOT_ENOMEM;
+		}
 	}
 
 	int timeout = conf->cache.srv_tcp_reply_timeout * 1000;
 
-	int ret = knot_requestor_exec(&requestor, req, timeout);
-	knot_request_free(req, NULL);
-	knot_requestor_clear(&requestor);
+	if (ret == KNOT_EOK) {
+		ret = knot_requestor_exec_multi(requestors, reqs, results, count,
+		                                timeout);
+	}
 
-	// alternative: we could put answer back through ctx instead of errcode
-	if (ret == KNOT_EOK && !data.ds_ok) {
-		ret = KNOT_ENORECORD;
+	for (size_t i = 0; i < ready; i++) {
+		knot_request_free(reqs[i], NULL);
+		knot_requestor_clear(&requestors[i]);
 	}
+	free(requestors);
+	free(reqs);
 
-	if (ret != KNOT_EOK && !data.result_logged) {
-		ns_log(LOG_WARNING, zone->name, LOG_OPERATION_PARENT,
-		       LOG_DIRECTION_OUT, data.remote, "failed (%s)", knot_strerror(ret));
+	for (size_t i = 0; i < count && ret == KNOT_EOK; i++) {
+		struct ds_query_data *data = &slots[i].data;
+
+		// alternative: we could put answer back through ctx instead of errcode
+		if (results[i] == KNOT_EOK && !data->ds_ok) {
+			results[i] = KNOT_ENORECORD;
+		}
+
+		if (results[i] != KNOT_EOK && !data->result_logged) {
+			ns_log(LOG_WARNING, zone->name, LOG_OPERATION_PARENT,
+			       LOG_DIRECTION_OUT, data->remote, "failed (%s)",
+			       knot_strerror(results[i]));
+		}
 	}
 
 	return ret;
@@ -188,24 +229,66 @@ static bool parents_have_ds(zone_t *zone, conf_t *conf, zone_key_t *key)
 		return false;
 	}
 	conf_val_t parents = conf_id_get(conf, C_SBM, C_PARENT, &ksk_sbm);
+	size_t count = conf_val_count(&parents);
+	if (count == 0) {
+		return false;
+	}
+
+	conf_val_t *remotes = calloc(count, sizeof(*remotes));
+	size_t *addr_count = calloc(count, sizeof(*addr_count));
+	bool *done = calloc(count, sizeof(*done));
+	struct ds_query_slot *slots = calloc(count, sizeof(*slots));
+	int *results = calloc(count, sizeof(*results));
+	if (!remotes || !addr_count || !done || !slots || !results) {
+		free(remotes);
+		free(addr_count);
+		free(done);
+		free(slots);
+		free(results);
+		return false;
+	}
 
-	bool success = false;
-	while (parents.code == KNOT_EOK) {
-		success = false;
+	for (size_t r = 0; r < count && parents.code == KNOT_EOK; r++) {
+		remotes[r] = parents;
 		conf_val_t addr = conf_id_get(conf, C_RMT, C_ADDR, &parents);
-		size_t addr_count = conf_val_count(&addr);
-
-		for (size_t i = 0; i < addr_count; i++) {
-			conf_remote_t parent = conf_remote(conf, &parents, i);
-			int ret = try_ds(conf, zone, &parent, key);
-			if (ret == KNOT_EOK) {
-				success = true;
-				break;
+		addr_count[r] = conf_val_count(&addr);
+		conf_val_next(&parents);
+	}
+
+	// query all parents at once, try next address of failed ones
+	for (size_t i = 0; ; i++) {
+		size_t n = 0;
+		for (size_t r = 0; r < count; r++) {
+			if (!done[r] && i < addr_count[r]) {
+				slots[n].parent = conf_remote(conf, &remotes[r], i);
+				slots[n].remote = r;
+				n++;
 			}
 		}
+		if (n == 0) {
+			break;
+		}
 
-		conf_val_next(&parents);
+		if (try_ds(conf, zone, slots, results, n, key) != KNOT_EOK) {
+			break;
+		}
+
+		for (size_t j = 0; j < n; j++) {
+			if (results[j] == KNOT_EOK) {
+				done[slots[j].remote] = true;
+			}
+		}
 	}
+
+	// the last parent decides
+	bool success = done[count - 1];
+
+	free(remotes);
+	free(addr_count);
+	free(done);
+	free(slots);
+	free(results);
+
 	return success;
 }
 
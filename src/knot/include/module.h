@@ -35,7 +35,7 @@
 /*** Query module API. ***/
 
 /*! Current module ABI version. */
-#define KNOTD_MOD_ABI_VERSION	100
+#define KNOTD_MOD_ABI_VERSION	101
 /*! Module configuration name prefix. */
 #define KNOTD_MOD_NAME_PREFIX	"mod-"
 
@@ -219,31 +219,40 @@ int knotd_mod_stats_add(knotd_mod_t *mod, const char *ctr_name, uint32_t idx_cou
  * Increments a statistics counter.
  *
  * \param[in] mod     Module context.
+ * \param[in] thr_id  Current thread id (see knotd_qdata_params_t).
  * \param[in] ctr_id  Counter id (counted in the order the counters were registered).
  * \param[in] idx     Subcounter index (set 0 for single-counter).
  * \param[in] val     Value increment.
  */
-void knotd_mod_stats_incr(knotd_mod_t *mod, uint32_t ctr_id, uint32_t idx, uint64_t val);
+void knotd_mod_stats_incr(knotd_mod_t *mod, unsigned thr_id, uint32_t ctr_id,
+                          uint32_t idx, uint64_t val);
 
 /*!
  * Decrements a statistics counter.
  *
  * \param[in] mod     Module context.
+ * \param[in] thr_id  Current thread id (see knotd_qdata_params_t).
  * \param[in] ctr_id  Counter id (counted in the order the counters were registered).
  * \param[in] idx     Subcounter index (set 0 for single-counter).
  * \param[in] val     Value decrement.
  */
-void knotd_mod_stats_decr(knotd_mod_t *mod, uint32_t ctr_id, uint32_t idx, uint64_t val);
+void knotd_mod_stats_decr(knotd_mod_t *mod, unsigned thr_id, uint32_t ctr_id,
+                          uint32_t idx, uint64_t val);
 
 /*!
  * Sets a statistics counter value.
  *
+ * \note The value replaces the contributions of all threads, concurrent
+ *       increments or decrements of the counter may be lost.
+ *
  * \param[in] mod     Module context.
+ * \param[in] thr_id  Current thread id (see knotd_qdata_params_t).
  * \param[in] ctr_id  Counter id (counted in the order the counters were registered).
  * \param[in] idx     Subcounter index (set 0 for single-counter).
  * \param[in] val     Value.
  */
-void knotd_mod_stats_store(knotd_mod_t *mod, uint32_t ctr_id, uint32_t idx, uint64_t val);
+void knotd_mod_stats_store(knotd_mod_t *mod, unsigned thr_id, uint32_t ctr_id,
+                           uint32_t idx, uint64_t val);
 
 /*! Configuration single-value abstraction. */
 typedef union {
@@ -373,9 +382,12 @@ typedef enum {
 typedef struct {
 	knotd_query_flag_t flags;              /*!< Current query flgas. */
 	const struct sockaddr_storage *remote; /*!< Current remote address. */
+	const struct cmsghdr *pktinfo;         /*!< Packet info for the response (UDP, may be NULL). */
 	int socket;                            /*!< Current network socket. */
 	unsigned thread_id;                    /*!< Current thread id. */
 	void *server;                          /*!< Server object private item. */
+	struct defer_queue *defer_queue;       /*!< Queue for deferred queries (may be NULL). */
+	struct knotd_defer *defer;             /*!< Deferred query (on deferral, or if resumed). */
 } knotd_qdata_params_t;
 
 /*! Query processing data context. */
@@ -415,6 +427,45 @@ const knot_dname_t *knotd_qdata_zone_name(knotd_qdata_t *qdata);
  */
 knot_rrset_t knotd_qdata_zone_apex_rrset(knotd_qdata_t *qdata, uint16_t type);
 
+/*! Deferred query. */
+typedef struct knotd_defer knotd_defer_t;
+
+/*!
+ * Defers the query until an asynchronous operation finishes.
+ *
+ * Available in general processing hooks only. The query processing stops
+ * after the hook returns, without a response. When resumed, the query is
+ * processed again from the deferring hook, which gets the operation result
+ * via knotd_qdata_resumed(). The query must not be modified before deferring.
+ *
+ * \param[in] qdata  Query data.
+ *
+ * \return Deferred query handle, NULL if not possible (e.g. not supported by
+ *         the transport, or the query was already resumed).
+ */
+knotd_defer_t *knotd_qdata_defer(knotd_qdata_t *qdata);
+
+/*!
+ * Resumes a deferred query (thread-safe).
+ *
+ * Must be called exactly once for each deferred query, at the latest on
+ * module unload.
+ *
+ * \param[in] defer  Deferred query handle.
+ * \param[in] data   Result for the deferring hook (released with free()).
+ */
+void knotd_defer_resume(knotd_defer_t *defer, void *data);
+
+/*!
+ * Gets the result of the operation the query was deferred for.
+ *
+ * \param[in] qdata  Query data.
+ *
+ * \return Result passed to knotd_defer_resume() if called from the deferring
+ *         hook of a resumed query, NULL otherwise.
+ */
+void *knotd_qdata_resumed(knotd_qdata_t *qdata);
+
 /*! General query processing states. */
 typedef enum {
 	KNOTD_STATE_NOOP = 0, /*!< No response. */
@@ -17,11 +17,16 @@
 #include <limits.h>
 #include <sys/stat.h>
 #include <stdarg.h>
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
 
 #include "knot/journal/journal.h"
 #include "knot/common/log.h"
 #include "contrib/files.h"
 #include "contrib/endian.h"
+#include "contrib/string.h"
+#include "contrib/tolower.h"
 
 /*! \brief Journal version. */
 #define JOURNAL_VERSION	"1.0"
@@ -35,6 +40,7 @@
 #define MDKEY_GLOBAL_JOURNAL_COUNT		"journal_count"
 #define MDKEY_GLOBAL_LAST_TOTAL_OCCUPIED	"last_total_occupied"
 #define MDKEY_GLOBAL_LAST_INSERTER_ZONE		"last_inserter_zone"
+#define MDKEY_GLOBAL_LAST_INSERTER_GROUP	"last_inserter_group"
 #define MDKEY_PERZONE_OCCUPIED			"occupied"
 #define MDKEY_PERZONE_FLAGS			"flags"
 #define KEY_BOOTSTRAP_CHANGESET			"bootstrap"
@@ -43,9 +49,15 @@
 #define DB_KEY_UNUSED_ZERO (4)
 
 /*! \brief Metadata inserted on the beginning of each chunk:
- * uint32_t serial_to + uint32_t chunk_count + 24B unused */
+ * uint32_t serial_to + uint32_t chunk_count + uint32_t flags +
+ * uint32_t raw_size + 16B unused */
 #define JOURNAL_HEADER_SIZE (32)
 
+/*! \brief Chunk header flags, valid only with CHUNKS_COMPRESSED metadata flag. */
+enum {
+	CHUNK_COMPRESSED = 1 << 0, /* Chunk data compressed, raw_size is valid. */
+};
+
 // eventually move to contrib and reuse as needed
 #define local_array_max_static_size (100)
 #define local_array(type, name, size) \
@@ -60,6 +72,7 @@ enum {
 	MERGED_SERIAL_VALID  = 1 << 2, /* "serial_from" of merged changeset. */
 	DIRTY_SERIAL_VALID   = 1 << 3, /* "dirty_serial" is present in the DB. */
 	FIRST_SERIAL_INVALID = 1 << 4, /* "first_serial" is not valid. */
+	CHUNKS_COMPRESSED    = 1 << 5, /* Chunks may be compressed, see chunk flags. */
 };
 
 static bool journal_flush_allowed(journal_t *j) {
@@ -98,6 +111,12 @@ static float journal_max_txn(journal_t *j)
 	return 0.05f;
 }
 
+static bool journal_compression(journal_t *j)
+{
+	conf_val_t val = conf_zone_get(conf(), C_JOURNAL_COMPRESSION, j->zone);
+	return conf_bool(&val);
+}
+
 /*
  * ***************************** PART I *******************************
  *
@@ -120,6 +139,7 @@ typedef struct {
 typedef struct {
 	journal_t *j;
 	knot_db_txn_t *txn;
+	knot_db_txn_t *parent; // Group commit transaction (optional).
 	int ret;
 	bool opened;
 
@@ -264,8 +284,13 @@ static void txn_begin(txn_t *txn, bool write_allowed)
 		return;
 	}
 
-	txn->ret = txn->j->db->db_api->txn_begin(txn->j->db->db, txn->txn,
-	                                         (write_allowed ? 0 : KNOT_DB_RDONLY));
+	if (txn->parent != NULL) {
+		txn->ret = knot_db_lmdb_txn_begin(txn->j->db->db, txn->txn, txn->parent,
+		                                  (write_allowed ? 0 : KNOT_DB_RDONLY));
+	} else {
+		txn->ret = txn->j->db->db_api->txn_begin(txn->j->db->db, txn->txn,
+		                                         (write_allowed ? 0 : KNOT_DB_RDONLY));
+	}
 
 	txn->is_rw = write_allowed;
 	txn->opened = true;
@@ -479,6 +504,68 @@ static int md_set_common_last_inserter_zone(txn_t *txn, knot_dname_t *zone)
 	return txn->ret;
 }
 
+/*
+ * Zones of the last group commit are stored as a sequence of:
+ * | (be64)serialized_size | zone_name |
+ */
+
+// moves to the next zone of the group, returns false at the end
+static bool group_next(const knot_db_val_t *group, size_t *pos,
+                       const knot_dname_t **zone, uint64_t *size)
+{
+	const uint8_t *data = group->data;
+	if (*pos + sizeof(uint64_t) >= group->len) {
+		return false;
+	}
+	uint64_t size_be;
+	memcpy(&size_be, data + *pos, sizeof(size_be));
+	int zone_size = knot_dname_wire_check(data + *pos + sizeof(size_be),
+	                                      data + group->len, NULL);
+	if (zone_size <= 0) {
+		return false;
+	}
+	*size = be64toh(size_be);
+	*zone = data + *pos + sizeof(size_be);
+	*pos += sizeof(size_be) + zone_size;
+	return true;
+}
+
+static bool group_contains(const knot_db_val_t *group, const knot_dname_t *zone,
+                           uint64_t *size, uint64_t *total)
+{
+	bool found = false;
+	*total = 0;
+	size_t pos = 0;
+	const knot_dname_t *it;
+	uint64_t it_size;
+	while (group_next(group, &pos, &it, &it_size)) {
+		if (!found && knot_dname_is_equal(it, zone)) {
+			*size = it_size;
+			found = true;
+		}
+		*total += it_size;
+	}
+	return found;
+}
+
+// allocates res->data
+static void md_get_last_inserter_group(txn_t *txn, knot_db_val_t *res)
+{
+	res->data = NULL;
+	res->len = 0;
+	txn_check_open(txn);
+	txn_key_str(txn, NULL, MDKEY_GLOBAL_LAST_INSERTER_GROUP);
+	if (txn_find(txn)) {
+		res->data = malloc(txn->val.len);
+		if (res->data == NULL) {
+			txn->ret = KNOT_ENOMEM;
+			return;
+		}
+		memcpy(res->data, txn->val.data, txn->val.len);
+		res->len = txn->val.len;
+	}
+}
+
 static void md_del_last_inserter_zone(txn_t *txn, knot_dname_t *if_equals)
 {
 	txn_check_open(txn);
@@ -488,6 +575,13 @@ static void md_del_last_inserter_zone(txn_t *txn, knot_dname_t *if_equals)
 			txn_del(txn);
 		}
 	}
+	txn_key_str(txn, NULL, MDKEY_GLOBAL_LAST_INSERTER_GROUP);
+	if (txn_find(txn)) {
+		uint64_t size, total;
+		if (if_equals == NULL || group_contains(&txn->val, if_equals, &size, &total)) {
+			txn_del(txn);
+		}
+	}
 }
 
 static void md_get_common_last_occupied(txn_t *txn, size_t *res)
@@ -550,6 +644,76 @@ static void make_header(knot_db_val_t *to, uint32_t serial_to, int chunk_count)
 	       JOURNAL_HEADER_SIZE - sizeof(be_serial_to) - sizeof(be_chunk_count));
 }
 
+/*! \brief Get the chunk flags and the size of the uncompressed chunk data. */
+static uint32_t chunk_flags(const knot_db_val_t *chunk, size_t *raw_size)
+{
+	assert(chunk->len >= JOURNAL_HEADER_SIZE);
+
+	uint32_t be_flags, be_raw_size;
+	memcpy(&be_flags, chunk->data + 2 * sizeof(uint32_t), sizeof(be_flags));
+	memcpy(&be_raw_size, chunk->data + 3 * sizeof(uint32_t), sizeof(be_raw_size));
+
+	uint32_t flags = be32toh(be_flags);
+	*raw_size = (flags & CHUNK_COMPRESSED) ? be32toh(be_raw_size) :
+	                                         chunk->len - JOURNAL_HEADER_SIZE;
+	return flags;
+}
+
+/*!
+ * \brief Compress the chunk data in place if it gets smaller.
+ *
+ * \param chunk  Chunk with the header.
+ * \param buf    Buffer of the chunk data size.
+ *
+ * \return True if compressed.
+ */
+static bool compress_chunk(knot_db_val_t *chunk, uint8_t *buf)
+{
+#ifdef ENABLE_ZLIB
+	size_t raw_size = chunk->len - JOURNAL_HEADER_SIZE;
+	uLongf size = raw_size;
+	if (compress2(buf, &size, chunk->data + JOURNAL_HEADER_SIZE, raw_size,
+	              Z_BEST_SPEED) != Z_OK || size >= raw_size) {
+		return false;
+	}
+
+	memcpy(chunk->data + JOURNAL_HEADER_SIZE, buf, size);
+	chunk->len = JOURNAL_HEADER_SIZE + size;
+
+	uint32_t be_flags = htobe32(CHUNK_COMPRESSED);
+	uint32_t be_raw_size = htobe32(raw_size);
+	memcpy(chunk->data + 2 * sizeof(uint32_t), &be_flags, sizeof(be_flags));
+	memcpy(chunk->data + 3 * sizeof(uint32_t), &be_raw_size, sizeof(be_raw_size));
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*! \brief Decompress the chunk data into a new buffer. */
+static int decompress_chunk(const knot_db_val_t *chunk, size_t raw_size, uint8_t **data)
+{
+#ifdef ENABLE_ZLIB
+	*data = malloc(raw_size);
+	if (*data == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	uLongf size = raw_size;
+	if (uncompress(*data, &size, chunk->data + JOURNAL_HEADER_SIZE,
+	               chunk->len - JOURNAL_HEADER_SIZE) != Z_OK || size != raw_size) {
+		free(*data);
+		*data = NULL;
+		return KNOT_EMALF;
+	}
+
+	return KNOT_EOK;
+#else
+	return KNOT_ENOTSUP;
+#endif
+}
+
 /*! \brief read properties from chunk header "from". All the output params are optional */
 static void unmake_header(const knot_db_val_t *from, uint32_t *serial_to,
 			  int *chunk_count, size_t *header_size)
@@ -765,34 +929,45 @@ static int normal_iterkeycb(iteration_ctx_t *ctx)
  * ********************************************************************
  */
 
-/*! \brief Deserialize changeset from chunks (in vals) */
-static int vals_to_changeset(knot_db_val_t *vals, int nvals,
+/*! \brief Deserialize changeset from chunks (in vals), possibly compressed */
+static int vals_to_changeset(knot_db_val_t *vals, int nvals, bool compressed,
                              const knot_dname_t *zone_name, changeset_t **ch)
 {
 	local_array(uint8_t *, valps, nvals)
 	local_array(size_t, vallens, nvals)
-	if (valps == NULL || vallens == NULL) {
+	local_array(uint8_t *, rawps, nvals)
+	if (valps == NULL || vallens == NULL || rawps == NULL) {
 		local_array_free(valps)
 		local_array_free(vallens)
+		local_array_free(rawps)
 		return KNOT_ENOMEM;
 	}
 
+	int ret = KNOT_EOK;
 	for (size_t i = 0; i < nvals; i++) {
 		valps[i] = vals[i].data + JOURNAL_HEADER_SIZE;
 		vallens[i] = vals[i].len - JOURNAL_HEADER_SIZE;
+		if (compressed && ret == KNOT_EOK &&
+		    (chunk_flags(&vals[i], &vallens[i]) & CHUNK_COMPRESSED)) {
+			ret = decompress_chunk(&vals[i], vallens[i], &rawps[i]);
+			valps[i] = rawps[i];
+		}
 	}
 
-	changeset_t *t_ch = changeset_new(zone_name);
-	if (t_ch == NULL) {
-		local_array_free(valps)
-		local_array_free(vallens)
-		return KNOT_ENOMEM;
+	changeset_t *t_ch = (ret == KNOT_EOK) ? changeset_new(zone_name) : NULL;
+	if (t_ch == NULL && ret == KNOT_EOK) {
+		ret = KNOT_ENOMEM;
+	}
+	if (ret == KNOT_EOK) {
+		ret = changeset_deserialize(t_ch, valps, vallens, nvals);
 	}
 
-	int ret = changeset_deserialize(t_ch, valps, vallens, nvals);
-
+	for (size_t i = 0; i < nvals; i++) {
+		free(rawps[i]);
+	}
 	local_array_free(valps)
 	local_array_free(vallens)
+	local_array_free(rawps)
 	if (ret != KNOT_EOK) {
 		changeset_free(t_ch);
 		return ret;
@@ -808,7 +983,9 @@ static int load_one_itercb(iteration_ctx_t *ctx)
 		return KNOT_EINVAL;
 	}
 
-	int ret = vals_to_changeset(ctx->val, ctx->chunk_count, ctx->txn->j->zone, &ch);
+	int ret = vals_to_changeset(ctx->val, ctx->chunk_count,
+	                            md_flag(ctx->txn, CHUNKS_COMPRESSED),
+	                            ctx->txn->j->zone, &ch);
 	if (ret == KNOT_EOK) *targ = ch;
 	return ret;
 }
@@ -818,7 +995,9 @@ static int load_list_itercb(iteration_ctx_t *ctx)
 	changeset_t *ch = NULL;
 	list_t *chlist = *(list_t **) ctx->iter_context;
 
-	int ret = vals_to_changeset(ctx->val, ctx->chunk_count, ctx->txn->j->zone, &ch);
+	int ret = vals_to_changeset(ctx->val, ctx->chunk_count,
+	                            md_flag(ctx->txn, CHUNKS_COMPRESSED),
+	                            ctx->txn->j->zone, &ch);
 
 	if (ret == KNOT_EOK) {
 		add_tail(chlist, &ch->n);
@@ -1178,7 +1357,9 @@ static int merge_itercb(iteration_ctx_t *ctx)
 {
 	changeset_t *ch = NULL, *mch = *(changeset_t **)ctx->iter_context;
 
-	int ret = vals_to_changeset(ctx->val, ctx->chunk_count, ctx->txn->j->zone, &ch);
+	int ret = vals_to_changeset(ctx->val, ctx->chunk_count,
+	                            md_flag(ctx->txn, CHUNKS_COMPRESSED),
+	                            ctx->txn->j->zone, &ch);
 	if (ret == KNOT_EOK) {
 		ret = changeset_merge(mch, ch, 0);
 		changeset_free(ch);
@@ -1232,6 +1413,55 @@ m_u_ch_end:
 	return txn->ret;
 }
 
+static void md_charge_zone(txn_t *txn, const knot_dname_t *zone, int64_t change)
+{
+	uint64_t occupied = 0;
+	md_get(txn, zone, MDKEY_PERZONE_OCCUPIED, &occupied);
+	occupied = (change > 0 || occupied > (uint64_t)-change ? occupied + change : 0);
+	md_set(txn, zone, MDKEY_PERZONE_OCCUPIED, occupied);
+}
+
+// the part of the DB usage change which belongs to the zone of a group commit
+static int64_t group_share(int64_t change, uint64_t size, uint64_t total)
+{
+	return (total > 0 ? (int64_t)((double)change * size / total) : 0);
+}
+
+// charges the DB usage change since the last insert to the zone(s) which inserted
+static void md_charge_last_insert(txn_t *txn, size_t occupied_now)
+{
+	size_t occupied_last;
+	md_get_common_last_occupied(txn, &occupied_last);
+	md_set(txn, NULL, MDKEY_GLOBAL_LAST_TOTAL_OCCUPIED, occupied_now);
+	if (occupied_now == occupied_last) {
+		return;
+	}
+	int64_t change = (int64_t)occupied_now - (int64_t)occupied_last;
+
+	knot_dname_t *last_zone = NULL;
+	md_get_common_last_inserter_zone(txn, &last_zone);
+	if (last_zone != NULL) {
+		md_charge_zone(txn, last_zone, change);
+		free(last_zone);
+		return;
+	}
+
+	// split among the zones of a group commit by their inserted sizes
+	knot_db_val_t group;
+	md_get_last_inserter_group(txn, &group);
+	uint64_t size, total = 0;
+	const knot_dname_t *zone;
+	size_t pos = 0;
+	while (group_next(&group, &pos, &zone, &size)) {
+		total += size;
+	}
+	pos = 0;
+	while (group_next(&group, &pos, &zone, &size)) {
+		md_charge_zone(txn, zone, group_share(change, size, total));
+	}
+	free(group.data);
+}
+
 // uses local context, e.g.: j, txn, changesets, nchs, serialized_size_total, store_changeset_cleanup, inserting_merged
 #define try_flush \
 	if (!md_flushed(txn)) { \
@@ -1253,7 +1483,7 @@ m_u_ch_end:
 		} \
 	}
 
-static int store_changesets(journal_t *j, list_t *changesets)
+static int store_changesets(journal_t *j, list_t *changesets, knot_db_txn_t *parent)
 {
 	// PART 1 : initializers, compute serialized_sizes, transaction start
 	changeset_t *ch;
@@ -1265,12 +1495,13 @@ static int store_changesets(journal_t *j, list_t *changesets)
 	uint8_t **chunkptrs = NULL;
 	size_t *chunksizes = NULL;
 	knot_db_val_t *vals = NULL;
+	uint8_t *compress_buf = NULL;
 
 	bool inserting_merged = false;
 	bool merged_into_bootstrap = false;
 	bool inserting_bootstrap = false;
 
-	size_t occupied_last, occupied_now = knot_db_lmdb_get_usage(j->db->db);
+	size_t occupied_now = knot_db_lmdb_get_usage(j->db->db);
 
 	WALK_LIST(ch, *changesets) {
 		nchs++;
@@ -1281,6 +1512,7 @@ static int store_changesets(journal_t *j, list_t *changesets)
 	}
 
 	local_txn_t(txn, j);
+	txn->parent = parent;
 	txn_begin(txn, true);
 
 	bool zone_in_journal = has_bootstrap_changeset(j, txn);
@@ -1289,21 +1521,12 @@ static int store_changesets(journal_t *j, list_t *changesets)
 	// if you're tempted to add dirty_serial deletion somewhere here, you're wrong. Don't do it.
 
 	// PART 2 : recalculating the previous insert's occupy change
-	md_get_common_last_occupied(txn, &occupied_last);
-	md_set(txn, NULL, MDKEY_GLOBAL_LAST_TOTAL_OCCUPIED, occupied_now);
-	if (occupied_now != occupied_last) {
-		knot_dname_t *last_zone = NULL;
-		uint64_t lz_occupied;
-		md_get_common_last_inserter_zone(txn, &last_zone);
-		if (last_zone != NULL) {
-			md_get(txn, last_zone, MDKEY_PERZONE_OCCUPIED, &lz_occupied);
-			lz_occupied = (lz_occupied + occupied_now > occupied_last ?
-			               lz_occupied + occupied_now - occupied_last : 0);
-			md_set(txn, last_zone, MDKEY_PERZONE_OCCUPIED, lz_occupied);
-			free(last_zone);
-		}
+	// (a group commit does it for all its stores, see store_batch())
+	if (parent == NULL) {
+		md_charge_last_insert(txn, occupied_now);
+		md_del_last_inserter_zone(txn, NULL);
+		md_set_common_last_inserter_zone(txn, j->zone);
 	}
-	md_set_common_last_inserter_zone(txn, j->zone);
 
 	// PART 3a : delete all if inserting bootstrap changeset
 	if (inserting_bootstrap) {
@@ -1399,7 +1622,13 @@ static int store_changesets(journal_t *j, list_t *changesets)
 		}
 	}
 
-	// PART 5: serializing into chunks
+	// PART 5: serializing into chunks, optionally compressed
+	if (journal_compression(j) && txn->ret == KNOT_EOK) {
+		compress_buf = malloc(CHUNK_MAX);
+		if (compress_buf == NULL) {
+			txn->ret = KNOT_ENOMEM;
+		}
+	}
 	WALK_LIST(ch, *changesets) {
 		if (txn->ret != KNOT_EOK) {
 			break;
@@ -1433,6 +1662,9 @@ static int store_changesets(journal_t *j, list_t *changesets)
 			vals[i].data = allchunks + i*CHUNK_MAX;
 			vals[i].len = JOURNAL_HEADER_SIZE + chunksizes[i];
 			make_header(vals + i, serial_to, chunks);
+			if (compress_buf != NULL && compress_chunk(vals + i, compress_buf)) {
+				txn->shadow_md.flags |= CHUNKS_COMPRESSED;
+			}
 		}
 
 	// PART 6: inserting vals into db
@@ -1501,6 +1733,7 @@ store_changeset_cleanup:
 
 	if (txn->ret != KNOT_EOK) {
 		local_txn_t(ddtxn, j);
+		ddtxn->parent = parent;
 		txn_begin(ddtxn, true);
 		if (md_flag(ddtxn, DIRTY_SERIAL_VALID)) {
 			delete_dirty_serial(j, ddtxn);
@@ -1512,6 +1745,7 @@ store_changeset_cleanup:
 	if (chunkptrs != NULL) free(chunkptrs);
 	if (chunksizes != NULL) free(chunksizes);
 	if (vals != NULL) free(vals);
+	free(compress_buf);
 
 	changeset_t *dbgchst = TAIL(*changesets);
 
@@ -1525,6 +1759,157 @@ store_changeset_cleanup:
 }
 #undef try_flush
 
+/*! \brief Store waiting for a group commit. */
+typedef struct {
+	node_t n;
+	journal_t *j;
+	list_t *changesets;
+	size_t size;
+	int ret;
+	bool done;
+} store_req_t;
+
+/*! \brief Records the zones of a group commit and their sizes for usage accounting. */
+static void md_set_last_inserter_group(txn_t *txn, list_t *batch)
+{
+	md_del_last_inserter_zone(txn, NULL);
+
+	size_t len = 0;
+	store_req_t *req;
+	WALK_LIST(req, *batch) {
+		if (req->ret == KNOT_EOK) {
+			len += sizeof(uint64_t) + knot_dname_size(req->j->zone);
+		}
+	}
+	if (len == 0) {
+		return;
+	}
+	uint8_t *group = malloc(len);
+	if (group == NULL) {
+		txn->ret = KNOT_ENOMEM;
+		return;
+	}
+	uint8_t *pos = group;
+	WALK_LIST(req, *batch) {
+		if (req->ret == KNOT_EOK) {
+			uint64_t size_be = htobe64(req->size);
+			memcpy(pos, &size_be, sizeof(size_be));
+			pos += sizeof(size_be);
+			pos += knot_dname_to_wire(pos, req->j->zone, group + len - pos);
+		}
+	}
+
+	txn_key_str(txn, NULL, MDKEY_GLOBAL_LAST_INSERTER_GROUP);
+	txn->val.len = len;
+	txn->val.data = group;
+	txn_insert(txn);
+	free(group);
+}
+
+/*! \brief Stores the changesets of the requests in one DB transaction. */
+static void store_batch(journal_db_t *db, list_t *batch)
+{
+	knot_db_txn_t parent;
+	int ret = knot_db_lmdb_txn_begin(db->db, &parent, NULL, 0);
+
+	// The DB usage changes only when the parent commits, so the usage
+	// change of the whole group is split among its zones by the next insert.
+	journal_t *first = ((store_req_t *)HEAD(*batch))->j;
+	if (ret == KNOT_EOK) {
+		local_txn_t(txn, first);
+		txn->parent = &parent;
+		txn_begin(txn, true);
+		md_charge_last_insert(txn, knot_db_lmdb_get_usage(db->db));
+		txn_commit(txn);
+	}
+
+	// Each store uses a nested transaction, so that a failing one is reverted alone.
+	store_req_t *req;
+	WALK_LIST(req, *batch) {
+		req->ret = (ret == KNOT_EOK) ? store_changesets(req->j, req->changesets, &parent) : ret;
+	}
+
+	if (ret == KNOT_EOK) {
+		local_txn_t(txn, first);
+		txn->parent = &parent;
+		txn_begin(txn, true);
+		md_set_last_inserter_group(txn, batch);
+		txn_commit(txn);
+	}
+
+	if (ret == KNOT_EOK) {
+		ret = db->db_api->txn_commit(&parent);
+		if (ret != KNOT_EOK) {
+			db->db_api->txn_abort(&parent);
+			WALK_LIST(req, *batch) {
+				if (req->ret == KNOT_EOK) {
+					req->ret = ret;
+				}
+			}
+		}
+	}
+}
+
+static int store_grouped(journal_t *j, list_t *changesets)
+{
+	journal_db_t *db = j->db;
+
+	size_t size = 0;
+	changeset_t *ch;
+	WALK_LIST(ch, *changesets) {
+		size += changeset_serialized_size(ch);
+	}
+
+	// Large inserts are split into more transactions, only in their own.
+	size_t max_size = journal_max_txn(j) * db->fslimit;
+	if (db->mode != JOURNAL_MODE_ROBUST || size > max_size) {
+		return store_changesets(j, changesets, NULL);
+	}
+
+	store_req_t req = {
+		.j = j,
+		.changesets = changesets,
+		.size = size,
+	};
+
+	pthread_mutex_lock(&db->batch_mutex);
+	add_tail(&db->batch, &req.n);
+	while (!req.done) {
+		if (db->batch_busy) {
+			pthread_cond_wait(&db->batch_cond, &db->batch_mutex);
+			continue;
+		}
+
+		// Lead the group commit of the stores waiting so far.
+		db->batch_busy = true;
+		list_t batch;
+		init_list(&batch);
+		size_t batch_size = 0;
+		store_req_t *it, *nxt;
+		WALK_LIST_DELSAFE(it, nxt, db->batch) {
+			if (!EMPTY_LIST(batch) && batch_size + it->size > max_size) {
+				break;
+			}
+			batch_size += it->size;
+			rem_node(&it->n);
+			add_tail(&batch, &it->n);
+		}
+		pthread_mutex_unlock(&db->batch_mutex);
+
+		store_batch(db, &batch);
+
+		pthread_mutex_lock(&db->batch_mutex);
+		WALK_LIST(it, batch) {
+			it->done = true;
+		}
+		db->batch_busy = false;
+		pthread_cond_broadcast(&db->batch_cond);
+	}
+	pthread_mutex_unlock(&db->batch_mutex);
+
+	return req.ret;
+}
+
 int journal_store_changeset(journal_t *journal, changeset_t *ch)
 {
 	if (journal == NULL || journal->db == NULL || ch == NULL) return KNOT_EINVAL;
@@ -1538,7 +1923,7 @@ int journal_store_changeset(journal_t *journal, changeset_t *ch)
 	list_t list;
 	init_list(&list);
 	add_tail(&list, &ch_shallowcopy->n);
-	int ret = store_changesets(journal, &list);
+	int ret = store_grouped(journal, &list);
 
 	free(ch_shallowcopy);
 	return ret;
@@ -1547,7 +1932,7 @@ int journal_store_changeset(journal_t *journal, changeset_t *ch)
 int journal_store_changesets(journal_t *journal, list_t *src)
 {
 	if (journal == NULL || journal->db == NULL || src == NULL) return KNOT_EINVAL;
-	return store_changesets(journal, src);
+	return store_grouped(journal, src);
 }
 
 /*
@@ -1574,6 +1959,22 @@ void journal_free(journal_t **journal)
 	*journal = NULL;
 }
 
+/*! \brief Get the shard of the journal DB the zone belongs to. */
+static journal_db_t *db_shard(journal_db_t *db, const knot_dname_t *zone)
+{
+	if (db->shard_count == 0) {
+		return db;
+	}
+
+	// FNV-1a of the lowercased name, the assignment must be stable.
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < knot_dname_size(zone); i++) {
+		hash = (hash ^ knot_tolower(zone[i])) * 16777619u;
+	}
+
+	return db->shards[hash % db->shard_count];
+}
+
 static int open_journal_db_unsafe(journal_db_t **db)
 {
 	if ((*db)->db != NULL) return KNOT_EOK;
@@ -1602,12 +2003,37 @@ static int open_journal_db_unsafe(journal_db_t **db)
 int journal_open_db(journal_db_t **db)
 {
 	if (*db == NULL) return KNOT_EINVAL;
+
+	// All shards are opened, so that their number is apparent on the disk.
+	if ((*db)->shard_count > 0) {
+		int ret = make_path((*db)->shards[0]->path, S_IRWXU | S_IRWXG);
+		for (unsigned i = 0; i < (*db)->shard_count && ret == KNOT_EOK; i++) {
+			ret = journal_open_db(&(*db)->shards[i]);
+		}
+		return ret;
+	}
+
 	pthread_mutex_lock(&(*db)->db_mutex);
 	int ret = open_journal_db_unsafe(db);
 	pthread_mutex_unlock(&(*db)->db_mutex);
 	return ret;
 }
 
+bool journal_db_is_open(journal_db_t *db)
+{
+	if (db == NULL) {
+		return false;
+	}
+
+	for (unsigned i = 0; i < db->shard_count; i++) {
+		if (db->shards[i]->db != NULL) {
+			return true;
+		}
+	}
+
+	return db->db != NULL;
+}
+
 int journal_open(journal_t *journal, journal_db_t **db, const knot_dname_t *zone_name)
 {
 	int ret = KNOT_EOK;
@@ -1618,13 +2044,14 @@ int journal_open(journal_t *journal, journal_db_t **db, const knot_dname_t *zone
 	}
 
 	// open shared journal DB if not already
-	if ((*db)->db == NULL) {
+	journal_db_t *shard = db_shard(*db, zone_name);
+	if (shard->db == NULL) {
 		ret = journal_open_db(db);
 	}
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
-	journal->db = *db;
+	journal->db = shard;
 
 	journal->zone = knot_dname_copy(zone_name, NULL);
 	if (journal->zone == NULL) {
@@ -1648,12 +2075,69 @@ void journal_close(journal_t *journal)
 	journal->zone = NULL;
 }
 
+static char *shard_path(const char *lmdb_dir_path, unsigned index)
+{
+	return sprintf_alloc("%s/shard%u", lmdb_dir_path, index);
+}
+
+/*! \brief Count the consecutive shard directories of an existing DB. */
+static unsigned detect_shards(const char *lmdb_dir_path)
+{
+	unsigned count = 0;
+	while (count < JOURNAL_MAX_SHARDS) {
+		char *path = shard_path(lmdb_dir_path, count);
+		struct stat st;
+		bool exists = (path != NULL && stat(path, &st) == 0 && S_ISDIR(st.st_mode));
+		free(path);
+		if (!exists) {
+			break;
+		}
+		count++;
+	}
+
+	return count;
+}
+
+/*! \brief Check that an existing DB has the same number of shards as configured. */
+static int check_shards(const char *lmdb_dir_path, unsigned shards)
+{
+	unsigned detected = detect_shards(lmdb_dir_path);
+	if (detected == 0) {
+		char *path = sprintf_alloc("%s/data.mdb", lmdb_dir_path);
+		struct stat st;
+		if (path != NULL && stat(path, &st) == 0 && st.st_size > 0) {
+			detected = 1;
+		}
+		free(path);
+	}
+
+	if (detected != 0 && detected != shards) {
+		log_error("journal DB '%s' has %u shard(s) but %u configured, "
+		          "flush the zones and remove the DB to change it",
+		          lmdb_dir_path, detected, shards);
+		return KNOT_EEXIST;
+	}
+
+	return KNOT_EOK;
+}
+
 int journal_db_init(journal_db_t **db, const char *lmdb_dir_path, size_t lmdb_fslimit,
-                    journal_mode_t mode)
+                    journal_mode_t mode, unsigned shards)
 {
 	if (*db != NULL) {
 		return KNOT_EOK;
 	}
+	if (shards > JOURNAL_MAX_SHARDS) {
+		return KNOT_EINVAL;
+	}
+	if (shards == 0) {
+		shards = detect_shards(lmdb_dir_path);
+	} else {
+		int ret = check_shards(lmdb_dir_path, shards);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
 	*db = malloc(sizeof(journal_db_t));
 	if (*db == NULL) {
 		return KNOT_ENOMEM;
@@ -1667,6 +2151,30 @@ int journal_db_init(journal_db_t **db, const char *lmdb_dir_path, size_t lmdb_fs
 	};
 	memcpy(*db, &dbinit, sizeof(journal_db_t));
 	pthread_mutex_init(&(*db)->db_mutex, NULL);
+	pthread_mutex_init(&(*db)->batch_mutex, NULL);
+	pthread_cond_init(&(*db)->batch_cond, NULL);
+	init_list(&(*db)->batch);
+
+	if (shards > 1) {
+		(*db)->shards = calloc(shards, sizeof(journal_db_t *));
+		if ((*db)->shards == NULL) {
+			journal_db_close(db);
+			return KNOT_ENOMEM;
+		}
+		(*db)->shard_count = shards;
+
+		for (unsigned i = 0; i < shards; i++) {
+			char *path = shard_path(lmdb_dir_path, i);
+			int ret = (path == NULL) ? KNOT_ENOMEM :
+			          journal_db_init(&(*db)->shards[i], path, lmdb_fslimit, mode, 1);
+			free(path);
+			if (ret != KNOT_EOK) {
+				journal_db_close(db);
+				return ret;
+			}
+		}
+	}
+
 	return KNOT_EOK;
 }
 
@@ -1675,6 +2183,9 @@ static void destroy_journal_db(journal_db_t **db)
 	assert((*db)->db == NULL);
 
 	pthread_mutex_destroy(&(*db)->db_mutex);
+	pthread_mutex_destroy(&(*db)->batch_mutex);
+	pthread_cond_destroy(&(*db)->batch_cond);
+	free((*db)->shards);
 	free((*db)->path);
 	free((*db));
 	*db = NULL;
@@ -1686,6 +2197,10 @@ void journal_db_close(journal_db_t **db)
 		return;
 	}
 
+	for (unsigned i = 0; i < (*db)->shard_count; i++) {
+		journal_db_close(&(*db)->shards[i]);
+	}
+
 	pthread_mutex_lock(&(*db)->db_mutex);
 	if ((*db)->db != NULL) {
 		(*db)->db_api->deinit((*db)->db);
@@ -1715,9 +2230,10 @@ bool journal_exists(journal_db_t **db, knot_dname_t *zone_name)
 		return false;
 	}
 
-	if ((*db)->db == NULL) {
+	journal_db_t *shard = db_shard(*db, zone_name);
+	if (shard->db == NULL) {
 		struct stat st;
-		if (stat((*db)->path, &st) != 0 || st.st_size == 0) {
+		if (stat(shard->path, &st) != 0 || st.st_size == 0) {
 			return false;
 		}
 		int ret = journal_open_db(db);
@@ -1726,7 +2242,7 @@ bool journal_exists(journal_db_t **db, knot_dname_t *zone_name)
 		}
 	}
 
-	journal_t fake_journal = { .db = *db, .zone = zone_name };
+	journal_t fake_journal = { .db = shard, .zone = zone_name };
 	local_txn_t(txn, &fake_journal);
 	txn_begin(txn, false);
 	txn_key_str(txn, zone_name, MDKEY_PERZONE_FLAGS);
@@ -1796,9 +2312,57 @@ scrape_end:
 	return txn->ret;
 }
 
+/*! \brief Sum the sizes of all chunks of the journal. */
+static void chunk_stats_get(txn_t *txn, journal_chunk_stats_t *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	const knot_dname_t *zone = txn->j->zone;
+	size_t prefix_len = knot_dname_size(zone) + DB_KEY_UNUSED_ZERO;
+	size_t bootstrap_len = prefix_len + strlen(KEY_BOOTSTRAP_CHANGESET) + 1 + sizeof(uint32_t);
+	bool compressed = md_flag(txn, CHUNKS_COMPRESSED);
+
+	txn_key_2u32(txn, zone, 0, 0);
+	txn->key.len = prefix_len;
+	txn_iter_begin(txn);
+	if (txn->ret != KNOT_EOK) {
+		return;
+	}
+	txn->iter = txn->j->db->db_api->iter_seek(txn->iter, &txn->key, KNOT_DB_GEQ);
+
+	knot_db_val_t key;
+	while (txn->iter != NULL && txn->ret == KNOT_EOK) {
+		txn_iter_key(txn, &key);
+		if (txn->ret != KNOT_EOK || key.len < prefix_len ||
+		    memcmp(key.data, txn->key.data, prefix_len) != 0) {
+			break;
+		}
+
+		// Changeset chunk keys, the metadata keys differ in length.
+		bool is_chunk = (key.len == prefix_len + 2 * sizeof(uint32_t)) ||
+		                (key.len == bootstrap_len &&
+		                 strcmp(key.data + prefix_len, KEY_BOOTSTRAP_CHANGESET) == 0);
+		if (is_chunk) {
+			txn_iter_val(txn);
+		}
+		if (is_chunk && txn->ret == KNOT_EOK && txn->val.len >= JOURNAL_HEADER_SIZE) {
+			size_t raw_size = txn->val.len - JOURNAL_HEADER_SIZE;
+			if (compressed && (chunk_flags(&txn->val, &raw_size) & CHUNK_COMPRESSED)) {
+				stats->compressed++;
+			}
+			stats->chunks++;
+			stats->raw_size += raw_size;
+			stats->stored_size += txn->val.len - JOURNAL_HEADER_SIZE;
+		}
+
+		txn->iter = txn->j->db->db_api->iter_next(txn->iter);
+	}
+	txn_iter_finish(txn);
+}
+
 void journal_metadata_info(journal_t *j, bool *has_bootstrap, kserial_t *merged_serial,
 			   kserial_t *first_serial, kserial_t *last_flushed, kserial_t *serial_to,
-			   uint64_t *occupied)
+			   uint64_t *occupied, journal_chunk_stats_t *chunk_stats)
 {
 	// NOTE: there is NEVER the situation that only merged changeset would be present and no common changeset in db.
 
@@ -1821,6 +2385,9 @@ void journal_metadata_info(journal_t *j, bool *has_bootstrap, kserial_t *merged_
 		if (occupied != NULL) {
 			*occupied = 0;
 		}
+		if (chunk_stats != NULL) {
+			memset(chunk_stats, 0, sizeof(*chunk_stats));
+		}
 		return;
 	}
 
@@ -1849,19 +2416,49 @@ void journal_metadata_info(journal_t *j, bool *has_bootstrap, kserial_t *merged_
 	}
 	if (occupied != NULL) {
 		md_get(txn, j->zone, MDKEY_PERZONE_OCCUPIED, occupied);
+		size_t lz_occupied;
+		md_get_common_last_occupied(txn, &lz_occupied);
+		int64_t change = (int64_t)knot_db_lmdb_get_usage(j->db->db) - (int64_t)lz_occupied;
 		knot_dname_t *last_inserter = NULL;
 		md_get_common_last_inserter_zone(txn, &last_inserter);
+		knot_db_val_t group;
+		md_get_last_inserter_group(txn, &group);
+		uint64_t size, total;
 		if (last_inserter != NULL && knot_dname_is_equal(last_inserter, j->zone)) {
-			size_t lz_occupied;
-			md_get_common_last_occupied(txn, &lz_occupied);
-			*occupied += knot_db_lmdb_get_usage(j->db->db) - lz_occupied;
+			*occupied += change;
+		} else if (group_contains(&group, j->zone, &size, &total)) {
+			*occupied += group_share(change, size, total);
 		}
 		free(last_inserter);
+		free(group.data);
+	}
+	if (chunk_stats != NULL) {
+		chunk_stats_get(txn, chunk_stats);
 	}
 
 	txn_abort(txn);
 }
 
+/*! \brief List the zones of all the shards, skipping the empty ones. */
+static int list_zones_sharded(journal_db_t *db, list_t *zones)
+{
+	for (unsigned i = 0; i < db->shard_count; i++) {
+		list_t shard_zones;
+		init_list(&shard_zones);
+		int ret = journal_db_list_zones(&db->shards[i], &shard_zones);
+		if (ret == KNOT_ENOENT) {
+			continue;
+		} else if (ret != KNOT_EOK) {
+			ptrlist_deep_free(zones, NULL);
+			init_list(zones);
+			return ret;
+		}
+		add_tail_list(zones, &shard_zones);
+	}
+
+	return (list_size(zones) < 1) ? KNOT_ENOENT : KNOT_EOK;
+}
+
 int journal_db_list_zones(journal_db_t **db, list_t *zones)
 {
 	uint64_t expected_count;
@@ -1870,6 +2467,10 @@ int journal_db_list_zones(journal_db_t **db, list_t *zones)
 		return KNOT_EINVAL;
 	}
 
+	if ((*db)->shard_count > 0) {
+		return list_zones_sharded(*db, zones);
+	}
+
 	if ((*db)->db == NULL) {
 		int ret = journal_open_db(db);
 		if (ret != KNOT_EOK) {
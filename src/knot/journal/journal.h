@@ -27,18 +27,27 @@
 /*! \brief Minimum journal size. */
 #define JOURNAL_MIN_FSLIMIT	(1 * 1024 * 1024)
 
+/*! \brief Maximum number of journal DB shards. */
+#define JOURNAL_MAX_SHARDS	64
+
 typedef enum {
 	JOURNAL_MODE_ROBUST = 0, // Robust journal DB disk synchronization.
 	JOURNAL_MODE_ASYNC  = 1, // Asynchronous journal DB disk synchronization.
 } journal_mode_t;
 
-typedef struct {
+typedef struct journal_db {
 	knot_db_t *db;
 	const knot_db_api_t *db_api;
 	char *path;
 	size_t fslimit;
 	journal_mode_t mode;
 	pthread_mutex_t db_mutex; // please delete this once you move DB opening from journal_open to db_init
+	pthread_mutex_t batch_mutex; // Protects the stores waiting for a group commit.
+	pthread_cond_t batch_cond;   // Signals a finished group commit.
+	list_t batch;                // Stores waiting for a group commit.
+	bool batch_busy;             // A group commit is in progress.
+	struct journal_db **shards;  // Independent shard DBs the zones are hashed onto.
+	unsigned shard_count;        // Number of shards, 0 if not sharded.
 } journal_db_t;
 
 typedef struct {
@@ -46,6 +55,14 @@ typedef struct {
 	knot_dname_t *zone;
 } journal_t;
 
+/*! \brief Sizes of the stored changeset chunks of a journal. */
+typedef struct {
+	uint64_t chunks;       // Number of chunks.
+	uint64_t compressed;   // Number of compressed chunks.
+	uint64_t raw_size;     // Size of the serialized changesets.
+	uint64_t stored_size;  // Size of the stored, possibly compressed, chunk data.
+} journal_chunk_stats_t;
+
 typedef enum {
 	JOURNAL_CHECK_SILENT = 0, // No logging, just curious for return value.
 	JOURNAL_CHECK_WARN   = 1, // Log journal inconsistencies.
@@ -56,15 +73,23 @@ typedef enum {
 /*!
  * \brief Initialize shared journal DB file. The DB will be open on first use.
  *
+ * With more shards, the DB consists of independent LMDB environments in
+ * subdirectories "shard<i>" of the DB directory, each with its own writer,
+ * and the zones are assigned to the shards by a hash of their names.
+ * Each shard is limited by \a lmdb_fslimit.
+ *
  * \param db             Database to be initialized. Must be (*db == NULL) before!
  * \param lmdb_dir_path  Path to the directory with DB
  * \param lmdb_fslimit   Maximum size of DB data file
  * \param mode           Journal DB synchronization mode.
+ * \param shards         Number of shards, 1 for a single DB, 0 to detect
+ *                       the number of shards of an existing DB.
  *
+ * \retval KNOT_EEXIST if an existing DB has a different number of shards.
  * \return KNOT_E*
  */
 int journal_db_init(journal_db_t **db, const char *lmdb_dir_path, size_t lmdb_fslimit,
-                    journal_mode_t mode);
+                    journal_mode_t mode, unsigned shards);
 
 /*!
  * \brief Close shared journal DB file.
@@ -74,7 +99,16 @@ int journal_db_init(journal_db_t **db, const char *lmdb_dir_path, size_t lmdb_fs
 void journal_db_close(journal_db_t **db);
 
 /*!
- * \brief List the zones contained in journal DB.
+ * \brief Check if the journal DB (any of its shards) is open.
+ *
+ * \param db  Shared journal DB.
+ *
+ * \return true or false
+ */
+bool journal_db_is_open(journal_db_t *db);
+
+/*!
+ * \brief List the zones contained in journal DB (all its shards).
  *
  * \param[in] db      Shared journal DB
  * \param[out] zones  List of strings (char *) of zone names
@@ -149,6 +183,10 @@ int journal_load_bootstrap(journal_t *journal, list_t *dst);
 /*!
  * \brief Store changesets in journal.
  *
+ * In robust mode, concurrent stores into journals of different zones are
+ * grouped into one DB transaction, so that they share one disk synchronization.
+ * The function returns once the changesets are durably stored.
+ *
  * \param journal  Journal to store in.
  * \param src      Changesets to store.
  *
@@ -175,7 +213,7 @@ int journal_store_changeset(journal_t *journal, changeset_t *change);
  *
  * This is an "almost static" function, which is mostly called by other journal
  * methods like journal_open() and journal_exists(). However it can be called
- * separately just for more precise error resolution.
+ * separately just for more precise error resolution. All shards are opened.
  *
  * \param db Journal to be opened.
  * \return KNOT_E*
@@ -211,10 +249,13 @@ int journal_flush(journal_t *journal);
 int journal_scrape(journal_t *journal);
 
 /*! \brief Obtain public information from journal metadata
+ *
+ * \note Obtaining the chunk statistics requires reading all the journal chunks.
  */
 void journal_metadata_info(journal_t *journal, bool *is_empty, kserial_t *merged_serial,
                            kserial_t *first_serial, kserial_t *last_flushed,
-                           kserial_t *serial_to, uint64_t *occupied);
+                           kserial_t *serial_to, uint64_t *occupied,
+                           journal_chunk_stats_t *chunk_stats);
 
 /*! \brief Check the journal consistency, errors to stderr.
  *
@@ -17,8 +17,7 @@
 #include "contrib/net.h"
 #include "knot/include/module.h"
 #include "knot/conf/schema.h"
-#include "knot/query/capture.h" // Forces static module!
-#include "knot/query/requestor.h" // Forces static module!
+#include "knot/modules/dnsproxy/upstream.h"
 
 #define MOD_REMOTE		"\x06""remote"
 #define MOD_TIMEOUT		"\x07""timeout"
@@ -51,8 +50,61 @@ typedef struct {
 	bool fallback;
 	bool catch_nxdomain;
 	int timeout;
+	upstream_t *upstream;
 } dnsproxy_t;
 
+/*! \brief Upstream result for a deferred query. */
+typedef struct {
+	int ret;
+	size_t len;
+	uint8_t wire[];
+} dnsproxy_answer_t;
+
+static void dnsproxy_done(int ret, const uint8_t *answer, size_t answer_len,
+                          void *data)
+{
+	dnsproxy_answer_t *result = malloc(sizeof(*result) + answer_len);
+	if (result != NULL) {
+		result->ret = ret;
+		result->len = answer_len;
+		if (answer_len > 0) {
+			memcpy(result->wire, answer, answer_len);
+		}
+	}
+
+	knotd_defer_resume(data, result);
+}
+
+static int dnsproxy_fill(knot_pkt_t *pkt, const dnsproxy_answer_t *answer)
+{
+	if (answer->ret != KNOT_EOK) {
+		return answer->ret;
+	}
+
+	knot_pkt_clear(pkt);
+	if (answer->len <= pkt->max_size) {
+		memcpy(pkt->wire, answer->wire, answer->len);
+		pkt->size = answer->len;
+		return knot_pkt_parse(pkt, 0);
+	}
+
+	/* Too big for the client, truncate to the question to make it retry over TCP. */
+	int qname_len = knot_dname_wire_check(answer->wire + KNOT_WIRE_HEADER_SIZE,
+	                                      answer->wire + answer->len, NULL);
+	if (qname_len <= 0) {
+		return KNOT_EMALF;
+	}
+	size_t qend = KNOT_WIRE_HEADER_SIZE + qname_len + 2 * sizeof(uint16_t);
+	memcpy(pkt->wire, answer->wire, qend);
+	pkt->size = qend;
+	knot_wire_set_tc(pkt->wire);
+	knot_wire_set_ancount(pkt->wire, 0);
+	knot_wire_set_nscount(pkt->wire, 0);
+	knot_wire_set_arcount(pkt->wire, 0);
+
+	return knot_pkt_parse(pkt, 0);
+}
+
 static knotd_state_t dnsproxy_fwd(knotd_state_t state, knot_pkt_t *pkt,
                                   knotd_qdata_t *qdata, knotd_mod_t *mod)
 {
@@ -60,61 +112,54 @@ static knotd_state_t dnsproxy_fwd(knotd_state_t state, knot_pkt_t *pkt,
 
 	dnsproxy_t *proxy = knotd_mod_ctx(mod);
 
+	/* Finish a query resumed with the upstream answer. */
+	dnsproxy_answer_t *answer = knotd_qdata_resumed(qdata);
+	if (answer != NULL) {
+		if (dnsproxy_fill(pkt, answer) != KNOT_EOK) {
+			qdata->rcode = KNOT_RCODE_SERVFAIL;
+			return KNOTD_STATE_FAIL; /* Forwarding failed, SERVFAIL. */
+		}
+		qdata->rcode = knot_pkt_ext_rcode(pkt);
+
+		/* The answer is complete, don't add own OPT. */
+		knot_rrset_clear(&qdata->opt_rr, qdata->mm);
+
+		/* Respond also with TSIG. */
+		if (pkt->tsig_rr != NULL && !proxy->fallback) {
+			knot_tsig_append(pkt->wire, &pkt->size, pkt->max_size, pkt->tsig_rr);
+		}
+
+		return KNOTD_STATE_DONE;
+	}
+
 	/* Forward only queries ending with REFUSED (no zone) or NXDOMAIN (if configured) */
 	if (proxy->fallback && !(qdata->rcode == KNOT_RCODE_REFUSED ||
 	     (qdata->rcode == KNOT_RCODE_NXDOMAIN && proxy->catch_nxdomain))) {
 		return state;
 	}
 
-	/* Forward also original TSIG. */
-	if (qdata->query->tsig_rr != NULL && !proxy->fallback) {
-		knot_tsig_append(qdata->query->wire, &qdata->query->size,
-		                 qdata->query->max_size, qdata->query->tsig_rr);
-	}
-
-	/* Capture layer context. */
-	const knot_layer_api_t *capture = query_capture_api();
-	struct capture_param capture_param = {
-		.sink = pkt
-	};
-
-	/* Create a forwarding request. */
-	struct knot_requestor re;
-	int ret = knot_requestor_init(&re, capture, &capture_param, qdata->mm);
-	if (ret != KNOT_EOK) {
-		return state; /* Ignore, not enough memory. */
+	/* Don't block the I/O thread, the answer is produced when resumed. */
+	knotd_defer_t *defer = knotd_qdata_defer(qdata);
+	if (defer == NULL) {
+		qdata->rcode = KNOT_RCODE_SERVFAIL;
+		return KNOTD_STATE_FAIL; /* Forwarding not possible, SERVFAIL. */
 	}
 
-	bool is_tcp = net_is_stream(qdata->params->socket);
-	const struct sockaddr *dst = (const struct sockaddr *)&proxy->remote;
-	const struct sockaddr *src = (const struct sockaddr *)&proxy->via;
-	struct knot_request *req = knot_request_make(re.mm, dst, src, qdata->query, NULL,
-	                                             is_tcp ? 0 : KNOT_RQ_UDP);
-	if (req == NULL) {
-		knot_requestor_clear(&re);
-		return state; /* Ignore, not enough memory. */
+	/* Forward also original TSIG. */
+	knot_pkt_t *query = qdata->query;
+	if (query->tsig_rr != NULL && !proxy->fallback) {
+		knot_tsig_append(query->wire, &query->size, query->max_size,
+		                 query->tsig_rr);
 	}
 
-	/* Forward request. */
-	ret = knot_requestor_exec(&re, req, proxy->timeout);
-
-	knot_request_free(req, re.mm);
-	knot_requestor_clear(&re);
-
-	/* Check result. */
+	int ret = upstream_send(proxy->upstream, query->wire, query->size,
+	                        net_is_stream(qdata->params->socket),
+	                        dnsproxy_done, defer);
 	if (ret != KNOT_EOK) {
-		qdata->rcode = KNOT_RCODE_SERVFAIL;
-		return KNOTD_STATE_FAIL; /* Forwarding failed, SERVFAIL. */
-	} else {
-		qdata->rcode = knot_pkt_ext_rcode(pkt);
-	}
-
-	/* Respond also with TSIG. */
-	if (pkt->tsig_rr != NULL && !proxy->fallback) {
-		knot_tsig_append(pkt->wire, &pkt->size, pkt->max_size, pkt->tsig_rr);
+		dnsproxy_done(ret, NULL, 0, defer);
 	}
 
-	return KNOTD_STATE_DONE;
+	return state;
 }
 
 int dnsproxy_load(knotd_mod_t *mod)
@@ -145,6 +190,12 @@ int dnsproxy_load(knotd_mod_t *mod)
 	conf = knotd_conf_mod(mod, MOD_CATCH_NXDOMAIN);
 	proxy->catch_nxdomain = conf.single.boolean;
 
+	proxy->upstream = upstream_new(&proxy->remote, &proxy->via, proxy->timeout);
+	if (proxy->upstream == NULL) {
+		free(proxy);
+		return KNOT_ENOMEM;
+	}
+
 	knotd_mod_ctx_set(mod, proxy);
 
 	if (proxy->fallback) {
@@ -156,7 +207,11 @@ int dnsproxy_load(knotd_mod_t *mod)
 
 void dnsproxy_unload(knotd_mod_t *mod)
 {
-	free(knotd_mod_ctx(mod));
+	dnsproxy_t *proxy = knotd_mod_ctx(mod);
+	if (proxy != NULL) {
+		upstream_free(proxy->upstream);
+		free(proxy);
+	}
 }
 
 KNOTD_MOD_API(dnsproxy, KNOTD_MOD_FLAG_SCOPE_ANY,
@@ -0,0 +1,597 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "knot/modules/dnsproxy/upstream.h"
+#include "contrib/macros.h"
+#include "contrib/net.h"
+#include "contrib/sockaddr.h"
+#include "contrib/time.h"
+#include "contrib/ucw/lists.h"
+#include "contrib/wire.h"
+#include "dnssec/random.h"
+#include "libknot/libknot.h"
+
+/* OS X doesn't support MSG_NOSIGNAL. */
+#if defined(__APPLE__) && !defined(MSG_NOSIGNAL)
+#  define MSG_NOSIGNAL 0
+#endif
+
+#define CHAN_COUNT (UPSTREAM_UDP_SOCKETS + UPSTREAM_TCP_CONNS)
+#define CHAN_IS_TCP(i) ((i) >= UPSTREAM_UDP_SOCKETS)
+#define ID_COUNT (UINT16_MAX + 1)
+#define ID_TRIES 16
+#define TCP_FRAME_MAX (sizeof(uint16_t) + KNOT_WIRE_MAX_PKTSIZE)
+
+/*! \brief Forwarded query. */
+typedef struct {
+	node_t n;                   /*!< Node in the pending or in-flight list. */
+	struct timespec deadline;   /*!< Response deadline. */
+	bool tcp;                   /*!< Forward over TCP. */
+	int chan;                   /*!< Assigned channel. */
+	uint16_t orig_id;           /*!< Client message ID. */
+	size_t qend;                /*!< End of the question section. */
+	upstream_cb_t cb;           /*!< Completion callback. */
+	void *data;                 /*!< Completion callback data. */
+	size_t wire_len;
+	uint8_t wire[];             /*!< Query copy. */
+} upstream_job_t;
+
+/*! \brief Upstream socket (UDP) or connection (TCP). */
+typedef struct {
+	int fd;
+	bool connected;             /*!< TCP connection established. */
+	size_t inflight;            /*!< Number of in-flight queries. */
+	size_t used;                /*!< Number of queries sent. */
+	uint8_t *tx;                /*!< TCP output queue. */
+	size_t tx_len;
+	size_t tx_size;
+	uint8_t *rx;                /*!< TCP input buffer. */
+	size_t rx_len;
+} upstream_chan_t;
+
+struct upstream {
+	struct sockaddr_storage remote;
+	struct sockaddr_storage via;
+	int timeout;
+
+	pthread_t thread;
+	int wake[2];                /*!< Wake-up pipe for the I/O thread. */
+
+	pthread_mutex_t lock;       /*!< Protects the pending queue and stop flag. */
+	list_t pending;
+	bool stop;
+
+	/* Owned by the I/O thread. */
+	list_t inflight;            /*!< In-flight queries ordered by deadline. */
+	upstream_job_t **ids;       /*!< In-flight queries by upstream message ID. */
+	upstream_chan_t chan[CHAN_COUNT];
+	unsigned next_udp;
+	uint8_t buf[KNOT_WIRE_MAX_PKTSIZE];
+};
+
+/*! \brief Deliver the response (or error) to the caller. */
+static void job_complete(upstream_job_t *job, uint8_t *wire, size_t wire_len,
+                         int ret)
+{
+	if (ret == KNOT_EOK) {
+		knot_wire_set_id(wire, job->orig_id);
+		job->cb(ret, wire, wire_len, job->data);
+	} else {
+		job->cb(ret, NULL, 0, job->data);
+	}
+	free(job);
+}
+
+/*! \brief Remove an in-flight query and complete it. */
+static void job_finish(upstream_t *up, upstream_job_t *job, uint8_t *wire,
+                       size_t wire_len, int ret)
+{
+	uint16_t id = knot_wire_get_id(job->wire);
+	assert(up->ids[id] == job);
+	up->ids[id] = NULL;
+	up->chan[job->chan].inflight -= 1;
+	rem_node(&job->n);
+
+	job_complete(job, wire, wire_len, ret);
+}
+
+static void chan_close(upstream_t *up, int idx)
+{
+	upstream_chan_t *chan = &up->chan[idx];
+	if (chan->fd < 0) {
+		return;
+	}
+
+	close(chan->fd);
+	chan->fd = -1;
+	chan->connected = false;
+	chan->used = 0;
+	chan->tx_len = 0;
+	chan->rx_len = 0;
+
+	/* Fail queries waiting for the closed channel. */
+	upstream_job_t *job = NULL, *next = NULL;
+	WALK_LIST_DELSAFE(job, next, up->inflight) {
+		if (job->chan == idx) {
+			job_finish(up, job, NULL, 0, KNOT_ECONN);
+		}
+	}
+}
+
+static int chan_open(upstream_t *up, int idx)
+{
+	upstream_chan_t *chan = &up->chan[idx];
+	if (chan->fd >= 0) {
+		return KNOT_EOK;
+	}
+
+	int type = CHAN_IS_TCP(idx) ? SOCK_STREAM : SOCK_DGRAM;
+	int fd = net_connected_socket(type, (struct sockaddr *)&up->remote,
+	                              (struct sockaddr *)&up->via);
+	if (fd < 0) {
+		return fd;
+	}
+
+	if (CHAN_IS_TCP(idx) && chan->rx == NULL) {
+		chan->rx = malloc(TCP_FRAME_MAX);
+		if (chan->rx == NULL) {
+			close(fd);
+			return KNOT_ENOMEM;
+		}
+	}
+
+	chan->fd = fd;
+	chan->connected = !CHAN_IS_TCP(idx);
+
+	return KNOT_EOK;
+}
+
+/*! \brief Pick a channel for the query, the least loaded one for TCP. */
+static int chan_select(upstream_t *up, bool tcp)
+{
+	if (!tcp) {
+		return up->next_udp++ % UPSTREAM_UDP_SOCKETS;
+	}
+
+	int best = UPSTREAM_UDP_SOCKETS;
+	for (int i = UPSTREAM_UDP_SOCKETS; i < CHAN_COUNT; i++) {
+		if (up->chan[i].inflight < up->chan[best].inflight) {
+			best = i;
+		}
+	}
+	return best;
+}
+
+static int chan_flush(upstream_t *up, int idx)
+{
+	upstream_chan_t *chan = &up->chan[idx];
+	if (!chan->connected || chan->tx_len == 0) {
+		return KNOT_EOK;
+	}
+
+	ssize_t ret = send(chan->fd, chan->tx, chan->tx_len, MSG_NOSIGNAL);
+	if (ret < 0) {
+		return (errno == EAGAIN || errno == EINTR) ? KNOT_EOK : KNOT_ECONN;
+	}
+
+	chan->tx_len -= ret;
+	memmove(chan->tx, chan->tx + ret, chan->tx_len);
+
+	return KNOT_EOK;
+}
+
+static int chan_enqueue(upstream_t *up, int idx, const uint8_t *wire, size_t wire_len)
+{
+	upstream_chan_t *chan = &up->chan[idx];
+
+	if (!CHAN_IS_TCP(idx)) {
+		ssize_t ret = send(chan->fd, wire, wire_len, 0);
+		return (ret == wire_len) ? KNOT_EOK : KNOT_ECONN;
+	}
+
+	size_t need = chan->tx_len + sizeof(uint16_t) + wire_len;
+	if (need > chan->tx_size) {
+		size_t size = MAX(need, 2 * chan->tx_size);
+		uint8_t *tx = realloc(chan->tx, size);
+		if (tx == NULL) {
+			return KNOT_ENOMEM;
+		}
+		chan->tx = tx;
+		chan->tx_size = size;
+	}
+
+	wire_write_u16(chan->tx + chan->tx_len, wire_len);
+	memcpy(chan->tx + chan->tx_len + sizeof(uint16_t), wire, wire_len);
+	chan->tx_len = need;
+
+	return chan_flush(up, idx);
+}
+
+/*! \brief Pick an unpredictable free message ID, false if too many are in use. */
+static bool id_select(upstream_t *up, uint16_t *id)
+{
+	for (int i = 0; i < ID_TRIES; i++) {
+		*id = dnssec_random_uint16_t();
+		if (up->ids[*id] == NULL) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*! \brief Assign an upstream message ID and send the query. */
+static void job_start(upstream_t *up, upstream_job_t *job)
+{
+	uint16_t id;
+	if (!id_select(up, &id)) {
+		job_complete(job, NULL, 0, KNOT_EBUSY);
+		return;
+	}
+
+	job->chan = chan_select(up, job->tcp);
+	int ret = chan_open(up, job->chan);
+	if (ret != KNOT_EOK) {
+		job_complete(job, NULL, 0, ret);
+		return;
+	}
+
+	knot_wire_set_id(job->wire, id);
+	up->ids[id] = job;
+	up->chan[job->chan].inflight += 1;
+	up->chan[job->chan].used += 1;
+	add_tail(&up->inflight, &job->n);
+
+	ret = chan_enqueue(up, job->chan, job->wire, job->wire_len);
+	if (ret != KNOT_EOK) {
+		if (CHAN_IS_TCP(job->chan)) {
+			chan_close(up, job->chan);
+		} else {
+			job_finish(up, job, NULL, 0, ret);
+		}
+	}
+}
+
+/*! \brief Match the response with an in-flight query. */
+static void chan_answer(upstream_t *up, int idx, uint8_t *wire, size_t wire_len)
+{
+	if (wire_len < KNOT_WIRE_HEADER_SIZE || !knot_wire_get_qr(wire)) {
+		return;
+	}
+
+	upstream_job_t *job = up->ids[knot_wire_get_id(wire)];
+	if (job == NULL || job->chan != idx || wire_len < job->qend ||
+	    memcmp(wire + KNOT_WIRE_OFFSET_QDCOUNT, job->wire + KNOT_WIRE_OFFSET_QDCOUNT,
+	           sizeof(uint16_t)) != 0 ||
+	    memcmp(wire + KNOT_WIRE_HEADER_SIZE, job->wire + KNOT_WIRE_HEADER_SIZE,
+	           job->qend - KNOT_WIRE_HEADER_SIZE) != 0) {
+		return; /* Unexpected or mismatching response. */
+	}
+
+	job_finish(up, job, wire, wire_len, KNOT_EOK);
+
+	/* Move to a new source port once the socket is idle. */
+	upstream_chan_t *chan = &up->chan[idx];
+	if (!CHAN_IS_TCP(idx) && chan->inflight == 0 &&
+	    chan->used >= UPSTREAM_UDP_REUSE) {
+		chan_close(up, idx);
+	}
+}
+
+static void chan_read(upstream_t *up, int idx)
+{
+	upstream_chan_t *chan = &up->chan[idx];
+
+	if (!CHAN_IS_TCP(idx)) {
+		ssize_t ret;
+		while ((ret = recv(chan->fd, up->buf, sizeof(up->buf), 0)) >= 0 ||
+		       errno == ECONNREFUSED) {
+			if (ret >= 0) {
+				chan_answer(up, idx, up->buf, ret);
+			}
+		}
+		return;
+	}
+
+	ssize_t ret = recv(chan->fd, chan->rx + chan->rx_len,
+	                   TCP_FRAME_MAX - chan->rx_len, 0);
+	if (ret <= 0) {
+		if (ret == 0 || (errno != EAGAIN && errno != EINTR)) {
+			chan_close(up, idx);
+		}
+		return;
+	}
+	chan->rx_len += ret;
+
+	/* Process complete frames. */
+	size_t pos = 0;
+	while (chan->rx_len - pos >= sizeof(uint16_t)) {
+		size_t len = wire_read_u16(chan->rx + pos);
+		if (chan->rx_len - pos < sizeof(uint16_t) + len) {
+			break;
+		}
+		chan_answer(up, idx, chan->rx + pos + sizeof(uint16_t), len);
+		pos += sizeof(uint16_t) + len;
+	}
+	chan->rx_len -= pos;
+	memmove(chan->rx, chan->rx + pos, chan->rx_len);
+}
+
+static void chan_write(upstream_t *up, int idx)
+{
+	upstream_chan_t *chan = &up->chan[idx];
+
+	if (!chan->connected) {
+		int err = 0;
+		socklen_t len = sizeof(err);
+		if (getsockopt(chan->fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 ||
+		    err != 0) {
+			chan_close(up, idx);
+			return;
+		}
+		chan->connected = true;
+	}
+
+	if (chan_flush(up, idx) != KNOT_EOK) {
+		chan_close(up, idx);
+	}
+}
+
+/*! \brief Fail expired queries, return time to the next deadline. */
+static int sweep_timeouts(upstream_t *up)
+{
+	struct timespec now = time_now();
+
+	upstream_job_t *job = NULL, *next = NULL;
+	WALK_LIST_DELSAFE(job, next, up->inflight) {
+		double left = time_diff_ms(&now, &job->deadline);
+		if (left > 0) {
+			return (int)left + 1;
+		}
+		job_finish(up, job, NULL, 0, KNOT_ETIMEOUT);
+	}
+
+	return -1;
+}
+
+static bool take_pending(upstream_t *up, list_t *jobs)
+{
+	char drain[64];
+	while (read(up->wake[0], drain, sizeof(drain)) > 0);
+
+	pthread_mutex_lock(&up->lock);
+	init_list(jobs);
+	if (!EMPTY_LIST(up->pending)) {
+		add_tail_list(jobs, &up->pending);
+		init_list(&up->pending);
+	}
+	bool stop = up->stop;
+	pthread_mutex_unlock(&up->lock);
+
+	return stop;
+}
+
+static void *upstream_thread(void *arg)
+{
+	upstream_t *up = arg;
+
+	bool stop = false;
+	while (!stop) {
+		struct pollfd pfd[1 + CHAN_COUNT];
+		int pfd_chan[1 + CHAN_COUNT];
+		nfds_t nfds = 0;
+
+		pfd[nfds].fd = up->wake[0];
+		pfd[nfds].events = POLLIN;
+		pfd_chan[nfds++] = -1;
+		for (int i = 0; i < CHAN_COUNT; i++) {
+			upstream_chan_t *chan = &up->chan[i];
+			if (chan->fd < 0) {
+				continue;
+			}
+			pfd[nfds].fd = chan->fd;
+			pfd[nfds].events = POLLIN;
+			if (!chan->connected || chan->tx_len > 0) {
+				pfd[nfds].events |= POLLOUT;
+			}
+			pfd_chan[nfds++] = i;
+		}
+
+		int ret = poll(pfd, nfds, sweep_timeouts(up));
+		if (ret < 0) {
+			continue;
+		}
+
+		for (nfds_t i = 1; i < nfds; i++) {
+			int idx = pfd_chan[i];
+			if (up->chan[idx].fd != pfd[i].fd) {
+				continue; /* Closed meanwhile. */
+			}
+			if (pfd[i].revents & POLLOUT) {
+				chan_write(up, idx);
+			}
+			if (up->chan[idx].fd >= 0 &&
+			    (pfd[i].revents & (POLLIN | POLLERR | POLLHUP))) {
+				chan_read(up, idx);
+			}
+		}
+
+		if (pfd[0].revents & POLLIN) {
+			list_t jobs;
+			stop = take_pending(up, &jobs);
+			upstream_job_t *job = NULL, *next = NULL;
+			WALK_LIST_DELSAFE(job, next, jobs) {
+				job_start(up, job);
+			}
+		}
+	}
+
+	/* Fail unfinished queries. */
+	for (int i = 0; i < CHAN_COUNT; i++) {
+		chan_close(up, i);
+		free(up->chan[i].tx);
+		free(up->chan[i].rx);
+	}
+	upstream_job_t *job = NULL, *next = NULL;
+	WALK_LIST_DELSAFE(job, next, up->pending) {
+		job_complete(job, NULL, 0, KNOT_ETIMEOUT);
+	}
+
+	return NULL;
+}
+
+upstream_t *upstream_new(const struct sockaddr_storage *remote,
+                         const struct sockaddr_storage *via, int timeout_ms)
+{
+	upstream_t *up = calloc(1, sizeof(*up));
+	if (up == NULL) {
+		return NULL;
+	}
+
+	up->ids = calloc(ID_COUNT, sizeof(*up->ids));
+	if (up->ids == NULL || pipe(up->wake) != 0) {
+		free(up->ids);
+		free(up);
+		return NULL;
+	}
+	(void)fcntl(up->wake[0], F_SETFL, O_NONBLOCK);
+
+	memcpy(&up->remote, remote, sizeof(up->remote));
+	memcpy(&up->via, via, sizeof(up->via));
+	up->timeout = timeout_ms;
+	for (int i = 0; i < CHAN_COUNT; i++) {
+		up->chan[i].fd = -1;
+	}
+	init_list(&up->pending);
+	init_list(&up->inflight);
+	pthread_mutex_init(&up->lock, NULL);
+
+	if (pthread_create(&up->thread, NULL, upstream_thread, up) != 0) {
+		pthread_mutex_destroy(&up->lock);
+		close(up->wake[0]);
+		close(up->wake[1]);
+		free(up->ids);
+		free(up);
+		return NULL;
+	}
+
+	return up;
+}
+
+static void upstream_wake(upstream_t *up)
+{
+	const uint8_t byte = 0;
+	(void)write(up->wake[1], &byte, sizeof(byte));
+}
+
+void upstream_free(upstream_t *up)
+{
+	if (up == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&up->lock);
+	up->stop = true;
+	pthread_mutex_unlock(&up->lock);
+	upstream_wake(up);
+	pthread_join(up->thread, NULL);
+
+	pthread_mutex_destroy(&up->lock);
+	close(up->wake[0]);
+	close(up->wake[1]);
+	free(up->ids);
+	free(up);
+}
+
+static upstream_job_t *job_new(upstream_t *up, const uint8_t *query, size_t query_len)
+{
+	/* Find the end of the question to match responses against. */
+	if (query_len < KNOT_WIRE_HEADER_SIZE ||
+	    knot_wire_get_qdcount(query) != 1) {
+		return NULL;
+	}
+	int qname_len = knot_dname_wire_check(query + KNOT_WIRE_HEADER_SIZE,
+	                                      query + query_len, NULL);
+	if (qname_len <= 0 ||
+	    KNOT_WIRE_HEADER_SIZE + qname_len + 2 * sizeof(uint16_t) > query_len) {
+		return NULL;
+	}
+
+	upstream_job_t *job = calloc(1, sizeof(*job) + query_len);
+	if (job == NULL) {
+		return NULL;
+	}
+
+	memcpy(job->wire, query, query_len);
+	job->wire_len = query_len;
+	job->qend = KNOT_WIRE_HEADER_SIZE + qname_len + 2 * sizeof(uint16_t);
+	job->orig_id = knot_wire_get_id(query);
+	job->chan = -1;
+
+	/* Set the deadline. */
+	job->deadline = time_now();
+	job->deadline.tv_sec += up->timeout / 1000;
+	job->deadline.tv_nsec += (up->timeout % 1000) * 1000000;
+	if (job->deadline.tv_nsec >= 1000000000) {
+		job->deadline.tv_sec += 1;
+		job->deadline.tv_nsec -= 1000000000;
+	}
+
+	return job;
+}
+
+static void job_submit(upstream_t *up, upstream_job_t *job)
+{
+	pthread_mutex_lock(&up->lock);
+	bool wake = EMPTY_LIST(up->pending);
+	add_tail(&up->pending, &job->n);
+	pthread_mutex_unlock(&up->lock);
+
+	/* Wake up the I/O thread only once per batch. */
+	if (wake) {
+		upstream_wake(up);
+	}
+}
+
+int upstream_send(upstream_t *up, const uint8_t *query, size_t query_len,
+                  bool tcp, upstream_cb_t cb, void *data)
+{
+	if (up == NULL || query == NULL || cb == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	upstream_job_t *job = job_new(up, query, query_len);
+	if (job == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	job->tcp = tcp;
+	job->cb = cb;
+	job->data = data;
+
+	job_submit(up, job);
+
+	return KNOT_EOK;
+}
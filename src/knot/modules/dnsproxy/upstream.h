@@ -0,0 +1,81 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+/* Defaults */
+#define UPSTREAM_UDP_SOCKETS 4   /* Query-ID multiplexed UDP sockets. */
+#define UPSTREAM_UDP_REUSE   256 /* Queries per UDP socket (source port). */
+#define UPSTREAM_TCP_CONNS   4   /* Pipelined TCP connections. */
+
+/*!
+ * \brief Upstream server forwarding context.
+ *
+ * All upstream communication is performed by a dedicated I/O thread.
+ * UDP queries are multiplexed over a few connected sockets by the message ID,
+ * TCP queries are pipelined over a pool of persistent connections.
+ */
+typedef struct upstream upstream_t;
+
+/*!
+ * \brief Forwarded query completion callback, called from the I/O thread.
+ *
+ * \param ret         KNOT_EOK, KNOT_ETIMEOUT, or other error.
+ * \param answer      Response wire with the original message ID (NULL on error).
+ * \param answer_len  Response wire length.
+ * \param data        Caller data.
+ */
+typedef void (*upstream_cb_t)(int ret, const uint8_t *answer, size_t answer_len,
+                              void *data);
+
+/*!
+ * \brief Create an upstream context and start its I/O thread.
+ *
+ * \param remote      Upstream server address.
+ * \param via         Source address (AF_UNSPEC if not set).
+ * \param timeout_ms  Upstream response timeout.
+ *
+ * \return New context or NULL on error.
+ */
+upstream_t *upstream_new(const struct sockaddr_storage *remote,
+                         const struct sockaddr_storage *via, int timeout_ms);
+
+/*!
+ * \brief Stop the I/O thread and free the context.
+ *
+ * Unfinished queries are completed with an error.
+ */
+void upstream_free(upstream_t *up);
+
+/*!
+ * \brief Forward a query without waiting for the response.
+ *
+ * \param up         Upstream context.
+ * \param query      Query wire.
+ * \param query_len  Query wire length.
+ * \param tcp        Use TCP connection pool.
+ * \param cb         Completion callback.
+ * \param data       Callback data.
+ *
+ * \return KNOT_EOK if accepted, the callback is then called exactly once,
+ *         error otherwise.
+ */
+int upstream_send(upstream_t *up, const uint8_t *query, size_t query_len,
+                  bool tcp, upstream_cb_t cb, void *data);
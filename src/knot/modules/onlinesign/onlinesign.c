@@ -22,6 +22,7 @@
 #include "dnssec/error.h"
 #include "knot/include/module.h"
 #include "knot/modules/onlinesign/nsec_next.h"
+#include "knot/modules/onlinesign/rrsig_cache.h"
 // Next dependencies force static module!
 #include "knot/dnssec/key-events.h"
 #include "knot/dnssec/rrset-sign.h"
@@ -31,6 +32,8 @@
 #include "knot/nameserver/process_query.h"
 
 #define MOD_POLICY	"\x06""policy"
+#define MOD_CACHE_SIZE	"\x0A""cache-size"
+#define MOD_CACHE_REUSE	"\x0B""cache-reuse"
 
 int policy_check(knotd_conf_check_args_t *args)
 {
@@ -43,11 +46,20 @@ int policy_check(knotd_conf_check_args_t *args)
 }
 
 const yp_item_t online_sign_conf[] = {
-	{ MOD_POLICY, YP_TREF, YP_VREF = { C_POLICY }, YP_FNONE, { policy_check } },
+	{ MOD_POLICY,      YP_TREF, YP_VREF = { C_POLICY }, YP_FNONE, { policy_check } },
+	{ MOD_CACHE_SIZE,  YP_TINT, YP_VINT = { 0, INT32_MAX, 100000 } },
+	{ MOD_CACHE_REUSE, YP_TINT, YP_VINT = { 1, 90, 10 } },
 	{ NULL }
 };
 
 #define RRSIG_LIFETIME (25*60*60)
+#define RRSIG_CACHE_SIZE 100000
+#define RRSIG_CACHE_REUSE 10 /* Percentage of the signature lifetime. */
+
+enum {
+	CTR_CACHE_HIT,
+	CTR_CACHE_MISS
+};
 
 /*
  * TODO:
@@ -86,7 +98,10 @@ static const uint16_t NSEC_FORCE_TYPES[] = {
 
 typedef struct {
 	dnssec_key_t *key;
+	uint16_t keytag;
 	uint32_t rrsig_lifetime;
+	rrsig_cache_t *cache;
+	uint32_t cache_reuse;
 } online_sign_ctx_t;
 
 static bool want_dnssec(knotd_qdata_t *qdata)
@@ -234,28 +249,52 @@ static knot_rrset_t *synth_nsec(knot_pkt_t *pkt, knotd_qdata_t *qdata, knot_mm_t
 static knot_rrset_t *sign_rrset(const knot_dname_t *owner,
                                 const knot_rrset_t *cover,
                                 online_sign_ctx_t *module_ctx,
-                                dnssec_sign_ctx_t *sign_ctx,
+                                dnssec_sign_ctx_t **sign_ctx,
+                                knotd_qdata_t *qdata,
+                                knotd_mod_t *mod,
                                 knot_mm_t *mm)
 {
+	uint32_t now = time(NULL);
+
+	// resulting RRSIG
+
+	knot_rrset_t *rrsig = knot_rrset_new(owner, KNOT_RRTYPE_RRSIG, cover->rclass,
+	                                     cover->ttl, mm);
+	if (!rrsig) {
+		return NULL;
+	}
+
+	// reuse recently created signature
+
+	rrsig_cache_key_t cache_key;
+	if (module_ctx->cache != NULL) {
+		rrsig_cache_key_init(module_ctx->cache, &cache_key, owner, cover,
+		                     module_ctx->keytag);
+		if (rrsig_cache_get(module_ctx->cache, &cache_key, now, rrsig, mm)) {
+			knotd_mod_stats_incr(mod, qdata->params->thread_id, CTR_CACHE_HIT, 0, 1);
+			return rrsig;
+		}
+		knotd_mod_stats_incr(mod, qdata->params->thread_id, CTR_CACHE_MISS, 0, 1);
+	}
+
+	if (*sign_ctx == NULL &&
+	    dnssec_sign_new(sign_ctx, module_ctx->key) != DNSSEC_EOK) {
+		knot_rrset_free(&rrsig, mm);
+		return NULL;
+	}
+
 	// copy of RR set with replaced owner name
 
 	knot_rrset_t *copy = knot_rrset_new(owner, cover->type, cover->rclass,
 	                                    cover->ttl, NULL);
 	if (!copy) {
+		knot_rrset_free(&rrsig, mm);
 		return NULL;
 	}
 
 	if (knot_rdataset_copy(&copy->rrs, &cover->rrs, NULL) != KNOT_EOK) {
 		knot_rrset_free(&copy, NULL);
-		return NULL;
-	}
-
-	// resulting RRSIG
-
-	knot_rrset_t *rrsig = knot_rrset_new(owner, KNOT_RRTYPE_RRSIG, copy->rclass,
-	                                     copy->ttl, mm);
-	if (!rrsig) {
-		knot_rrset_free(&copy, NULL);
+		knot_rrset_free(&rrsig, mm);
 		return NULL;
 	}
 
@@ -266,11 +305,11 @@ static knot_rrset_t *sign_rrset(const knot_dname_t *owner,
 	};
 
 	kdnssec_ctx_t ksign_ctx = {
-		.now = time(NULL),
+		.now = now,
 		.policy = &policy
 	};
 
-	int r = knot_sign_rrset(rrsig, copy, module_ctx->key, sign_ctx, &ksign_ctx, mm);
+	int r = knot_sign_rrset(rrsig, copy, module_ctx->key, *sign_ctx, &ksign_ctx, mm);
 
 	knot_rrset_free(&copy, NULL);
 
@@ -279,6 +318,12 @@ static knot_rrset_t *sign_rrset(const knot_dname_t *owner,
 		return NULL;
 	}
 
+	if (module_ctx->cache != NULL) {
+		uint32_t reuse = (uint64_t)module_ctx->rrsig_lifetime *
+		                 module_ctx->cache_reuse / 100;
+		(void)rrsig_cache_put(module_ctx->cache, &cache_key, rrsig, now + reuse);
+	}
+
 	return rrsig;
 }
 
@@ -291,11 +336,8 @@ static knotd_in_state_t sign_section(knotd_in_state_t state, knot_pkt_t *pkt,
 		return state;
 	}
 
+	// signing context is created only if some signature isn't cached
 	dnssec_sign_ctx_t *sign_ctx = NULL;
-	int r = dnssec_sign_new(&sign_ctx, module_ctx->key);
-	if (r != DNSSEC_EOK) {
-		return KNOTD_IN_STATE_ERROR;
-	}
 
 	const knot_pktsection_t *section = knot_pkt_section(pkt, pkt->current);
 	assert(section);
@@ -309,13 +351,14 @@ static knotd_in_state_t sign_section(knotd_in_state_t state, knot_pkt_t *pkt,
 		knot_dname_unpack(owner, pkt->wire + rr_pos, sizeof(owner), pkt->wire);
 		knot_dname_to_lower(owner);
 
-		knot_rrset_t *rrsig = sign_rrset(owner, rr, module_ctx, sign_ctx, &pkt->mm);
+		knot_rrset_t *rrsig = sign_rrset(owner, rr, module_ctx, &sign_ctx,
+		                                 qdata, mod, &pkt->mm);
 		if (!rrsig) {
 			state = KNOTD_IN_STATE_ERROR;
 			break;
 		}
 
-		r = knot_pkt_put(pkt, KNOT_COMPR_HINT_NONE, rrsig, KNOT_PF_FREE);
+		int r = knot_pkt_put(pkt, KNOT_COMPR_HINT_NONE, rrsig, KNOT_PF_FREE);
 		if (r != KNOT_EOK) {
 			knot_rrset_free(&rrsig, &pkt->mm);
 			state = KNOTD_IN_STATE_ERROR;
@@ -484,6 +527,7 @@ fail:
 static void online_sign_ctx_free(online_sign_ctx_t *ctx)
 {
 	dnssec_key_free(ctx->key);
+	rrsig_cache_free(ctx->cache);
 
 	free(ctx);
 }
@@ -501,6 +545,8 @@ static int online_sign_ctx_new(online_sign_ctx_t **ctx_ptr, knotd_mod_t *mod)
 		return r;
 	}
 
+	ctx->keytag = dnssec_key_get_keytag(ctx->key);
+
 	ctx->rrsig_lifetime = RRSIG_LIFETIME;
 	knotd_conf_t policy = knotd_conf_mod(mod, MOD_POLICY);
 	if (policy.count != 0) {
@@ -510,6 +556,24 @@ static int online_sign_ctx_new(online_sign_ctx_t **ctx_ptr, knotd_mod_t *mod)
 		}
 	}
 
+	size_t cache_size = RRSIG_CACHE_SIZE;
+	knotd_conf_t conf = knotd_conf_mod(mod, MOD_CACHE_SIZE);
+	if (conf.count != 0) {
+		cache_size = conf.single.integer;
+	}
+	ctx->cache_reuse = RRSIG_CACHE_REUSE;
+	conf = knotd_conf_mod(mod, MOD_CACHE_REUSE);
+	if (conf.count != 0) {
+		ctx->cache_reuse = conf.single.integer;
+	}
+	if (cache_size > 0) {
+		ctx->cache = rrsig_cache_new(cache_size);
+		if (ctx->cache == NULL) {
+			online_sign_ctx_free(ctx);
+			return KNOT_ENOMEM;
+		}
+	}
+
 	*ctx_ptr = ctx;
 
 	return KNOT_EOK;
@@ -532,6 +596,15 @@ int online_sign_load(knotd_mod_t *mod)
 		return KNOT_ERROR;
 	}
 
+	r = knotd_mod_stats_add(mod, "cache-hit", 1, NULL);
+	if (r == KNOT_EOK) {
+		r = knotd_mod_stats_add(mod, "cache-miss", 1, NULL);
+	}
+	if (r != KNOT_EOK) {
+		online_sign_ctx_free(ctx);
+		return r;
+	}
+
 	knotd_mod_ctx_set(mod, ctx);
 
 	knotd_mod_in_hook(mod, KNOTD_STAGE_ANSWER, synth_answer);
@@ -0,0 +1,173 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "knot/modules/onlinesign/rrsig_cache.h"
+#include "contrib/openbsd/siphash.h"
+#include "dnssec/random.h"
+#include "libknot/errcode.h"
+
+/* Number of locks distributed amongst cache slots. */
+#define RRSIG_CACHE_LOCKS 64
+
+/*! \brief Cached signature. */
+typedef struct {
+	uint64_t hash;
+	uint32_t ttl;
+	uint32_t reuse_until;
+	uint16_t type;
+	uint16_t keytag;
+	uint16_t rdata_len;
+	uint16_t owner_len;
+	uint8_t data[];      /* Owner followed by the RRSIG RDATA. */
+} rrsig_cache_entry_t;
+
+struct rrsig_cache {
+	SIPHASH_KEY key;
+	pthread_mutex_t locks[RRSIG_CACHE_LOCKS];
+	size_t size;
+	rrsig_cache_entry_t *slots[];
+};
+
+rrsig_cache_t *rrsig_cache_new(size_t size)
+{
+	if (size == 0) {
+		return NULL;
+	}
+
+	rrsig_cache_t *cache = calloc(1, sizeof(*cache) + size * sizeof(cache->slots[0]));
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	(void)dnssec_random_buffer((uint8_t *)&cache->key, sizeof(cache->key));
+	for (size_t i = 0; i < RRSIG_CACHE_LOCKS; i++) {
+		pthread_mutex_init(&cache->locks[i], NULL);
+	}
+	cache->size = size;
+
+	return cache;
+}
+
+void rrsig_cache_free(rrsig_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < cache->size; i++) {
+		free(cache->slots[i]);
+	}
+	for (size_t i = 0; i < RRSIG_CACHE_LOCKS; i++) {
+		pthread_mutex_destroy(&cache->locks[i]);
+	}
+	free(cache);
+}
+
+void rrsig_cache_key_init(const rrsig_cache_t *cache, rrsig_cache_key_t *key,
+                          const knot_dname_t *owner, const knot_rrset_t *cover,
+                          uint16_t keytag)
+{
+	key->owner = owner;
+	key->type = cover->type;
+	key->ttl = cover->ttl;
+	key->keytag = keytag;
+
+	SIPHASH_CTX ctx;
+	SipHash24_Init(&ctx, &cache->key);
+	SipHash24_Update(&ctx, owner, knot_dname_size(owner));
+	SipHash24_Update(&ctx, &key->type, sizeof(key->type));
+	SipHash24_Update(&ctx, &key->ttl, sizeof(key->ttl));
+	SipHash24_Update(&ctx, &key->keytag, sizeof(key->keytag));
+	for (uint16_t i = 0; i < cover->rrs.rr_count; i++) {
+		const knot_rdata_t *rdata = knot_rdataset_at(&cover->rrs, i);
+		SipHash24_Update(&ctx, &rdata->len, sizeof(rdata->len));
+		SipHash24_Update(&ctx, rdata->data, rdata->len);
+	}
+	key->hash = SipHash24_End(&ctx);
+}
+
+static bool entry_match(const rrsig_cache_entry_t *entry, const rrsig_cache_key_t *key)
+{
+	return entry->hash == key->hash &&
+	       entry->type == key->type &&
+	       entry->ttl == key->ttl &&
+	       entry->keytag == key->keytag &&
+	       entry->owner_len == knot_dname_size(key->owner) &&
+	       memcmp(entry->data, key->owner, entry->owner_len) == 0;
+}
+
+bool rrsig_cache_get(rrsig_cache_t *cache, const rrsig_cache_key_t *key,
+                     uint32_t now, knot_rrset_t *rrsig, knot_mm_t *mm)
+{
+	if (cache == NULL || key == NULL || rrsig == NULL) {
+		return false;
+	}
+
+	size_t slot = key->hash % cache->size;
+	pthread_mutex_t *lock = &cache->locks[slot % RRSIG_CACHE_LOCKS];
+
+	bool found = false;
+	pthread_mutex_lock(lock);
+	const rrsig_cache_entry_t *entry = cache->slots[slot];
+	if (entry != NULL && entry_match(entry, key) && now < entry->reuse_until) {
+		found = (knot_rrset_add_rdata(rrsig, entry->data + entry->owner_len,
+		                              entry->rdata_len, mm) == KNOT_EOK);
+	}
+	pthread_mutex_unlock(lock);
+
+	return found;
+}
+
+int rrsig_cache_put(rrsig_cache_t *cache, const rrsig_cache_key_t *key,
+                    const knot_rrset_t *rrsig, uint32_t reuse_until)
+{
+	if (cache == NULL || key == NULL || rrsig == NULL || rrsig->rrs.rr_count != 1) {
+		return KNOT_EINVAL;
+	}
+
+	const knot_rdata_t *rdata = knot_rdataset_at(&rrsig->rrs, 0);
+	size_t owner_len = knot_dname_size(key->owner);
+
+	rrsig_cache_entry_t *entry = malloc(sizeof(*entry) + owner_len + rdata->len);
+	if (entry == NULL) {
+		return KNOT_ENOMEM;
+	}
+	entry->hash = key->hash;
+	entry->ttl = key->ttl;
+	entry->reuse_until = reuse_until;
+	entry->type = key->type;
+	entry->keytag = key->keytag;
+	entry->rdata_len = rdata->len;
+	entry->owner_len = owner_len;
+	memcpy(entry->data, key->owner, owner_len);
+	memcpy(entry->data + owner_len, rdata->data, rdata->len);
+
+	size_t slot = key->hash % cache->size;
+	pthread_mutex_t *lock = &cache->locks[slot % RRSIG_CACHE_LOCKS];
+
+	pthread_mutex_lock(lock);
+	rrsig_cache_entry_t *old = cache->slots[slot];
+	cache->slots[slot] = entry;
+	pthread_mutex_unlock(lock);
+
+	free(old);
+
+	return KNOT_EOK;
+}
@@ -0,0 +1,94 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "libknot/dname.h"
+#include "libknot/mm_ctx.h"
+#include "libknot/rrset.h"
+
+/*!
+ * \brief Signature cache lookup key.
+ */
+typedef struct {
+	const knot_dname_t *owner; /*!< Owner of the signed RR set. */
+	uint16_t type;             /*!< Type of the signed RR set. */
+	uint32_t ttl;              /*!< TTL of the signed RR set. */
+	uint16_t keytag;           /*!< Signing key tag. */
+	uint64_t hash;             /*!< Hash of the above and the signed RDATA. */
+} rrsig_cache_key_t;
+
+typedef struct rrsig_cache rrsig_cache_t;
+
+/*!
+ * \brief Create a bounded RRSIG cache.
+ *
+ * The cache is a direct-mapped table, a new signature replaces the one
+ * stored in the same slot.
+ *
+ * \param size  Number of cache slots.
+ *
+ * \return New cache or NULL on error.
+ */
+rrsig_cache_t *rrsig_cache_new(size_t size);
+
+/*!
+ * \brief Free the RRSIG cache.
+ */
+void rrsig_cache_free(rrsig_cache_t *cache);
+
+/*!
+ * \brief Initialize lookup key for a signed RR set.
+ *
+ * \param cache   RRSIG cache.
+ * \param key     Key to be initialized.
+ * \param owner   Owner of the signed RR set (in lower-case).
+ * \param cover   Signed RR set.
+ * \param keytag  Signing key tag.
+ */
+void rrsig_cache_key_init(const rrsig_cache_t *cache, rrsig_cache_key_t *key,
+                          const knot_dname_t *owner, const knot_rrset_t *cover,
+                          uint16_t keytag);
+
+/*!
+ * \brief Get a cached signature.
+ *
+ * \param cache  RRSIG cache.
+ * \param key    Lookup key.
+ * \param now    Current time, expired cache entries are ignored.
+ * \param rrsig  RRSIG RR set to add the cached signature to.
+ * \param mm     Memory context of the RRSIG RR set.
+ *
+ * \return True if a usable signature was found and added.
+ */
+bool rrsig_cache_get(rrsig_cache_t *cache, const rrsig_cache_key_t *key,
+                     uint32_t now, knot_rrset_t *rrsig, knot_mm_t *mm);
+
+/*!
+ * \brief Store a signature into the cache.
+ *
+ * \param cache        RRSIG cache.
+ * \param key          Lookup key.
+ * \param rrsig        RRSIG RR set with a single signature.
+ * \param reuse_until  Time until which the signature can be reused.
+ *
+ * \return KNOT_EOK or error.
+ */
+int rrsig_cache_put(rrsig_cache_t *cache, const rrsig_cache_key_t *key,
+                    const knot_rrset_t *rrsig, uint32_t reuse_until);
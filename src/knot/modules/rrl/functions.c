@@ -14,15 +14,27 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <assert.h>
 #include <time.h>
 
 #include "knot/modules/rrl/functions.h"
+#include "contrib/macros.h"
 #include "contrib/sockaddr.h"
 #include "dnssec/random.h"
 
-/* Hopscotch defines. */
-#define HOP_LEN (sizeof(unsigned)*8)
+#ifdef HAVE_ATOMIC
+#define ATOMIC_GET(src)      __atomic_load_n(&(src), __ATOMIC_RELAXED)
+#define ATOMIC_SET(dst, val) __atomic_store_n(&(dst), (val), __ATOMIC_RELAXED)
+#define ATOMIC_CAS(dst, exp, val) \
+	__atomic_compare_exchange_n(&(dst), &(exp), (val), false, \
+	                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#else
+#define ATOMIC_GET(src)      (src)
+#define ATOMIC_SET(dst, val) ((dst) = (val))
+#define ATOMIC_CAS(dst, exp, val) ((dst) = (val), true)
+#endif
+
+/* Number of buckets probed for a flow. */
+#define RRL_PROBES 4
 /* Limits */
 #define RRL_CLSBLK_MAXLEN (4 + 8 + 1 + 256)
 /* CIDR block prefix lengths for v4/v6 */
@@ -199,81 +211,42 @@ static int rrl_classify(char *dst, size_t maxlen, const struct sockaddr_storage
 	return blklen;
 }
 
-static int bucket_free(rrl_item_t *b, uint32_t now) {
-	return b->cls == CLS_NULL || (b->time + 1 < now);
-}
-
-static int bucket_match(rrl_item_t *b, rrl_item_t *m)
+static bool bucket_free(const rrl_item_t *b, uint16_t now)
 {
-	return b->cls    == m->cls &&
-	       b->netblk == m->netblk &&
-	       b->qname  == m->qname;
+	return b->cls == CLS_NULL || (uint16_t)(now - b->time) > 1;
 }
 
-static int find_free(rrl_table_t *t, unsigned i, uint32_t now)
+static bool bucket_match(const rrl_item_t *b, const rrl_item_t *m)
 {
-	rrl_item_t *np = t->arr + t->size;
-	rrl_item_t *b = NULL;
-	for (b = t->arr + i; b != np; ++b) {
-		if (bucket_free(b, now)) {
-			return b - (t->arr + i);
-		}
-	}
-	np = t->arr + i;
-	for (b = t->arr; b != np; ++b) {
-		if (bucket_free(b, now)) {
-			return (b - t->arr) + (t->size - i);
-		}
-	}
-
-	/* this happens if table is full... force vacate current elm */
-	return i;
+	return b->cls == m->cls && b->tag == m->tag;
 }
 
-static inline unsigned find_match(rrl_table_t *t, uint32_t id, rrl_item_t *m)
+static uint16_t bucket_tokens(uint64_t tokens)
 {
-	unsigned f = 0;
-	unsigned d = 0;
-	unsigned match = t->arr[id].hop;
-	while (match != 0) {
-		d = __builtin_ctz(match);
-		f = (id + d) % t->size;
-		if (bucket_match(t->arr + f, m)) {
-			return d;
-		} else {
-			match &= ~(1<<d); /* clear potential match */
-		}
-	}
-
-	return HOP_LEN + 1;
+	return (tokens > UINT16_MAX) ? UINT16_MAX : tokens;
 }
 
-static inline unsigned reduce_dist(rrl_table_t *t, unsigned id, unsigned d, unsigned *f)
+/*!
+ * \brief Select the bucket for the flow.
+ *
+ * Returns the first bucket with a matching flow in the probe sequence, or
+ * the first free one, or the initial bucket if all of them are taken.
+ */
+static rrl_item_t *rrl_bucket(rrl_table_t *t, uint64_t id, const rrl_item_t *m)
 {
-	unsigned rd = HOP_LEN - 1;
-	while (rd > 0) {
-		unsigned s = (t->size + *f - rd) % t->size; /* bucket to be vacated */
-		if (t->arr[s].hop != 0) {
-			unsigned o = __builtin_ctz(t->arr[s].hop);  /* offset of first valid bucket */
-			if (o < rd) {                               /* only offsets in <s, f> are interesting */
-				unsigned e = (s + o) % t->size;     /* this item will be displaced to [f] */
-				unsigned keep_hop = t->arr[*f].hop; /* unpredictable padding */
-				memcpy(t->arr + *f, t->arr + e, sizeof(rrl_item_t));
-				t->arr[*f].hop = keep_hop;
-				t->arr[e].cls = CLS_NULL;
-				t->arr[s].hop &= ~(1<<o);
-				t->arr[s].hop |= 1<<rd;
-				*f = e;
-				return d - (rd - o);
-			}
+	rrl_item_t *free_b = NULL;
+	for (unsigned i = 0; i < RRL_PROBES; ++i) {
+		rrl_item_t *b = t->arr + (id + i) % t->size;
+		rrl_item_t cur = { .word = ATOMIC_GET(b->word) };
+		if (bucket_match(&cur, m)) {
+			return b;
+		}
+		if (free_b == NULL && bucket_free(&cur, m->time)) {
+			free_b = b;
 		}
-		--rd;
 	}
 
-	assert(rd == 0); /* this happens with p=1/fact(HOP_LEN) */
-	*f = id;
-	d = 0; /* force vacate initial element */
-	return d;
+	return (free_b != NULL) ? free_b : t->arr + id;
 }
 
 static void rrl_log_state(knotd_mod_t *mod, const struct sockaddr_storage *ss,
@@ -329,176 +302,94 @@ uint32_t rrl_rate(rrl_table_t *rrl)
 	return rrl ? rrl->rate : 0;
 }
 
-int rrl_setlocks(rrl_table_t *rrl, unsigned granularity)
+int rrl_query(rrl_table_t *rrl, const struct sockaddr_storage *a, rrl_req_t *req,
+              const knot_dname_t *zone, knotd_mod_t *mod)
 {
-	if (!rrl) {
+	if (!rrl || !req || !a) {
 		return KNOT_EINVAL;
 	}
 
-	assert(!rrl->lk); /* Cannot change while locks are used. */
-	assert(granularity <= rrl->size / 10); /* Due to int. division err. */
-
-	if (pthread_mutex_init(&rrl->ll, NULL) < 0) {
-		return KNOT_ENOMEM;
-	}
-
-	/* Alloc new locks. */
-	rrl->lk = malloc(granularity * sizeof(pthread_mutex_t));
-	if (!rrl->lk) {
-		return KNOT_ENOMEM;
-	}
-	memset(rrl->lk, 0, granularity * sizeof(pthread_mutex_t));
-
-	/* Initialize. */
-	for (size_t i = 0; i < granularity; ++i) {
-		if (pthread_mutex_init(rrl->lk + i, NULL) < 0) {
-			break;
-		}
-		++rrl->lk_count;
-	}
-
-	/* Incomplete initialization */
-	if (rrl->lk_count != granularity) {
-		for (size_t i = 0; i < rrl->lk_count; ++i) {
-			pthread_mutex_destroy(rrl->lk + i);
-		}
-		free(rrl->lk);
-		rrl->lk_count = 0;
-		return KNOT_ERROR;
-	}
-
-	return KNOT_EOK;
-}
-
-rrl_item_t *rrl_hash(rrl_table_t *t, const struct sockaddr_storage *a, rrl_req_t *p,
-                     const knot_dname_t *zone, uint32_t stamp, int *lock)
-{
 	char buf[RRL_CLSBLK_MAXLEN];
-	int len = rrl_classify(buf, sizeof(buf), a, p, zone, t->seed);
+	int len = rrl_classify(buf, sizeof(buf), a, req, zone, rrl->seed);
 	if (len < 0) {
-		return NULL;
+		return KNOT_ERROR;
 	}
 
-	uint32_t id = SipHash24(&t->key, buf, len) % t->size;
-
-	/* Lock for lookup. */
-	pthread_mutex_lock(&t->ll);
-
-	/* Find an exact match in <id, id + HOP_LEN). */
-	char *qname = buf + sizeof(uint8_t) + sizeof(uint64_t);
-	uint64_t netblk;
-	memcpy(&netblk, buf + sizeof(uint8_t), sizeof(netblk));
+	/* Calculate hash, bucket position is given by the lower bits, the upper
+	 * bits are kept as a flow identifier. */
+	uint64_t hash = SipHash24(&rrl->key, buf, len);
+	uint16_t now = time(NULL);
 	rrl_item_t match = {
-		.hop = 0,
-		.netblk = netblk,
-		.ntok = t->rate * RRL_CAPACITY,
+		.tag = hash >> 48,
+		.ntok = bucket_tokens((uint64_t)rrl->rate * RRL_CAPACITY),
+		.time = now,
 		.cls = buf[0],
-		.flags = RRL_BF_NULL,
-		.qname = SipHash24(&t->key, qname + 1, *qname),
-		.time = stamp
+		.flags = RRL_BF_NULL
 	};
-
-	unsigned d = find_match(t, id, &match);
-	if (d > HOP_LEN) { /* not an exact match, find free element [f] */
-		d = find_free(t, id, stamp);
-	}
-
-	/* Reduce distance to fit <id, id + HOP_LEN) */
-	unsigned f = (id + d) % t->size;
-	while (d >= HOP_LEN) {
-		d = reduce_dist(t, id, d, &f);
-	}
-
-	/* Assign granular lock and unlock lookup. */
-	*lock = f % t->lk_count;
-	rrl_lock(t, *lock);
-	pthread_mutex_unlock(&t->ll);
-
-	/* found free elm 'k' which is in <id, id + HOP_LEN) */
-	t->arr[id].hop |= (1 << d);
-	rrl_item_t *b = t->arr + f;
-	assert(f == (id+d) % t->size);
-
-	/* Inspect bucket state. */
-	unsigned hop = b->hop;
-	if (b->cls == CLS_NULL) {
-		memcpy(b, &match, sizeof(rrl_item_t));
-		b->hop = hop;
-	}
-	/* Check for collisions. */
-	if (!bucket_match(b, &match)) {
-		if (!(b->flags & RRL_BF_SSTART)) {
-			memcpy(b, &match, sizeof(rrl_item_t));
-			b->hop = hop;
-			b->ntok = t->rate + t->rate / RRL_SSTART;
-			b->flags |= RRL_BF_SSTART;
+	rrl_item_t *bucket = rrl_bucket(rrl, hash % rrl->size, &match);
+
+	/* Update the bucket, retry if modified in the meantime. */
+	int ret;
+	rrl_item_t old = { .word = ATOMIC_GET(bucket->word) };
+	rrl_item_t b;
+	do {
+		ret = KNOT_EOK;
+		b = old;
+
+		/* Inspect bucket state. */
+		if (bucket_free(&b, now) && !bucket_match(&b, &match)) {
+			b = match;
+		}
+		/* Check for collisions. */
+		if (!bucket_match(&b, &match)) {
+			if (!(b.flags & RRL_BF_SSTART)) {
+				b = match;
+				b.ntok = bucket_tokens(rrl->rate + rrl->rate / RRL_SSTART);
+				b.flags |= RRL_BF_SSTART;
+			}
 		}
-	}
 
-	return b;
-}
+		/* Calculate rate for dT */
+		uint32_t dt = (uint16_t)(now - b.time);
+		if (dt > RRL_CAPACITY) {
+			dt = RRL_CAPACITY;
+		}
+		/* Visit bucket. */
+		b.time = now;
+		if (dt > 0) { /* Window moved. */
 
-int rrl_query(rrl_table_t *rrl, const struct sockaddr_storage *a, rrl_req_t *req,
-              const knot_dname_t *zone, knotd_mod_t *mod)
-{
-	if (!rrl || !req || !a) {
-		return KNOT_EINVAL;
-	}
+			/* Check state change. */
+			if ((b.ntok > 0 || dt > 1) && (b.flags & RRL_BF_ELIMIT)) {
+				b.flags &= ~RRL_BF_ELIMIT;
+			}
 
-	/* Calculate hash and fetch */
-	int ret = KNOT_EOK;
-	int lock = -1;
-	uint32_t now = time(NULL);
-	rrl_item_t *b = rrl_hash(rrl, a, req, zone, now, &lock);
-	if (!b) {
-		if (lock > -1) {
-			rrl_unlock(rrl, lock);
+			/* Add new tokens. */
+			if (b.flags & RRL_BF_SSTART) { /* Bucket in slow-start. */
+				b.flags &= ~RRL_BF_SSTART;
+			}
+			uint64_t ntok = b.ntok + (uint64_t)rrl->rate * dt;
+			b.ntok = bucket_tokens(MIN(ntok, (uint64_t)rrl->rate * RRL_CAPACITY));
 		}
-		return KNOT_ERROR;
-	}
 
-	/* Calculate rate for dT */
-	uint32_t dt = now - b->time;
-	if (dt > RRL_CAPACITY) {
-		dt = RRL_CAPACITY;
-	}
-	/* Visit bucket. */
-	b->time = now;
-	if (dt > 0) { /* Window moved. */
-
-		/* Check state change. */
-		if ((b->ntok > 0 || dt > 1) && (b->flags & RRL_BF_ELIMIT)) {
-			b->flags &= ~RRL_BF_ELIMIT;
-			rrl_log_state(mod, a, b->flags, b->cls);
+		/* Last item taken. */
+		if (b.ntok == 1 && !(b.flags & RRL_BF_ELIMIT)) {
+			b.flags |= RRL_BF_ELIMIT;
 		}
 
-		/* Add new tokens. */
-		uint32_t dn = rrl->rate * dt;
-		if (b->flags & RRL_BF_SSTART) { /* Bucket in slow-start. */
-			b->flags &= ~RRL_BF_SSTART;
-		}
-		b->ntok += dn;
-		if (b->ntok > RRL_CAPACITY * rrl->rate) {
-			b->ntok = RRL_CAPACITY * rrl->rate;
+		/* Decay current bucket. */
+		if (b.ntok > 0) {
+			--b.ntok;
+		} else {
+			ret = KNOT_ELIMIT;
 		}
-	}
-
-	/* Last item taken. */
-	if (b->ntok == 1 && !(b->flags & RRL_BF_ELIMIT)) {
-		b->flags |= RRL_BF_ELIMIT;
-		rrl_log_state(mod, a, b->flags, b->cls);
-	}
+	} while (!ATOMIC_CAS(bucket->word, old.word, b.word));
 
-	/* Decay current bucket. */
-	if (b->ntok > 0) {
-		--b->ntok;
-	} else if (b->ntok == 0) {
-		ret = KNOT_ELIMIT;
+	/* Log limiting state change of the flow. */
+	uint8_t old_limit = bucket_match(&old, &b) ? (old.flags & RRL_BF_ELIMIT) : 0;
+	if (old_limit != (b.flags & RRL_BF_ELIMIT)) {
+		rrl_log_state(mod, a, b.flags, b.cls);
 	}
 
-	if (lock > -1) {
-		rrl_unlock(rrl, lock);
-	}
 	return ret;
 }
 
@@ -514,57 +405,16 @@ bool rrl_slip_roll(int n_slip)
 
 int rrl_destroy(rrl_table_t *rrl)
 {
-	if (rrl) {
-		if (rrl->lk_count > 0) {
-			pthread_mutex_destroy(&rrl->ll);
-		}
-		for (size_t i = 0; i < rrl->lk_count; ++i) {
-			pthread_mutex_destroy(rrl->lk + i);
-		}
-		free(rrl->lk);
-	}
-
 	free(rrl);
 	return KNOT_EOK;
 }
 
 int rrl_reseed(rrl_table_t *rrl)
 {
-	/* Lock entire table. */
-	if (rrl->lk_count > 0) {
-		pthread_mutex_lock(&rrl->ll);
-		for (unsigned i = 0; i < rrl->lk_count; ++i) {
-			rrl_lock(rrl, i);
-		}
+	for (size_t i = 0; i < rrl->size; ++i) {
+		ATOMIC_SET(rrl->arr[i].word, 0);
 	}
-
-	memset(rrl->arr, 0, rrl->size * sizeof(rrl_item_t));
 	rrl->seed = dnssec_random_uint32_t();
 
-	if (rrl->lk_count > 0) {
-		for (unsigned i = 0; i < rrl->lk_count; ++i) {
-			rrl_unlock(rrl, i);
-		}
-		pthread_mutex_unlock(&rrl->ll);
-	}
-
-	return KNOT_EOK;
-}
-
-int rrl_lock(rrl_table_t *t, int lk_id)
-{
-	assert(lk_id > -1);
-	if (pthread_mutex_lock(t->lk + lk_id) != 0) {
-		return KNOT_ERROR;
-	}
-	return KNOT_EOK;
-}
-
-int rrl_unlock(rrl_table_t *t, int lk_id)
-{
-	assert(lk_id > -1);
-	if (pthread_mutex_unlock(t->lk + lk_id)!= 0) {
-		return KNOT_ERROR;
-	}
 	return KNOT_EOK;
 }
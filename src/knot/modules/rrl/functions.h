@@ -17,7 +17,6 @@
 #pragma once
 
 #include <stdint.h>
-#include <pthread.h>
 #include <sys/socket.h>
 
 #include "libknot/libknot.h"
@@ -26,20 +25,23 @@
 
 /* Defaults */
 #define RRL_SLIP_MAX 100
-#define RRL_LOCK_GRANULARITY 32 /* Last digit granularity */
 #define RRL_CAPACITY 4 /* Window size in seconds */
 
 /*!
  * \brief RRL hash bucket.
+ *
+ * The whole bucket state fits into one machine word, so that it can be
+ * updated with a single compare-and-swap instead of taking a lock.
  */
-typedef struct {
-	unsigned hop;        /* Hop bitmap. */
-	uint64_t netblk;     /* Prefix associated. */
-	uint16_t ntok;       /* Tokens available. */
-	uint8_t  cls;        /* Bucket class. */
-	uint8_t  flags;      /* Flags. */
-	uint32_t qname;      /* imputed(QNAME) hash. */
-	uint32_t time;       /* Timestamp. */
+typedef union {
+	struct {
+		uint16_t tag;   /* Flow hash tag. */
+		uint16_t ntok;  /* Tokens available. */
+		uint16_t time;  /* Timestamp (lower bits). */
+		uint8_t  cls;   /* Bucket class. */
+		uint8_t  flags; /* Flags. */
+	};
+	uint64_t word;
 } rrl_item_t;
 
 /*!
@@ -50,17 +52,15 @@ typedef struct {
  * When a bucket is in a slow-start mode, it cannot reset again for the time
  * period.
  *
- * To avoid lock contention, N locks are created and distributed amongst buckets.
- * As of now lock K for bucket N is calculated as K = N % (num_buckets).
+ * A flow is looked up in a short probe sequence starting at its hash
+ * position and identified by its class and the hash tag. Buckets are updated
+ * lock-free, concurrent updates of one bucket are retried.
  */
 
 typedef struct {
 	SIPHASH_KEY key;     /* Siphash key. */
 	uint32_t rate;       /* Configured RRL limit. */
 	uint32_t seed;       /* Pseudorandom seed for hashing. */
-	pthread_mutex_t ll;
-	pthread_mutex_t *lk; /* Table locks. */
-	unsigned lk_count;   /* Table lock count (granularity). */
 	size_t size;         /* Number of buckets. */
 	rrl_item_t arr[];    /* Buckets. */
 } rrl_table_t;
@@ -106,29 +106,6 @@ uint32_t rrl_rate(rrl_table_t *rrl);
  */
 uint32_t rrl_setrate(rrl_table_t *rrl, uint32_t rate);
 
-/*!
- * \brief Set N distributed locks for the RRL table.
- *
- * \param rrl RRL table.
- * \param granularity Number of created locks.
- * \retval KNOT_EOK
- * \retval KNOT_EINVAL
- */
-int rrl_setlocks(rrl_table_t *rrl, unsigned granularity);
-
-/*!
- * \brief Get bucket for current combination of parameters.
- * \param t RRL table.
- * \param a Source address.
- * \param p RRL request.
- * \param zone Relate zone name.
- * \param stamp Timestamp (current time).
- * \param lock Held lock.
- * \return assigned bucket
- */
-rrl_item_t *rrl_hash(rrl_table_t *t, const struct sockaddr_storage *a, rrl_req_t *p,
-                     const knot_dname_t *zone, uint32_t stamp, int *lock);
-
 /*!
  * \brief Query the RRL table for accept or deny, when the rate limit is reached.
  *
@@ -164,20 +141,3 @@ int rrl_destroy(rrl_table_t *rrl);
  */
 int rrl_reseed(rrl_table_t *rrl);
 
-/*!
- * \brief Lock specified element lock.
- * \param rrl RRL table.
- * \param lk_id Specified lock.
- * \retval KNOT_EOK
- * \retval KNOT_ERROR
- */
-int rrl_lock(rrl_table_t *rrl, int lk_id);
-
-/*!
- * \brief Unlock specified element lock.
- * \param rrl RRL table.
- * \param lk_id Specified lock.
- * \retval KNOT_EOK
- * \retval KNOT_ERROR
- */
-int rrl_unlock(rrl_table_t *rrl, int lk_id);
@@ -162,12 +162,12 @@ static knotd_state_t ratelimit_apply(knotd_state_t state, knot_pkt_t *pkt,
 
 	if (ctx->slip > 0 && rrl_slip_roll(ctx->slip)) {
 		// Slip the answer.
-		knotd_mod_stats_incr(mod, 0, 0, 1);
+		knotd_mod_stats_incr(mod, qdata->params->thread_id, 0, 0, 1);
 		qdata->err_truncated = true;
 		return KNOTD_STATE_FAIL;
 	} else {
 		// Drop the answer.
-		knotd_mod_stats_incr(mod, 1, 0, 1);
+		knotd_mod_stats_incr(mod, qdata->params->thread_id, 1, 0, 1);
 		return KNOTD_STATE_NOOP;
 	}
 }
@@ -196,16 +196,9 @@ int rrl_load(knotd_mod_t *mod)
 		return KNOT_ENOMEM;
 	}
 
-	// Set locks.
-	int ret = rrl_setlocks(ctx->rrl, RRL_LOCK_GRANULARITY);
-	if (ret != KNOT_EOK) {
-		ctx_free(ctx);
-		return ret;
-	}
-
 	// Set rate limit.
 	conf = knotd_conf_mod(mod, MOD_RATE_LIMIT);
-	ret = rrl_setrate(ctx->rrl, conf.single.integer);
+	int ret = rrl_setrate(ctx->rrl, conf.single.integer);
 	if (ret != KNOT_EOK) {
 		ctx_free(ctx);
 		return ret;
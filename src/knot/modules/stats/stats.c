@@ -324,6 +324,7 @@ static knotd_state_t update_counters(knotd_state_t state, knot_pkt_t *pkt,
 	assert(pkt && qdata);
 
 	stats_t *stats = knotd_mod_ctx(mod);
+	unsigned tid = qdata->params->thread_id;
 
 	uint16_t operation;
 	unsigned xfr_packets = 0;
@@ -360,16 +361,16 @@ static knotd_state_t update_counters(knotd_state_t state, knot_pkt_t *pkt,
 	if (stats->req_bytes) {
 		switch (operation) {
 		case OPERATION_QUERY:
-			knotd_mod_stats_incr(mod, CTR_REQ_BYTES, REQ_BYTES_QUERY,
+			knotd_mod_stats_incr(mod, tid, CTR_REQ_BYTES, REQ_BYTES_QUERY,
 			                     qdata->query->size);
 			break;
 		case OPERATION_UPDATE:
-			knotd_mod_stats_incr(mod, CTR_REQ_BYTES, REQ_BYTES_UPDATE,
+			knotd_mod_stats_incr(mod, tid, CTR_REQ_BYTES, REQ_BYTES_UPDATE,
 			                     qdata->query->size);
 			break;
 		default:
 			if (xfr_packets <= 1) {
-				knotd_mod_stats_incr(mod, CTR_REQ_BYTES, REQ_BYTES_OTHER,
+				knotd_mod_stats_incr(mod, tid, CTR_REQ_BYTES, REQ_BYTES_OTHER,
 				                     qdata->query->size);
 			}
 			break;
@@ -380,16 +381,16 @@ static knotd_state_t update_counters(knotd_state_t state, knot_pkt_t *pkt,
 	if (stats->resp_bytes && state != KNOTD_STATE_NOOP) {
 		switch (operation) {
 		case OPERATION_QUERY:
-			knotd_mod_stats_incr(mod, CTR_RESP_BYTES, RESP_BYTES_REPLY,
+			knotd_mod_stats_incr(mod, tid, CTR_RESP_BYTES, RESP_BYTES_REPLY,
 			                     pkt->size);
 			break;
 		case OPERATION_AXFR:
 		case OPERATION_IXFR:
-			knotd_mod_stats_incr(mod, CTR_RESP_BYTES, RESP_BYTES_TRANSFER,
+			knotd_mod_stats_incr(mod, tid, CTR_RESP_BYTES, RESP_BYTES_TRANSFER,
 			                     pkt->size);
 			break;
 		default:
-			knotd_mod_stats_incr(mod, CTR_RESP_BYTES, RESP_BYTES_OTHER,
+			knotd_mod_stats_incr(mod, tid, CTR_RESP_BYTES, RESP_BYTES_OTHER,
 			                     pkt->size);
 			break;
 		}
@@ -407,14 +408,14 @@ static knotd_state_t update_counters(knotd_state_t state, knot_pkt_t *pkt,
 			if (xfr_packets > 1) {
 				assert(rcode != KNOT_RCODE_NOERROR);
 				// Ignore the leading XFR message NOERROR.
-				knotd_mod_stats_decr(mod, CTR_RCODE,
+				knotd_mod_stats_decr(mod, tid, CTR_RCODE,
 				                     KNOT_RCODE_NOERROR, 1);
 			}
 
 			if (qdata->rcode_tsig == KNOT_RCODE_BADSIG) {
-				knotd_mod_stats_incr(mod, CTR_RCODE, RCODE_BADSIG, 1);
+				knotd_mod_stats_incr(mod, tid, CTR_RCODE, RCODE_BADSIG, 1);
 			} else {
-				knotd_mod_stats_incr(mod, CTR_RCODE,
+				knotd_mod_stats_incr(mod, tid, CTR_RCODE,
 				                     MIN(rcode, RCODE_OTHER), 1);
 			}
 		}
@@ -427,25 +428,25 @@ static knotd_state_t update_counters(knotd_state_t state, knot_pkt_t *pkt,
 
 	// Count the server opearation.
 	if (stats->operation) {
-		knotd_mod_stats_incr(mod, CTR_OPERATION, operation, 1);
+		knotd_mod_stats_incr(mod, tid, CTR_OPERATION, operation, 1);
 	}
 
 	// Count the request protocol.
 	if (stats->protocol) {
 		if (qdata->params->remote->ss_family == AF_INET) {
 			if (qdata->params->flags & KNOTD_QUERY_FLAG_LIMIT_SIZE) {
-				knotd_mod_stats_incr(mod, CTR_PROTOCOL,
+				knotd_mod_stats_incr(mod, tid, CTR_PROTOCOL,
 				                     PROTOCOL_UDP4, 1);
 			} else {
-				knotd_mod_stats_incr(mod, CTR_PROTOCOL,
+				knotd_mod_stats_incr(mod, tid, CTR_PROTOCOL,
 				                     PROTOCOL_TCP4, 1);
 			}
 		} else {
 			if (qdata->params->flags & KNOTD_QUERY_FLAG_LIMIT_SIZE) {
-				knotd_mod_stats_incr(mod, CTR_PROTOCOL,
+				knotd_mod_stats_incr(mod, tid, CTR_PROTOCOL,
 				                     PROTOCOL_UDP6, 1);
 			} else {
-				knotd_mod_stats_incr(mod, CTR_PROTOCOL,
+				knotd_mod_stats_incr(mod, tid, CTR_PROTOCOL,
 				                     PROTOCOL_TCP6, 1);
 			}
 		}
@@ -454,20 +455,20 @@ static knotd_state_t update_counters(knotd_state_t state, knot_pkt_t *pkt,
 	// Count EDNS occurrences.
 	if (stats->edns) {
 		if (qdata->query->opt_rr != NULL) {
-			knotd_mod_stats_incr(mod, CTR_EDNS, EDNS_REQ, 1);
+			knotd_mod_stats_incr(mod, tid, CTR_EDNS, EDNS_REQ, 1);
 		}
 		if (pkt->opt_rr != NULL && state != KNOTD_STATE_NOOP) {
-			knotd_mod_stats_incr(mod, CTR_EDNS, EDNS_RESP, 1);
+			knotd_mod_stats_incr(mod, tid, CTR_EDNS, EDNS_RESP, 1);
 		}
 	}
 
 	// Count interesting message header flags.
 	if (stats->flag) {
 		if (state != KNOTD_STATE_NOOP && knot_wire_get_tc(pkt->wire)) {
-			knotd_mod_stats_incr(mod, CTR_FLAG, FLAG_TC, 1);
+			knotd_mod_stats_incr(mod, tid, CTR_FLAG, FLAG_TC, 1);
 		}
 		if (pkt->opt_rr != NULL && knot_edns_do(pkt->opt_rr)) {
-			knotd_mod_stats_incr(mod, CTR_FLAG, FLAG_DO, 1);
+			knotd_mod_stats_incr(mod, tid, CTR_FLAG, FLAG_DO, 1);
 		}
 	}
 
@@ -483,13 +484,13 @@ static knotd_state_t update_counters(knotd_state_t state, knot_pkt_t *pkt,
 	     knot_pkt_rr(knot_pkt_section(pkt, KNOT_AUTHORITY), 0)->type == KNOT_RRTYPE_SOA)) {
 		switch (knot_pkt_qtype(qdata->query)) {
 		case KNOT_RRTYPE_A:
-			knotd_mod_stats_incr(mod, CTR_NODATA, NODATA_A, 1);
+			knotd_mod_stats_incr(mod, tid, CTR_NODATA, NODATA_A, 1);
 			break;
 		case KNOT_RRTYPE_AAAA:
-			knotd_mod_stats_incr(mod, CTR_NODATA, NODATA_AAAA, 1);
+			knotd_mod_stats_incr(mod, tid, CTR_NODATA, NODATA_AAAA, 1);
 			break;
 		default:
-			knotd_mod_stats_incr(mod, CTR_NODATA, NODATA_OTHER, 1);
+			knotd_mod_stats_incr(mod, tid, CTR_NODATA, NODATA_OTHER, 1);
 			break;
 		}
 	}
@@ -506,19 +507,19 @@ static knotd_state_t update_counters(knotd_state_t state, knot_pkt_t *pkt,
 		default:                        idx = QTYPE_OTHER; break;
 		}
 
-		knotd_mod_stats_incr(mod, CTR_QTYPE, idx, 1);
+		knotd_mod_stats_incr(mod, tid, CTR_QTYPE, idx, 1);
 	}
 
 	// Count the query size.
 	if (stats->qsize) {
 		uint64_t idx = qdata->query->size / BUCKET_SIZE;
-		knotd_mod_stats_incr(mod, CTR_QSIZE, MIN(idx, QSIZE_MAX_IDX), 1);
+		knotd_mod_stats_incr(mod, tid, CTR_QSIZE, MIN(idx, QSIZE_MAX_IDX), 1);
 	}
 
 	// Count the reply size.
 	if (stats->rsize && state != KNOTD_STATE_NOOP) {
 		uint64_t idx = pkt->size / BUCKET_SIZE;
-		knotd_mod_stats_incr(mod, CTR_RSIZE, MIN(idx, RSIZE_MAX_IDX), 1);
+		knotd_mod_stats_incr(mod, tid, CTR_RSIZE, MIN(idx, RSIZE_MAX_IDX), 1);
 	}
 
 	return state;
@@ -34,7 +34,7 @@
 /* AXFR context. @note aliasing the generic xfr_proc */
 struct axfr_proc {
 	struct xfr_proc proc;
-	trie_it_t *i;
+	zone_tree_it_t i;
 	unsigned cur_rrset;
 };
 
@@ -70,25 +70,27 @@ static int axfr_process_node_tree(knot_pkt_t *pkt, const void *item,
 
 	struct axfr_proc *axfr = (struct axfr_proc*)state;
 
-	if (axfr->i == NULL) {
-		axfr->i = trie_it_begin((trie_t *)item);
+	int ret = KNOT_EOK;
+	if (axfr->i.tree == NULL) {
+		ret = zone_tree_it_begin((zone_tree_t *)item, &axfr->i);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
 	}
 
 	/* Put responses. */
-	int ret = KNOT_EOK;
-	while (!trie_it_finished(axfr->i)) {
-		zone_node_t *node = (zone_node_t *)*trie_it_val(axfr->i);
+	while (!zone_tree_it_finished(&axfr->i)) {
+		zone_node_t *node = zone_tree_it_val(&axfr->i);
 		ret = axfr_put_rrsets(pkt, node, axfr);
 		if (ret != KNOT_EOK) {
 			break;
 		}
-		trie_it_next(axfr->i);
+		zone_tree_it_next(&axfr->i);
 	}
 
 	/* Finished all nodes. */
 	if (ret == KNOT_EOK) {
-		trie_it_free(axfr->i);
-		axfr->i = NULL;
+		zone_tree_it_free(&axfr->i);
 	}
 	return ret;
 }
@@ -97,12 +99,10 @@ static void axfr_query_cleanup(knotd_qdata_t *qdata)
 {
 	struct axfr_proc *axfr = (struct axfr_proc *)qdata->extra->ext;
 
-	trie_it_free(axfr->i);
+	zone_tree_it_free(&axfr->i);
 	ptrlist_free(&axfr->proc.nodes, qdata->mm);
+	xfr_cached_cleanup(&axfr->proc);
 	mm_free(qdata->mm, axfr);
-
-	/* Allow zone changes (finished). */
-	rcu_read_unlock();
 }
 
 static int axfr_query_check(knotd_qdata_t *qdata)
@@ -135,23 +135,25 @@ static int axfr_query_init(knotd_qdata_t *qdata)
 	}
 	memset(axfr, 0, sizeof(struct axfr_proc));
 	init_list(&axfr->proc.nodes);
+	xfr_contents_init(&axfr->proc, qdata);
 
-	/* Put data to process. */
+	/* Put data to process, unless already rendered. */
 	xfr_stats_begin(&axfr->proc.stats);
+	const xfr_stream_t *cached = xfr_cached_find(qdata, KNOT_RRTYPE_AXFR, 0);
+	xfr_cached_init(&axfr->proc, qdata, cached, KNOT_RRTYPE_AXFR, 0);
 	zone_contents_t *zone = qdata->extra->zone->contents;
-	ptrlist_add(&axfr->proc.nodes, zone->nodes, mm);
-	/* Put NSEC3 data if exists. */
-	if (!zone_tree_is_empty(zone->nsec3_nodes)) {
-		ptrlist_add(&axfr->proc.nodes, zone->nsec3_nodes, mm);
+	if (cached == NULL) {
+		ptrlist_add(&axfr->proc.nodes, zone->nodes, mm);
+		/* Put NSEC3 data if exists. */
+		if (!zone_tree_is_empty(zone->nsec3_nodes)) {
+			ptrlist_add(&axfr->proc.nodes, zone->nsec3_nodes, mm);
+		}
 	}
 
 	/* Set up cleanup callback. */
 	qdata->extra->ext = axfr;
 	qdata->extra->ext_cleanup = &axfr_query_cleanup;
 
-	/* No zone changes during multipacket answer (unlocked in axfr_answer_cleanup) */
-	rcu_read_lock();
-
 	return KNOT_EOK;
 }
 
@@ -174,8 +176,9 @@ int axfr_process_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 		axfr = qdata->extra->ext;
 		switch (ret) {
 		case KNOT_EOK:      /* OK */
-			AXFROUT_LOG(LOG_INFO, qdata, "started, serial %u",
-			            zone_contents_serial(qdata->extra->zone->contents));
+			AXFROUT_LOG(LOG_INFO, qdata, "started, serial %u%s",
+			            zone_contents_serial(qdata->extra->zone->contents),
+			            (axfr->proc.cached != NULL) ? ", cached" : "");
 			break;
 		case KNOT_EDENIED:  /* Not authorized, already logged. */
 			return KNOT_STATE_FAIL;
@@ -187,6 +190,11 @@ int axfr_process_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 			            knot_strerror(ret));
 			return KNOT_STATE_FAIL;
 		}
+	} else if (xfr_contents_check(&axfr->proc, qdata) != KNOT_EOK) {
+		/* The zone isn't locked between messages, don't mix versions. */
+		AXFROUT_LOG(LOG_NOTICE, qdata, "zone changed, transfer aborted");
+		qdata->rcode = KNOT_RCODE_SERVFAIL;
+		return KNOT_STATE_FAIL;
 	}
 
 	/* Reserve space for TSIG. */
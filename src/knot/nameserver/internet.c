@@ -18,6 +18,7 @@
 #include "knot/nameserver/internet.h"
 #include "knot/nameserver/nsec_proofs.h"
 #include "knot/nameserver/query_module.h"
+#include "knot/conf/snapshot.h"
 #include "knot/zone/serial.h"
 #include "contrib/mempattern.h"
 
@@ -122,6 +123,17 @@ static bool have_dnssec(knotd_qdata_t *qdata)
 /*! \brief This is a wildcard-covered or any other terminal node for QNAME.
  *         e.g. positive answer.
  */
+static bool disable_any(const knot_dname_t *zone_name)
+{
+	const conf_snap_zone_t *snap = conf_snapshot_zone(conf(), zone_name);
+	if (snap != NULL) {
+		return snap->disable_any;
+	}
+
+	conf_val_t val = conf_zone_get(conf(), C_DISABLE_ANY, zone_name);
+	return conf_bool(&val);
+}
+
 static int put_answer(knot_pkt_t *pkt, uint16_t type, knotd_qdata_t *qdata)
 {
 	knot_rrset_t rrset;
@@ -143,11 +155,9 @@ static int put_answer(knot_pkt_t *pkt, uint16_t type, knotd_qdata_t *qdata)
 	int ret = KNOT_EOK;
 	switch (type) {
 	case KNOT_RRTYPE_ANY: /* Append all RRSets. */ {
-		conf_val_t val = conf_zone_get(conf(), C_DISABLE_ANY,
-		                               qdata->extra->zone->name);
 		/* If ANY not allowed, set TC bit. */
 		if ((qdata->params->flags & KNOTD_QUERY_FLAG_LIMIT_ANY) &&
-		    conf_bool(&val)) {
+		    disable_any(qdata->extra->zone->name)) {
 			knot_wire_set_tc(pkt->wire);
 			return KNOT_ESPACE;
 		}
@@ -189,7 +199,7 @@ static int put_delegation(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 {
 	/* Find closest delegation point. */
 	while (!(qdata->extra->node->flags & NODE_FLAGS_DELEG)) {
-		qdata->extra->node = qdata->extra->node->parent;
+		qdata->extra->node = node_parent(qdata->extra->node);
 	}
 
 	/* Insert NS record. */
@@ -215,6 +225,7 @@ static int put_additional(knot_pkt_t *pkt, const knot_rrset_t *rr,
 	int ret = KNOT_EOK;
 
 	additional_t *additional = (additional_t *)rr->additional;
+	const zone_node_t *apex = qdata->extra->zone->contents->apex;
 
 	/* Iterate over the additionals. */
 	for (uint16_t i = 0; i < additional->count; i++) {
@@ -228,9 +239,10 @@ static int put_additional(knot_pkt_t *pkt, const knot_rrset_t *rr,
 
 		uint16_t hint = knot_pkt_compr_hint(info, KNOT_COMPR_HINT_RDATA +
 		                                    glue->ns_pos);
-		knot_rrset_t rrsigs = node_rrset(glue->node, KNOT_RRTYPE_RRSIG);
+		const zone_node_t *node = glue_node(glue, apex);
+		knot_rrset_t rrsigs = node_rrset(node, KNOT_RRTYPE_RRSIG);
 		for (int k = 0; k < ar_type_count; ++k) {
-			knot_rrset_t rrset = node_rrset(glue->node, ar_type_list[k]);
+			knot_rrset_t rrset = node_rrset(node, ar_type_list[k]);
 			if (knot_rrset_empty(&rrset)) {
 				continue;
 			}
@@ -384,7 +396,7 @@ static int name_not_found(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 	/* Look up an authoritative encloser or its parent. */
 	const zone_node_t *node = qdata->extra->encloser;
 	while (node->rrset_count == 0 || node->flags & NODE_FLAGS_NONAUTH) {
-		node = node->parent;
+		node = node_parent(node);
 		assert(node);
 	}
 
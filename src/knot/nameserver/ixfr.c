@@ -180,12 +180,10 @@ static void ixfr_answer_cleanup(knotd_qdata_t *qdata)
 	knot_mm_t *mm = qdata->mm;
 
 	ptrlist_free(&ixfr->proc.nodes, mm);
+	xfr_cached_cleanup(&ixfr->proc);
 	changeset_iter_clear(&ixfr->cur);
 	changesets_free(&ixfr->changesets);
 	mm_free(mm, qdata->extra->ext);
-
-	/* Allow zone changes (finished). */
-	rcu_read_unlock();
 }
 
 static int ixfr_answer_init(knotd_qdata_t *qdata)
@@ -201,14 +199,18 @@ static int ixfr_answer_init(knotd_qdata_t *qdata)
 		}
 	}
 
-	/* Compare serials. */
+	/* Compare serials, unless the changes are rendered already. */
 	const knot_pktsection_t *authority = knot_pkt_section(qdata->query, KNOT_AUTHORITY);
 	const knot_rrset_t *their_soa = knot_pkt_rr(authority, 0);
+	uint32_t serial_from = knot_soa_serial(&their_soa->rrs);
+	const xfr_stream_t *cached = xfr_cached_find(qdata, KNOT_RRTYPE_IXFR, serial_from);
 	list_t chgsets;
 	init_list(&chgsets);
-	int ret = ixfr_load_chsets(&chgsets, (zone_t *)qdata->extra->zone, their_soa);
-	if (ret != KNOT_EOK) {
-		return ret;
+	if (cached == NULL) {
+		int ret = ixfr_load_chsets(&chgsets, (zone_t *)qdata->extra->zone, their_soa);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
 	}
 
 	/* Initialize transfer processing. */
@@ -220,12 +222,16 @@ static int ixfr_answer_init(knotd_qdata_t *qdata)
 	}
 	memset(xfer, 0, sizeof(struct ixfr_proc));
 	xfr_stats_begin(&xfer->proc.stats);
+	xfr_contents_init(&xfer->proc, qdata);
+	xfr_cached_init(&xfer->proc, qdata, cached, KNOT_RRTYPE_IXFR, serial_from);
 	xfer->state = IXFR_SOA_DEL;
 	init_list(&xfer->proc.nodes);
 	init_list(&xfer->changesets);
 	init_list(&xfer->cur.iters);
 	knot_rrset_init_empty(&xfer->cur_rr);
-	add_tail_list(&xfer->changesets, &chgsets);
+	if (!EMPTY_LIST(chgsets)) {
+		add_tail_list(&xfer->changesets, &chgsets);
+	}
 	xfer->qdata = qdata;
 
 	/* Put all changesets to processing queue. */
@@ -234,19 +240,13 @@ static int ixfr_answer_init(knotd_qdata_t *qdata)
 		ptrlist_add(&xfer->proc.nodes, chs, mm);
 	}
 
-	/* Keep first and last serial. */
-	chs = HEAD(xfer->changesets);
-	xfer->soa_from = chs->soa_from;
-	chs = TAIL(xfer->changesets);
-	xfer->soa_to = chs->soa_to;
+	/* Keep first serial. */
+	xfer->soa_from = their_soa;
 
 	/* Set up cleanup callback. */
 	qdata->extra->ext = xfer;
 	qdata->extra->ext_cleanup = &ixfr_answer_cleanup;
 
-	/* No zone changes during multipacket answer (unlocked in ixfr_answer_cleanup) */
-	rcu_read_lock();
-
 	return KNOT_EOK;
 }
 
@@ -300,9 +300,10 @@ int ixfr_process_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 		ixfr = qdata->extra->ext;
 		switch (ret) {
 		case KNOT_EOK:       /* OK */
-			IXFROUT_LOG(LOG_INFO, qdata, "started, serial %u -> %u",
+			IXFROUT_LOG(LOG_INFO, qdata, "started, serial %u -> %u%s",
 			            knot_soa_serial(&ixfr->soa_from->rrs),
-			            knot_soa_serial(&ixfr->soa_to->rrs));
+			            zone_contents_serial(qdata->extra->zone->contents),
+			            (ixfr->proc.cached != NULL) ? ", cached" : "");
 			break;
 		case KNOT_EUPTODATE: /* Our zone is same age/older, send SOA. */
 			IXFROUT_LOG(LOG_INFO, qdata, "zone is up-to-date");
@@ -322,6 +323,11 @@ int ixfr_process_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 			            knot_strerror(ret));
 			return KNOT_STATE_FAIL;
 		}
+	} else if (xfr_contents_check(&ixfr->proc, qdata) != KNOT_EOK) {
+		/* The zone isn't locked between messages, don't mix versions. */
+		IXFROUT_LOG(LOG_NOTICE, qdata, "zone changed, transfer aborted");
+		qdata->rcode = KNOT_RCODE_SERVFAIL;
+		return KNOT_STATE_FAIL;
 	}
 
 	/* Reserve space for TSIG. */
@@ -44,7 +44,6 @@ struct ixfr_proc {
 	knot_rrset_t cur_rr;
 	changeset_iter_t cur;
 	const knot_rrset_t *soa_from;
-	const knot_rrset_t *soa_to;
 
 	/* Processing context. */
 	knotd_qdata_t *qdata;
@@ -28,7 +28,9 @@
 #include "knot/nameserver/update.h"
 #include "knot/nameserver/nsec_proofs.h"
 #include "knot/nameserver/notify.h"
+#include "knot/server/defer.h"
 #include "knot/server/server.h"
+#include "knot/zone/answer-cache.h"
 #include "libknot/libknot.h"
 #include "contrib/macros.h"
 #include "contrib/mempattern.h"
@@ -135,6 +137,11 @@ static int process_query_in(knot_layer_t *ctx, knot_pkt_t *pkt)
 	qdata->query = pkt;
 	qdata->type = query_type(pkt);
 
+	/* Continue a resumed query from the hook that deferred it. */
+	if (qdata->params->defer != NULL) {
+		qdata->extra->resume_step = qdata->params->defer->step;
+	}
+
 	/* Declare having response. */
 	return KNOT_STATE_PRODUCE;
 }
@@ -445,10 +452,38 @@ static int process_query_err(knot_layer_t *ctx, knot_pkt_t *pkt)
 	return KNOT_STATE_DONE;
 }
 
+/*! \brief Check if the hook runs, a resumed query skips those before the deferring one. */
+static bool process_step_enter(knotd_qdata_t *qdata, const struct query_step *step)
+{
+	knotd_qdata_extra_t *extra = qdata->extra;
+	if (extra->resume_step != NULL) {
+		if (extra->resume_step != step) {
+			return false;
+		}
+		extra->resume_step = NULL;
+	}
+
+	extra->step = step;
+	return true;
+}
+
+/*! \brief Finish the hook, check if it deferred the query. */
+static bool process_step_deferred(knotd_qdata_t *qdata)
+{
+	qdata->extra->step = NULL;
+	return qdata->extra->deferred;
+}
+
 #define PROCESS_BEGIN(plan, step, next_state, qdata) \
 	if (plan != NULL) { \
 		WALK_LIST(step, plan->stage[KNOTD_STAGE_BEGIN]) { \
+			if (!process_step_enter(qdata, step)) { \
+				continue; \
+			} \
 			next_state = step->process(next_state, pkt, qdata, step->ctx); \
+			if (process_step_deferred(qdata)) { \
+				goto deferred; \
+			} \
 			if (next_state == KNOT_STATE_FAIL) { \
 				goto finish; \
 			} \
@@ -458,13 +493,80 @@ static int process_query_err(knot_layer_t *ctx, knot_pkt_t *pkt)
 #define PROCESS_END(plan, step, next_state, qdata) \
 	if (plan != NULL) { \
 		WALK_LIST(step, plan->stage[KNOTD_STAGE_END]) { \
+			if (!process_step_enter(qdata, step)) { \
+				continue; \
+			} \
 			next_state = step->process(next_state, pkt, qdata, step->ctx); \
+			if (process_step_deferred(qdata)) { \
+				goto deferred; \
+			} \
 			if (next_state == KNOT_STATE_FAIL) { \
 				next_state = process_query_err(ctx, pkt); \
 			} \
 		} \
 	}
 
+/*! \brief Get the zone answer cache usable for the query, fill the key. */
+static answer_cache_t *answer_cache_prepare(knot_pkt_t *pkt, knotd_qdata_t *qdata,
+                                            struct query_plan *plan,
+                                            answer_cache_key_t *key)
+{
+	const zone_t *zone = qdata->extra->zone;
+	if (zone == NULL || zone->contents == NULL ||
+	    zone->contents->answer_cache == NULL) {
+		return NULL;
+	}
+
+	/* Modules, TSIG, and EDNS options may alter the answer. */
+	knot_pkt_t *query = qdata->query;
+	if (plan != NULL || zone->query_plan != NULL ||
+	    qdata->type != KNOTD_QUERY_TYPE_NORMAL ||
+	    knot_pkt_qclass(query) != KNOT_CLASS_IN ||
+	    knot_pkt_has_tsig(query) ||
+	    (query->opt_rr != NULL && query->opt_rr->rrs.data->len > 0)) {
+		return NULL;
+	}
+
+	key->qname = knot_pkt_qname(query);
+	key->qtype = knot_pkt_qtype(query);
+	key->max_size = pkt->max_size;
+	key->flags = 0;
+	if (query->opt_rr != NULL) {
+		key->flags |= ANSWER_CACHE_EDNS;
+		if (knot_edns_do(query->opt_rr)) {
+			key->flags |= ANSWER_CACHE_DO;
+		}
+	}
+
+	return zone->contents->answer_cache;
+}
+
+/*! \brief Fill the response from the answer cache. */
+static bool answer_cache_fill(answer_cache_t *cache, const answer_cache_key_t *key,
+                              knot_pkt_t *pkt, knotd_qdata_t *qdata)
+{
+	size_t size = 0;
+	if (!answer_cache_get(cache, key, pkt->wire, &size)) {
+		return false;
+	}
+	pkt->size = size;
+
+	/* Patch query specific header fields and QNAME case. */
+	const knot_pkt_t *query = qdata->query;
+	knot_wire_set_id(pkt->wire, knot_wire_get_id(query->wire));
+	if (knot_wire_get_rd(query->wire)) {
+		knot_wire_set_rd(pkt->wire);
+	} else {
+		knot_wire_clear_rd(pkt->wire);
+	}
+	memcpy(pkt->wire + KNOT_WIRE_HEADER_SIZE, qdata->extra->orig_qname,
+	       query->qname_size);
+
+	qdata->rcode = knot_wire_get_rcode(pkt->wire);
+
+	return true;
+}
+
 static int process_query_out(knot_layer_t *ctx, knot_pkt_t *pkt)
 {
 	assert(pkt && ctx);
@@ -475,6 +577,8 @@ static int process_query_out(knot_layer_t *ctx, knot_pkt_t *pkt)
 	struct query_plan *plan = conf()->query_plan;
 	struct query_plan *zone_plan = NULL;
 	struct query_step *step = NULL;
+	answer_cache_t *cache = NULL;
+	answer_cache_key_t cache_key;
 
 	int next_state = KNOT_STATE_PRODUCE;
 
@@ -496,12 +600,19 @@ static int process_query_out(knot_layer_t *ctx, knot_pkt_t *pkt)
 		zone_plan = qdata->extra->zone->query_plan;
 	}
 
+	/* Reuse a previously rendered answer if possible. */
+	cache = answer_cache_prepare(pkt, qdata, plan, &cache_key);
+	if (cache != NULL && answer_cache_fill(cache, &cache_key, pkt, qdata)) {
+		rcu_read_unlock();
+		return KNOT_STATE_DONE;
+	}
+
 	/* Before query processing code. */
 	PROCESS_BEGIN(plan, step, next_state, qdata);
 	PROCESS_BEGIN(zone_plan, step, next_state, qdata);
 
-	/* Answer based on qclass. */
-	if (next_state == KNOT_STATE_PRODUCE) {
+	/* Answer based on qclass, unless resuming a query deferred after that. */
+	if (next_state == KNOT_STATE_PRODUCE && qdata->extra->resume_step == NULL) {
 		switch (knot_pkt_qclass(pkt)) {
 		case KNOT_CLASS_CH:
 			next_state = query_chaos(pkt, ctx);
@@ -551,15 +662,32 @@ finish:
 		break;
 	default:
 		set_rcode_to_packet(pkt, qdata);
+		if (cache != NULL && next_state == KNOT_STATE_DONE &&
+		    (qdata->rcode == KNOT_RCODE_NOERROR ||
+		     qdata->rcode == KNOT_RCODE_NXDOMAIN)) {
+			(void)answer_cache_put(cache, &cache_key, pkt->wire, pkt->size);
+		}
 	}
 
 	/* After query processing code. */
 	PROCESS_END(plan, step, next_state, qdata);
 	PROCESS_END(zone_plan, step, next_state, qdata);
 
+	/* The deferring hook is gone (reconfigured), no answer without it. */
+	if (qdata->params->defer != NULL && !qdata->extra->resumed_taken) {
+		qdata->rcode = KNOT_RCODE_SERVFAIL;
+		next_state = process_query_err(ctx, pkt);
+	}
+
 	rcu_read_unlock();
 
 	return next_state;
+
+deferred:
+	/* Set aside without an answer until resumed. */
+	rcu_read_unlock();
+
+	return KNOT_STATE_NOOP;
 }
 
 bool process_query_acl_check(conf_t *conf, const knot_dname_t *zone_name,
@@ -580,9 +708,17 @@ bool process_query_acl_check(conf_t *conf, const knot_dname_t *zone_name,
 		tsig.algorithm = knot_tsig_rdata_alg(query->tsig_rr);
 	}
 
-	/* Check if authenticated. */
-	conf_val_t acl = conf_zone_get(conf, C_ACL, zone_name);
-	if (!acl_allowed(conf, &acl, action, query_source, &tsig)) {
+	/* Check if authenticated, preferably using the compiled configuration. */
+	bool allowed;
+	const conf_snap_zone_t *snap = conf_snapshot_zone(conf, zone_name);
+	if (snap != NULL) {
+		allowed = acl_allowed_snap(snap->acl, snap->acl_count, action,
+		                           query_source, &tsig);
+	} else {
+		conf_val_t acl = conf_zone_get(conf, C_ACL, zone_name);
+		allowed = acl_allowed(conf, &acl, action, query_source, &tsig);
+	}
+	if (!allowed) {
 		char addr_str[SOCKADDR_STRLEN] = { 0 };
 		sockaddr_tostr(addr_str, sizeof(addr_str), (struct sockaddr *)query_source);
 		const knot_lookup_t *act = knot_lookup_by_id((knot_lookup_t *)acl_actions,
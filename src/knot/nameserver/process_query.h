@@ -37,6 +37,12 @@ typedef struct knotd_qdata_extra {
 	/* Original QNAME case. */
 	uint8_t orig_qname[KNOT_DNAME_MAXLEN];
 
+	/* Query deferring (see knotd_qdata_defer()). */
+	const struct query_step *step;        /*!< Running general hook. */
+	const struct query_step *resume_step; /*!< Hook to resume from. */
+	bool deferred;                        /*!< The running hook deferred the query. */
+	bool resumed_taken;                   /*!< The resumed hook took its data. */
+
 	/* Extensions. */
 	void *ext;
 	void (*ext_cleanup)(knotd_qdata_t *); /*!< Extensions cleanup callback. */
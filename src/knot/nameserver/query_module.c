@@ -26,6 +26,7 @@
 #include "knot/conf/tools.h"
 #include "knot/nameserver/query_module.h"
 #include "knot/nameserver/process_query.h"
+#include "knot/server/defer.h"
 #include "contrib/mempattern.h"
 
 #ifdef HAVE_ATOMIC
@@ -39,6 +40,13 @@
  #define ATOMIC_SET(dst, val) ((dst) = (val))
 #endif
 
+/* Thread-owned shards need no read-modify-write atomicity, only untorn values. */
+#define LOCAL_ADD(dst, val) ATOMIC_SET(dst, ATOMIC_GET(dst) + (val))
+#define LOCAL_SUB(dst, val) ATOMIC_SET(dst, ATOMIC_GET(dst) - (val))
+
+/*! Cache line size, shards are aligned to it to prevent false sharing. */
+#define STATS_SHARD_ALIGN 64
+
 _public_
 int knotd_conf_check_ref(knotd_conf_check_args_t *args)
 {
@@ -221,6 +229,25 @@ void knotd_mod_vlog(knotd_mod_t *mod, int priority, const char *fmt, va_list arg
 	#undef LOG_ARGS
 }
 
+static uint64_t *stats_shard_realloc(uint64_t *shard, uint32_t counters,
+                                     uint32_t prev_counters)
+{
+	// Whole cache lines so that no other data shares the last one.
+	size_t size = counters * sizeof(uint64_t);
+	size = (size + STATS_SHARD_ALIGN - 1) / STATS_SHARD_ALIGN * STATS_SHARD_ALIGN;
+
+	void *new_shard = NULL;
+	if (posix_memalign(&new_shard, STATS_SHARD_ALIGN, size) != 0) {
+		return NULL;
+	}
+	if (shard != NULL) {
+		memcpy(new_shard, shard, prev_counters * sizeof(uint64_t));
+		free(shard);
+	}
+
+	return new_shard;
+}
+
 _public_
 int knotd_mod_stats_add(knotd_mod_t *mod, const char *ctr_name, uint32_t idx_count,
                         knotd_mod_idx_to_str_f idx_to_str)
@@ -229,40 +256,51 @@ int knotd_mod_stats_add(knotd_mod_t *mod, const char *ctr_name, uint32_t idx_cou
 		return KNOT_EINVAL;
 	}
 
-	mod_ctr_t *stats = NULL;
-	if (mod->stats == NULL) {
+	if (mod->stats_vals == NULL) {
 		assert(mod->stats_count == 0);
-		stats = mm_alloc(mod->mm, sizeof(*stats));
-		if (stats == NULL) {
-			return KNOT_ENOMEM;
-		}
-		mod->stats = stats;
-	} else {
-		assert(mod->stats_count > 0);
-		size_t old_size = mod->stats_count * sizeof(*stats);
-		size_t new_size = old_size + sizeof(*stats);
-		stats = mm_realloc(mod->mm, mod->stats, new_size, old_size);
-		if (stats == NULL) {
-			knotd_mod_stats_free(mod);
+		// One shard per UDP/TCP thread and a shared one for other threads.
+		conf_t *config = (mod->config != NULL) ? mod->config : conf();
+		mod->stats_threads = conf_udp_threads(config) + conf_tcp_threads(config);
+		size_t size = (mod->stats_threads + 1) * sizeof(*mod->stats_vals);
+		mod->stats_vals = mm_alloc(mod->mm, size);
+		if (mod->stats_vals == NULL) {
 			return KNOT_ENOMEM;
 		}
-		mod->stats = stats;
-		stats += mod->stats_count;
+		memset(mod->stats_vals, 0, size);
 	}
 
-	mod->stats_count++;
+	uint32_t offset = 0;
+	if (mod->stats_count > 0) {
+		mod_ctr_t *last = mod->stats_info + mod->stats_count - 1;
+		offset = last->offset + last->count;
+	}
 
-	if (idx_count > 1) {
-		size_t size = idx_count * sizeof(((mod_ctr_t *)0)->counter);
-		stats->counters = mm_alloc(mod->mm, size);
-		if (stats->counters == NULL) {
+	size_t old_size = mod->stats_count * sizeof(*mod->stats_info);
+	size_t new_size = old_size + sizeof(*mod->stats_info);
+	mod_ctr_t *stats = mm_realloc(mod->mm, mod->stats_info, new_size, old_size);
+	if (stats == NULL) {
+		knotd_mod_stats_free(mod);
+		return KNOT_ENOMEM;
+	}
+	mod->stats_info = stats;
+	stats += mod->stats_count;
+
+	for (unsigned i = 0; i <= mod->stats_threads; i++) {
+		uint64_t *vals = stats_shard_realloc(mod->stats_vals[i],
+		                                     offset + idx_count, offset);
+		if (vals == NULL) {
 			knotd_mod_stats_free(mod);
 			return KNOT_ENOMEM;
 		}
-		memset(stats->counters, 0, size);
-		stats->idx_to_str = idx_to_str;
+		memset(vals + offset, 0, idx_count * sizeof(*vals));
+		mod->stats_vals[i] = vals;
 	}
+
+	mod->stats_count++;
+
 	stats->name = ctr_name;
+	stats->idx_to_str = (idx_count > 1) ? idx_to_str : NULL;
+	stats->offset = offset;
 	stats->count = idx_count;
 
 	return KNOT_EOK;
@@ -271,48 +309,81 @@ int knotd_mod_stats_add(knotd_mod_t *mod, const char *ctr_name, uint32_t idx_cou
 _public_
 void knotd_mod_stats_free(knotd_mod_t *mod)
 {
-	if (mod == NULL || mod->stats == NULL) {
+	if (mod == NULL) {
 		return;
 	}
 
-	for (int i = 0; i < mod->stats_count; i++) {
-		if (mod->stats[i].count > 1) {
-			mm_free(mod->mm, mod->stats[i].counters);
+	if (mod->stats_vals != NULL) {
+		for (unsigned i = 0; i <= mod->stats_threads; i++) {
+			free(mod->stats_vals[i]);
 		}
+		mm_free(mod->mm, mod->stats_vals);
+		mod->stats_vals = NULL;
+	}
+
+	mm_free(mod->mm, mod->stats_info);
+	mod->stats_info = NULL;
+	mod->stats_count = 0;
+}
+
+uint64_t mod_stats_get(knotd_mod_t *mod, mod_ctr_t *ctr, uint32_t idx)
+{
+	assert(mod && ctr && idx < ctr->count);
+
+	uint64_t sum = 0;
+	for (unsigned i = 0; i <= mod->stats_threads; i++) {
+		sum += ATOMIC_GET(mod->stats_vals[i][ctr->offset + idx]);
 	}
 
-	mm_free(mod->mm, mod->stats);
+	return sum;
 }
 
-#define STATS_BODY(OPERATION) { \
+/*
+ * Each UDP/TCP thread updates its own shard, other threads (if any) share
+ * the last one, which is updated atomically.
+ */
+#define STATS_BODY(LOCAL_OPERATION, SHARED_OPERATION) { \
 	if (mod == NULL) return; \
 	\
-	mod_ctr_t *ctr = mod->stats + ctr_id; \
-	if (ctr->count == 1) { \
-		assert(idx == 0); \
-		OPERATION(ctr->counter, val); \
+	mod_ctr_t *ctr = mod->stats_info + ctr_id; \
+	assert(idx < ctr->count); \
+	if (thr_id < mod->stats_threads) { \
+		LOCAL_OPERATION(mod->stats_vals[thr_id][ctr->offset + idx], val); \
 	} else { \
-		assert(idx < ctr->count); \
-		OPERATION(ctr->counters[idx], val); \
+		uint64_t *shared = mod->stats_vals[mod->stats_threads]; \
+		SHARED_OPERATION(shared[ctr->offset + idx], val); \
 	} \
 }
 
 _public_
-void knotd_mod_stats_incr(knotd_mod_t *mod, uint32_t ctr_id, uint32_t idx, uint64_t val)
+void knotd_mod_stats_incr(knotd_mod_t *mod, unsigned thr_id, uint32_t ctr_id,
+                          uint32_t idx, uint64_t val)
 {
-	STATS_BODY(ATOMIC_ADD)
+	STATS_BODY(LOCAL_ADD, ATOMIC_ADD)
 }
 
 _public_
-void knotd_mod_stats_decr(knotd_mod_t *mod, uint32_t ctr_id, uint32_t idx, uint64_t val)
+void knotd_mod_stats_decr(knotd_mod_t *mod, unsigned thr_id, uint32_t ctr_id,
+                          uint32_t idx, uint64_t val)
 {
-	STATS_BODY(ATOMIC_SUB)
+	STATS_BODY(LOCAL_SUB, ATOMIC_SUB)
 }
 
 _public_
-void knotd_mod_stats_store(knotd_mod_t *mod, uint32_t ctr_id, uint32_t idx, uint64_t val)
+void knotd_mod_stats_store(knotd_mod_t *mod, unsigned thr_id, uint32_t ctr_id,
+                           uint32_t idx, uint64_t val)
 {
-	STATS_BODY(ATOMIC_SET)
+	if (mod == NULL) {
+		return;
+	}
+
+	// The value replaces the sum of all shards.
+	mod_ctr_t *ctr = mod->stats_info + ctr_id;
+	assert(idx < ctr->count);
+	unsigned own = (thr_id < mod->stats_threads) ? thr_id : mod->stats_threads;
+	for (unsigned i = 0; i <= mod->stats_threads; i++) {
+		ATOMIC_SET(mod->stats_vals[i][ctr->offset + idx], (i == own) ? val : 0);
+	}
 }
 
 _public_
@@ -530,3 +601,47 @@ knot_rrset_t knotd_qdata_zone_apex_rrset(knotd_qdata_t *qdata, uint16_t type)
 
 	return node_rrset(qdata->extra->zone->contents->apex, type);
 }
+
+_public_
+knotd_defer_t *knotd_qdata_defer(knotd_qdata_t *qdata)
+{
+	if (qdata == NULL || qdata->params->defer_queue == NULL ||
+	    qdata->params->defer != NULL || qdata->extra->step == NULL) {
+		return NULL;
+	}
+
+	/* Keep the query as received to process it again. */
+	const knot_pkt_t *query = qdata->query;
+	size_t query_len = query->size + query->tsig_wire.len;
+	knotd_defer_t *defer = defer_new(qdata->params->defer_queue, query_len);
+	if (defer == NULL) {
+		return NULL;
+	}
+	memcpy(defer->query, query->wire, query_len);
+	if (qdata->extra->orig_qname[0] != '\0') {
+		memcpy(defer->query + KNOT_WIRE_HEADER_SIZE, qdata->extra->orig_qname,
+		       query->qname_size);
+	}
+	if (query->tsig_wire.pos != NULL) {
+		knot_wire_set_arcount(defer->query, knot_wire_get_arcount(defer->query) + 1);
+	}
+	defer->step = qdata->extra->step;
+
+	qdata->params->defer = defer;
+	qdata->extra->deferred = true;
+
+	return defer;
+}
+
+_public_
+void *knotd_qdata_resumed(knotd_qdata_t *qdata)
+{
+	if (qdata == NULL || qdata->params->defer == NULL || qdata->extra->deferred ||
+	    qdata->extra->step != qdata->params->defer->step) {
+		return NULL;
+	}
+
+	qdata->extra->resumed_taken = true;
+
+	return qdata->params->defer->data;
+}
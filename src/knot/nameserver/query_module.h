@@ -70,13 +70,8 @@ typedef char* (*mod_idx_to_str_f)(uint32_t idx, uint32_t count);
 
 typedef struct {
 	const char *name;
-	union {
-		uint64_t counter;
-		struct {
-			uint64_t *counters;
-			mod_idx_to_str_f idx_to_str;
-		};
-	};
+	mod_idx_to_str_f idx_to_str; // unused if count == 1
+	uint32_t offset; // offset of the counter(s) in each stats_vals shard
 	uint32_t count;
 } mod_ctr_t;
 
@@ -88,9 +83,20 @@ struct knotd_mod {
 	struct query_plan *plan;
 	const knot_dname_t *zone;
 	const knotd_mod_api_t *api;
-	mod_ctr_t *stats;
+	mod_ctr_t *stats_info;
+	uint64_t **stats_vals; // per-thread counter shards + one shared (last)
 	uint32_t stats_count;
+	unsigned stats_threads;
 	void *ctx;
 };
 
 void knotd_mod_stats_free(knotd_mod_t *mod);
+
+/*!
+ * \brief Returns the value of a statistics counter summed over all thread shards.
+ *
+ * \param mod  Module context.
+ * \param ctr  Counter info.
+ * \param idx  Subcounter index (0 for single-counter).
+ */
+uint64_t mod_stats_get(knotd_mod_t *mod, mod_ctr_t *ctr, uint32_t idx);
@@ -108,6 +108,11 @@ static int process_bulk(zone_t *zone, list_t *requests, zone_update_t *up)
 	ptrnode_t *node = NULL;
 	WALK_LIST(node, *requests) {
 		struct knot_request *req = node->d;
+		if (knot_wire_get_rcode(req->resp->wire) != KNOT_RCODE_NOERROR) {
+			// Skip requests failed in the previous pass.
+			continue;
+		}
+
 		// Init qdata structure for logging (unique per-request).
 		knotd_qdata_params_t params = {
 			.remote = &req->remote
@@ -122,15 +127,31 @@ static int process_bulk(zone_t *zone, list_t *requests, zone_update_t *up)
 		int ret = check_prereqs(req, zone, up, &qdata);
 		if (ret != KNOT_EOK) {
 			// Skip updates with failed prereqs.
+			process_query_qname_case_restore(req->query, &qdata);
 			continue;
 		}
 
-		ret = process_single_update(req, zone, up, &qdata);
+		ret = zone_update_savepoint(up);
 		if (ret != KNOT_EOK) {
+			process_query_qname_case_restore(req->query, &qdata);
 			return ret;
 		}
 
+		ret = process_single_update(req, zone, up, &qdata);
 		process_query_qname_case_restore(req->query, &qdata);
+		if (ret != KNOT_EOK) {
+			// Drop the partially applied update, keep the others.
+			ret = zone_update_savepoint_rollback(up);
+		} else {
+			ret = zone_update_savepoint_release(up);
+			if (ret != KNOT_EOK) {
+				knot_wire_set_rcode(req->resp->wire, KNOT_RCODE_SERVFAIL);
+			}
+		}
+		if (ret != KNOT_EOK) {
+			// The update is in an unknown state, start over without it.
+			return KNOT_EAGAIN;
+		}
 	}
 
 	return KNOT_EOK;
@@ -140,18 +161,22 @@ static int process_normal(conf_t *conf, zone_t *zone, list_t *requests)
 {
 	assert(requests);
 
-	// Init zone update structure
+	// Process all updates into one zone update, without the failed ones.
 	zone_update_t up;
-	int ret = zone_update_init(&up, zone, UPDATE_INCREMENTAL | UPDATE_SIGN);
-	if (ret != KNOT_EOK) {
-		set_rcodes(requests, KNOT_RCODE_SERVFAIL);
-		return ret;
-	}
+	int ret = KNOT_EAGAIN;
+	while (ret == KNOT_EAGAIN) {
+		ret = zone_update_init(&up, zone, UPDATE_INCREMENTAL | UPDATE_SIGN);
+		if (ret != KNOT_EOK) {
+			set_rcodes(requests, KNOT_RCODE_SERVFAIL);
+			return ret;
+		}
 
-	// Process all updates.
-	ret = process_bulk(zone, requests, &up);
+		ret = process_bulk(zone, requests, &up);
+		if (ret != KNOT_EOK) {
+			zone_update_clear(&up);
+		}
+	}
 	if (ret != KNOT_EOK) {
-		zone_update_clear(&up);
 		set_rcodes(requests, KNOT_RCODE_SERVFAIL);
 		return ret;
 	}
@@ -441,8 +466,9 @@ int update_process_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 void updates_execute(conf_t *conf, zone_t *zone)
 {
 	/* Get list of pending updates. */
+	conf_val_t val = conf_zone_get(conf, C_DDNS_BATCH_SIZE, zone->name);
 	list_t updates;
-	size_t update_count = zone_update_dequeue(zone, &updates);
+	size_t update_count = zone_update_dequeue(zone, &updates, conf_int(&val));
 	if (update_count == 0) {
 		return;
 	}
@@ -14,9 +14,148 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "knot/nameserver/xfr.h"
 #include "contrib/mempattern.h"
 
+/*! \brief Header and question size of the answers. */
+static uint16_t answer_base_size(knotd_qdata_t *qdata)
+{
+	return KNOT_WIRE_HEADER_SIZE + knot_pkt_question_size(qdata->query);
+}
+
+/*! \brief Put the next pre-rendered message into the packet. */
+static int xfr_put_cached(knot_pkt_t *pkt, struct xfr_proc *xfer)
+{
+	const uint8_t *body = NULL;
+	uint16_t ancount = 0;
+	size_t size = xfr_stream_next(xfer->cached, &xfer->cached_pos, &body, &ancount);
+
+	/* Header and question are prepared already, checked in the lookup. */
+	if (size == 0 || pkt->size != xfer->cached->base_size ||
+	    pkt->size + size + pkt->reserved > pkt->max_size) {
+		return KNOT_ERROR;
+	}
+
+	memcpy(pkt->wire + pkt->size, body, size);
+	pkt->size += size;
+	knot_wire_set_ancount(pkt->wire, ancount);
+
+	xfr_stats_add(&xfer->stats, pkt->size);
+
+	return (xfer->cached_pos < xfer->cached->size) ? KNOT_ESPACE : KNOT_EOK;
+}
+
+/*! \brief Record the rendered message, store the complete transfer. */
+static void xfr_record(const knot_pkt_t *pkt, int ret, struct xfr_proc *xfer,
+                       xfr_cache_t *cache)
+{
+	bool last = (ret == KNOT_EOK);
+	if (ret == KNOT_EOK || ret == KNOT_ESPACE) {
+		ret = xfr_stream_append(xfer->record, pkt->wire, pkt->size,
+		                        xfr_cache_available(cache));
+	}
+	if (ret == KNOT_EOK && last) {
+		(void)xfr_cache_put(cache, xfer->record);
+	}
+
+	/* Finished, failed, or too large. */
+	if (ret != KNOT_EOK || last) {
+		xfr_cached_cleanup(xfer);
+	}
+}
+
+const xfr_stream_t *xfr_cached_find(knotd_qdata_t *qdata, uint16_t type,
+                                    uint32_t serial)
+{
+	if (qdata == NULL || qdata->extra->zone == NULL ||
+	    qdata->extra->zone->contents == NULL ||
+	    (qdata->params->flags & KNOTD_QUERY_FLAG_LIMIT_SIZE)) {
+		return NULL;
+	}
+
+	xfr_cache_t *cache = qdata->extra->zone->contents->xfr_cache;
+	const xfr_stream_t *cached = xfr_cache_get(cache, type, serial);
+	if (cached == NULL || cached->base_size != answer_base_size(qdata)) {
+		return NULL;
+	}
+
+	/* Check the space for the records of this client. */
+	size_t reserve = knot_tsig_wire_size(&qdata->sign.tsig_key);
+	if (!knot_rrset_empty(&qdata->opt_rr)) {
+		reserve += knot_edns_wire_size(&qdata->opt_rr);
+	}
+	if (cached->base_size + cached->max_body + reserve > KNOT_WIRE_MAX_PKTSIZE) {
+		return NULL;
+	}
+
+	return cached;
+}
+
+void xfr_cached_init(struct xfr_proc *xfer, knotd_qdata_t *qdata,
+                     const xfr_stream_t *cached, uint16_t type, uint32_t serial)
+{
+	if (xfer == NULL || qdata == NULL) {
+		return;
+	}
+
+	xfer->cached = cached;
+	xfer->cached_pos = 0;
+	xfer->record = NULL;
+	if (cached != NULL || (qdata->params->flags & KNOTD_QUERY_FLAG_LIMIT_SIZE)) {
+		return;
+	}
+
+	/* Record the transfer if it may fit into the cache. */
+	zone_contents_t *zone = qdata->extra->zone->contents;
+	if (xfr_cache_available(zone->xfr_cache) > 0) {
+		xfer->record = malloc(sizeof(*xfer->record));
+		if (xfer->record != NULL) {
+			xfr_stream_init(xfer->record, type, serial,
+			                answer_base_size(qdata));
+		}
+	}
+}
+
+void xfr_cached_cleanup(struct xfr_proc *xfer)
+{
+	if (xfer == NULL || xfer->record == NULL) {
+		return;
+	}
+
+	xfr_stream_clear(xfer->record);
+	free(xfer->record);
+	xfer->record = NULL;
+}
+
+void xfr_contents_init(struct xfr_proc *xfer, knotd_qdata_t *qdata)
+{
+	if (xfer == NULL || qdata == NULL) {
+		return;
+	}
+
+	xfer->contents = qdata->extra->zone->contents;
+	xfer->version = xfer->contents->version;
+}
+
+int xfr_contents_check(const struct xfr_proc *xfer, knotd_qdata_t *qdata)
+{
+	if (xfer == NULL || qdata == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	/* The zone is looked up again for each message. */
+	const zone_contents_t *contents = (qdata->extra->zone != NULL) ?
+	                                  qdata->extra->zone->contents : NULL;
+	if (contents != xfer->contents || contents->version != xfer->version) {
+		return KNOT_EAGAIN;
+	}
+
+	return KNOT_EOK;
+}
+
 int xfr_process_list(knot_pkt_t *pkt, xfr_put_cb put, knotd_qdata_t *qdata)
 {
 	if (pkt == NULL || qdata == NULL || qdata->extra->ext == NULL) {
@@ -27,9 +166,23 @@ int xfr_process_list(knot_pkt_t *pkt, xfr_put_cb put, knotd_qdata_t *qdata)
 	knot_mm_t *mm = qdata->mm;
 	struct xfr_proc *xfer = qdata->extra->ext;
 
+	if (xfer->cached != NULL) {
+		return xfr_put_cached(pkt, xfer);
+	}
+
 	zone_contents_t *zone = qdata->extra->zone->contents;
 	knot_rrset_t soa_rr = node_rrset(zone->apex, KNOT_RRTYPE_SOA);
 
+	/* Recorded messages must leave space for any client's OPT and TSIG. */
+	uint16_t record_reserve = 0;
+	if (xfer->record != NULL && pkt->reserved < XFR_CACHE_RESERVE) {
+		record_reserve = XFR_CACHE_RESERVE - pkt->reserved;
+		ret = knot_pkt_reserve(pkt, record_reserve);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
 	/* Prepend SOA on first packet. */
 	if (xfer->stats.messages == 0) {
 		ret = knot_pkt_put(pkt, 0, &soa_rr, KNOT_PF_NOTRUNC);
@@ -56,6 +209,11 @@ int xfr_process_list(knot_pkt_t *pkt, xfr_put_cb put, knotd_qdata_t *qdata)
 		ret = knot_pkt_put(pkt, 0, &soa_rr, KNOT_PF_NOTRUNC);
 	}
 
+	if (xfer->record != NULL) {
+		(void)knot_pkt_reclaim(pkt, record_reserve);
+		xfr_record(pkt, ret, xfer, zone->xfr_cache);
+	}
+
 	/* Update counters. */
 	xfr_stats_add(&xfer->stats, pkt->size);
 
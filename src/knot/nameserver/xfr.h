@@ -50,10 +50,30 @@ void xfr_log_finished(const knot_dname_t *zone, enum log_operation op,
  */
 struct xfr_proc {
 	list_t nodes;               //!< Items to process (ptrnode_t).
-	zone_contents_t *contents;  //!< Processed zone.
+	zone_contents_t *contents;  //!< Processed zone (not dereferenced between messages).
+	uint64_t version;           //!< Version of the processed zone.
 	struct xfr_stats stats;     //!< Packet transfer statistics.
+	const xfr_stream_t *cached; //!< Pre-rendered transfer being replayed.
+	size_t cached_pos;          //!< Position in the replayed transfer.
+	xfr_stream_t *record;       //!< Transfer being recorded for the cache.
 };
 
+/*!
+ * \brief Remember the zone contents being transferred.
+ *
+ * The RCU read lock is held only while producing a message, the transfer
+ * must be checked with xfr_contents_check() before producing the next one.
+ */
+void xfr_contents_init(struct xfr_proc *xfer, knotd_qdata_t *qdata);
+
+/*!
+ * \brief Check that the transferred zone contents haven't been replaced.
+ *
+ * \retval KNOT_EOK if the contents are still current.
+ * \retval KNOT_EAGAIN if the zone has changed since the transfer started.
+ */
+int xfr_contents_check(const struct xfr_proc *xfer, knotd_qdata_t *qdata);
+
 /*!
  * \brief Generic transfer processing.
  *
@@ -67,3 +87,34 @@ typedef int (*xfr_put_cb)(knot_pkt_t *pkt, const void *item, struct xfr_proc *xf
  * \note qdata->extra->ext points to struct xfr_proc* (this is xfer-specific context)
  */
 int xfr_process_list(knot_pkt_t *pkt, xfr_put_cb put, knotd_qdata_t *qdata);
+
+/*!
+ * \brief Find a cached transfer usable for the query.
+ *
+ * \param qdata   Query data.
+ * \param type    Transfer type (AXFR or IXFR).
+ * \param serial  Starting serial for IXFR.
+ *
+ * \return Cached transfer or NULL.
+ */
+const xfr_stream_t *xfr_cached_find(knotd_qdata_t *qdata, uint16_t type,
+                                    uint32_t serial);
+
+/*!
+ * \brief Set up replaying of the cached transfer or recording of a new one.
+ *
+ * If a cached transfer is given, the items in xfr_proc.nodes are ignored.
+ *
+ * \param xfer    Transfer processing state.
+ * \param qdata   Query data.
+ * \param cached  Cached transfer to be replayed (or NULL).
+ * \param type    Transfer type (AXFR or IXFR).
+ * \param serial  Starting serial for IXFR.
+ */
+void xfr_cached_init(struct xfr_proc *xfer, knotd_qdata_t *qdata,
+                     const xfr_stream_t *cached, uint16_t type, uint32_t serial);
+
+/*!
+ * \brief Drop the unfinished transfer recording.
+ */
+void xfr_cached_cleanup(struct xfr_proc *xfer);
@@ -15,13 +15,27 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/uio.h>
 
 #include "libknot/attribute.h"
 #include "knot/query/requestor.h"
 #include "libknot/errcode.h"
+#include "contrib/macros.h"
 #include "contrib/mempattern.h"
 #include "contrib/net.h"
 #include "contrib/sockaddr.h"
+#include "contrib/time.h"
+#include "contrib/wire.h"
+
+/*! \brief Pending I/O operation of a request. */
+enum {
+	REQUEST_IO_NONE = 0,
+	REQUEST_IO_SEND,
+	REQUEST_IO_RECV
+};
 
 static bool use_tcp(struct knot_request *request)
 {
@@ -51,59 +65,124 @@ static int request_ensure_connected(struct knot_request *request)
 	return KNOT_EOK;
 }
 
-static int request_send(struct knot_request *request, int timeout_ms)
+/*! \brief Check if the failed I/O operation should be retried later. */
+static bool io_should_wait(int error)
 {
-	/* Initiate non-blocking connect if not connected. */
-	int ret = request_ensure_connected(request);
-	if (ret != KNOT_EOK) {
-		return ret;
+	if (error == EAGAIN || error == EWOULDBLOCK || error == EINTR) {
+		return true;
 	}
 
-	/* Send query, construct if not exists. */
+#ifndef __linux__
+	/* FreeBSD: connection in progress */
+	if (error == ENOTCONN) {
+		return true;
+	}
+#endif
+
+	return false;
+}
+
+/*! \brief Prepare the I/O vector for the unprocessed part of a message. */
+static int request_iov(struct knot_request *request, uint8_t *wire,
+                       size_t wire_len, struct iovec iov[2])
+{
+	size_t done = request->io_done;
+	int iovcnt = 0;
+
+	if (use_tcp(request) && done < sizeof(request->io_len)) {
+		iov[iovcnt].iov_base = request->io_len + done;
+		iov[iovcnt].iov_len = sizeof(request->io_len) - done;
+		iovcnt += 1;
+		done = 0;
+	} else if (use_tcp(request)) {
+		done -= sizeof(request->io_len);
+	}
+
+	iov[iovcnt].iov_base = wire + done;
+	iov[iovcnt].iov_len = wire_len - done;
+	iovcnt += 1;
+
+	return iovcnt;
+}
+
+/*! \brief Send the query, returns KNOT_EAGAIN if the socket isn't ready. */
+static int request_send(struct knot_request *request)
+{
 	knot_pkt_t *query = request->query;
-	uint8_t *wire = query->wire;
-	size_t wire_len = query->size;
 
-	/* Send query. */
-	if (use_tcp(request)) {
-		ret = net_dns_tcp_send(request->fd, wire, wire_len, timeout_ms);
-	} else {
-		ret = net_dgram_send(request->fd, wire, wire_len, NULL);
+	struct iovec iov[2];
+	struct msghdr msg = {
+		.msg_iov = iov,
+		.msg_iovlen = request_iov(request, query->wire, query->size, iov)
+	};
+
+	ssize_t ret = sendmsg(request->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (ret < 0) {
+		return io_should_wait(errno) ? KNOT_EAGAIN : KNOT_ECONN;
 	}
-	if (ret != wire_len) {
-		return KNOT_ECONN;
+
+	request->io_done += ret;
+	size_t total = query->size + (use_tcp(request) ? sizeof(request->io_len) : 0);
+	if (request->io_done < total) {
+		return use_tcp(request) ? KNOT_EAGAIN : KNOT_ECONN;
 	}
 
+	request->io = REQUEST_IO_NONE;
 	return KNOT_EOK;
 }
 
-static int request_recv(struct knot_request *request, int timeout_ms)
+/*! \brief Receive a response, returns KNOT_EAGAIN if it's incomplete. */
+static int request_recv(struct knot_request *request)
 {
 	knot_pkt_t *resp = request->resp;
-	knot_pkt_clear(resp);
 
-	/* Wait for readability */
-	int ret = request_ensure_connected(request);
-	if (ret != KNOT_EOK) {
-		return ret;
+	/* Datagram is always complete. */
+	if (!use_tcp(request)) {
+		ssize_t ret = recv(request->fd, resp->wire, resp->max_size,
+		                   MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (ret <= 0) {
+			return (ret < 0 && io_should_wait(errno)) ? KNOT_EAGAIN : KNOT_ECONN;
+		}
+		resp->size = ret;
+		request->io = REQUEST_IO_NONE;
+		return KNOT_EOK;
 	}
 
-	/* Receive it */
-	if (use_tcp(request)) {
-		ret = net_dns_tcp_recv(request->fd, resp->wire, resp->max_size, timeout_ms);
-	} else {
-		ret = net_dgram_recv(request->fd, resp->wire, resp->max_size, timeout_ms);
+	/* Read the message length first, then the message. */
+	size_t msg_len = resp->max_size;
+	if (request->io_done >= sizeof(request->io_len)) {
+		msg_len = wire_read_u16(request->io_len);
+	}
+
+	struct iovec iov[2];
+	struct msghdr msg = {
+		.msg_iov = iov,
+		.msg_iovlen = request_iov(request, resp->wire, msg_len, iov)
+	};
+	if (request->io_done < sizeof(request->io_len)) {
+		msg.msg_iovlen = 1;
 	}
+
+	ssize_t ret = recvmsg(request->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
 	if (ret <= 0) {
-		resp->size = 0;
-		if (ret == 0) {
-			return KNOT_ECONN;
-		}
-		return ret;
+		return (ret < 0 && io_should_wait(errno)) ? KNOT_EAGAIN : KNOT_ECONN;
 	}
+	request->io_done += ret;
 
-	resp->size = ret;
-	return ret;
+	if (request->io_done < sizeof(request->io_len)) {
+		return KNOT_EAGAIN;
+	}
+	msg_len = wire_read_u16(request->io_len);
+	if (msg_len > resp->max_size) {
+		return KNOT_ESPACE;
+	}
+	if (request->io_done < sizeof(request->io_len) + msg_len) {
+		return KNOT_EAGAIN;
+	}
+
+	resp->size = msg_len;
+	request->io = REQUEST_IO_NONE;
+	return KNOT_EOK;
 }
 
 struct knot_request *knot_request_make(knot_mm_t *mm,
@@ -131,6 +210,7 @@ struct knot_request *knot_request_make(knot_mm_t *mm,
 
 	request->query = query;
 	request->fd = -1;
+	request->io = REQUEST_IO_NONE;
 	request->flags = flags;
 	memcpy(&request->remote, remote, sockaddr_len(remote));
 	if (source) {
@@ -213,8 +293,7 @@ static int request_reset(struct knot_requestor *req,
 }
 
 static int request_produce(struct knot_requestor *req,
-                           struct knot_request *last,
-                           int timeout_ms)
+                           struct knot_request *last)
 {
 	knot_layer_produce(&req->layer, last->query);
 
@@ -225,22 +304,24 @@ static int request_produce(struct knot_requestor *req,
 
 	// TODO: verify condition
 	if (req->layer.state == KNOT_STATE_CONSUME) {
-		ret = request_send(last, timeout_ms);
+		/* Initiate non-blocking connect if not connected. */
+		ret = request_ensure_connected(last);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+
+		last->io = REQUEST_IO_SEND;
+		last->io_done = 0;
+		wire_write_u16(last->io_len, last->query->size);
 	}
 
 	return ret;
 }
 
 static int request_consume(struct knot_requestor *req,
-                           struct knot_request *last,
-                           int timeout_ms)
+                           struct knot_request *last)
 {
-	int ret = request_recv(last, timeout_ms);
-	if (ret < 0) {
-		return ret;
-	}
-
-	ret = knot_pkt_parse(last->resp, 0);
+	int ret = knot_pkt_parse(last->resp, 0);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -275,42 +356,76 @@ static bool layer_active(knot_layer_state_t state)
 	}
 }
 
-static int request_io(struct knot_requestor *req, struct knot_request *last,
-                      int timeout_ms)
+/*!
+ * \brief Drive the processing until it waits for I/O or ends.
+ *
+ * \retval KNOT_EAGAIN if waiting for I/O.
+ * \retval KNOT_EOK if the processing ended.
+ * \retval error on failure.
+ */
+static int request_advance(struct knot_requestor *req, struct knot_request *last)
 {
-	switch (req->layer.state) {
-	case KNOT_STATE_CONSUME:
-		return request_consume(req, last, timeout_ms);
-	case KNOT_STATE_PRODUCE:
-		return request_produce(req, last, timeout_ms);
-	case KNOT_STATE_RESET:
-		return request_reset(req, last);
-	default:
-		return KNOT_EINVAL;
-	}
-}
+	int ret = KNOT_EOK;
 
-int knot_requestor_exec(struct knot_requestor *requestor,
-                        struct knot_request *request,
-                        int timeout_ms)
-{
-	if (!requestor || !request) {
-		return KNOT_EINVAL;
-	}
+	while (ret == KNOT_EOK && layer_active(req->layer.state)) {
+		switch (last->io) {
+		case REQUEST_IO_SEND:
+			return KNOT_EAGAIN;
+		case REQUEST_IO_RECV:
+			ret = request_recv(last);
+			if (ret == KNOT_EOK) {
+				ret = request_consume(req, last);
+			}
+			continue;
+		default:
+			break;
+		}
 
-	int ret = KNOT_EOK;
+		switch (req->layer.state) {
+		case KNOT_STATE_CONSUME:
+			ret = request_ensure_connected(last);
+			knot_pkt_clear(last->resp);
+			last->io = REQUEST_IO_RECV;
+			last->io_done = 0;
+			break;
+		case KNOT_STATE_PRODUCE:
+			ret = request_produce(req, last);
+			break;
+		case KNOT_STATE_RESET:
+			ret = request_reset(req, last);
+			break;
+		default:
+			ret = KNOT_EINVAL;
+			break;
+		}
+	}
 
-	requestor->layer.tsig = &request->tsig;
+	return ret;
+}
 
-	/* Do I/O until the processing is satisifed or fails. */
-	while (layer_active(requestor->layer.state)) {
-		ret = request_io(requestor, request, timeout_ms);
+/*! \brief Process ready socket events. */
+static int request_io(struct knot_requestor *req, struct knot_request *last,
+                      short revents)
+{
+	if (last->io == REQUEST_IO_SEND && (revents & (POLLOUT | POLLERR | POLLHUP))) {
+		int ret = request_send(last);
 		if (ret != KNOT_EOK) {
-			knot_layer_finish(&requestor->layer);
 			return ret;
 		}
 	}
 
+	return request_advance(req, last);
+}
+
+/*! \brief Finish the request processing, evaluate the result. */
+static int request_finish(struct knot_requestor *requestor,
+                          struct knot_request *request, int ret)
+{
+	if (ret != KNOT_EOK) {
+		knot_layer_finish(&requestor->layer);
+		return ret;
+	}
+
 	/* Expect complete request. */
 	if (requestor->layer.state != KNOT_STATE_DONE) {
 		ret = KNOT_LAYER_ERROR;
@@ -326,3 +441,114 @@ int knot_requestor_exec(struct knot_requestor *requestor,
 
 	return ret;
 }
+
+static int64_t time_ms(const struct timespec *ts)
+{
+	return (int64_t)ts->tv_sec * 1000 + ts->tv_nsec / 1000000;
+}
+
+int knot_requestor_exec_multi(struct knot_requestor *requestors,
+                              struct knot_request **requests,
+                              int *results, size_t count,
+                              int timeout_ms)
+{
+	if (requestors == NULL || requests == NULL || results == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	struct pollfd *pfd = malloc(count * sizeof(*pfd));
+	size_t *pending = malloc(count * sizeof(*pending));
+	int64_t *deadline = malloc(count * sizeof(*deadline));
+	if (count > 0 && (pfd == NULL || pending == NULL || deadline == NULL)) {
+		free(pfd);
+		free(pending);
+		free(deadline);
+		return KNOT_ENOMEM;
+	}
+
+	/* Start all the requests. */
+	struct timespec now_ts = time_now();
+	int64_t now = time_ms(&now_ts);
+	size_t npending = 0;
+	for (size_t i = 0; i < count; ++i) {
+		requestors[i].layer.tsig = &requests[i]->tsig;
+		results[i] = request_advance(&requestors[i], requests[i]);
+		if (results[i] == KNOT_EAGAIN) {
+			pending[npending++] = i;
+			deadline[i] = now + timeout_ms;
+		} else {
+			results[i] = request_finish(&requestors[i], requests[i], results[i]);
+		}
+	}
+
+	/* Multiplex the I/O until every request ends. */
+	while (npending > 0) {
+		int64_t wait_until = -1;
+		for (size_t j = 0; j < npending; ++j) {
+			size_t i = pending[j];
+			pfd[j].fd = requests[i]->fd;
+			pfd[j].events = (requests[i]->io == REQUEST_IO_SEND) ? POLLOUT : POLLIN;
+			pfd[j].revents = 0;
+			if (timeout_ms >= 0 && (wait_until < 0 || deadline[i] < wait_until)) {
+				wait_until = deadline[i];
+			}
+		}
+
+		int wait_ms = (wait_until < 0) ? -1 : MAX(wait_until - now, 0);
+		int ret = poll(pfd, npending, wait_ms);
+		if (ret < 0 && errno != EINTR) {
+			ret = KNOT_ECONN;
+			for (size_t j = 0; j < npending; ++j) {
+				size_t i = pending[j];
+				results[i] = request_finish(&requestors[i], requests[i], ret);
+			}
+			break;
+		}
+
+		now_ts = time_now();
+		now = time_ms(&now_ts);
+
+		size_t kept = 0;
+		for (size_t j = 0; j < npending; ++j) {
+			size_t i = pending[j];
+			if (pfd[j].revents != 0) {
+				results[i] = request_io(&requestors[i], requests[i],
+				                        pfd[j].revents);
+				deadline[i] = now + timeout_ms;
+			} else if (timeout_ms >= 0 && deadline[i] <= now) {
+				results[i] = KNOT_ETIMEOUT;
+			}
+
+			if (results[i] == KNOT_EAGAIN) {
+				pending[kept++] = i;
+			} else {
+				results[i] = request_finish(&requestors[i], requests[i],
+				                            results[i]);
+			}
+		}
+		npending = kept;
+	}
+
+	free(pfd);
+	free(pending);
+	free(deadline);
+
+	return KNOT_EOK;
+}
+
+int knot_requestor_exec(struct knot_requestor *requestor,
+                        struct knot_request *request,
+                        int timeout_ms)
+{
+	if (!requestor || !request) {
+		return KNOT_EINVAL;
+	}
+
+	int result = KNOT_EOK;
+	int ret = knot_requestor_exec_multi(requestor, &request, &result, 1, timeout_ms);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	return result;
+}
@@ -55,6 +55,11 @@ struct knot_request {
 
 	knot_sign_context_t sign; /* TODO: Remove. Used in updates only, should
 	                             be part of the zone update context. */
+
+	/* Non-blocking I/O progress. */
+	int io;                   /* Pending I/O operation. */
+	size_t io_done;           /* Processed bytes including TCP length. */
+	uint8_t io_len[2];        /* TCP message length. */
 };
 
 /*!
@@ -108,6 +113,9 @@ void knot_requestor_clear(struct knot_requestor *requestor);
 /*!
  * \brief Execute a request.
  *
+ * \note The socket I/O is non-blocking, but the calling thread waits until
+ *       the request is finished or timed out.
+ *
  * \param requestor  Requestor instance.
  * \param request    Request instance.
  * \param timeout_ms Timeout of each operation in miliseconds (-1 for infinity).
@@ -117,3 +125,22 @@ void knot_requestor_clear(struct knot_requestor *requestor);
 int knot_requestor_exec(struct knot_requestor *requestor,
                         struct knot_request *request,
                         int timeout_ms);
+
+/*!
+ * \brief Execute multiple requests concurrently.
+ *
+ * All the requests are processed with non-blocking I/O multiplexed in one
+ * event loop, each requestor layer is driven as its socket becomes ready.
+ *
+ * \param requestors  Requestor instances (one per request).
+ * \param requests    Request instances.
+ * \param results     Output results of the requests (as from exec).
+ * \param count       Number of requests.
+ * \param timeout_ms  Timeout of each operation in miliseconds (-1 for infinity).
+ *
+ * \return KNOT_EOK if all requests were processed, or error
+ */
+int knot_requestor_exec_multi(struct knot_requestor *requestors,
+                              struct knot_request **requests,
+                              int *results, size_t count,
+                              int timeout_ms);
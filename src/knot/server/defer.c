@@ -0,0 +1,179 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "libknot/attribute.h"
+#include "knot/server/defer.h"
+
+static void queue_destroy(defer_queue_t *queue)
+{
+	close(queue->wake[0]);
+	close(queue->wake[1]);
+	pthread_mutex_destroy(&queue->lock);
+	free(queue);
+}
+
+static void defer_release(knotd_defer_t *defer)
+{
+	free(defer->data);
+	free(defer);
+}
+
+defer_queue_t *defer_queue_new(void)
+{
+	defer_queue_t *queue = calloc(1, sizeof(*queue));
+	if (queue == NULL) {
+		return NULL;
+	}
+
+	if (pipe(queue->wake) != 0) {
+		free(queue);
+		return NULL;
+	}
+	for (int i = 0; i < 2; i++) {
+		(void)fcntl(queue->wake[i], F_SETFL, O_NONBLOCK);
+		(void)fcntl(queue->wake[i], F_SETFD, FD_CLOEXEC);
+	}
+
+	pthread_mutex_init(&queue->lock, NULL);
+	init_list(&queue->resumed);
+
+	return queue;
+}
+
+void defer_queue_free(defer_queue_t *queue)
+{
+	if (queue == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&queue->lock);
+	queue->closed = true;
+	knotd_defer_t *defer = NULL, *next = NULL;
+	WALK_LIST_DELSAFE(defer, next, queue->resumed) {
+		defer_release(defer);
+	}
+	init_list(&queue->resumed);
+	bool unused = (queue->pending == 0);
+	pthread_mutex_unlock(&queue->lock);
+
+	/* Otherwise the last resumed query frees it. */
+	if (unused) {
+		queue_destroy(queue);
+	}
+}
+
+int defer_queue_fd(const defer_queue_t *queue)
+{
+	return queue->wake[0];
+}
+
+knotd_defer_t *defer_queue_pop(defer_queue_t *queue)
+{
+	knotd_defer_t *defer = NULL;
+
+	pthread_mutex_lock(&queue->lock);
+	if (EMPTY_LIST(queue->resumed)) {
+		/* Writers signal under the lock, nothing can be missed. */
+		char drain[64];
+		while (read(queue->wake[0], drain, sizeof(drain)) > 0);
+	} else {
+		defer = HEAD(queue->resumed);
+		rem_node(&defer->n);
+		defer->resumed = false;
+	}
+	pthread_mutex_unlock(&queue->lock);
+
+	return defer;
+}
+
+knotd_defer_t *defer_new(defer_queue_t *queue, size_t query_len)
+{
+	knotd_defer_t *defer = calloc(1, sizeof(*defer) + query_len);
+	if (defer == NULL) {
+		return NULL;
+	}
+	defer->queue = queue;
+	defer->query_len = query_len;
+
+	pthread_mutex_lock(&queue->lock);
+	queue->pending += 1;
+	pthread_mutex_unlock(&queue->lock);
+
+	return defer;
+}
+
+void defer_cancel(knotd_defer_t *defer)
+{
+	defer_queue_t *queue = defer->queue;
+
+	pthread_mutex_lock(&queue->lock);
+	bool resumed = defer->resumed;
+	if (resumed) {
+		rem_node(&defer->n);
+	} else {
+		defer->cancelled = true; /* Freed when resumed. */
+	}
+	pthread_mutex_unlock(&queue->lock);
+
+	if (resumed) {
+		defer_release(defer);
+	}
+}
+
+void defer_free(knotd_defer_t *defer)
+{
+	if (defer != NULL) {
+		defer_release(defer);
+	}
+}
+
+_public_
+void knotd_defer_resume(knotd_defer_t *defer, void *data)
+{
+	if (defer == NULL) {
+		free(data);
+		return;
+	}
+
+	defer_queue_t *queue = defer->queue;
+
+	pthread_mutex_lock(&queue->lock);
+	queue->pending -= 1;
+	if (defer->cancelled || queue->closed) {
+		bool unused = (queue->closed && queue->pending == 0);
+		pthread_mutex_unlock(&queue->lock);
+
+		free(data);
+		free(defer);
+		if (unused) {
+			queue_destroy(queue);
+		}
+		return;
+	}
+
+	defer->data = data;
+	defer->resumed = true;
+	if (EMPTY_LIST(queue->resumed)) {
+		const uint8_t byte = 0;
+		(void)write(queue->wake[1], &byte, sizeof(byte));
+	}
+	add_tail(&queue->resumed, &defer->n);
+	pthread_mutex_unlock(&queue->lock);
+}
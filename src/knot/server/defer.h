@@ -0,0 +1,106 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \brief Queries deferred by modules (see knotd_qdata_defer()).
+ *
+ * Each I/O thread owns a queue. A module resumes a deferred query from any
+ * thread, the query is put into the queue and the owner is woken up via the
+ * queue descriptor, to process the query again and send the answer.
+ *
+ * \addtogroup server
+ * @{
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "knot/include/module.h"
+#include "contrib/ucw/lists.h"
+
+/*! \brief Deferred query. */
+struct knotd_defer {
+	node_t n;                  /*!< Node in the queue of resumed queries. */
+	struct defer_queue *queue; /*!< Queue of the owning I/O thread. */
+	const void *step;          /*!< Processing step which deferred the query. */
+	void *owner;               /*!< I/O handler context of the query. */
+	void *data;                /*!< Result for the deferring step. */
+	bool resumed;              /*!< Waiting in the queue. */
+	bool cancelled;            /*!< Dropped by the owner before resumed. */
+	size_t query_len;          /*!< Original query message length. */
+	uint8_t query[];           /*!< Original query message. */
+};
+
+/*! \brief Queue of resumed queries of one I/O thread. */
+typedef struct defer_queue {
+	pthread_mutex_t lock; /*!< Protects everything below. */
+	int wake[2];          /*!< Pipe signalling non-empty queue. */
+	list_t resumed;       /*!< Resumed queries. */
+	size_t pending;       /*!< Deferred queries not resumed yet. */
+	bool closed;          /*!< The owner is gone. */
+} defer_queue_t;
+
+/*!
+ * \brief Creates an empty queue.
+ *
+ * \return New queue or NULL on error.
+ */
+defer_queue_t *defer_queue_new(void);
+
+/*!
+ * \brief Releases the queue by its owner.
+ *
+ * Resumed queries are discarded, the queue itself is freed once all
+ * pending queries are resumed.
+ */
+void defer_queue_free(defer_queue_t *queue);
+
+/*!
+ * \brief Returns the descriptor readable when a query was resumed.
+ */
+int defer_queue_fd(const defer_queue_t *queue);
+
+/*!
+ * \brief Takes the next resumed query, NULL if none (resets the descriptor).
+ *
+ * The taken query must be released with defer_free().
+ */
+knotd_defer_t *defer_queue_pop(defer_queue_t *queue);
+
+/*!
+ * \brief Creates a deferred query of the queue owner.
+ *
+ * \param queue      Queue of the owning I/O thread.
+ * \param query_len  Space for the original query.
+ *
+ * \return New deferred query or NULL on error.
+ */
+knotd_defer_t *defer_new(defer_queue_t *queue, size_t query_len);
+
+/*!
+ * \brief Drops the query by its owner before it's taken from the queue.
+ */
+void defer_cancel(knotd_defer_t *defer);
+
+/*!
+ * \brief Releases a query taken from the queue.
+ */
+void defer_free(knotd_defer_t *defer);
+
+/*! @} */
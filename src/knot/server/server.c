@@ -28,6 +28,7 @@
 #include "knot/conf/confio.h"
 #include "knot/conf/migration.h"
 #include "knot/conf/module.h"
+#include "knot/conf/snapshot.h"
 #include "knot/server/server.h"
 #include "knot/server/udp-handler.h"
 #include "knot/server/tcp-handler.h"
@@ -419,8 +420,10 @@ int server_init(server_t *server, int bg_workers)
 	char *journal_dir = conf_journalfile(conf());
 	conf_val_t journal_size = conf_default_get(conf(), C_MAX_JOURNAL_DB_SIZE);
 	conf_val_t journal_mode = conf_default_get(conf(), C_JOURNAL_DB_MODE);
+	conf_val_t journal_shards = conf_default_get(conf(), C_JOURNAL_DB_SHARDS);
 	int ret = journal_db_init(&server->journal_db, journal_dir,
-	                          conf_int(&journal_size), conf_opt(&journal_mode));
+	                          conf_int(&journal_size), conf_opt(&journal_mode),
+	                          conf_int(&journal_shards));
 	free(journal_dir);
 	if (ret != KNOT_EOK) {
 		worker_pool_destroy(server->workers);
@@ -661,6 +664,13 @@ int server_reload(server_t *server)
 		                      &new_conf->query_plan);
 	}
 
+	/* Compile per-zone configuration for query processing. */
+	ret = conf_snapshot_build(new_conf);
+	if (ret != KNOT_EOK) {
+		log_warning("failed to compile zone configuration (%s)",
+		            knot_strerror(ret));
+	}
+
 	conf_update_flag_t upd_flags = CONF_UPD_FNOFREE;
 	if (full) {
 		upd_flags |= CONF_UPD_FCONFIO;
@@ -756,12 +766,15 @@ static int reconfigure_journal_db(conf_t *conf, server_t *server)
 	char *journal_dir = conf_journalfile(conf);
 	conf_val_t journal_size = conf_default_get(conf, C_MAX_JOURNAL_DB_SIZE);
 	conf_val_t journal_mode = conf_default_get(conf, C_JOURNAL_DB_MODE);
+	conf_val_t journal_shards = conf_default_get(conf, C_JOURNAL_DB_SHARDS);
+	unsigned shards = conf_int(&journal_shards);
 	bool changed_path = (strcmp(journal_dir, server->journal_db->path) != 0);
 	bool changed_size = (conf_int(&journal_size) != server->journal_db->fslimit);
 	bool changed_mode = (conf_opt(&journal_mode) != server->journal_db->mode);
+	bool changed_shards = ((shards > 1 ? shards : 0) != server->journal_db->shard_count);
 	int ret = KNOT_EOK;
 
-	if (server->journal_db->db != NULL) {
+	if (journal_db_is_open(server->journal_db)) {
 		if (changed_path) {
 			log_warning("ignored reconfiguration of journal DB path (already open)");
 		}
@@ -771,10 +784,13 @@ static int reconfigure_journal_db(conf_t *conf, server_t *server)
 		if (changed_mode) {
 			log_warning("ignored reconfiguration of journal DB mode (already open)");
 		}
-	} else if (changed_path || changed_size || changed_mode) {
+		if (changed_shards) {
+			log_warning("ignored reconfiguration of journal DB shards (already open)");
+		}
+	} else if (changed_path || changed_size || changed_mode || changed_shards) {
 		journal_db_t *newjdb = NULL;
 		ret = journal_db_init(&newjdb, journal_dir, conf_int(&journal_size),
-		                      conf_opt(&journal_mode));
+		                      conf_opt(&journal_mode), shards);
 		if (ret == KNOT_EOK) {
 			journal_db_close(&server->journal_db);
 			server->journal_db = newjdb;
@@ -14,6 +14,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
@@ -28,8 +29,12 @@
 #ifdef HAVE_SYS_UIO_H			// struct iovec (OpenBSD)
 #include <sys/uio.h>
 #endif // HAVE_SYS_UIO_H
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif // HAVE_SYS_EPOLL_H
 
 #include "dnssec/random.h"
+#include "knot/server/defer.h"
 #include "knot/server/server.h"
 #include "knot/server/tcp-handler.h"
 #include "knot/common/fdset.h"
@@ -41,17 +46,74 @@
 #include "contrib/net.h"
 #include "contrib/sockaddr.h"
 #include "contrib/time.h"
+#include "contrib/wire.h"
+#include "contrib/ucw/lists.h"
 #include "contrib/ucw/mempool.h"
 
+/*! \brief Size of a buffer holding any length-prefixed DNS message. */
+#define TCP_BUFFER_SIZE (sizeof(uint16_t) + KNOT_WIRE_MAX_PKTSIZE)
+
+/*! \brief Queued output size limit for producing more transfer messages. */
+#define TCP_TX_WATERMARK (4 * TCP_BUFFER_SIZE)
+
+/*! \brief Maximum number of events processed in one loop iteration. */
+#define TCP_EVENTS_MAX 256
+
+/*! \brief Multi-message answer (zone transfer) suspended between writes. */
+typedef struct tcp_xfr {
+	knot_mm_t mm;                    /*!< Transfer memory context. */
+	knot_layer_t layer;              /*!< Transfer processing layer. */
+	knotd_qdata_params_t params;     /*!< Query processing parameters. */
+	knot_pkt_t *query;               /*!< Transfer query. */
+	knot_pkt_t *ans;                 /*!< Response message buffer. */
+} tcp_xfr_t;
+
+/*! \brief TCP endpoint: a listening socket or a client connection. */
+typedef struct tcp_conn {
+	node_t n;                        /*!< Node in the list of clients. */
+	int fd;                          /*!< Socket. */
+	bool listener;                   /*!< Listening (master) socket. */
+	unsigned events;                 /*!< Watched events (POLLIN, POLLOUT). */
+	time_t timeout;                  /*!< Watchdog deadline (seconds). */
+	struct sockaddr_storage remote;  /*!< Client address. */
+	uint8_t *rx;                     /*!< Incomplete input (TCP_BUFFER_SIZE). */
+	size_t rx_len;                   /*!< Incomplete input length. */
+	uint8_t *tx;                     /*!< Queued output. */
+	size_t tx_len;                   /*!< Queued output length. */
+	size_t tx_sent;                  /*!< Already sent part of queued output. */
+	size_t tx_size;                  /*!< Queued output buffer size. */
+	tcp_xfr_t *xfr;                  /*!< Suspended transfer if any. */
+	knotd_defer_t *defer;            /*!< Query deferred by a module if any. */
+} tcp_conn_t;
+
+/*! \brief Ready TCP endpoint. */
+typedef struct {
+	tcp_conn_t *conn;                /*!< Endpoint. */
+	unsigned events;                 /*!< Ready events (POLLIN, POLLOUT, ...). */
+} tcp_event_t;
+
 /*! \brief TCP context data. */
 typedef struct tcp_context {
 	knot_layer_t layer;              /*!< Query processing layer. */
 	server_t *server;                /*!< Name server structure. */
-	struct iovec iov[2];             /*!< TX/RX buffers. */
-	unsigned client_threshold;       /*!< Index of first TCP client. */
+	struct iovec iov[2];             /*!< RX/TX buffers. */
 	struct timespec last_poll_time;  /*!< Time of the last socket poll. */
 	struct timespec throttle_end;    /*!< End of accept() throttling. */
-	fdset_t set;                     /*!< Set of server/client sockets. */
+	fdset_t set;                     /*!< Set of server sockets. */
+	tcp_conn_t *listeners;           /*!< Server socket endpoints. */
+	bool accepting;                  /*!< Server sockets are watched. */
+	list_t clients;                  /*!< Client connections. */
+	unsigned client_count;           /*!< Number of client connections. */
+	defer_queue_t *defers;           /*!< Resumed deferred queries. */
+	tcp_conn_t resumer;              /*!< Endpoint of the resumed queries. */
+	tcp_event_t events[TCP_EVENTS_MAX]; /*!< Ready endpoints. */
+#ifdef HAVE_SYS_EPOLL_H
+	int epfd;                        /*!< Epoll instance. */
+#else
+	struct pollfd *pfd;              /*!< Poll state (rebuilt for each poll). */
+	tcp_conn_t **pfd_conn;           /*!< Endpoints matching the poll state. */
+	unsigned pfd_size;               /*!< Size of the poll state arrays. */
+#endif
 	unsigned thread_id;              /*!< Thread identifier. */
 } tcp_context_t;
 
@@ -66,27 +128,148 @@ static inline int tcp_throttle(void) {
 	return TCP_THROTTLE_LO + (dnssec_random_uint16_t() % TCP_THROTTLE_HI);
 }
 
-/*! \brief Sweep TCP connection. */
-static enum fdset_sweep_state tcp_sweep(fdset_t *set, int i, void *data)
+#ifdef HAVE_SYS_EPOLL_H
+
+static int tcp_events_init(tcp_context_t *tcp)
 {
-	UNUSED(data);
-	assert(set && i < set->n && i >= 0);
-	int fd = set->pfd[i].fd;
+	tcp->epfd = epoll_create1(EPOLL_CLOEXEC);
+	return (tcp->epfd < 0) ? knot_map_errno() : KNOT_EOK;
+}
 
-	/* Best-effort, name and shame. */
-	struct sockaddr_storage ss;
-	socklen_t len = sizeof(struct sockaddr_storage);
-	if (getpeername(fd, (struct sockaddr*)&ss, &len) == 0) {
-		char addr_str[SOCKADDR_STRLEN] = {0};
-		sockaddr_tostr(addr_str, sizeof(addr_str), (struct sockaddr *)&ss);
-		log_notice("TCP, terminated inactive client, address %s", addr_str);
+static void tcp_events_deinit(tcp_context_t *tcp)
+{
+	if (tcp->epfd >= 0) {
+		close(tcp->epfd);
+	}
+}
+
+/*! \brief Start, change, or stop (events == 0) watching an endpoint. */
+static int tcp_watch(tcp_context_t *tcp, tcp_conn_t *conn, unsigned events)
+{
+	if (conn->events == events) {
+		return KNOT_EOK;
+	}
+
+	struct epoll_event ev = {
+		.events = ((events & POLLIN) ? EPOLLIN : 0) |
+		          ((events & POLLOUT) ? EPOLLOUT : 0),
+		.data.ptr = conn
+	};
+
+	int op = (conn->events == 0) ? EPOLL_CTL_ADD :
+	         (events == 0) ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
+	if (epoll_ctl(tcp->epfd, op, conn->fd, &ev) != 0) {
+		return knot_map_errno();
+	}
+
+	conn->events = events;
+	return KNOT_EOK;
+}
+
+/*! \brief Wait for ready endpoints, returns their count. */
+static int tcp_wait(tcp_context_t *tcp, int timeout_ms)
+{
+	struct epoll_event ev[TCP_EVENTS_MAX];
+	int nfds = epoll_wait(tcp->epfd, ev, TCP_EVENTS_MAX, timeout_ms);
+	for (int i = 0; i < nfds; ++i) {
+		tcp->events[i].conn = ev[i].data.ptr;
+		tcp->events[i].events =
+			((ev[i].events & EPOLLIN) ? POLLIN : 0) |
+			((ev[i].events & EPOLLOUT) ? POLLOUT : 0) |
+			((ev[i].events & EPOLLERR) ? POLLERR : 0) |
+			((ev[i].events & EPOLLHUP) ? POLLHUP : 0);
 	}
 
-	close(fd);
+	return nfds;
+}
+
+#else
+
+static int tcp_events_init(tcp_context_t *tcp)
+{
+	UNUSED(tcp);
+	return KNOT_EOK;
+}
 
-	return FDSET_SWEEP;
+static void tcp_events_deinit(tcp_context_t *tcp)
+{
+	free(tcp->pfd);
+	free(tcp->pfd_conn);
 }
 
+/*! \brief Start, change, or stop (events == 0) watching an endpoint. */
+static int tcp_watch(tcp_context_t *tcp, tcp_conn_t *conn, unsigned events)
+{
+	UNUSED(tcp);
+	conn->events = events;
+	return KNOT_EOK;
+}
+
+static int tcp_poll_add(tcp_context_t *tcp, unsigned *n, tcp_conn_t *conn)
+{
+	if (conn->events == 0) {
+		return KNOT_EOK;
+	}
+
+	if (*n == tcp->pfd_size) {
+		unsigned size = tcp->pfd_size + FDSET_INIT_SIZE;
+		struct pollfd *pfd = realloc(tcp->pfd, size * sizeof(*pfd));
+		if (pfd == NULL) {
+			return KNOT_ENOMEM;
+		}
+		tcp->pfd = pfd;
+		tcp_conn_t **pfd_conn = realloc(tcp->pfd_conn, size * sizeof(*pfd_conn));
+		if (pfd_conn == NULL) {
+			return KNOT_ENOMEM;
+		}
+		tcp->pfd_conn = pfd_conn;
+		tcp->pfd_size = size;
+	}
+
+	tcp->pfd[*n].fd = conn->fd;
+	tcp->pfd[*n].events = conn->events;
+	tcp->pfd[*n].revents = 0;
+	tcp->pfd_conn[*n] = conn;
+	*n += 1;
+
+	return KNOT_EOK;
+}
+
+/*! \brief Wait for ready endpoints, returns their count. */
+static int tcp_wait(tcp_context_t *tcp, int timeout_ms)
+{
+	unsigned n = 0;
+	for (unsigned i = 0; i < tcp->set.n; ++i) {
+		if (tcp_poll_add(tcp, &n, &tcp->listeners[i]) != KNOT_EOK) {
+			return -1;
+		}
+	}
+	if (tcp_poll_add(tcp, &n, &tcp->resumer) != KNOT_EOK) {
+		return -1;
+	}
+	tcp_conn_t *conn = NULL;
+	WALK_LIST(conn, tcp->clients) {
+		if (tcp_poll_add(tcp, &n, conn) != KNOT_EOK) {
+			return -1;
+		}
+	}
+
+	int nfds = poll(tcp->pfd, n, timeout_ms);
+
+	int ready = 0;
+	for (unsigned i = 0; i < n && ready < nfds && ready < TCP_EVENTS_MAX; ++i) {
+		if (tcp->pfd[i].revents != 0) {
+			tcp->events[ready].conn = tcp->pfd_conn[i];
+			tcp->events[ready].events = tcp->pfd[i].revents;
+			++ready;
+		}
+	}
+
+	return (nfds < 0) ? nfds : ready;
+}
+
+#endif // HAVE_SYS_EPOLL_H
+
 static bool tcp_active_state(int state)
 {
 	return (state == KNOT_STATE_PRODUCE || state == KNOT_STATE_FAIL);
@@ -97,68 +280,253 @@ static bool tcp_send_state(int state)
 	return (state != KNOT_STATE_FAIL && state != KNOT_STATE_NOOP);
 }
 
-/*!
- * \brief TCP event handler function.
- */
-static int tcp_handle(tcp_context_t *tcp, int fd,
-                      struct iovec *rx, struct iovec *tx)
+/*! \brief Check if the client waits for our output. */
+static bool tcp_conn_busy(const tcp_conn_t *conn)
 {
-	/* Create query processing parameter. */
-	struct sockaddr_storage ss = { 0 };
-	knotd_qdata_params_t params = {
-		.remote = &ss,
-		.socket = fd,
-		.server = tcp->server,
-		.thread_id = tcp->thread_id
+	return conn->tx_sent < conn->tx_len || conn->xfr != NULL ||
+	       conn->defer != NULL;
+}
+
+/*! \brief Update the connection watchdog and the watched events. */
+static int tcp_conn_update(tcp_context_t *tcp, tcp_conn_t *conn)
+{
+	bool busy = tcp_conn_busy(conn);
+
+	/* Pending message (either way) must make progress in time. */
+	rcu_read_lock();
+	int timeout = (busy || conn->rx_len > 0) ?
+	              conf()->cache.srv_tcp_reply_timeout :
+	              conf()->cache.srv_tcp_idle_timeout;
+	rcu_read_unlock();
+	conn->timeout = time_now().tv_sec + timeout;
+
+	/* Don't read more queries until the answers are out. */
+	unsigned events = busy ? POLLOUT : POLLIN;
+	if (conn->defer != NULL && conn->tx_sent == conn->tx_len) {
+		events = 0; /* Nothing to do until resumed. */
+	}
+	return tcp_watch(tcp, conn, events);
+}
+
+/*! \brief Append data to the connection output queue. */
+static int tcp_conn_queue(tcp_conn_t *conn, const uint8_t *data, size_t len)
+{
+	if (conn->tx_len + len > conn->tx_size) {
+		/* Drop the already sent part first. */
+		if (conn->tx_sent > 0) {
+			memmove(conn->tx, conn->tx + conn->tx_sent,
+			        conn->tx_len - conn->tx_sent);
+			conn->tx_len -= conn->tx_sent;
+			conn->tx_sent = 0;
+		}
+		if (conn->tx_len + len > conn->tx_size) {
+			size_t size = MAX(conn->tx_len + len, 2 * conn->tx_size);
+			uint8_t *tx = realloc(conn->tx, size);
+			if (tx == NULL) {
+				return KNOT_ENOMEM;
+			}
+			conn->tx = tx;
+			conn->tx_size = size;
+		}
+	}
+
+	memcpy(conn->tx + conn->tx_len, data, len);
+	conn->tx_len += len;
+
+	return KNOT_EOK;
+}
+
+/*! \brief Non-blocking write, returns the amount written or an error. */
+static ssize_t tcp_conn_write(tcp_conn_t *conn, struct iovec *iov, int iovcnt)
+{
+	struct msghdr msg = {
+		.msg_iov = iov,
+		.msg_iovlen = iovcnt
 	};
 
-	rx->iov_len = KNOT_WIRE_MAX_PKTSIZE;
-	tx->iov_len = KNOT_WIRE_MAX_PKTSIZE;
+	ssize_t ret = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+	if (ret < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+			return 0;
+		}
+		return KNOT_ECONN;
+	}
 
-	/* Receive peer name. */
-	socklen_t addrlen = sizeof(struct sockaddr_storage);
-	if (getpeername(fd, (struct sockaddr *)&ss, &addrlen) < 0) {
-		;
+	return ret;
+}
+
+/*! \brief Send as much of the output queue as possible. */
+static int tcp_conn_flush(tcp_conn_t *conn)
+{
+	if (conn->tx_sent == conn->tx_len) {
+		return KNOT_EOK;
 	}
 
-	/* Timeout. */
-	rcu_read_lock();
-	int timeout = 1000 * conf()->cache.srv_tcp_reply_timeout;
-	rcu_read_unlock();
+	struct iovec iov = {
+		.iov_base = conn->tx + conn->tx_sent,
+		.iov_len = conn->tx_len - conn->tx_sent
+	};
+	ssize_t ret = tcp_conn_write(conn, &iov, 1);
+	if (ret < 0) {
+		return ret;
+	}
+
+	conn->tx_sent += ret;
+	if (conn->tx_sent == conn->tx_len) {
+		/* Release the buffer, most clients never need it again. */
+		free(conn->tx);
+		conn->tx = NULL;
+		conn->tx_len = conn->tx_sent = conn->tx_size = 0;
+	}
+
+	return KNOT_EOK;
+}
 
-	/* Receive data. */
-	int ret = net_dns_tcp_recv(fd, rx->iov_base, rx->iov_len, timeout);
-	if (ret <= 0) {
-		if (ret == KNOT_EAGAIN) {
-			char addr_str[SOCKADDR_STRLEN] = {0};
-			sockaddr_tostr(addr_str, sizeof(addr_str), (struct sockaddr *)&ss);
-			log_warning("TCP, connection timed out, address %s",
-			            addr_str);
+/*! \brief Send a DNS message, queueing what can't be written right now. */
+static int tcp_conn_send(tcp_conn_t *conn, const uint8_t *wire, size_t len)
+{
+	uint8_t prefix[sizeof(uint16_t)];
+	wire_write_u16(prefix, len);
+
+	/* Keep the order if something is queued already. */
+	if (conn->tx_sent < conn->tx_len) {
+		int ret = tcp_conn_queue(conn, prefix, sizeof(prefix));
+		if (ret != KNOT_EOK) {
+			return ret;
 		}
-		return KNOT_ECONNREFUSED;
+		return tcp_conn_queue(conn, wire, len);
+	}
+
+	struct iovec iov[2] = {
+		{ .iov_base = prefix, .iov_len = sizeof(prefix) },
+		{ .iov_base = (uint8_t *)wire, .iov_len = len }
+	};
+	ssize_t sent = tcp_conn_write(conn, iov, 2);
+	if (sent < 0) {
+		return sent;
+	}
+
+	/* Queue the rest. */
+	if (sent < sizeof(prefix)) {
+		int ret = tcp_conn_queue(conn, prefix + sent, sizeof(prefix) - sent);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+		sent = 0;
 	} else {
-		rx->iov_len = ret;
+		sent -= sizeof(prefix);
+	}
+	if (sent < len) {
+		return tcp_conn_queue(conn, wire + sent, len - sent);
 	}
 
-	/* Initialize processing layer. */
-	knot_layer_begin(&tcp->layer, &params);
+	return KNOT_EOK;
+}
 
-	/* Create packets. */
+static void tcp_xfr_end(tcp_conn_t *conn)
+{
+	tcp_xfr_t *xfr = conn->xfr;
+
+	knot_layer_finish(&xfr->layer);
+	knot_pkt_free(&xfr->query);
+	knot_pkt_free(&xfr->ans);
+	mp_delete(xfr->mm.ctx);
+	free(xfr);
+
+	conn->xfr = NULL;
+}
+
+/*! \brief Produce transfer messages until the output queue is full enough. */
+static int tcp_xfr_produce(tcp_conn_t *conn)
+{
+	tcp_xfr_t *xfr = conn->xfr;
+
+	int ret = KNOT_EOK;
+	while (tcp_active_state(xfr->layer.state) &&
+	       conn->tx_len - conn->tx_sent < TCP_TX_WATERMARK) {
+		knot_layer_produce(&xfr->layer, xfr->ans);
+		/* Send, if response generation passed and wasn't ignored. */
+		if (xfr->ans->size > 0 && tcp_send_state(xfr->layer.state)) {
+			ret = tcp_conn_send(conn, xfr->ans->wire, xfr->ans->size);
+			if (ret != KNOT_EOK) {
+				break;
+			}
+		}
+	}
+
+	if (ret != KNOT_EOK || !tcp_active_state(xfr->layer.state)) {
+		tcp_xfr_end(conn);
+	}
+
+	return ret;
+}
+
+/*!
+ * \brief Start a multi-message answer.
+ *
+ * The transfer gets its own processing layer and memory, so that it can be
+ * suspended whenever the client doesn't keep up, and other clients served.
+ */
+static int tcp_xfr_begin(tcp_context_t *tcp, tcp_conn_t *conn,
+                         const uint8_t *msg, size_t msg_len)
+{
+	tcp_xfr_t *xfr = calloc(1, sizeof(*xfr));
+	if (xfr == NULL) {
+		return KNOT_ENOMEM;
+	}
+	mm_ctx_mempool(&xfr->mm, 16 * MM_DEFAULT_BLKSIZE);
+
+	uint8_t *query_wire = mm_alloc(&xfr->mm, msg_len);
+	uint8_t *ans_wire = mm_alloc(&xfr->mm, KNOT_WIRE_MAX_PKTSIZE);
+	if (query_wire == NULL || ans_wire == NULL) {
+		mp_delete(xfr->mm.ctx);
+		free(xfr);
+		return KNOT_ENOMEM;
+	}
+	memcpy(query_wire, msg, msg_len);
+	xfr->query = knot_pkt_new(query_wire, msg_len, &xfr->mm);
+	xfr->ans = knot_pkt_new(ans_wire, KNOT_WIRE_MAX_PKTSIZE, &xfr->mm);
+
+	xfr->params = (knotd_qdata_params_t) {
+		.remote = &conn->remote,
+		.socket = conn->fd,
+		.server = tcp->server,
+		.thread_id = tcp->thread_id
+	};
+
+	knot_layer_init(&xfr->layer, &xfr->mm, process_query_layer());
+	conn->xfr = xfr;
+
+	knot_layer_begin(&xfr->layer, &xfr->params);
+	(void) knot_pkt_parse(xfr->query, 0);
+	knot_layer_consume(&xfr->layer, xfr->query);
+
+	return tcp_xfr_produce(conn);
+}
+
+/*!
+ * \brief Process a parsed query message, send the answers.
+ */
+static int tcp_process(tcp_context_t *tcp, tcp_conn_t *conn,
+                       knotd_qdata_params_t *params, knot_pkt_t *query)
+{
+	struct iovec *tx = &tcp->iov[1];
 	knot_pkt_t *ans = knot_pkt_new(tx->iov_base, tx->iov_len, tcp->layer.mm);
-	knot_pkt_t *query = knot_pkt_new(rx->iov_base, rx->iov_len, tcp->layer.mm);
+
+	/* Initialize processing layer. */
+	knot_layer_begin(&tcp->layer, params);
 
 	/* Input packet. */
-	(void) knot_pkt_parse(query, 0);
 	knot_layer_consume(&tcp->layer, query);
 
 	/* Resolve until NOOP or finished. */
-	ret = KNOT_EOK;
+	int ret = KNOT_EOK;
 	while (tcp_active_state(tcp->layer.state)) {
 		knot_layer_produce(&tcp->layer, ans);
 		/* Send, if response generation passed and wasn't ignored. */
 		if (ans->size > 0 && tcp_send_state(tcp->layer.state)) {
-			if (net_dns_tcp_send(fd, ans->wire, ans->size, timeout) != ans->size) {
-				ret = KNOT_ECONNREFUSED;
+			ret = tcp_conn_send(conn, ans->wire, ans->size);
+			if (ret != KNOT_EOK) {
 				break;
 			}
 		}
@@ -167,135 +535,385 @@ static int tcp_handle(tcp_context_t *tcp, int fd,
 	/* Reset after processing. */
 	knot_layer_finish(&tcp->layer);
 
+	knot_pkt_free(&ans);
+
+	return ret;
+}
+
+/*!
+ * \brief Process one query message.
+ */
+static int tcp_handle(tcp_context_t *tcp, tcp_conn_t *conn,
+                      const uint8_t *msg, size_t msg_len)
+{
+	/* Create query processing parameter. */
+	knotd_qdata_params_t params = {
+		.remote = &conn->remote,
+		.socket = conn->fd,
+		.server = tcp->server,
+		.thread_id = tcp->thread_id,
+		.defer_queue = tcp->defers
+	};
+
+	/* Create packets. */
+	knot_pkt_t *query = knot_pkt_new((uint8_t *)msg, msg_len, tcp->layer.mm);
+	(void) knot_pkt_parse(query, 0);
+
+	/* Transfers may span many messages, they are processed separately. */
+	uint16_t qtype = knot_pkt_qtype(query);
+	if (query->qname_size > 0 &&
+	    (qtype == KNOT_RRTYPE_AXFR || qtype == KNOT_RRTYPE_IXFR)) {
+		knot_pkt_free(&query);
+		mp_flush(tcp->layer.mm->ctx);
+		return tcp_xfr_begin(tcp, conn, msg, msg_len);
+	}
+
+	int ret = tcp_process(tcp, conn, &params, query);
+
+	/* Wait for the answer if deferred by a module. */
+	if (params.defer != NULL) {
+		params.defer->owner = conn;
+		conn->defer = params.defer;
+	}
+
 	/* Cleanup. */
 	knot_pkt_free(&query);
-	knot_pkt_free(&ans);
+
+	/* Flush per-query memory. */
+	mp_flush(tcp->layer.mm->ctx);
 
 	return ret;
 }
 
-int tcp_accept(int fd)
+/*!
+ * \brief Process complete messages from the input data, keep the rest.
+ *
+ * Processing stops when the client has unsent answers pending.
+ */
+static int tcp_conn_consume(tcp_context_t *tcp, tcp_conn_t *conn,
+                            uint8_t *data, size_t len)
 {
-	/* Accept incoming connection. */
-	int incoming = net_accept(fd, NULL);
+	size_t off = 0;
+	while (!tcp_conn_busy(conn) && len - off >= sizeof(uint16_t)) {
+		size_t msg_len = wire_read_u16(data + off);
+		if (msg_len == 0) {
+			return KNOT_EMALF;
+		}
+		if (len - off < sizeof(uint16_t) + msg_len) {
+			break; /* Incomplete message. */
+		}
 
-	/* Evaluate connection. */
-	if (incoming >= 0) {
-#ifdef SO_RCVTIMEO
-		struct timeval tv;
-		rcu_read_lock();
-		tv.tv_sec = conf()->cache.srv_tcp_idle_timeout;
-		rcu_read_unlock();
-		tv.tv_usec = 0;
-		if (setsockopt(incoming, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
-			log_warning("TCP, failed to set up watchdog timer"
-			            ", fd %d", incoming);
+		int ret = tcp_handle(tcp, conn, data + off + sizeof(uint16_t), msg_len);
+		if (ret != KNOT_EOK) {
+			return ret;
 		}
-#endif
+		off += sizeof(uint16_t) + msg_len;
+	}
+
+	/* Keep the unprocessed rest. */
+	size_t rest = len - off;
+	if (rest > 0 && conn->rx == NULL) {
+		conn->rx = malloc(TCP_BUFFER_SIZE);
+		if (conn->rx == NULL) {
+			return KNOT_ENOMEM;
+		}
+	}
+	if (rest > 0) {
+		memmove(conn->rx, data + off, rest);
+	} else {
+		free(conn->rx);
+		conn->rx = NULL;
 	}
+	conn->rx_len = rest;
 
-	return incoming;
+	return KNOT_EOK;
 }
 
-static int tcp_event_accept(tcp_context_t *tcp, unsigned i)
+/*! \brief Handle readable client. */
+static int tcp_conn_recv(tcp_context_t *tcp, tcp_conn_t *conn)
 {
-	/* Accept client. */
-	int fd = tcp->set.pfd[i].fd;
-	int client = tcp_accept(fd);
-	if (client >= 0) {
-		/* Assign to fdset. */
-		int next_id = fdset_add(&tcp->set, client, POLLIN, NULL);
-		if (next_id < 0) {
-			close(client);
-			return next_id; /* Contains errno. */
+	/* Continue an incomplete message, or use the shared buffer. */
+	uint8_t *buf = (conn->rx_len > 0) ? conn->rx : tcp->iov[0].iov_base;
+	size_t len = (conn->rx_len > 0) ? conn->rx_len : 0;
+	assert(len < TCP_BUFFER_SIZE);
+
+	ssize_t ret = recv(conn->fd, buf + len, TCP_BUFFER_SIZE - len, 0);
+	if (ret < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+			return KNOT_EOK;
 		}
+		return KNOT_ECONN;
+	} else if (ret == 0) {
+		return KNOT_ECONN; /* Closed by the client. */
+	}
 
-		/* Update watchdog timer. */
-		rcu_read_lock();
-		int timeout = conf()->cache.srv_tcp_hshake_timeout;
-		fdset_set_watchdog(&tcp->set, next_id, timeout);
-		rcu_read_unlock();
+	return tcp_conn_consume(tcp, conn, buf, len + ret);
+}
 
-		return KNOT_EOK;
+/*!
+ * \brief Answer a resumed deferred query, continue with the received ones.
+ */
+static int tcp_conn_resumed(tcp_context_t *tcp, tcp_conn_t *conn)
+{
+	knotd_defer_t *defer = conn->defer;
+	conn->defer = NULL;
+
+	knotd_qdata_params_t params = {
+		.remote = &conn->remote,
+		.socket = conn->fd,
+		.server = tcp->server,
+		.thread_id = tcp->thread_id,
+		.defer = defer
+	};
+
+	knot_pkt_t *query = knot_pkt_new(defer->query, defer->query_len, tcp->layer.mm);
+	(void) knot_pkt_parse(query, 0);
+
+	int ret = tcp_process(tcp, conn, &params, query);
+
+	knot_pkt_free(&query);
+	defer_free(defer);
+	mp_flush(tcp->layer.mm->ctx);
+
+	/* Process already received queries. */
+	if (ret == KNOT_EOK && !tcp_conn_busy(conn) && conn->rx_len > 0) {
+		ret = tcp_conn_consume(tcp, conn, conn->rx, conn->rx_len);
 	}
 
-	return client;
+	return ret;
 }
 
-static int tcp_event_serve(tcp_context_t *tcp, unsigned i)
+/*! \brief Handle writable client. */
+static int tcp_conn_resume(tcp_context_t *tcp, tcp_conn_t *conn)
 {
-	int fd = tcp->set.pfd[i].fd;
-	int ret = tcp_handle(tcp, fd, &tcp->iov[0], &tcp->iov[1]);
+	int ret = tcp_conn_flush(conn);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
 
-	/* Flush per-query memory. */
-	mp_flush(tcp->layer.mm->ctx);
+	/* Continue a suspended transfer. */
+	if (conn->xfr != NULL && conn->tx_len - conn->tx_sent < TCP_TX_WATERMARK) {
+		ret = tcp_xfr_produce(conn);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
 
-	if (ret == KNOT_EOK) {
-		/* Update socket activity timer. */
-		rcu_read_lock();
-		int timeout = conf()->cache.srv_tcp_idle_timeout;
-		fdset_set_watchdog(&tcp->set, i, timeout);
-		rcu_read_unlock();
+	/* Process already received queries. */
+	if (!tcp_conn_busy(conn) && conn->rx_len > 0) {
+		ret = tcp_conn_consume(tcp, conn, conn->rx, conn->rx_len);
 	}
 
 	return ret;
 }
 
-static int tcp_wait_for_events(tcp_context_t *tcp)
+static void tcp_conn_close(tcp_context_t *tcp, tcp_conn_t *conn)
 {
-	/* Wait for events. */
-	fdset_t *set = &tcp->set;
-	int nfds = poll(set->pfd, set->n, TCP_SWEEP_INTERVAL * 1000);
+	(void)tcp_watch(tcp, conn, 0);
+	close(conn->fd);
 
-	/* Mark the time of last poll call. */
-	tcp->last_poll_time = time_now();
-	bool is_throttled = (tcp->last_poll_time.tv_sec < tcp->throttle_end.tv_sec);
+	if (conn->xfr != NULL) {
+		tcp_xfr_end(conn);
+	}
+	if (conn->defer != NULL) {
+		defer_cancel(conn->defer);
+	}
+	free(conn->rx);
+	free(conn->tx);
+
+	rem_node(&conn->n);
+	free(conn);
+	tcp->client_count -= 1;
+}
+
+/*! \brief Sweep inactive TCP connections. */
+static void tcp_sweep(tcp_context_t *tcp)
+{
+	time_t now = time_now().tv_sec;
+
+	tcp_conn_t *conn = NULL, *next = NULL;
+	WALK_LIST_DELSAFE(conn, next, tcp->clients) {
+		if (conn->timeout > now) {
+			continue;
+		}
+
+		/* Best-effort, name and shame. */
+		char addr_str[SOCKADDR_STRLEN] = {0};
+		sockaddr_tostr(addr_str, sizeof(addr_str), (struct sockaddr *)&conn->remote);
+		if (tcp_conn_busy(conn) || conn->rx_len > 0) {
+			log_warning("TCP, connection timed out, address %s", addr_str);
+		} else {
+			log_notice("TCP, terminated inactive client, address %s", addr_str);
+		}
+
+		tcp_conn_close(tcp, conn);
+	}
+}
+
+int tcp_accept(int fd)
+{
+	/* Accept incoming connection, it's non-blocking. */
+	return net_accept(fd, NULL);
+}
+
+static int tcp_event_accept(tcp_context_t *tcp, tcp_conn_t *listener)
+{
+	/* Accept client. */
+	int client = tcp_accept(listener->fd);
+	if (client < 0) {
+		return client;
+	}
+
+	tcp_conn_t *conn = calloc(1, sizeof(*conn));
+	if (conn == NULL) {
+		close(client);
+		return KNOT_ENOMEM;
+	}
+	conn->fd = client;
+
+	/* Receive peer name. */
+	socklen_t addrlen = sizeof(struct sockaddr_storage);
+	if (getpeername(client, (struct sockaddr *)&conn->remote, &addrlen) < 0) {
+		;
+	}
+
+	int ret = tcp_watch(tcp, conn, POLLIN);
+	if (ret != KNOT_EOK) {
+		close(client);
+		free(conn);
+		return ret;
+	}
+	add_tail(&tcp->clients, &conn->n);
+	tcp->client_count += 1;
+
+	/* Update watchdog timer. */
+	rcu_read_lock();
+	conn->timeout = time_now().tv_sec + conf()->cache.srv_tcp_hshake_timeout;
+	rcu_read_unlock();
+
+	return KNOT_EOK;
+}
+
+/*! \brief Stop or start watching the server sockets. */
+static void tcp_set_accepting(tcp_context_t *tcp, bool accepting)
+{
+	if (tcp->accepting == accepting) {
+		return;
+	}
+
+	for (unsigned i = 0; i < tcp->set.n; ++i) {
+		(void)tcp_watch(tcp, &tcp->listeners[i], accepting ? POLLIN : 0);
+	}
+	tcp->accepting = accepting;
+}
+
+static int tcp_wait_for_events(tcp_context_t *tcp)
+{
+	/* Configuration limit, infer maximal pool size. */
+	struct timespec now = time_now();
+	bool is_throttled = (now.tv_sec < tcp->throttle_end.tv_sec);
 	if (!is_throttled) {
-		/* Configuration limit, infer maximal pool size. */
 		rcu_read_lock();
 		int clients = conf()->cache.srv_max_tcp_clients;
 		unsigned max_per_set = MAX(clients / conf_tcp_threads(conf()), 1);
 		rcu_read_unlock();
-		/* Subtract master sockets check limits. */
-		is_throttled = (set->n - tcp->client_threshold) >= max_per_set;
+		is_throttled = tcp->client_count >= max_per_set;
 	}
+	tcp_set_accepting(tcp, !is_throttled);
+
+	/* Wait for events, recheck the throttling state early. */
+	int timeout = (is_throttled ? 1 : TCP_SWEEP_INTERVAL) * 1000;
+	int nfds = tcp_wait(tcp, timeout);
+
+	/* Mark the time of last poll call. */
+	tcp->last_poll_time = time_now();
 
 	/* Process events. */
-	unsigned i = 0;
-	while (nfds > 0 && i < set->n) {
-		bool should_close = false;
-		int fd = set->pfd[i].fd;
-		if (set->pfd[i].revents & (POLLERR|POLLHUP|POLLNVAL)) {
-			should_close = (i >= tcp->client_threshold);
-			--nfds;
-		} else if (set->pfd[i].revents & (POLLIN)) {
-			/* Master sockets */
-			if (i < tcp->client_threshold) {
-				if (!is_throttled && tcp_event_accept(tcp, i) == KNOT_EBUSY) {
+	bool resumed = false;
+	for (int i = 0; i < nfds; ++i) {
+		tcp_conn_t *conn = tcp->events[i].conn;
+		unsigned events = tcp->events[i].events;
+
+		/* Resumed queries, answered after the other events. */
+		if (conn == &tcp->resumer) {
+			resumed = true;
+			continue;
+		}
+
+		/* Master sockets */
+		if (conn->listener) {
+			if (events & POLLIN) {
+				if (tcp_event_accept(tcp, conn) == KNOT_EBUSY) {
 					tcp->throttle_end = time_now();
 					tcp->throttle_end.tv_sec += tcp_throttle();
 				}
-			/* Client sockets */
-			} else {
-				if (tcp_event_serve(tcp, i) != KNOT_EOK) {
-					should_close = true;
-				}
 			}
-			--nfds;
+			continue;
 		}
 
-		/* Evaluate */
-		if (should_close) {
-			fdset_remove(set, i);
-			close(fd);
-		} else {
-			++i;
+		/* Client sockets */
+		int ret = KNOT_EOK;
+		if (events & POLLOUT) {
+			ret = tcp_conn_resume(tcp, conn);
+		} else if (events & POLLIN) {
+			ret = tcp_conn_recv(tcp, conn);
+		} else if (events & (POLLERR|POLLHUP|POLLNVAL)) {
+			ret = KNOT_ECONN;
+		}
+
+		if (ret == KNOT_EOK) {
+			ret = tcp_conn_update(tcp, conn);
+		}
+		if (ret != KNOT_EOK) {
+			tcp_conn_close(tcp, conn);
+		}
+	}
+
+	/* Answer resumed queries last, their connections may be closed then. */
+	knotd_defer_t *defer = NULL;
+	while (resumed && (defer = defer_queue_pop(tcp->defers)) != NULL) {
+		tcp_conn_t *conn = defer->owner;
+		int ret = tcp_conn_resumed(tcp, conn);
+		if (ret == KNOT_EOK) {
+			ret = tcp_conn_update(tcp, conn);
+		}
+		if (ret != KNOT_EOK) {
+			tcp_conn_close(tcp, conn);
 		}
 	}
 
 	return nfds;
 }
 
+/*! \brief Close all clients and stop watching the server sockets. */
+static void tcp_reset(tcp_context_t *tcp)
+{
+	tcp_conn_t *conn = NULL, *next = NULL;
+	WALK_LIST_DELSAFE(conn, next, tcp->clients) {
+		tcp_conn_close(tcp, conn);
+	}
+
+	tcp_set_accepting(tcp, false);
+	free(tcp->listeners);
+	tcp->listeners = NULL;
+}
+
+/*! \brief Create endpoints for the server sockets. */
+static int tcp_set_listeners(tcp_context_t *tcp)
+{
+	tcp->listeners = calloc(tcp->set.n, sizeof(tcp_conn_t));
+	if (tcp->listeners == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	for (unsigned i = 0; i < tcp->set.n; ++i) {
+		tcp->listeners[i].fd = tcp->set.pfd[i].fd;
+		tcp->listeners[i].listener = true;
+	}
+
+	return KNOT_EOK;
+}
+
 int tcp_master(dthread_t *thread)
 {
 	if (!thread || !thread->data) {
@@ -309,6 +927,7 @@ int tcp_master(dthread_t *thread)
 	ref_t *ref = NULL;
 	tcp_context_t tcp;
 	memset(&tcp, 0, sizeof(tcp_context_t));
+	init_list(&tcp.clients);
 
 	/* Create big enough memory cushion. */
 	knot_mm_t mm = { 0 };
@@ -323,9 +942,23 @@ int tcp_master(dthread_t *thread)
 	conf_val_t val = conf_get(conf(), C_SRV, C_LISTEN);
 	fdset_init(&tcp.set, conf_val_count(&val) + CONF_XFERS);
 
+	/* Prepare event notification. */
+	ret = tcp_events_init(&tcp);
+	if (ret != KNOT_EOK) {
+		goto finish;
+	}
+
+	/* Modules can't defer queries without the queue. */
+	tcp.defers = defer_queue_new();
+	if (tcp.defers != NULL) {
+		tcp.resumer.fd = defer_queue_fd(tcp.defers);
+		(void)tcp_watch(&tcp, &tcp.resumer, POLLIN);
+	}
+
 	/* Create iovec abstraction. */
+	tcp.iov[0].iov_len = TCP_BUFFER_SIZE;
+	tcp.iov[1].iov_len = KNOT_WIRE_MAX_PKTSIZE;
 	for (unsigned i = 0; i < 2; ++i) {
-		tcp.iov[i].iov_len = KNOT_WIRE_MAX_PKTSIZE;
 		tcp.iov[i].iov_base = malloc(tcp.iov[i].iov_len);
 		if (tcp.iov[i].iov_base == NULL) {
 			ret = KNOT_ENOMEM;
@@ -344,9 +977,7 @@ int tcp_master(dthread_t *thread)
 			*iostate &= ~ServerReload;
 
 			/* Cancel client connections. */
-			for (unsigned i = tcp.client_threshold; i < tcp.set.n; ++i) {
-				close(tcp.set.pfd[i].fd);
-			}
+			tcp_reset(&tcp);
 
 			ref_release(ref);
 			ref = server_set_ifaces(handler->server, &tcp.set, IO_TCP, tcp.thread_id);
@@ -354,7 +985,10 @@ int tcp_master(dthread_t *thread)
 				break; /* Terminate on zero interfaces. */
 			}
 
-			tcp.client_threshold = tcp.set.n;
+			ret = tcp_set_listeners(&tcp);
+			if (ret != KNOT_EOK) {
+				break;
+			}
 		}
 
 		/* Check for cancellation. */
@@ -367,13 +1001,16 @@ int tcp_master(dthread_t *thread)
 
 		/* Sweep inactive clients. */
 		if (tcp.last_poll_time.tv_sec >= next_sweep.tv_sec) {
-			fdset_sweep(&tcp.set, &tcp_sweep, NULL);
+			tcp_sweep(&tcp);
 			next_sweep = time_now();
 			next_sweep.tv_sec += TCP_SWEEP_INTERVAL;
 		}
 	}
 
 finish:
+	tcp_reset(&tcp);
+	tcp_events_deinit(&tcp);
+	defer_queue_free(tcp.defers);
 	free(tcp.iov[0].iov_base);
 	free(tcp.iov[1].iov_base);
 	mp_delete(mm.ctx);
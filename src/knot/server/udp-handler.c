@@ -37,6 +37,7 @@
 #include "contrib/ucw/mempool.h"
 #include "knot/nameserver/process_query.h"
 #include "knot/query/layer.h"
+#include "knot/server/defer.h"
 #include "knot/server/server.h"
 #include "knot/server/udp-handler.h"
 
@@ -47,34 +48,42 @@ enum {
 	NBUFS = 2
 };
 
+/*! \brief Control message to fit IP_PKTINFO or IPv6_RECVPKTINFO. */
+typedef union {
+	struct cmsghdr cmsg;
+	uint8_t buf[CMSG_SPACE(sizeof(struct in6_pktinfo))];
+} cmsg_pktinfo_t;
+
 /*! \brief UDP context data. */
 typedef struct {
-	knot_layer_t layer; /*!< Query processing layer. */
-	server_t *server;   /*!< Name server structure. */
-	unsigned thread_id; /*!< Thread identifier. */
+	knot_layer_t layer;    /*!< Query processing layer. */
+	server_t *server;      /*!< Name server structure. */
+	unsigned thread_id;    /*!< Thread identifier. */
+	defer_queue_t *defers; /*!< Resumed deferred queries. */
+	list_t deferred;       /*!< Deferred queries waiting for an answer. */
 } udp_context_t;
 
+/*! \brief Query deferred by a module, answered when resumed. */
+typedef struct {
+	node_t n;                       /*!< Node in the list of deferred queries. */
+	knotd_defer_t *defer;           /*!< Deferred query. */
+	int fd;                         /*!< Socket the query was received on. */
+	struct sockaddr_storage remote; /*!< Client address. */
+	cmsg_pktinfo_t pktinfo;         /*!< Packet info for the response. */
+	size_t pktinfo_len;             /*!< Packet info length. */
+} udp_deferred_t;
+
 static bool udp_state_active(int state)
 {
 	return (state == KNOT_STATE_PRODUCE || state == KNOT_STATE_FAIL);
 }
 
-static void udp_handle(udp_context_t *udp, int fd, struct sockaddr_storage *ss,
-                       struct iovec *rx, struct iovec *tx)
+/*! \brief Process a query, returns the answer size (zero if none). */
+static size_t udp_process(udp_context_t *udp, knotd_qdata_params_t *params,
+                          struct iovec *rx, struct iovec *tx)
 {
-	/* Create query processing parameter. */
-	knotd_qdata_params_t params = {
-		.remote = ss,
-		.flags = KNOTD_QUERY_FLAG_NO_AXFR | KNOTD_QUERY_FLAG_NO_IXFR | /* No transfers. */
-		         KNOTD_QUERY_FLAG_LIMIT_SIZE | /* Enforce UDP packet size limit. */
-		         KNOTD_QUERY_FLAG_LIMIT_ANY,  /* Limit ANY over UDP (depends on zone as well). */
-		.socket = fd,
-		.server = udp->server,
-		.thread_id = udp->thread_id
-	};
-
 	/* Start query processing. */
-	knot_layer_begin(&udp->layer, &params);
+	knot_layer_begin(&udp->layer, params);
 
 	/* Create packets. */
 	knot_pkt_t *query = knot_pkt_new(rx->iov_base, rx->iov_len, udp->layer.mm);
@@ -90,11 +99,7 @@ static void udp_handle(udp_context_t *udp, int fd, struct sockaddr_storage *ss,
 	}
 
 	/* Send response only if finished successfully. */
-	if (udp->layer.state == KNOT_STATE_DONE) {
-		tx->iov_len = ans->size;
-	} else {
-		tx->iov_len = 0;
-	}
+	size_t ans_len = (udp->layer.state == KNOT_STATE_DONE) ? ans->size : 0;
 
 	/* Reset after processing. */
 	knot_layer_finish(&udp->layer);
@@ -102,6 +107,116 @@ static void udp_handle(udp_context_t *udp, int fd, struct sockaddr_storage *ss,
 	/* Cleanup. */
 	knot_pkt_free(&query);
 	knot_pkt_free(&ans);
+
+	return ans_len;
+}
+
+static void udp_params_init(knotd_qdata_params_t *params, udp_context_t *udp, int fd,
+                            const struct sockaddr_storage *ss,
+                            const struct cmsghdr *pktinfo)
+{
+	*params = (knotd_qdata_params_t) {
+		.remote = ss,
+		.pktinfo = pktinfo,
+		.flags = KNOTD_QUERY_FLAG_NO_AXFR | KNOTD_QUERY_FLAG_NO_IXFR | /* No transfers. */
+		         KNOTD_QUERY_FLAG_LIMIT_SIZE | /* Enforce UDP packet size limit. */
+		         KNOTD_QUERY_FLAG_LIMIT_ANY,  /* Limit ANY over UDP (depends on zone as well). */
+		.socket = fd,
+		.server = udp->server,
+		.thread_id = udp->thread_id,
+		.defer_queue = udp->defers
+	};
+}
+
+/*! \brief Remember where to answer a deferred query. */
+static void udp_defer(udp_context_t *udp, knotd_defer_t *defer, int fd,
+                      const struct sockaddr_storage *ss, const struct msghdr *tx_hdr)
+{
+	udp_deferred_t *item = calloc(1, sizeof(*item));
+	if (item == NULL) {
+		defer_cancel(defer); /* Drop the query. */
+		return;
+	}
+
+	item->defer = defer;
+	item->fd = fd;
+	memcpy(&item->remote, ss, sizeof(item->remote));
+	if (tx_hdr->msg_controllen > 0 && tx_hdr->msg_controllen <= sizeof(item->pktinfo)) {
+		memcpy(item->pktinfo.buf, tx_hdr->msg_control, tx_hdr->msg_controllen);
+		item->pktinfo_len = tx_hdr->msg_controllen;
+	}
+
+	defer->owner = item;
+	add_tail(&udp->deferred, &item->n);
+}
+
+static void udp_handle(udp_context_t *udp, int fd, struct sockaddr_storage *ss,
+                       const struct msghdr *tx_hdr, struct iovec *rx, struct iovec *tx)
+{
+	/* Create query processing parameter. */
+	knotd_qdata_params_t params;
+	udp_params_init(&params, udp, fd, ss, CMSG_FIRSTHDR(tx_hdr));
+
+	tx->iov_len = udp_process(udp, &params, rx, tx);
+
+	/* Set the query aside if deferred by a module. */
+	if (params.defer != NULL) {
+		udp_defer(udp, params.defer, fd, ss, tx_hdr);
+	}
+}
+
+/*! \brief Answer resumed deferred queries. */
+static void udp_resume(udp_context_t *udp)
+{
+	knotd_defer_t *defer = NULL;
+	while ((defer = defer_queue_pop(udp->defers)) != NULL) {
+		udp_deferred_t *item = defer->owner;
+		rem_node(&item->n);
+
+		struct msghdr msg = {
+			.msg_name = &item->remote,
+			.msg_namelen = sockaddr_len((struct sockaddr *)&item->remote),
+			// BSD has problem with zero length and not-null pointer
+			.msg_control = (item->pktinfo_len > 0) ? item->pktinfo.buf : NULL,
+			.msg_controllen = item->pktinfo_len
+		};
+
+		knotd_qdata_params_t params;
+		udp_params_init(&params, udp, item->fd, &item->remote, CMSG_FIRSTHDR(&msg));
+		params.defer = defer;
+
+		struct iovec rx = {
+			.iov_base = defer->query,
+			.iov_len = defer->query_len
+		};
+		struct iovec tx = {
+			.iov_base = mm_alloc(udp->layer.mm, KNOT_WIRE_MAX_PKTSIZE),
+			.iov_len = KNOT_WIRE_MAX_PKTSIZE
+		};
+		if (tx.iov_base != NULL) {
+			tx.iov_len = udp_process(udp, &params, &rx, &tx);
+			if (tx.iov_len > 0) {
+				msg.msg_iov = &tx;
+				msg.msg_iovlen = 1;
+				(void)sendmsg(item->fd, &msg, 0);
+			}
+		}
+
+		defer_free(defer);
+		free(item);
+		mp_flush(udp->layer.mm->ctx);
+	}
+}
+
+/*! \brief Drop deferred queries, e.g. when their sockets go away. */
+static void udp_drop_deferred(udp_context_t *udp)
+{
+	udp_deferred_t *item = NULL, *next = NULL;
+	WALK_LIST_DELSAFE(item, next, udp->deferred) {
+		defer_cancel(item->defer);
+		free(item);
+	}
+	init_list(&udp->deferred);
 }
 
 /*! \brief Pointer to selected UDP master implementation. */
@@ -111,12 +226,6 @@ static int (*_udp_recv)(int, void *) = 0;
 static int (*_udp_handle)(udp_context_t *, void *) = 0;
 static int (*_udp_send)(void *) = 0;
 
-/*! \brief Control message to fit IP_PKTINFO or IPv6_RECVPKTINFO. */
-typedef union {
-	struct cmsghdr cmsg;
-	uint8_t buf[CMSG_SPACE(sizeof(struct in6_pktinfo))];
-} cmsg_pktinfo_t;
-
 static void udp_pktinfo_handle(const struct msghdr *rx, struct msghdr *tx)
 {
 	tx->msg_controllen = rx->msg_controllen;
@@ -212,7 +321,7 @@ static int udp_recvfrom_handle(udp_context_t *ctx, void *d)
 	udp_pktinfo_handle(&rq->msg[RX], &rq->msg[TX]);
 
 	/* Process received pkt. */
-	udp_handle(ctx, rq->fd, &rq->addr, &rq->iov[RX], &rq->iov[TX]);
+	udp_handle(ctx, rq->fd, &rq->addr, &rq->msg[TX], &rq->iov[RX], &rq->iov[TX]);
 
 	return KNOT_EOK;
 }
@@ -311,7 +420,7 @@ static int udp_recvmmsg_handle(udp_context_t *ctx, void *d)
 
 		udp_pktinfo_handle(&rq->msgs[RX][i].msg_hdr, &rq->msgs[TX][i].msg_hdr);
 
-		udp_handle(ctx, rq->fd, rq->addrs + i, rx, tx);
+		udp_handle(ctx, rq->fd, rq->addrs + i, &rq->msgs[TX][i].msg_hdr, rx, tx);
 		rq->msgs[TX][i].msg_len = tx->iov_len;
 		rq->msgs[TX][i].msg_hdr.msg_namelen = 0;
 		if (tx->iov_len > 0) {
@@ -326,7 +435,17 @@ static int udp_recvmmsg_handle(udp_context_t *ctx, void *d)
 static int udp_recvmmsg_send(void *d)
 {
 	struct udp_recvmmsg *rq = (struct udp_recvmmsg *)d;
-	int rc = sendmmsg(rq->fd, rq->msgs[TX], rq->rcvd, 0);
+
+	/* Skip messages without a response, sendmmsg() stops on the first
+	 * failed message. */
+	struct mmsghdr out[RECVMMSG_BATCHLEN];
+	unsigned out_count = 0;
+	for (unsigned i = 0; i < rq->rcvd; ++i) {
+		if (rq->msgs[TX][i].msg_len > 0) {
+			out[out_count++] = rq->msgs[TX][i];
+		}
+	}
+	int rc = (out_count > 0) ? sendmmsg(rq->fd, out, out_count, 0) : 0;
 	for (unsigned i = 0; i < rq->rcvd; ++i) {
 		/* Reset buffer size and address len. */
 		struct iovec *rx = rq->msgs[RX][i].msg_hdr.msg_iov;
@@ -385,17 +504,18 @@ static void forget_ifaces(ifacelist_t *ifaces, struct pollfd **fds_ptr)
  *
  * \param[in]   ifaces  New interface list.
  * \param[in]   thrid   Thread ID.
+ * \param[in]   wake_fd Resumed queries descriptor, appended (-1 if none).
  * \param[out]  fds_ptr Allocated set of descriptors.
  *
- * \return Number of watched descriptors, zero on error.
+ * \return Number of watched interface descriptors, zero on error.
  */
-static nfds_t track_ifaces(const ifacelist_t *ifaces, int thrid,
+static nfds_t track_ifaces(const ifacelist_t *ifaces, int thrid, int wake_fd,
                            struct pollfd **fds_ptr)
 {
 	assert(ifaces && fds_ptr);
 
 	nfds_t nfds = list_size(&ifaces->l);
-	struct pollfd *fds = malloc(nfds * sizeof(*fds));
+	struct pollfd *fds = malloc((nfds + 1) * sizeof(*fds));
 	if (!fds) {
 		*fds_ptr = NULL;
 		return 0;
@@ -411,6 +531,11 @@ static nfds_t track_ifaces(const ifacelist_t *ifaces, int thrid,
 	}
 	assert(i == nfds);
 
+	/* Negative descriptors are ignored by poll(). */
+	fds[nfds].fd = wake_fd;
+	fds[nfds].events = POLLIN;
+	fds[nfds].revents = 0;
+
 	*fds_ptr = fds;
 	return nfds;
 }
@@ -440,6 +565,11 @@ int udp_master(dthread_t *thread)
 	udp.server = handler->server;
 	udp.thread_id = handler->thread_id[thr_id];
 	knot_layer_init(&udp.layer, &mm, process_query_layer());
+	init_list(&udp.deferred);
+
+	/* Modules can't defer queries without the queue. */
+	udp.defers = defer_queue_new();
+	int wake_fd = (udp.defers != NULL) ? defer_queue_fd(udp.defers) : -1;
 
 	/* Event source. */
 	struct pollfd *fds = NULL;
@@ -453,10 +583,13 @@ int udp_master(dthread_t *thread)
 			*iostate &= ~ServerReload;
 			udp.thread_id = handler->thread_id[thr_id];
 
+			/* The sockets of deferred queries may be closed. */
+			udp_drop_deferred(&udp);
+
 			rcu_read_lock();
 			forget_ifaces(ref, &fds);
 			ref = handler->server->ifaces;
-			nfds = track_ifaces(ref, udp.thread_id, &fds);
+			nfds = track_ifaces(ref, udp.thread_id, wake_fd, &fds);
 			rcu_read_unlock();
 			if (nfds == 0) {
 				break;
@@ -469,12 +602,18 @@ int udp_master(dthread_t *thread)
 		}
 
 		/* Wait for events. */
-		int events = poll(fds, nfds, -1);
+		int events = poll(fds, nfds + 1, -1);
 		if (events <= 0) {
 			if (errno == EINTR) continue;
 			break;
 		}
 
+		/* Answer resumed queries. */
+		if (fds[nfds].revents != 0) {
+			events -= 1;
+			udp_resume(&udp);
+		}
+
 		/* Process the events. */
 		for (nfds_t i = 0; i < nfds && events > 0; i++) {
 			if (fds[i].revents == 0) {
@@ -491,6 +630,8 @@ int udp_master(dthread_t *thread)
 		}
 	}
 
+	udp_drop_deferred(&udp);
+	defer_queue_free(udp.defers);
 	_udp_deinit(rq);
 	forget_ifaces(ref, &fds);
 	mp_delete(mm.ctx);
@@ -15,6 +15,7 @@
  */
 
 #include "knot/updates/acl.h"
+#include "contrib/sockaddr.h"
 
 bool acl_allowed(conf_t *conf, conf_val_t *acl, acl_action_t action,
                  const struct sockaddr_storage *addr, knot_tsig_key_t *tsig)
@@ -102,3 +103,93 @@ next_acl:
 
 	return false;
 }
+
+static bool addr_match(const conf_snap_acl_t *rule,
+                       const struct sockaddr_storage *addr)
+{
+	for (size_t i = 0; i < rule->addr_count; i++) {
+		const conf_snap_addr_t *range = &rule->addrs[i];
+		if (range->max.ss_family == AF_UNSPEC) {
+			if (sockaddr_net_match((struct sockaddr *)addr,
+			                       (struct sockaddr *)&range->min,
+			                       range->prefix)) {
+				return true;
+			}
+		} else {
+			if (sockaddr_range_match((struct sockaddr *)addr,
+			                         (struct sockaddr *)&range->min,
+			                         (struct sockaddr *)&range->max)) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+static const knot_tsig_key_t *key_match(const conf_snap_acl_t *rule,
+                                        const knot_tsig_key_t *tsig)
+{
+	for (size_t i = 0; i < rule->key_count; i++) {
+		const knot_tsig_key_t *key = &rule->keys[i];
+		if (knot_dname_cmp(key->name, tsig->name) == 0 &&
+		    key->algorithm == tsig->algorithm) {
+			return key;
+		}
+	}
+
+	return NULL;
+}
+
+bool acl_allowed_snap(const conf_snap_acl_t **acl, size_t acl_count,
+                      acl_action_t action, const struct sockaddr_storage *addr,
+                      knot_tsig_key_t *tsig)
+{
+	if (acl == NULL || addr == NULL || tsig == NULL) {
+		return false;
+	}
+
+	for (size_t i = 0; i < acl_count; i++) {
+		const conf_snap_acl_t *rule = acl[i];
+
+		/* Check if the address matches the current acl address list. */
+		if (rule->addr_count > 0 && !addr_match(rule, addr)) {
+			continue;
+		}
+
+		/* Check for key match or empty list without key provided. */
+		const knot_tsig_key_t *key = NULL;
+		if (tsig->name != NULL) {
+			key = key_match(rule, tsig);
+			if (key == NULL) {
+				continue;
+			}
+		} else if (rule->key_count > 0) {
+			continue;
+		}
+
+		/* Check if the action is allowed. */
+		if (action != ACL_ACTION_NONE) {
+			if (rule->actions == 0) {
+				/* Empty action list allowed with deny only. */
+				return false;
+			} else if (!(rule->actions & (1 << action))) {
+				continue;
+			}
+		}
+
+		/* Check if denied. */
+		if (rule->deny) {
+			return false;
+		}
+
+		/* Fill the output with tsig secret if provided. */
+		if (key != NULL) {
+			tsig->secret = key->secret;
+		}
+
+		return true;
+	}
+
+	return false;
+}
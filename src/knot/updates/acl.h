@@ -29,6 +29,7 @@
 
 #include "libknot/tsig.h"
 #include "knot/conf/conf.h"
+#include "knot/conf/snapshot.h"
 
 /*! \brief ACL actions. */
 typedef enum {
@@ -54,4 +55,21 @@ typedef enum {
 bool acl_allowed(conf_t *conf, conf_val_t *acl, acl_action_t action,
                  const struct sockaddr_storage *addr, knot_tsig_key_t *tsig);
 
+/*!
+ * \brief Checks if the address and/or tsig key matches given compiled ACL rules.
+ *
+ * Equivalent to acl_allowed() without the configuration database access.
+ *
+ * \param acl        Compiled zone ACL rules.
+ * \param acl_count  Number of the rules.
+ * \param action     ACL action.
+ * \param addr       IP address.
+ * \param tsig       TSIG parameters.
+ *
+ * \retval True if authenticated.
+ */
+bool acl_allowed_snap(const conf_snap_acl_t **acl, size_t acl_count,
+                      acl_action_t action, const struct sockaddr_storage *addr,
+                      knot_tsig_key_t *tsig);
+
 /*! @} */
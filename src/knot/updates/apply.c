@@ -59,6 +59,12 @@ static int free_additional(zone_node_t **node, void *data)
 /*! \brief Replaces rdataset of given type with a copy. */
 static int replace_rdataset_with_copy(zone_node_t *node, uint16_t type)
 {
+	// The RRSet array may be shared with the previous zone version.
+	int ret = binode_prepare_change(node, NULL);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
 	// Find data to copy.
 	struct rr_data *data = NULL;
 	for (uint16_t i = 0; i < node->rrset_count; ++i) {
@@ -96,6 +102,11 @@ static void clear_new_rrs(zone_node_t *node, uint16_t type)
 /*! \brief Stores RR data for update cleanup. */
 static int add_old_data(apply_ctx_t *ctx, knot_rdata_t *old_data)
 {
+	// Data in the zone arena are released with the arena.
+	if (zone_arena_owns(ctx->contents->arena, old_data)) {
+		return KNOT_EOK;
+	}
+
 	if (ptrlist_add(&ctx->old_data, old_data, NULL) == NULL) {
 		return KNOT_ENOMEM;
 	}
@@ -113,6 +124,28 @@ static int add_new_data(apply_ctx_t *ctx, knot_rdata_t *new_data)
 	return KNOT_EOK;
 }
 
+/*! \brief Returns the wire size of the node RRSet, zero if missing. */
+static size_t rrset_size(const zone_node_t *node, uint16_t type)
+{
+	knot_rrset_t rrset = node_rrset(node, type);
+	return knot_rrset_empty(&rrset) ? 0 : knot_rrset_size(&rrset);
+}
+
+/*! \brief Adjusts the contents, incrementally if possible. */
+static int adjust(apply_ctx_t *ctx)
+{
+	if (!(ctx->flags & APPLY_INCREMENTAL_ADJUST)) {
+		return zone_contents_adjust_full(ctx->contents);
+	}
+
+	int ret = zone_contents_adjust_incremental(ctx->contents, &ctx->changes);
+	if (ret == KNOT_EOK) {
+		zone_adjust_changes_clear(&ctx->changes);
+	}
+
+	return ret;
+}
+
 /*! \brief Returns true if given RR is present in node and can be removed. */
 static bool can_remove(const zone_node_t *node, const knot_rrset_t *rr)
 {
@@ -221,6 +254,7 @@ void apply_init_ctx(apply_ctx_t *ctx, zone_contents_t *contents, uint32_t flags)
 
 	init_list(&ctx->old_data);
 	init_list(&ctx->new_data);
+	zone_adjust_changes_init(&ctx->changes);
 
 	ctx->flags = flags;
 }
@@ -233,15 +267,15 @@ int apply_prepare_zone_copy(zone_contents_t *old_contents,
 	}
 
 	/*
-	 * Create a shallow copy of the zone, so that the structures may be
+	 * Create a copy-on-write copy of the zone, so that the structures may be
 	 * updated.
 	 *
-	 * This will create new zone contents structures (normal nodes' tree,
-	 * NSEC3 tree), and copy all nodes.
-	 * The data in the nodes (RRSets) remain the same though.
+	 * The trees and the nodes are shared with the original until changed,
+	 * only the nodes touched by the changes are copied. The data in the nodes
+	 * (RRSets) remain the same though.
 	 */
 	zone_contents_t *contents_copy = NULL;
-	int ret = zone_contents_shallow_copy(old_contents, &contents_copy);
+	int ret = zone_contents_cow(old_contents, &contents_copy);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -254,6 +288,14 @@ int apply_prepare_zone_copy(zone_contents_t *old_contents,
 int apply_add_rr(apply_ctx_t *ctx, const knot_rrset_t *rr)
 {
 	zone_contents_t *contents = ctx->contents;
+	bool incremental = ctx->flags & APPLY_INCREMENTAL_ADJUST;
+
+	if (incremental) {
+		int ret = zone_adjust_changes_add(&ctx->changes, contents, rr);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
 
 	// Get or create node with this owner
 	zone_node_t *node = zone_contents_get_node_for_rr(contents, rr);
@@ -261,6 +303,8 @@ int apply_add_rr(apply_ctx_t *ctx, const knot_rrset_t *rr)
 		return KNOT_ENOMEM;
 	}
 
+	size_t old_size = incremental ? rrset_size(node, rr->type) : 0;
+
 	knot_rrset_t changed_rrset = node_rrset(node, rr->type);
 	if (!knot_rrset_empty(&changed_rrset)) {
 		// Modifying existing RRSet.
@@ -289,6 +333,14 @@ int apply_add_rr(apply_ctx_t *ctx, const knot_rrset_t *rr)
 			return data_ret;
 		}
 
+		if (incremental) {
+			contents->size += rrset_size(node, rr->type) - old_size;
+			data_ret = zone_contents_update_referrers(contents, node, rr);
+			if (data_ret != KNOT_EOK) {
+				return data_ret;
+			}
+		}
+
 		if (ret == KNOT_ETTL) {
 			char buff[KNOT_DNAME_TXT_MAXLEN + 1];
 			char *owner = knot_dname_to_str(buff, rr->owner, sizeof(buff));
@@ -325,6 +377,15 @@ int apply_remove_rr(apply_ctx_t *ctx, const knot_rrset_t *rr)
 	zone_tree_t *tree = knot_rrset_is_nsec3rel(rr) ?
 	                    contents->nsec3_nodes : contents->nodes;
 
+	bool incremental = ctx->flags & APPLY_INCREMENTAL_ADJUST;
+	if (incremental) {
+		int ret = zone_adjust_changes_add(&ctx->changes, contents, rr);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+		contents->size -= rrset_size(node, rr->type);
+	}
+
 	knot_rrset_t removed_rrset = node_rrset(node, rr->type);
 	knot_rdata_t *old_data = removed_rrset.rrs.data;
 	int ret = replace_rdataset_with_copy(node, rr->type);
@@ -347,6 +408,14 @@ int apply_remove_rr(apply_ctx_t *ctx, const knot_rrset_t *rr)
 		return ret;
 	}
 
+	if (incremental) {
+		ret = zone_contents_update_referrers(contents, node, rr);
+		if (ret != KNOT_EOK) {
+			clear_new_rrs(node, rr->type);
+			return ret;
+		}
+	}
+
 	if (changed_rrs->rr_count > 0) {
 		// Subtraction left some data in RRSet, store it for rollback.
 		ret = add_new_data(ctx, changed_rrs->data);
@@ -354,11 +423,31 @@ int apply_remove_rr(apply_ctx_t *ctx, const knot_rrset_t *rr)
 			knot_rdataset_clear(changed_rrs, NULL);
 			return ret;
 		}
+
+		if (incremental) {
+			contents->size += rrset_size(node, rr->type);
+		}
 	} else {
 		// RRSet is empty now, remove it from node, all data freed.
+		for (uint16_t i = 0; i < node->rrset_count; ++i) {
+			struct rr_data *data = &node->rrs[i];
+			if (data->type == rr->type) {
+				// Shared additionals are still used by the previous version.
+				if (!binode_additional_shared(node, data->additional)) {
+					additional_clear(data->additional);
+				}
+				data->additional = NULL;
+			}
+		}
 		node_remove_rdataset(node, rr->type);
 		// If node is empty now, delete it from zone tree.
 		if (node->rrset_count == 0 && node != contents->apex) {
+			if (incremental && tree == contents->nsec3_nodes) {
+				ret = zone_adjust_changes_removed(&ctx->changes, node);
+				if (ret != KNOT_EOK) {
+					return ret;
+				}
+			}
 			zone_tree_delete_empty(tree, node);
 		}
 	}
@@ -390,6 +479,10 @@ int apply_replace_soa(apply_ctx_t *ctx, const changeset_t *chset)
 
 int apply_prepare_to_sign(apply_ctx_t *ctx)
 {
+	if (ctx->flags & APPLY_INCREMENTAL_ADJUST) {
+		return adjust(ctx);
+	}
+
 	return zone_contents_adjust_pointers(ctx->contents);
 }
 
@@ -407,7 +500,7 @@ int apply_changesets_directly(apply_ctx_t *ctx, list_t *chsets)
 		}
 	}
 
-	return zone_contents_adjust_full(ctx->contents);
+	return adjust(ctx);
 }
 
 int apply_changeset_directly(apply_ctx_t *ctx, const changeset_t *ch)
@@ -422,7 +515,7 @@ int apply_changeset_directly(apply_ctx_t *ctx, const changeset_t *ch)
 		return ret;
 	}
 
-	ret = zone_contents_adjust_full(ctx->contents);
+	ret = adjust(ctx);
 	if (ret != KNOT_EOK) {
 		update_rollback(ctx);
 		return ret;
@@ -433,7 +526,7 @@ int apply_changeset_directly(apply_ctx_t *ctx, const changeset_t *ch)
 
 int apply_finalize(apply_ctx_t *ctx)
 {
-	return zone_contents_adjust_full(ctx->contents);
+	return adjust(ctx);
 }
 
 void update_cleanup(apply_ctx_t *ctx)
@@ -448,6 +541,8 @@ void update_cleanup(apply_ctx_t *ctx)
 	// Keep new RR data
 	ptrlist_free(&ctx->new_data, NULL);
 	init_list(&ctx->new_data);
+
+	zone_adjust_changes_clear(&ctx->changes);
 }
 
 void update_rollback(apply_ctx_t *ctx)
@@ -462,6 +557,8 @@ void update_rollback(apply_ctx_t *ctx)
 	// Keep old RR data
 	ptrlist_free(&ctx->old_data, NULL);
 	init_list(&ctx->old_data);
+
+	zone_adjust_changes_clear(&ctx->changes);
 }
 
 void update_free_zone(zone_contents_t **contents)
@@ -473,8 +570,13 @@ void update_free_zone(zone_contents_t **contents)
 	(void)zone_tree_apply((*contents)->nodes, free_additional, NULL);
 	zone_tree_deep_free(&(*contents)->nodes);
 	zone_tree_deep_free(&(*contents)->nsec3_nodes);
+	trie_free((*contents)->referrers);
 
 	dnssec_nsec3_params_free(&(*contents)->nsec3_params);
+	answer_cache_free((*contents)->answer_cache);
+	nsec3_cache_free((*contents)->nsec3_cache);
+	xfr_cache_free((*contents)->xfr_cache);
+	zone_arena_unref((*contents)->arena);
 
 	free(*contents);
 	*contents = NULL;
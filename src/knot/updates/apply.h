@@ -22,12 +22,14 @@
 
 enum {
 	APPLY_STRICT = 1 << 0,    /* Apply strictly, don't ignore removing non-existent RRs. */
+	APPLY_INCREMENTAL_ADJUST = 1 << 1, /* Adjust only the changed parts of adjusted contents. */
 };
 
 struct apply_ctx {
 	zone_contents_t *contents;
 	list_t old_data;          /*!< Old data, to be freed after successful update. */
 	list_t new_data;          /*!< New data, to be freed after failed update. */
+	zone_adjust_changes_t changes; /*!< Changes since the last adjusting. */
 	uint32_t flags;
 };
 
@@ -43,7 +45,11 @@ typedef struct apply_ctx apply_ctx_t;
 void apply_init_ctx(apply_ctx_t *ctx, zone_contents_t *contents, uint32_t flags);
 
 /*!
- * \brief Creates a shallow zone contents copy.
+ * \brief Creates a copy-on-write zone contents copy.
+ *
+ * The copy keeps the adjusted pointers of the source, so that it can be
+ * adjusted incrementally (see \ref APPLY_INCREMENTAL_ADJUST). It must be
+ * finished by \ref zone_contents_cow_commit or \ref zone_contents_cow_rollback.
  *
  * \param old_contents  Source.
  * \param new_contents  Target.
@@ -119,7 +125,8 @@ int apply_changeset_directly(apply_ctx_t *ctx, const changeset_t *ch);
 /*!
  * \brief Finalizes the zone contents for publishing.
  *
- * Fully adjusts the zone.
+ * Fully adjusts the zone, or only its changed parts with
+ * \ref APPLY_INCREMENTAL_ADJUST.
  *
  * \param ctx  Apply context.
  *
@@ -142,8 +149,7 @@ void update_cleanup(apply_ctx_t *ctx);
 void update_rollback(apply_ctx_t *ctx);
 
 /*!
- * \brief Shallow frees zone contents - either shallow copy after failed update
- *        or original zone contents after successful update.
+ * \brief Shallow frees zone contents made by \ref zone_contents_shallow_copy.
  *
  * \param contents  Contents to free.
  */
@@ -58,8 +58,9 @@ static void cleanup_iter_list(list_t *l)
 {
 	ptrnode_t *n, *nxt;
 	WALK_LIST_DELSAFE(n, nxt, *l) {
-		trie_it_t *it = (trie_it_t *)n->d;
-		trie_it_free(it);
+		zone_tree_it_t *it = (zone_tree_it_t *)n->d;
+		zone_tree_it_free(it);
+		free(it);
 		rem_node(&n->n);
 		free(n);
 	}
@@ -76,19 +77,22 @@ static int changeset_iter_init(changeset_iter_t *ch_it, size_t tries, ...)
 	va_start(args, tries);
 
 	for (size_t i = 0; i < tries; ++i) {
-		trie_t *t = va_arg(args, trie_t *);
+		zone_tree_t *t = va_arg(args, zone_tree_t *);
 		if (t == NULL) {
 			continue;
 		}
 
-		trie_it_t *it = trie_it_begin(t);
-		if (it == NULL) {
+		zone_tree_it_t *it = malloc(sizeof(*it));
+		if (it == NULL || zone_tree_it_begin(t, it) != KNOT_EOK) {
+			free(it);
 			cleanup_iter_list(&ch_it->iters);
 			va_end(args);
 			return KNOT_ENOMEM;
 		}
 
 		if (ptrlist_add(&ch_it->iters, it, NULL) == NULL) {
+			zone_tree_it_free(it);
+			free(it);
 			cleanup_iter_list(&ch_it->iters);
 			va_end(args);
 			return KNOT_ENOMEM;
@@ -101,27 +105,27 @@ static int changeset_iter_init(changeset_iter_t *ch_it, size_t tries, ...)
 }
 
 /*! \brief Gets next node from trie iterators. */
-static void iter_next_node(changeset_iter_t *ch_it, trie_it_t *t_it)
+static void iter_next_node(changeset_iter_t *ch_it, zone_tree_it_t *t_it)
 {
-	assert(!trie_it_finished(t_it));
+	assert(!zone_tree_it_finished(t_it));
 	// Get next node, but not for the very first call.
 	if (ch_it->node) {
-		trie_it_next(t_it);
+		zone_tree_it_next(t_it);
 	}
-	if (trie_it_finished(t_it)) {
+	if (zone_tree_it_finished(t_it)) {
 		ch_it->node = NULL;
 		return;
 	}
 
-	ch_it->node = (zone_node_t *)*trie_it_val(t_it);
+	ch_it->node = zone_tree_it_val(t_it);
 	assert(ch_it->node);
 	while (ch_it->node && ch_it->node->rrset_count == 0) {
 		// Skip empty non-terminals.
-		trie_it_next(t_it);
-		if (trie_it_finished(t_it)) {
+		zone_tree_it_next(t_it);
+		if (zone_tree_it_finished(t_it)) {
 			ch_it->node = NULL;
 		} else {
-			ch_it->node = (zone_node_t *)*trie_it_val(t_it);
+			ch_it->node = zone_tree_it_val(t_it);
 			assert(ch_it->node);
 		}
 	}
@@ -130,12 +134,12 @@ static void iter_next_node(changeset_iter_t *ch_it, trie_it_t *t_it)
 }
 
 /*! \brief Gets next RRSet from trie iterators. */
-static knot_rrset_t get_next_rr(changeset_iter_t *ch_it, trie_it_t *t_it)
+static knot_rrset_t get_next_rr(changeset_iter_t *ch_it, zone_tree_it_t *t_it)
 {
 	if (ch_it->node == NULL || ch_it->node_pos == ch_it->node->rrset_count) {
 		iter_next_node(ch_it, t_it);
 		if (ch_it->node == NULL) {
-			assert(trie_it_finished(t_it));
+			assert(zone_tree_it_finished(t_it));
 			knot_rrset_t rr;
 			knot_rrset_init_empty(&rr);
 			return rr;
@@ -654,8 +658,8 @@ knot_rrset_t changeset_iter_next(changeset_iter_t *it)
 	knot_rrset_t rr;
 	knot_rrset_init_empty(&rr);
 	WALK_LIST(n, it->iters) {
-		trie_it_t *t_it = (trie_it_t *)n->d;
-		if (trie_it_finished(t_it)) {
+		zone_tree_it_t *t_it = (zone_tree_it_t *)n->d;
+		if (zone_tree_it_finished(t_it)) {
 			continue;
 		}
 
@@ -16,9 +16,11 @@
 
 #include "knot/common/log.h"
 #include "knot/dnssec/zone-events.h"
+#include "knot/dnssec/zone-nsec.h"
 #include "knot/updates/zone-update.h"
 #include "knot/zone/serial.h"
 #include "knot/zone/zone-diff.h"
+#include "contrib/macros.h"
 #include "contrib/mempattern.h"
 #include "contrib/ucw/lists.h"
 #include "contrib/ucw/mempool.h"
@@ -45,13 +47,14 @@ static int init_incremental(zone_update_t *update, zone_t *zone)
 	}
 
 	uint32_t apply_flags = update->flags & UPDATE_STRICT ? APPLY_STRICT : 0;
-	apply_init_ctx(update->a_ctx, update->new_cont, apply_flags);
+	apply_init_ctx(update->a_ctx, update->new_cont,
+	               apply_flags | APPLY_INCREMENTAL_ADJUST);
 
 	/* Copy base SOA RR. */
 	update->change.soa_from =
 		node_create_rrset(zone->contents->apex, KNOT_RRTYPE_SOA);
 	if (update->change.soa_from == NULL) {
-		zone_contents_free(&update->new_cont);
+		zone_contents_cow_rollback(zone->contents, &update->new_cont);
 		changeset_clear(&update->change);
 		return KNOT_ENOMEM;
 	}
@@ -95,6 +98,93 @@ static int replace_soa(zone_contents_t *contents, const knot_rrset_t *rr)
 	return ret;
 }
 
+/*! \brief RRSet replaced since the savepoint. */
+typedef struct {
+	node_t n;
+	knot_rrset_t *rrset;  /*!< RRSet before the change, may be empty. */
+	bool nsec3;           /*!< The RRSet is in the NSEC3 tree. */
+} undo_rrset_t;
+
+static const zone_node_t *undo_node(zone_update_t *update, const undo_rrset_t *undo)
+{
+	const knot_dname_t *owner = undo->rrset->owner;
+	return undo->nsec3 ? zone_contents_find_nsec3_node(update->new_cont, owner) :
+	                     zone_contents_find_node(update->new_cont, owner);
+}
+
+/*! \brief Stores the RRSet about to be changed for a savepoint rollback. */
+static int save_rrset(zone_update_t *update, const knot_rrset_t *rr)
+{
+	if (update->saved_change == NULL) {
+		return KNOT_EOK;
+	}
+
+	undo_rrset_t *undo = malloc(sizeof(*undo));
+	if (undo == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	undo->nsec3 = knot_rrset_is_nsec3rel(rr);
+	undo->rrset = knot_rrset_new(rr->owner, rr->type, rr->rclass, rr->ttl, NULL);
+	if (undo->rrset == NULL) {
+		free(undo);
+		return KNOT_ENOMEM;
+	}
+
+	knot_rrset_t prev = node_rrset(undo_node(update, undo), rr->type);
+	if (!knot_rrset_empty(&prev)) {
+		undo->rrset->ttl = prev.ttl;
+		int ret = knot_rdataset_copy(&undo->rrset->rrs, &prev.rrs, NULL);
+		if (ret != KNOT_EOK) {
+			knot_rrset_free(&undo->rrset, NULL);
+			free(undo);
+			return ret;
+		}
+	}
+
+	add_tail(&update->undo, &undo->n);
+
+	return KNOT_EOK;
+}
+
+/*! \brief Puts back the RRSet stored before the change. */
+static int restore_rrset(zone_update_t *update, const undo_rrset_t *undo)
+{
+	knot_rrset_t cur = node_rrset(undo_node(update, undo), undo->rrset->type);
+	if (!knot_rrset_empty(&cur)) {
+		knot_rrset_t *copy = knot_rrset_copy(&cur, NULL);
+		if (copy == NULL) {
+			return KNOT_ENOMEM;
+		}
+		int ret = apply_remove_rr(update->a_ctx, copy);
+		knot_rrset_free(&copy, NULL);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	if (!knot_rrset_empty(undo->rrset)) {
+		return apply_add_rr(update->a_ctx, undo->rrset);
+	}
+
+	return KNOT_EOK;
+}
+
+static void end_savepoint(zone_update_t *update)
+{
+	undo_rrset_t *undo = NULL, *nxt = NULL;
+	WALK_LIST_DELSAFE(undo, nxt, update->undo) {
+		knot_rrset_free(&undo->rrset, NULL);
+		free(undo);
+	}
+	init_list(&update->undo);
+
+	changeset_clear(&update->change);
+	update->change = *update->saved_change;
+	free(update->saved_change);
+	update->saved_change = NULL;
+}
+
 /* ------------------------------- API -------------------------------------- */
 
 int zone_update_init(zone_update_t *update, zone_t *zone, zone_update_flags_t flags)
@@ -277,6 +367,10 @@ void zone_update_clear(zone_update_t *update)
 		return;
 	}
 
+	if (update->saved_change != NULL) {
+		end_savepoint(update);
+	}
+
 	if (update->flags & UPDATE_INCREMENTAL) {
 		/* Revert any changes on error, do nothing on success. */
 		if (update->new_cont_deep_copy) {
@@ -284,7 +378,7 @@ void zone_update_clear(zone_update_t *update)
 			zone_contents_deep_free(&update->new_cont);
 		} else {
 			update_rollback(update->a_ctx);
-			update_free_zone(&update->new_cont);
+			zone_contents_cow_rollback(update->zone->contents, &update->new_cont);
 		}
 		changeset_clear(&update->change);
 	} else if (update->flags & UPDATE_FULL) {
@@ -303,7 +397,12 @@ int zone_update_add(zone_update_t *update, const knot_rrset_t *rrset)
 	}
 
 	if (update->flags & UPDATE_INCREMENTAL) {
-		int ret = changeset_add_addition(&update->change, rrset, CHANGESET_CHECK);
+		int ret = save_rrset(update, rrset);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+
+		ret = changeset_add_addition(&update->change, rrset, CHANGESET_CHECK);
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
@@ -325,6 +424,7 @@ int zone_update_add(zone_update_t *update, const knot_rrset_t *rrset)
 
 		return KNOT_EOK;
 	} else if (update->flags & UPDATE_FULL) {
+		update->new_cont_adjusted = false;
 		if (rrset->type == KNOT_RRTYPE_SOA) {
 			/* replace previous SOA */
 			return replace_soa(update->new_cont, rrset);
@@ -359,7 +459,12 @@ int zone_update_remove(zone_update_t *update, const knot_rrset_t *rrset)
 	}
 
 	if (update->flags & UPDATE_INCREMENTAL) {
-		int ret = changeset_add_removal(&update->change, rrset, CHANGESET_CHECK);
+		int ret = save_rrset(update, rrset);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+
+		ret = changeset_add_removal(&update->change, rrset, CHANGESET_CHECK);
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
@@ -377,6 +482,7 @@ int zone_update_remove(zone_update_t *update, const knot_rrset_t *rrset)
 
 		return KNOT_EOK;
 	} else if (update->flags & UPDATE_FULL) {
+		update->new_cont_adjusted = false;
 		zone_node_t *n = NULL;
 		knot_rrset_t *rrs_copy = knot_rrset_copy(rrset, &update->mm);
 		int ret = zone_contents_remove_rr(update->new_cont, rrs_copy, &n);
@@ -401,8 +507,12 @@ int zone_update_remove_rrset(zone_update_t *update, knot_dname_t *owner, uint16_
 			if (rrset.owner == NULL) {
 				return KNOT_ENOENT;
 			}
-			int ret = changeset_add_removal(&update->change, &rrset,
-			                                CHANGESET_CHECK);
+			int ret = save_rrset(update, &rrset);
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
+			ret = changeset_add_removal(&update->change, &rrset,
+			                            CHANGESET_CHECK);
 			if (ret != KNOT_EOK) {
 				return ret;
 			}
@@ -449,8 +559,12 @@ int zone_update_remove_node(zone_update_t *update, const knot_dname_t *owner)
 			size_t rrset_count = node->rrset_count;
 			for (int i = 0; i < rrset_count; ++i) {
 				knot_rrset_t rrset = node_rrset_at(node, rrset_count - 1 - i);
-				int ret = changeset_add_removal(&update->change, &rrset,
-				                                CHANGESET_CHECK);
+				int ret = save_rrset(update, &rrset);
+				if (ret != KNOT_EOK) {
+					return ret;
+				}
+				ret = changeset_add_removal(&update->change, &rrset,
+				                            CHANGESET_CHECK);
 				if (ret != KNOT_EOK) {
 					return ret;
 				}
@@ -512,6 +626,77 @@ int zone_update_apply_changeset_fix(zone_update_t *update, changeset_t *changes)
 	return ret;
 }
 
+int zone_update_savepoint(zone_update_t *update)
+{
+	if (update == NULL || !(update->flags & UPDATE_INCREMENTAL) ||
+	    update->saved_change != NULL) {
+		return KNOT_EINVAL;
+	}
+
+	changeset_t *saved = malloc(sizeof(*saved));
+	if (saved == NULL) {
+		return KNOT_ENOMEM;
+	}
+	*saved = update->change;
+
+	int ret = changeset_init(&update->change, update->zone->name);
+	if (ret != KNOT_EOK) {
+		update->change = *saved;
+		free(saved);
+		return ret;
+	}
+
+	/* Replace the current SOA, keep the new one for the merge. */
+	update->change.soa_from = node_create_rrset(update->new_cont->apex,
+	                                            KNOT_RRTYPE_SOA);
+	if (saved->soa_to != NULL) {
+		update->change.soa_to = knot_rrset_copy(saved->soa_to, NULL);
+	}
+	if (update->change.soa_from == NULL ||
+	    (saved->soa_to != NULL && update->change.soa_to == NULL)) {
+		changeset_clear(&update->change);
+		update->change = *saved;
+		free(saved);
+		return KNOT_ENOMEM;
+	}
+
+	init_list(&update->undo);
+	update->saved_change = saved;
+
+	return KNOT_EOK;
+}
+
+int zone_update_savepoint_release(zone_update_t *update)
+{
+	if (update == NULL || update->saved_change == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	int ret = changeset_merge(update->saved_change, &update->change, 0);
+	end_savepoint(update);
+
+	return ret;
+}
+
+int zone_update_savepoint_rollback(zone_update_t *update)
+{
+	if (update == NULL || update->saved_change == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	int ret = KNOT_EOK;
+	undo_rrset_t *undo = NULL;
+	WALK_LIST_BACKWARDS(undo, update->undo) {
+		ret = restore_rrset(update, undo);
+		if (ret != KNOT_EOK) {
+			break;
+		}
+	}
+	end_savepoint(update);
+
+	return ret;
+}
+
 static int set_new_soa(zone_update_t *update, unsigned serial_policy)
 {
 	assert(update);
@@ -610,10 +795,13 @@ static int commit_full(conf_t *conf, zone_update_t *update, zone_contents_t **co
 		return KNOT_ESEMCHECK;
 	}
 
-	int ret = zone_contents_adjust_full(update->new_cont);
-	if (ret != KNOT_EOK) {
-		zone_update_clear(update);
-		return ret;
+	int ret = KNOT_EOK;
+	if (!update->new_cont_adjusted) {
+		ret = zone_contents_adjust_full(update->new_cont);
+		if (ret != KNOT_EOK) {
+			zone_update_clear(update);
+			return ret;
+		}
 	}
 
 	/* Store new zone contents in journal. */
@@ -698,6 +886,42 @@ int zone_update_commit(conf_t *conf, zone_update_t *update)
 		return KNOT_EZONESIZE;
 	}
 
+	/* Pack complete new contents into one memory block if configured. */
+	val = conf_zone_get(conf, C_COMPACT_CONTENTS, update->zone->name);
+	if (conf_bool(&val) && update->new_cont_deep_copy && new_contents->arena == NULL) {
+		zone_memory_t before, after;
+		zone_contents_measure_memory(new_contents, &before);
+		ret = zone_contents_compact(new_contents);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+		zone_contents_measure_memory(new_contents, &after);
+		log_zone_info(update->zone->name, "zone contents compacted, %zu nodes, "
+		              "%zu -> %zu bytes, %zu -> %zu allocations", after.nodes,
+		              before.bytes, after.bytes, before.allocations,
+		              after.allocations);
+	}
+
+	/* Start with empty answer cache for the new version. */
+	val = conf_zone_get(conf, C_ANSWER_CACHE, update->zone->name);
+	answer_cache_free(new_contents->answer_cache);
+	new_contents->answer_cache = answer_cache_new(conf_int(&val));
+
+	/* Outgoing transfers of the new version are rendered again. */
+	val = conf_zone_get(conf, C_XFR_CACHE, update->zone->name);
+	xfr_cache_free(new_contents->xfr_cache);
+	new_contents->xfr_cache = xfr_cache_new(conf_int(&val));
+
+	/* Cache hashed names for NSEC3 proofs, sized by the zone. */
+	nsec3_cache_free(new_contents->nsec3_cache);
+	new_contents->nsec3_cache = NULL;
+	if (knot_is_nsec3_enabled(new_contents)) {
+		size_t slots = zone_tree_count(new_contents->nodes);
+		slots = MAX(1, MIN(slots, NSEC3_CACHE_MAX_SIZE));
+		new_contents->nsec3_cache = nsec3_cache_new(slots,
+		                                            &new_contents->nsec3_params);
+	}
+
 	/* Switch zone contents. */
 	zone_contents_t *old_contents;
 	old_contents = zone_switch_contents(update->zone, new_contents);
@@ -710,7 +934,9 @@ int zone_update_commit(conf_t *conf, zone_update_t *update)
 		if (update->new_cont_deep_copy) {
 			callrcu_wrapper(old_contents, (void (*)(void *))zone_contents_deep_free, true);
 		} else {
-			callrcu_wrapper(old_contents, (void (*)(void *))update_free_zone, true);
+			/* The nodes shared with the old version are finished once it isn't read. */
+			synchronize_rcu();
+			zone_contents_cow_commit(&old_contents, new_contents);
 		}
 		changeset_clear(&update->change);
 	}
@@ -735,27 +961,28 @@ static int iter_init_tree_iters(zone_update_iter_t *it, zone_update_t *update,
 
 	/* Begin iteration. We can safely assume _contents is a valid pointer. */
 	zone_tree_t *tree = nsec3 ? _contents->nsec3_nodes : _contents->nodes;
-	it->tree_it = trie_it_begin(tree);
-	if (it->tree_it == NULL) {
-		return KNOT_ENOMEM;
+	int ret = zone_tree_it_begin(tree, &it->tree_it);
+	if (ret != KNOT_EOK) {
+		return ret;
 	}
 
-	it->cur_node = (zone_node_t *)(*trie_it_val(it->tree_it));
+	if (!zone_tree_it_finished(&it->tree_it)) {
+		it->cur_node = zone_tree_it_val(&it->tree_it);
+	}
 
 	return KNOT_EOK;
 }
 
 static int iter_get_next_node(zone_update_iter_t *it)
 {
-	trie_it_next(it->tree_it);
-	if (trie_it_finished(it->tree_it)) {
-		trie_it_free(it->tree_it);
-		it->tree_it = NULL;
+	zone_tree_it_next(&it->tree_it);
+	if (zone_tree_it_finished(&it->tree_it)) {
+		zone_tree_it_free(&it->tree_it);
 		it->cur_node = NULL;
 		return KNOT_ENOENT;
 	}
 
-	it->cur_node = (zone_node_t *)(*trie_it_val(it->tree_it));
+	it->cur_node = zone_tree_it_val(&it->tree_it);
 
 	return KNOT_EOK;
 }
@@ -766,14 +993,7 @@ static int iter_init(zone_update_iter_t *it, zone_update_t *update, const bool n
 
 	it->update = update;
 	it->nsec3 = nsec3;
-	int ret = iter_init_tree_iters(it, update, nsec3);
-	if (ret != KNOT_EOK) {
-		return ret;
-	}
-
-	it->cur_node = (zone_node_t *)(*trie_it_val(it->tree_it));
-
-	return KNOT_EOK;
+	return iter_init_tree_iters(it, update, nsec3);
 }
 
 int zone_update_iter(zone_update_iter_t *it, zone_update_t *update)
@@ -813,7 +1033,7 @@ int zone_update_iter_next(zone_update_iter_t *it)
 		return KNOT_EINVAL;
 	}
 
-	if (it->tree_it != NULL) {
+	if (!zone_tree_it_finished(&it->tree_it)) {
 		int ret = iter_get_next_node(it);
 		if (ret != KNOT_EOK && ret != KNOT_ENOENT) {
 			return ret;
@@ -838,7 +1058,7 @@ void zone_update_iter_finish(zone_update_iter_t *it)
 		return;
 	}
 
-	trie_it_free(it->tree_it);
+	zone_tree_it_free(&it->tree_it);
 }
 
 bool zone_update_no_change(zone_update_t *update)
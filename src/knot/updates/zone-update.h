@@ -28,7 +28,10 @@ typedef struct zone_update {
 	zone_t *zone;                /*!< Zone being updated. */
 	zone_contents_t *new_cont;   /*!< New zone contents for full updates. */
 	bool new_cont_deep_copy;     /*!< On update_clear, perform deep free instead of shallow. */
+	bool new_cont_adjusted;      /*!< Full update contents adjusted and not changed since. */
 	changeset_t change;          /*!< Changes we want to apply. */
+	changeset_t *saved_change;   /*!< Changes set aside by a savepoint. */
+	list_t undo;                 /*!< RRSets replaced since the savepoint. */
 	apply_ctx_t *a_ctx;          /*!< Context for applying changesets. */
 	uint32_t flags;              /*!< Zone update flags. */
 	knot_mm_t mm;                /*!< Memory context used for intermediate nodes. */
@@ -36,7 +39,7 @@ typedef struct zone_update {
 
 typedef struct {
 	zone_update_t *update;          /*!< The update we're iterating over. */
-	trie_it_t *tree_it;             /*!< Iterator for the new zone. */
+	zone_tree_it_t tree_it;         /*!< Iterator for the new zone. */
 	const zone_node_t *cur_node;    /*!< Current node in the new zone. */
 	bool nsec3;                     /*!< Set when we're using the NSEC3 node tree. */
 } zone_update_iter_t;
@@ -228,6 +231,37 @@ int zone_update_apply_changeset(zone_update_t *update, const changeset_t *change
  */
 int zone_update_apply_changeset_fix(zone_update_t *update, changeset_t *changes);
 
+/*!
+ * \brief Sets a savepoint the following changes can be undone to.
+ *
+ * The changes made so far are set aside and the following ones are collected
+ * separately until the savepoint is released or rolled back. Only incremental
+ * updates are supported.
+ *
+ * \param update  Zone update.
+ *
+ * \return KNOT_E*
+ */
+int zone_update_savepoint(zone_update_t *update);
+
+/*!
+ * \brief Keeps the changes made since the savepoint and releases it.
+ *
+ * \param update  Zone update.
+ *
+ * \return KNOT_E*, the update must be cleared on error.
+ */
+int zone_update_savepoint_release(zone_update_t *update);
+
+/*!
+ * \brief Undoes the changes made since the savepoint and releases it.
+ *
+ * \param update  Zone update.
+ *
+ * \return KNOT_E*, the update must be cleared on error.
+ */
+int zone_update_savepoint_rollback(zone_update_t *update);
+
 /*!
  * \brief Increment SOA serial (according to cofigured policy) in the update.
  *
@@ -23,71 +23,164 @@
 #include "libknot/libknot.h"
 #include "knot/server/dthreads.h"
 #include "knot/worker/pool.h"
+#include "contrib/time.h"
+
+#ifdef HAVE_ATOMIC
+#define ATOMIC_GET(src)      __atomic_load_n(&(src), __ATOMIC_SEQ_CST)
+#define ATOMIC_SET(dst, val) __atomic_store_n(&(dst), (val), __ATOMIC_SEQ_CST)
+#define ATOMIC_ADD(dst, val) __atomic_add_fetch(&(dst), (val), __ATOMIC_SEQ_CST)
+#define ATOMIC_SUB(dst, val) __atomic_sub_fetch(&(dst), (val), __ATOMIC_SEQ_CST)
+#else
+#define ATOMIC_GET(src)      __sync_fetch_and_add(&(src), 0)
+#define ATOMIC_SET(dst, val) do { __sync_synchronize(); (dst) = (val); __sync_synchronize(); } while (0)
+#define ATOMIC_ADD(dst, val) __sync_add_and_fetch(&(dst), (val))
+#define ATOMIC_SUB(dst, val) __sync_sub_and_fetch(&(dst), (val))
+#endif
+
+/*! \brief Task queue of one worker, the other workers can steal from it. */
+typedef struct {
+	pthread_mutex_t lock;
+	worker_queue_t tasks[WORKER_PRIO_COUNT];
+	worker_pool_stats_t stats[WORKER_PRIO_COUNT]; /*!< Metrics of taken tasks. */
+} thread_queue_t;
 
-/*!
- * \brief Worker pool state.
- */
 struct worker_pool {
 	dt_unit_t *threads;
 
-	pthread_mutex_t lock;
-	pthread_cond_t wake;
+	thread_queue_t *queues;	/*!< Task queue of each worker. */
+	unsigned queue_count;	/*!< Number of the queues. */
+	unsigned next_queue;	/*!< Queue for the next task (round robin). */
+
+	pthread_mutex_t lock;	/*!< Protects sleeping, suspension, and termination. */
+	pthread_cond_t wake;	/*!< Wakes up idle workers. */
+	pthread_cond_t done;	/*!< Signals no pending or running tasks. */
 
 	bool terminating;	/*!< Is the pool terminating? .*/
 	bool suspended;		/*!< Is execution temporarily suspended? .*/
+	int idle;		/*!< Number of sleeping threads. */
 	int running;		/*!< Number of running threads. */
-	worker_queue_t tasks;
+	size_t pending[WORKER_PRIO_COUNT]; /*!< Number of enqueued tasks. */
 };
 
+static size_t pending_total(worker_pool_t *pool)
+{
+	size_t total = 0;
+	for (unsigned prio = 0; prio < WORKER_PRIO_COUNT; prio++) {
+		total += ATOMIC_GET(pool->pending[prio]);
+	}
+
+	return total;
+}
+
+static void stats_add(worker_pool_stats_t *stats, const struct timespec *queued)
+{
+	struct timespec now = time_now();
+	struct timespec wait = time_diff(queued, &now);
+	uint64_t wait_usec = wait.tv_sec * 1000000 + wait.tv_nsec / 1000;
+
+	stats->executed += 1;
+	stats->wait_usec += wait_usec;
+	if (wait_usec > stats->wait_max_usec) {
+		stats->wait_max_usec = wait_usec;
+	}
+}
+
 /*!
- * \brief Worker thread.
- *
- * The thread takes a task from the tasks queue and runs it, while checking
- * if the dispatching of new tasks is allowed by the thread pool.
- *
- * An execution of a running thread cannot be enforced.
+ * \brief Take the task of the highest priority class.
  *
+ * Own queue is tried first, then the tasks are stolen from the other queues.
  */
+static task_t *take_task(worker_pool_t *pool, unsigned self)
+{
+	for (unsigned prio = 0; prio < WORKER_PRIO_COUNT; prio++) {
+		if (ATOMIC_GET(pool->pending[prio]) == 0) {
+			continue;
+		}
+
+		for (unsigned i = 0; i < pool->queue_count; i++) {
+			thread_queue_t *queue = &pool->queues[(self + i) % pool->queue_count];
+
+			pthread_mutex_lock(&queue->lock);
+			struct timespec queued;
+			task_t *task = worker_queue_dequeue_timed(&queue->tasks[prio], &queued);
+			if (task != NULL) {
+				// Counted as running before not pending for worker_pool_wait().
+				ATOMIC_ADD(pool->running, 1);
+				ATOMIC_SUB(pool->pending[prio], 1);
+				stats_add(&queue->stats[prio], &queued);
+			}
+			pthread_mutex_unlock(&queue->lock);
+
+			if (task != NULL) {
+				return task;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*! \brief Sleep till there is something to do. */
+static void worker_sleep(worker_pool_t *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+
+	// Announced as idle before checking the tasks, see worker_pool_assign().
+	ATOMIC_ADD(pool->idle, 1);
+	if (!pool->terminating && (pool->suspended || pending_total(pool) == 0)) {
+		pthread_cond_wait(&pool->wake, &pool->lock);
+	}
+	ATOMIC_SUB(pool->idle, 1);
+
+	pthread_mutex_unlock(&pool->lock);
+}
+
 static int worker_main(dthread_t *thread)
 {
 	assert(thread);
 
 	worker_pool_t *pool = thread->data;
-
-	pthread_mutex_lock(&pool->lock);
+	unsigned self = dt_get_id(thread) % pool->queue_count;
 
 	for (;;) {
-		if (pool->terminating) {
+		if (ATOMIC_GET(pool->terminating)) {
 			break;
 		}
 
 		task_t *task = NULL;
-		if (!pool->suspended) {
-			task = worker_queue_dequeue(&pool->tasks);
+		if (!ATOMIC_GET(pool->suspended)) {
+			task = take_task(pool, self);
 		}
 
 		if (task == NULL) {
-			pthread_cond_wait(&pool->wake, &pool->lock);
+			worker_sleep(pool);
 			continue;
 		}
 
 		assert(task->run);
-		pool->running += 1;
-
-		pthread_mutex_unlock(&pool->lock);
 		task->run(task);
-		pthread_mutex_lock(&pool->lock);
 
-		pool->running -= 1;
-		pthread_cond_broadcast(&pool->wake);
+		if (ATOMIC_SUB(pool->running, 1) == 0 && pending_total(pool) == 0) {
+			pthread_mutex_lock(&pool->lock);
+			pthread_cond_broadcast(&pool->done);
+			pthread_mutex_unlock(&pool->lock);
+		}
 	}
 
-	pthread_mutex_unlock(&pool->lock);
-
 	return KNOT_EOK;
 }
 
-/* -- public API ------------------------------------------------------------ */
+static void queues_free(worker_pool_t *pool)
+{
+	for (unsigned i = 0; i < pool->queue_count; i++) {
+		thread_queue_t *queue = &pool->queues[i];
+		for (unsigned prio = 0; prio < WORKER_PRIO_COUNT; prio++) {
+			worker_queue_deinit(&queue->tasks[prio]);
+		}
+		pthread_mutex_destroy(&queue->lock);
+	}
+	free(pool->queues);
+}
 
 worker_pool_t *worker_pool_create(unsigned threads)
 {
@@ -102,6 +195,19 @@ worker_pool_t *worker_pool_create(unsigned threads)
 		goto fail;
 	}
 
+	pool->queues = calloc(threads, sizeof(thread_queue_t));
+	if (pool->queues == NULL) {
+		goto fail;
+	}
+	for (unsigned i = 0; i < threads; i++) {
+		thread_queue_t *queue = &pool->queues[i];
+		pthread_mutex_init(&queue->lock, NULL);
+		for (unsigned prio = 0; prio < WORKER_PRIO_COUNT; prio++) {
+			worker_queue_init(&queue->tasks[prio]);
+		}
+		pool->queue_count++;
+	}
+
 	if (pthread_mutex_init(&pool->lock, NULL) != 0) {
 		goto fail;
 	}
@@ -110,12 +216,15 @@ worker_pool_t *worker_pool_create(unsigned threads)
 		goto fail;
 	}
 
-	worker_queue_init(&pool->tasks);
+	if (pthread_cond_init(&pool->done, NULL) != 0) {
+		goto fail;
+	}
 
 	return pool;
 
 fail:
 	dt_delete(&pool->threads);
+	queues_free(pool);
 	free(pool);
 	return NULL;
 }
@@ -130,8 +239,9 @@ void worker_pool_destroy(worker_pool_t *pool)
 
 	pthread_mutex_destroy(&pool->lock);
 	pthread_cond_destroy(&pool->wake);
+	pthread_cond_destroy(&pool->done);
 
-	worker_queue_deinit(&pool->tasks);
+	queues_free(pool);
 
 	free(pool);
 }
@@ -152,7 +262,7 @@ void worker_pool_stop(worker_pool_t *pool)
 	}
 
 	pthread_mutex_lock(&pool->lock);
-	pool->terminating = true;
+	ATOMIC_SET(pool->terminating, true);
 	pthread_cond_broadcast(&pool->wake);
 	pthread_mutex_unlock(&pool->lock);
 
@@ -166,7 +276,7 @@ void worker_pool_suspend(worker_pool_t *pool)
 	}
 
 	pthread_mutex_lock(&pool->lock);
-	pool->suspended = true;
+	ATOMIC_SET(pool->suspended, true);
 	pthread_mutex_unlock(&pool->lock);
 }
 
@@ -177,7 +287,7 @@ void worker_pool_resume(worker_pool_t *pool)
 	}
 
 	pthread_mutex_lock(&pool->lock);
-	pool->suspended = false;
+	ATOMIC_SET(pool->suspended, false);
 	pthread_cond_broadcast(&pool->wake);
 	pthread_mutex_unlock(&pool->lock);
 }
@@ -198,8 +308,8 @@ void worker_pool_wait(worker_pool_t *pool)
 	}
 
 	pthread_mutex_lock(&pool->lock);
-	while (!EMPTY_LIST(pool->tasks.list) || pool->running > 0) {
-		pthread_cond_wait(&pool->wake, &pool->lock);
+	while (pending_total(pool) > 0 || ATOMIC_GET(pool->running) > 0) {
+		pthread_cond_wait(&pool->done, &pool->lock);
 	}
 	pthread_mutex_unlock(&pool->lock);
 }
@@ -210,10 +320,23 @@ void worker_pool_assign(worker_pool_t *pool, struct task *task)
 		return;
 	}
 
-	pthread_mutex_lock(&pool->lock);
-	worker_queue_enqueue(&pool->tasks, task);
-	pthread_cond_signal(&pool->wake);
-	pthread_mutex_unlock(&pool->lock);
+	unsigned prio = (task->prio < WORKER_PRIO_COUNT) ? task->prio : WORKER_PRIO_LOW;
+	unsigned index = ATOMIC_ADD(pool->next_queue, 1) % pool->queue_count;
+	thread_queue_t *queue = &pool->queues[index];
+
+	pthread_mutex_lock(&queue->lock);
+	int ret = worker_queue_enqueue(&queue->tasks[prio], task);
+	if (ret == KNOT_EOK) {
+		ATOMIC_ADD(pool->pending[prio], 1);
+	}
+	pthread_mutex_unlock(&queue->lock);
+
+	// A worker going to sleep either sees the task or is seen as idle.
+	if (ret == KNOT_EOK && ATOMIC_GET(pool->idle) > 0) {
+		pthread_mutex_lock(&pool->lock);
+		pthread_cond_signal(&pool->wake);
+		pthread_mutex_unlock(&pool->lock);
+	}
 }
 
 void worker_pool_clear(worker_pool_t *pool)
@@ -222,8 +345,43 @@ void worker_pool_clear(worker_pool_t *pool)
 		return;
 	}
 
+	for (unsigned i = 0; i < pool->queue_count; i++) {
+		thread_queue_t *queue = &pool->queues[i];
+		pthread_mutex_lock(&queue->lock);
+		for (unsigned prio = 0; prio < WORKER_PRIO_COUNT; prio++) {
+			size_t cleared = worker_queue_size(&queue->tasks[prio]);
+			worker_queue_deinit(&queue->tasks[prio]);
+			worker_queue_init(&queue->tasks[prio]);
+			ATOMIC_SUB(pool->pending[prio], cleared);
+		}
+		pthread_mutex_unlock(&queue->lock);
+	}
+
 	pthread_mutex_lock(&pool->lock);
-	worker_queue_deinit(&pool->tasks);
-	worker_queue_init(&pool->tasks);
+	pthread_cond_broadcast(&pool->done);
 	pthread_mutex_unlock(&pool->lock);
 }
+
+void worker_pool_stats(worker_pool_t *pool, worker_prio_t prio, worker_pool_stats_t *stats)
+{
+	if (!stats) {
+		return;
+	}
+
+	memset(stats, 0, sizeof(*stats));
+	if (!pool || prio >= WORKER_PRIO_COUNT) {
+		return;
+	}
+
+	stats->queued = ATOMIC_GET(pool->pending[prio]);
+	for (unsigned i = 0; i < pool->queue_count; i++) {
+		thread_queue_t *queue = &pool->queues[i];
+		pthread_mutex_lock(&queue->lock);
+		stats->executed += queue->stats[prio].executed;
+		stats->wait_usec += queue->stats[prio].wait_usec;
+		if (queue->stats[prio].wait_max_usec > stats->wait_max_usec) {
+			stats->wait_max_usec = queue->stats[prio].wait_max_usec;
+		}
+		pthread_mutex_unlock(&queue->lock);
+	}
+}
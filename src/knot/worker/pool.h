@@ -16,11 +16,33 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #include "knot/worker/queue.h"
 
 struct worker_pool;
 typedef struct worker_pool worker_pool_t;
 
+/*!
+ * \brief Task priority classes, tasks of a higher class are processed first.
+ */
+typedef enum {
+	WORKER_PRIO_HIGH = 0,	/*!< Urgent tasks, e.g. user-triggered. */
+	WORKER_PRIO_NORMAL,	/*!< Regular tasks. */
+	WORKER_PRIO_LOW,	/*!< Bulk tasks, e.g. periodic maintenance. */
+	WORKER_PRIO_COUNT
+} worker_prio_t;
+
+/*!
+ * \brief Metrics of a task priority class.
+ */
+typedef struct {
+	size_t queued;		/*!< Number of tasks waiting in the queues. */
+	uint64_t executed;	/*!< Number of tasks taken for execution. */
+	uint64_t wait_usec;	/*!< Total time the executed tasks waited. */
+	uint64_t wait_max_usec;	/*!< Longest time an executed task waited. */
+} worker_pool_stats_t;
+
 /*!
  * \brief Initialize worker pool.
  *
@@ -68,6 +90,10 @@ void worker_pool_wait(worker_pool_t *pool);
 
 /*!
  * \brief Assign a task to be performed by a worker in the pool.
+ *
+ * Each worker has its own queue, the tasks are distributed among them and
+ * idle workers steal the tasks from the others. The tasks are processed
+ * according to their priority class (task->prio).
  */
 void worker_pool_assign(worker_pool_t *pool, struct task *task);
 
@@ -75,3 +101,12 @@ void worker_pool_assign(worker_pool_t *pool, struct task *task);
  * \brief Clear all tasks enqueued in pool processing queue.
  */
 void worker_pool_clear(worker_pool_t *pool);
+
+/*!
+ * \brief Get metrics of a task priority class.
+ *
+ * \param pool   Worker pool.
+ * \param prio   Priority class.
+ * \param stats  Output metrics.
+ */
+void worker_pool_stats(worker_pool_t *pool, worker_prio_t prio, worker_pool_stats_t *stats);
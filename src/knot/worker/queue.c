@@ -15,7 +15,16 @@
 */
 
 #include "knot/worker/queue.h"
+#include "libknot/errcode.h"
 #include "contrib/mempattern.h"
+#include "contrib/time.h"
+
+/*! \brief Enqueued task with the enqueue time. */
+typedef struct {
+	node_t n;
+	task_t *task;
+	struct timespec queued;
+} queue_node_t;
 
 void worker_queue_init(worker_queue_t *queue)
 {
@@ -31,19 +40,36 @@ void worker_queue_init(worker_queue_t *queue)
 
 void worker_queue_deinit(worker_queue_t *queue)
 {
-	ptrlist_free(&queue->list, &queue->mm_ctx);
+	if (!queue) {
+		return;
+	}
+
+	node_t *node, *nxt;
+	WALK_LIST_DELSAFE(node, nxt, queue->list) {
+		mm_free(&queue->mm_ctx, node);
+	}
+	init_list(&queue->list);
 }
 
-void worker_queue_enqueue(worker_queue_t *queue, task_t *task)
+int worker_queue_enqueue(worker_queue_t *queue, task_t *task)
 {
 	if (!queue || !task) {
-		return;
+		return KNOT_EINVAL;
+	}
+
+	queue_node_t *node = mm_alloc(&queue->mm_ctx, sizeof(*node));
+	if (node == NULL) {
+		return KNOT_ENOMEM;
 	}
 
-	ptrlist_add(&queue->list, task, &queue->mm_ctx);
+	node->task = task;
+	node->queued = time_now();
+	add_tail(&queue->list, &node->n);
+
+	return KNOT_EOK;
 }
 
-task_t *worker_queue_dequeue(worker_queue_t *queue)
+task_t *worker_queue_dequeue_timed(worker_queue_t *queue, struct timespec *queued)
 {
 	if (!queue) {
 		return NULL;
@@ -52,11 +78,24 @@ task_t *worker_queue_dequeue(worker_queue_t *queue)
 	task_t *task = NULL;
 
 	if (!EMPTY_LIST(queue->list)) {
-		ptrnode_t *node = HEAD(queue->list);
-		task = (void *)node->d;
+		queue_node_t *node = HEAD(queue->list);
+		task = node->task;
+		if (queued != NULL) {
+			*queued = node->queued;
+		}
 		rem_node(&node->n);
-		queue->mm_ctx.free(&node->n);
+		mm_free(&queue->mm_ctx, node);
 	}
 
 	return task;
 }
+
+task_t *worker_queue_dequeue(worker_queue_t *queue)
+{
+	return worker_queue_dequeue_timed(queue, NULL);
+}
+
+size_t worker_queue_size(worker_queue_t *queue)
+{
+	return (queue != NULL) ? list_size(&queue->list) : 0;
+}
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <time.h>
+
 #include "contrib/ucw/lists.h"
 
 struct task;
@@ -27,6 +29,7 @@ typedef void (*task_cb)(struct task *);
 typedef struct task {
 	void *ctx;
 	task_cb run;
+	unsigned prio;	/*!< Priority class (worker_prio_t), highest is 0. */
 } task_t;
 
 /*!
@@ -48,9 +51,11 @@ void worker_queue_init(worker_queue_t *queue);
 void worker_queue_deinit(worker_queue_t *queue);
 
 /*!
- * \brief Insert new item into the queue.
+ * \brief Insert new item into the queue, remember the time of insertion.
+ *
+ * \return KNOT_E*
  */
-void worker_queue_enqueue(worker_queue_t *queue, task_t *task);
+int worker_queue_enqueue(worker_queue_t *queue, task_t *task);
 
 /*!
  * \brief Remove item from the queue.
@@ -58,3 +63,18 @@ void worker_queue_enqueue(worker_queue_t *queue, task_t *task);
  * \return Task or NULL if the queue is empty.
  */
 task_t *worker_queue_dequeue(worker_queue_t *queue);
+
+/*!
+ * \brief Remove item from the queue, get the time of its insertion.
+ *
+ * \param queue   Worker queue.
+ * \param queued  Output time of insertion (optional).
+ *
+ * \return Task or NULL if the queue is empty.
+ */
+task_t *worker_queue_dequeue_timed(worker_queue_t *queue, struct timespec *queued);
+
+/*!
+ * \brief Get the number of items in the queue.
+ */
+size_t worker_queue_size(worker_queue_t *queue);
@@ -0,0 +1,167 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <urcu.h>
+
+#include "knot/zone/answer-cache.h"
+#include "libknot/errcode.h"
+
+/*! \brief Number of probed slots. */
+#define ANSWER_CACHE_PROBES 4
+
+typedef struct {
+	uint32_t hash;
+	uint16_t qtype;
+	uint16_t max_size;
+	uint8_t flags;
+	uint8_t qname_len;
+	uint16_t wire_len;
+	uint8_t data[];     /*!< QNAME followed by the answer wire. */
+} answer_cache_entry_t;
+
+struct answer_cache {
+	size_t size;
+	answer_cache_entry_t *slots[];
+};
+
+static uint32_t key_hash(const answer_cache_key_t *key, size_t qname_len)
+{
+	/* FNV-1a. */
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < qname_len; i++) {
+		hash = (hash ^ key->qname[i]) * 16777619u;
+	}
+	uint8_t tail[] = {
+		key->qtype >> 8, key->qtype & 0xff,
+		key->max_size >> 8, key->max_size & 0xff,
+		key->flags
+	};
+	for (size_t i = 0; i < sizeof(tail); i++) {
+		hash = (hash ^ tail[i]) * 16777619u;
+	}
+
+	return hash;
+}
+
+static bool key_match(const answer_cache_entry_t *entry, uint32_t hash,
+                      const answer_cache_key_t *key, size_t qname_len)
+{
+	return entry->hash == hash &&
+	       entry->qtype == key->qtype &&
+	       entry->max_size == key->max_size &&
+	       entry->flags == key->flags &&
+	       entry->qname_len == qname_len &&
+	       memcmp(entry->data, key->qname, qname_len) == 0;
+}
+
+answer_cache_t *answer_cache_new(size_t size)
+{
+	if (size == 0) {
+		return NULL;
+	}
+
+	answer_cache_t *cache = calloc(1, sizeof(*cache) + size * sizeof(cache->slots[0]));
+	if (cache == NULL) {
+		return NULL;
+	}
+	cache->size = size;
+
+	return cache;
+}
+
+void answer_cache_free(answer_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < cache->size; i++) {
+		free(cache->slots[i]);
+	}
+	free(cache);
+}
+
+bool answer_cache_get(answer_cache_t *cache, const answer_cache_key_t *key,
+                      uint8_t *wire, size_t *wire_len)
+{
+	if (cache == NULL || key == NULL || wire == NULL || wire_len == NULL) {
+		return false;
+	}
+
+	size_t qname_len = knot_dname_size(key->qname);
+	uint32_t hash = key_hash(key, qname_len);
+
+	for (size_t i = 0; i < ANSWER_CACHE_PROBES; i++) {
+		answer_cache_entry_t *entry =
+			rcu_dereference(cache->slots[(hash + i) % cache->size]);
+		if (entry == NULL) {
+			return false;
+		}
+		if (key_match(entry, hash, key, qname_len)) {
+			memcpy(wire, entry->data + qname_len, entry->wire_len);
+			*wire_len = entry->wire_len;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int answer_cache_put(answer_cache_t *cache, const answer_cache_key_t *key,
+                     const uint8_t *wire, size_t wire_len)
+{
+	if (cache == NULL || key == NULL || wire == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	if (wire_len > ANSWER_CACHE_MAX_WIRE || wire_len > key->max_size) {
+		return KNOT_ESPACE;
+	}
+
+	size_t qname_len = knot_dname_size(key->qname);
+	uint32_t hash = key_hash(key, qname_len);
+
+	answer_cache_entry_t *entry = malloc(sizeof(*entry) + qname_len + wire_len);
+	if (entry == NULL) {
+		return KNOT_ENOMEM;
+	}
+	entry->hash = hash;
+	entry->qtype = key->qtype;
+	entry->max_size = key->max_size;
+	entry->flags = key->flags;
+	entry->qname_len = qname_len;
+	entry->wire_len = wire_len;
+	memcpy(entry->data, key->qname, qname_len);
+	memcpy(entry->data + qname_len, wire, wire_len);
+
+	/* Take the first free slot, unless the answer is cached already. */
+	for (size_t i = 0; i < ANSWER_CACHE_PROBES; i++) {
+		answer_cache_entry_t **slot = &cache->slots[(hash + i) % cache->size];
+		answer_cache_entry_t *cur = rcu_cmpxchg_pointer(slot, NULL, entry);
+		if (cur == NULL) {
+			return KNOT_EOK;
+		}
+		if (key_match(cur, hash, key, qname_len)) {
+			free(entry);
+			return KNOT_EEXIST;
+		}
+	}
+
+	free(entry);
+	return KNOT_ESPACE;
+}
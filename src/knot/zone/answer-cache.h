@@ -0,0 +1,87 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libknot/dname.h"
+
+/*! \brief Answer cache key flags. */
+enum {
+	ANSWER_CACHE_EDNS = 1 << 0, /*!< Query with EDNS. */
+	ANSWER_CACHE_DO   = 1 << 1, /*!< Query with DO bit. */
+};
+
+/*! \brief Maximal size of a cached answer. */
+#define ANSWER_CACHE_MAX_WIRE 4096
+
+/*! \brief Answer cache lookup key. */
+typedef struct {
+	const knot_dname_t *qname; /*!< Lowercase QNAME. */
+	uint16_t qtype;            /*!< QTYPE. */
+	uint16_t max_size;         /*!< Maximal answer size. */
+	uint8_t flags;             /*!< ANSWER_CACHE_* flags. */
+} answer_cache_key_t;
+
+typedef struct answer_cache answer_cache_t;
+
+/*!
+ * \brief Create an answer cache.
+ *
+ * The cache is bound to one zone contents version and only grows, entries
+ * are never replaced. Lookups and insertions are lock-free. The cache is
+ * replaced with an empty one on configuration reload.
+ *
+ * \param size  Maximal number of cached answers.
+ *
+ * \return New cache or NULL on error.
+ */
+answer_cache_t *answer_cache_new(size_t size);
+
+/*!
+ * \brief Free the answer cache.
+ */
+void answer_cache_free(answer_cache_t *cache);
+
+/*!
+ * \brief Copy a cached answer wire.
+ *
+ * \param cache     Answer cache.
+ * \param key       Lookup key.
+ * \param wire      Output wire (at least key->max_size long).
+ * \param wire_len  Output wire length.
+ *
+ * \return True if found.
+ */
+bool answer_cache_get(answer_cache_t *cache, const answer_cache_key_t *key,
+                      uint8_t *wire, size_t *wire_len);
+
+/*!
+ * \brief Store an answer wire.
+ *
+ * \param cache     Answer cache.
+ * \param key       Lookup key.
+ * \param wire      Answer wire.
+ * \param wire_len  Answer wire length.
+ *
+ * \return KNOT_EOK, KNOT_EEXIST if already cached, KNOT_ESPACE if the cache
+ *         is full or the answer too large, or other error.
+ */
+int answer_cache_put(answer_cache_t *cache, const answer_cache_key_t *key,
+                     const uint8_t *wire, size_t wire_len);
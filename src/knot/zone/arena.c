@@ -0,0 +1,101 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "knot/zone/arena.h"
+
+#define ARENA_ALIGN 8
+
+struct zone_arena {
+	int refcount;
+	size_t size;
+	size_t used;
+	uint8_t *base;
+};
+
+zone_arena_t *zone_arena_new(size_t size)
+{
+	zone_arena_t *arena = malloc(sizeof(*arena));
+	if (arena == NULL) {
+		return NULL;
+	}
+
+	arena->base = malloc(size > 0 ? size : 1);
+	if (arena->base == NULL) {
+		free(arena);
+		return NULL;
+	}
+	arena->refcount = 1;
+	arena->size = size;
+	arena->used = 0;
+
+	return arena;
+}
+
+void *zone_arena_alloc(zone_arena_t *arena, size_t size)
+{
+	if (arena == NULL) {
+		return NULL;
+	}
+
+	size_t aligned = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	if (aligned > arena->size - arena->used) {
+		return NULL;
+	}
+
+	void *mem = arena->base + arena->used;
+	arena->used += aligned;
+
+	return mem;
+}
+
+bool zone_arena_owns(const zone_arena_t *arena, const void *ptr)
+{
+	if (arena == NULL) {
+		return false;
+	}
+
+	const uint8_t *p = ptr;
+	return p >= arena->base && p < arena->base + arena->size;
+}
+
+size_t zone_arena_size(const zone_arena_t *arena)
+{
+	return (arena != NULL) ? arena->size : 0;
+}
+
+zone_arena_t *zone_arena_ref(zone_arena_t *arena)
+{
+	if (arena != NULL) {
+		__atomic_add_fetch(&arena->refcount, 1, __ATOMIC_RELAXED);
+	}
+
+	return arena;
+}
+
+void zone_arena_unref(zone_arena_t *arena)
+{
+	if (arena == NULL) {
+		return;
+	}
+
+	if (__atomic_sub_fetch(&arena->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+		free(arena->base);
+		free(arena);
+	}
+}
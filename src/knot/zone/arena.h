@@ -0,0 +1,87 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \file
+ *
+ * Zone contents arena.
+ *
+ * A single preallocated memory block holding the nodes of a compacted zone
+ * contents. The arena is shared by all zone versions derived from the
+ * compacted one, as they keep referencing the unchanged RDATA, and it's
+ * released together with the last of them.
+ *
+ * \addtogroup zone
+ * @{
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct zone_arena zone_arena_t;
+
+/*!
+ * \brief Creates an arena with one reference.
+ *
+ * \param size  Arena capacity in bytes.
+ *
+ * \return New arena or NULL on error.
+ */
+zone_arena_t *zone_arena_new(size_t size);
+
+/*!
+ * \brief Allocates memory from the arena.
+ *
+ * The memory is 8-byte aligned and can't be freed separately.
+ *
+ * \param arena  Arena.
+ * \param size   Size to allocate.
+ *
+ * \return Allocated memory or NULL if the arena capacity is exhausted.
+ */
+void *zone_arena_alloc(zone_arena_t *arena, size_t size);
+
+/*!
+ * \brief Checks if the memory belongs to the arena.
+ *
+ * \param arena  Arena (can be NULL).
+ * \param ptr    Memory to check.
+ */
+bool zone_arena_owns(const zone_arena_t *arena, const void *ptr);
+
+/*!
+ * \brief Returns the arena capacity in bytes.
+ */
+size_t zone_arena_size(const zone_arena_t *arena);
+
+/*!
+ * \brief Adds an arena reference.
+ *
+ * \param arena  Arena (can be NULL).
+ *
+ * \return The arena.
+ */
+zone_arena_t *zone_arena_ref(zone_arena_t *arena);
+
+/*!
+ * \brief Drops an arena reference, frees the arena if it was the last one.
+ *
+ * \param arena  Arena (can be NULL).
+ */
+void zone_arena_unref(zone_arena_t *arena);
+
+/*! @} */
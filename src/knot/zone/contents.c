@@ -33,8 +33,17 @@ typedef struct {
 	zone_node_t *first_node;
 	zone_contents_t *zone;
 	zone_node_t *previous_node;
+	const zone_adjust_changes_t *changes;
+	size_t nsec3_created;
+	size_t nsec3_linked;
 } zone_adjust_arg_t;
 
+/*! \brief Scope of a name change for incremental adjusting. */
+enum {
+	ADJUST_NAME    = 1 << 0, /*!< Node changed, was added or removed. */
+	ADJUST_SUBTREE = 1 << 1, /*!< Flags or wildcards below may have changed. */
+};
+
 static int tree_apply_cb(zone_node_t **node, void *data)
 {
 	if (node == NULL || data == NULL) {
@@ -78,16 +87,23 @@ static int check_node(const zone_contents_t *contents, const zone_node_t *node)
  * This function is designed to be used in the tree-iterating functions.
  *
  * \param node Node to destroy RRSets from.
- * \param data Unused parameter.
+ * \param data Zone arena (zone_arena_t *), can be NULL.
  */
 static int destroy_node_rrsets_from_tree(zone_node_t **node, void *data)
 {
 	assert(node);
-	UNUSED(data);
+	const zone_arena_t *arena = data;
 
 	if (*node != NULL) {
-		node_free_rrsets(*node, NULL);
-		node_free(node, NULL);
+		// RDATA in the arena are released with the arena.
+		for (uint16_t i = 0; i < (*node)->rrset_count; i++) {
+			knot_rdataset_t *rrs = &(*node)->rrs[i].rrs;
+			if (!zone_arena_owns(arena, rrs->data)) {
+				knot_rdataset_clear(rrs, NULL);
+			}
+		}
+		binode_free(*node, arena);
+		*node = NULL;
 	}
 
 	return KNOT_EOK;
@@ -109,15 +125,58 @@ static int create_nsec3_name(uint8_t *out, size_t out_size,
 	                               &zone->nsec3_params);
 }
 
-/*! \brief Link pointers to additional nodes for this RRSet. */
-static int discover_additionals(const knot_dname_t *owner, struct rr_data *rr_data,
-                                zone_contents_t *zone)
+static int create_nsec3_name_cached(uint8_t *out, size_t out_size,
+                                    const zone_contents_t *zone,
+                                    const knot_dname_t *name)
+{
+	assert(out);
+	assert(zone);
+	assert(name);
+
+	if (zone->nsec3_cache == NULL) {
+		return create_nsec3_name(out, out_size, zone, name);
+	}
+
+	if (!knot_is_nsec3_enabled(zone)) {
+		return KNOT_ENSEC3PAR;
+	}
+
+	uint8_t hash[NSEC3_CACHE_MAX_HASH];
+	size_t hash_len = 0;
+	if (nsec3_cache_get(zone->nsec3_cache, &zone->nsec3_params, name,
+	                    hash, &hash_len)) {
+		return knot_nsec3_hash_to_dname(out, out_size, hash, hash_len,
+		                                zone->apex->owner);
+	}
+
+	dnssec_binary_t data = {
+		.data = (uint8_t *)name,
+		.size = knot_dname_size(name)
+	};
+	dnssec_binary_t computed = { 0 };
+	int ret = dnssec_nsec3_hash(&data, &zone->nsec3_params, &computed);
+	if (ret != DNSSEC_EOK) {
+		return knot_error_from_libdnssec(ret);
+	}
+
+	nsec3_cache_put(zone->nsec3_cache, &zone->nsec3_params, name,
+	                computed.data, computed.size);
+
+	ret = knot_nsec3_hash_to_dname(out, out_size, computed.data, computed.size,
+	                               zone->apex->owner);
+	dnssec_binary_free(&computed);
+
+	return ret;
+}
+
+/*! \brief Finds the additional nodes for this RRSet. */
+static int discover_additionals(const knot_dname_t *owner, const struct rr_data *rr_data,
+                                zone_contents_t *zone, additional_t **additional)
 {
 	assert(rr_data != NULL);
+	assert(additional != NULL);
 
-	/* Drop possible previous additional nodes. */
-	additional_clear(rr_data->additional);
-	rr_data->additional = NULL;
+	*additional = NULL;
 
 	const knot_rdataset_t *rrs = &rr_data->rrs;
 	uint16_t rdcount = rrs->rr_count;
@@ -155,35 +214,187 @@ static int discover_additionals(const knot_dname_t *owner, struct rr_data *rr_da
 			glue = &others[others_count++];
 			glue->optional = true;
 		}
-		glue->node = node;
+		glue->node = binode_first(node);
 		glue->ns_pos = i;
 	}
 
 	/* Store sorted additionals by the type, mandatory first. */
 	size_t total_count = mandatory_count + others_count;
 	if (total_count > 0) {
-		rr_data->additional = malloc(sizeof(additional_t));
-		if (rr_data->additional == NULL) {
+		additional_t *add = malloc(sizeof(additional_t));
+		if (add == NULL) {
 			return KNOT_ENOMEM;
 		}
-		rr_data->additional->count = total_count;
+		add->count = total_count;
 
 		size_t size = total_count * sizeof(glue_t);
-		rr_data->additional->glues = malloc(size);
-		if (rr_data->additional->glues == NULL) {
-			free(rr_data->additional);
+		add->glues = malloc(size);
+		if (add->glues == NULL) {
+			free(add);
 			return KNOT_ENOMEM;
 		}
 
 		size_t mandatory_size = mandatory_count * sizeof(glue_t);
-		memcpy(rr_data->additional->glues, mandatory, mandatory_size);
-		memcpy(rr_data->additional->glues + mandatory_count, others,
-		       size - mandatory_size);
+		memcpy(add->glues, mandatory, mandatory_size);
+		memcpy(add->glues + mandatory_count, others, size - mandatory_size);
+		*additional = add;
+	}
+
+	return KNOT_EOK;
+}
+
+static bool additionals_equal(const additional_t *a, const additional_t *b)
+{
+	if (a == NULL || b == NULL) {
+		return a == b;
+	}
+
+	if (a->count != b->count) {
+		return false;
+	}
+
+	for (uint16_t i = 0; i < a->count; ++i) {
+		if (a->glues[i].node != b->glues[i].node ||
+		    a->glues[i].ns_pos != b->glues[i].ns_pos ||
+		    a->glues[i].optional != b->glues[i].optional) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*!
+ * \brief Links pointers to additional nodes for the RRSet on given position.
+ *
+ * The node is changed only if the additionals differ, so that unchanged
+ * additionals stay shared with the previous zone version.
+ */
+static int update_additionals(zone_contents_t *zone, zone_node_t *node, uint16_t pos)
+{
+	additional_t *additional = NULL;
+	int ret = discover_additionals(node->owner, &node->rrs[pos], zone, &additional);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	if (additionals_equal(additional, node->rrs[pos].additional)) {
+		additional_clear(additional);
+		return KNOT_EOK;
+	}
+
+	ret = zone_tree_touch(zone->nodes, node);
+	if (ret == KNOT_EOK) {
+		ret = binode_prepare_change(node, NULL);
+	}
+	if (ret != KNOT_EOK) {
+		additional_clear(additional);
+		return ret;
+	}
+
+	struct rr_data *rr_data = &node->rrs[pos];
+	if (!binode_additional_shared(node, rr_data->additional)) {
+		additional_clear(rr_data->additional);
+	}
+	rr_data->additional = additional;
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Adds or removes the referrer index entry of the RDATA name and owner.
+ *
+ * The key is the RDATA name in the lookup format, a zero byte and the owner
+ * in the wire format. The value is the owner length.
+ */
+static int set_referrer(trie_t *referrers, const knot_dname_t *name,
+                        const knot_dname_t *owner, bool refers)
+{
+	uint8_t key[2 * KNOT_DNAME_MAXLEN + 1];
+	int ret = knot_dname_lf(key, name, NULL);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	size_t owner_len = knot_dname_size(owner);
+	size_t len = key[0];
+	key[++len] = '\0';
+	memcpy(key + len + 1, owner, owner_len);
+	len += owner_len;
+
+	if (!refers) {
+		(void)trie_del(referrers, (char *)key + 1, len, NULL);
+		return KNOT_EOK;
+	}
+
+	trie_val_t *val = trie_get_ins(referrers, (char *)key + 1, len);
+	if (val == NULL) {
+		return KNOT_ENOMEM;
+	}
+	if (*val == NULL) {
+		*val = (void *)(uintptr_t)owner_len;
 	}
 
 	return KNOT_EOK;
 }
 
+/*!
+ * \brief Checks if an RRSet of the node with additionals refers to the name.
+ *
+ * The names are compared the same way as the index keys, case-insensitively.
+ */
+static bool node_refers(const zone_node_t *node, const knot_dname_t *name)
+{
+	for (uint16_t i = 0; i < node->rrset_count; ++i) {
+		const struct rr_data *rr_data = &node->rrs[i];
+		if (!knot_rrtype_additional_needed(rr_data->type)) {
+			continue;
+		}
+		for (uint16_t j = 0; j < rr_data->rrs.rr_count; j++) {
+			const knot_dname_t *rdname = knot_rdata_name(&rr_data->rrs, j, rr_data->type);
+			if (knot_dname_cmp(rdname, name) == 0) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/*! \brief Sets the previous node, the node is touched only if it changes. */
+static int set_prev(zone_tree_t *tree, zone_node_t *node, const zone_node_t *prev)
+{
+	if (node->prev == binode_first(prev)) {
+		return KNOT_EOK;
+	}
+
+	int ret = zone_tree_touch(tree, node);
+	if (ret == KNOT_EOK) {
+		node->prev = binode_first(prev);
+	}
+
+	return ret;
+}
+
+/*! \brief Computes the flags of the node from its parent and RRSets. */
+static uint16_t adjusted_flags(const zone_node_t *node, const zone_contents_t *zone)
+{
+	// clear Removed NSEC flag so that no relicts remain
+	uint16_t flags = node->flags & ~NODE_FLAGS_REMOVED_NSEC;
+
+	// set flags (delegation point, non-authoritative)
+	const zone_node_t *parent = node_parent(node);
+	if (parent != NULL &&
+	    (parent->flags & NODE_FLAGS_DELEG || parent->flags & NODE_FLAGS_NONAUTH)) {
+		return flags | NODE_FLAGS_NONAUTH;
+	} else if (node_rrtype_exists(node, KNOT_RRTYPE_NS) && node != zone->apex) {
+		return flags | NODE_FLAGS_DELEG;
+	} else {
+		// Default.
+		return NODE_FLAGS_AUTH | (flags & (NODE_FLAGS_ARENA | NODE_FLAGS_SECOND));
+	}
+}
+
 static int adjust_pointers(zone_node_t **tnode, void *data)
 {
 	assert(tnode != NULL);
@@ -197,29 +408,16 @@ static int adjust_pointers(zone_node_t **tnode, void *data)
 		args->first_node = node;
 	}
 
-	// clear Removed NSEC flag so that no relicts remain
-	node->flags &= ~NODE_FLAGS_REMOVED_NSEC;
-
 	// check if this node is not a wildcard child of its parent
 	if (knot_dname_is_wildcard(node->owner)) {
 		assert(node->parent != NULL);
-		node->parent->flags |= NODE_FLAGS_WILDCARD_CHILD;
+		node_parent(node)->flags |= NODE_FLAGS_WILDCARD_CHILD;
 	}
 
-	// set flags (delegation point, non-authoritative)
-	if (node->parent &&
-	    (node->parent->flags & NODE_FLAGS_DELEG ||
-	     node->parent->flags & NODE_FLAGS_NONAUTH)) {
-		node->flags |= NODE_FLAGS_NONAUTH;
-	} else if (node_rrtype_exists(node, KNOT_RRTYPE_NS) && node != args->zone->apex) {
-		node->flags |= NODE_FLAGS_DELEG;
-	} else {
-		// Default.
-		node->flags = NODE_FLAGS_AUTH;
-	}
+	node->flags = adjusted_flags(node, args->zone);
 
 	// set pointer to previous node
-	node->prev = args->previous_node;
+	node->prev = binode_first(args->previous_node);
 
 	// update remembered previous pointer only if authoritative
 	if (!(node->flags & NODE_FLAGS_NONAUTH) && node->rrset_count > 0) {
@@ -229,6 +427,23 @@ static int adjust_pointers(zone_node_t **tnode, void *data)
 	return KNOT_EOK;
 }
 
+/*! \brief Finds the NSEC3 node corresponding to the node (first half). */
+static int find_nsec3_node(zone_contents_t *zone, const zone_node_t *node,
+                           zone_node_t **nsec3_node)
+{
+	// Connect to NSEC3 node (only if NSEC3 tree is not empty)
+	uint8_t nsec3_name[KNOT_DNAME_MAXLEN];
+	int ret = create_nsec3_name(nsec3_name, sizeof(nsec3_name), zone, node->owner);
+	if (ret == KNOT_EOK) {
+		*nsec3_node = binode_first(zone_tree_get(zone->nsec3_nodes, nsec3_name));
+	} else if (ret == KNOT_ENSEC3PAR) {
+		*nsec3_node = NULL;
+		ret = KNOT_EOK;
+	}
+
+	return ret;
+}
+
 static int adjust_nsec3_pointers(zone_node_t **tnode, void *data)
 {
 	assert(data != NULL);
@@ -237,15 +452,10 @@ static int adjust_nsec3_pointers(zone_node_t **tnode, void *data)
 	zone_adjust_arg_t *args = (zone_adjust_arg_t *)data;
 	zone_node_t *node = *tnode;
 
-	// Connect to NSEC3 node (only if NSEC3 tree is not empty)
-	uint8_t nsec3_name[KNOT_DNAME_MAXLEN];
-	int ret = create_nsec3_name(nsec3_name, sizeof(nsec3_name), args->zone,
-	                            node->owner);
+	zone_node_t *nsec3_node = NULL;
+	int ret = find_nsec3_node(args->zone, node, &nsec3_node);
 	if (ret == KNOT_EOK) {
-		node->nsec3_node = zone_tree_get(args->zone->nsec3_nodes, nsec3_name);
-	} else if (ret == KNOT_ENSEC3PAR) {
-		node->nsec3_node = NULL;
-		ret = KNOT_EOK;
+		node->nsec3_node = nsec3_node;
 	}
 
 	return ret;
@@ -315,7 +525,7 @@ static int adjust_nsec3_node(zone_node_t **tnode, void *data)
 	}
 
 	// set previous node
-	node->prev = args->previous_node;
+	node->prev = binode_first(args->previous_node);
 	args->previous_node = node;
 
 	measure_size(*tnode, &args->zone->size);
@@ -334,12 +544,18 @@ static int adjust_additional(zone_node_t **tnode, void *data)
 
 	/* Lookup additional records for specific nodes. */
 	for(uint16_t i = 0; i < node->rrset_count; ++i) {
-		struct rr_data *rr_data = &node->rrs[i];
-		if (knot_rrtype_additional_needed(rr_data->type)) {
-			int ret = discover_additionals(node->owner, rr_data, args->zone);
-			if (ret != KNOT_EOK) {
-				return ret;
-			}
+		const struct rr_data *rr_data = &node->rrs[i];
+		if (!knot_rrtype_additional_needed(rr_data->type)) {
+			continue;
+		}
+
+		int ret = update_additionals(args->zone, node, i);
+		for (uint16_t j = 0; ret == KNOT_EOK && j < rr_data->rrs.rr_count; j++) {
+			const knot_dname_t *name = knot_rdata_name(&rr_data->rrs, j, rr_data->type);
+			ret = set_referrer(args->zone->referrers, name, node->owner, true);
+		}
+		if (ret != KNOT_EOK) {
+			return ret;
 		}
 	}
 
@@ -420,15 +636,14 @@ zone_contents_t *zone_contents_new(const knot_dname_t *apex_name)
 		goto cleanup;
 	}
 
-	if (zone_tree_insert(contents->nodes, contents->apex) != KNOT_EOK) {
+	if (zone_tree_insert(contents->nodes, &contents->apex) != KNOT_EOK) {
 		goto cleanup;
 	}
 
 	return contents;
 
 cleanup:
-	free(contents->nodes);
-	free(contents->nsec3_nodes);
+	zone_tree_free(&contents->nodes);
 	free(contents);
 	return NULL;
 }
@@ -441,21 +656,51 @@ static zone_node_t *get_node(const zone_contents_t *zone, const knot_dname_t *na
 	return zone_tree_get(zone->nodes, name);
 }
 
-static int add_node(zone_contents_t *zone, zone_node_t *node, bool create_parents)
+/*! \brief Finds a node, trying the ancestors of the hint node first. */
+static zone_node_t *get_ancestor_node(const zone_contents_t *zone,
+                                      zone_node_t *hint, const knot_dname_t *name)
+{
+	if (hint != NULL) {
+		size_t labels = knot_dname_labels(name, NULL);
+		for (; hint != NULL; hint = node_parent(hint)) {
+			size_t hint_labels = knot_dname_labels(hint->owner, NULL);
+			if (hint_labels < labels) {
+				break;
+			} else if (hint_labels == labels) {
+				if (knot_dname_is_equal(hint->owner, name)) {
+					return hint;
+				}
+				break;
+			}
+		}
+	}
+
+	return get_node(zone, name);
+}
+
+/*! \brief Makes the node changeable in a zone contents copy. */
+static int touch_node(zone_contents_t *zone, zone_node_t *node, bool nsec3)
+{
+	return zone_tree_touch(nsec3 ? zone->nsec3_nodes : zone->nodes, node);
+}
+
+static int add_node(zone_contents_t *zone, zone_node_t **tnode, bool create_parents,
+                    zone_node_t *hint)
 {
-	if (zone == NULL || node == NULL) {
+	if (zone == NULL || tnode == NULL || *tnode == NULL) {
 		return KNOT_EINVAL;
 	}
 
-	int ret = check_node(zone, node);
+	int ret = check_node(zone, *tnode);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
 
-	ret = zone_tree_insert(zone->nodes, node);
+	ret = zone_tree_insert(zone->nodes, tnode);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
+	zone_node_t *node = *tnode;
 
 	if (!create_parents) {
 		return KNOT_EOK;
@@ -477,7 +722,8 @@ static int add_node(zone_contents_t *zone, zone_node_t *node, bool create_parent
 			zone->apex->flags |= NODE_FLAGS_WILDCARD_CHILD;
 		}
 	} else {
-		while (parent != NULL && !(next_node = get_node(zone, parent))) {
+		while (parent != NULL &&
+		       !(next_node = get_ancestor_node(zone, hint, parent))) {
 
 			/* Create a new node. */
 			next_node = node_new(parent, NULL);
@@ -486,7 +732,7 @@ static int add_node(zone_contents_t *zone, zone_node_t *node, bool create_parent
 			}
 
 			/* Insert node to a tree. */
-			ret = zone_tree_insert(zone->nodes, next_node);
+			ret = zone_tree_insert(zone->nodes, &next_node);
 			if (ret != KNOT_EOK) {
 				node_free(&next_node, NULL);
 				return ret;
@@ -505,19 +751,23 @@ static int add_node(zone_contents_t *zone, zone_node_t *node, bool create_parent
 		// set the found parent (in the zone) as the parent of the last
 		// inserted node
 		assert(node->parent == NULL);
+		ret = touch_node(zone, next_node, false);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
 		node_set_parent(node, next_node);
 	}
 
 	return KNOT_EOK;
 }
 
-static int add_nsec3_node(zone_contents_t *zone, zone_node_t *node)
+static int add_nsec3_node(zone_contents_t *zone, zone_node_t **node)
 {
-	if (zone == NULL || node == NULL) {
+	if (zone == NULL || node == NULL || *node == NULL) {
 		return KNOT_EINVAL;
 	}
 
-	int ret = check_node(zone, node);
+	int ret = check_node(zone, *node);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -528,6 +778,8 @@ static int add_nsec3_node(zone_contents_t *zone, zone_node_t *node)
 		if (zone->nsec3_nodes == NULL) {
 			return KNOT_ENOMEM;
 		}
+		// Nodes of a contents copy use the same halves in both trees.
+		zone->nsec3_nodes->flags = zone->nodes->flags;
 	}
 
 	// how to know if this is successful??
@@ -538,7 +790,7 @@ static int add_nsec3_node(zone_contents_t *zone, zone_node_t *node)
 
 	// no parents to be created, the only parent is the zone apex
 	// set the apex as the parent of the node
-	node_set_parent(node, zone->apex);
+	node_set_parent(*node, zone->apex);
 
 	// cannot be wildcard child, so nothing to be done
 
@@ -555,7 +807,7 @@ static zone_node_t *get_nsec3_node(const zone_contents_t *zone,
 }
 
 static int insert_rr(zone_contents_t *z, const knot_rrset_t *rr,
-                     zone_node_t **n, bool nsec3)
+                     zone_node_t **n, bool nsec3, zone_node_t *hint)
 {
 	if (knot_rrset_empty(rr)) {
 		return KNOT_EINVAL;
@@ -575,9 +827,15 @@ static int insert_rr(zone_contents_t *z, const knot_rrset_t *rr,
 			if (*n == NULL) {
 				return KNOT_ENOMEM;
 			}
-			int ret = nsec3 ? add_nsec3_node(z, *n) : add_node(z, *n, true);
+			int ret = nsec3 ? add_nsec3_node(z, n) : add_node(z, n, true, hint);
 			if (ret != KNOT_EOK) {
 				node_free(n, NULL);
+				return ret;
+			}
+		} else {
+			int ret = touch_node(z, *n, nsec3);
+			if (ret != KNOT_EOK) {
+				return ret;
 			}
 		}
 	}
@@ -604,13 +862,22 @@ static int remove_rr(zone_contents_t *z, const knot_rrset_t *rr,
 		if (node == NULL) {
 			return KNOT_ENONODE;
 		}
+		int ret = touch_node(z, node, nsec3);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
 	} else {
 		node = *n;
 	}
 
+	int ret = binode_prepare_change(node, NULL);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
 	knot_rdataset_t *node_rrs = node_rdataset(node, rr->type);
 	// Subtract changeset RRS from node RRS.
-	int ret = knot_rdataset_subtract(node_rrs, &rr->rrs, NULL);
+	ret = knot_rdataset_subtract(node_rrs, &rr->rrs, NULL);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -628,92 +895,51 @@ static int remove_rr(zone_contents_t *z, const knot_rrset_t *rr,
 	return KNOT_EOK;
 }
 
-static int recreate_normal_tree(const zone_contents_t *z, zone_contents_t *out)
+/*! \brief Copies the nodes of the tree, the data are shared. */
+static int copy_tree(zone_tree_t *from, const zone_node_t *from_apex,
+                     zone_contents_t *to, bool nsec3)
 {
-	out->nodes = trie_create(NULL);
-	if (out->nodes == NULL) {
-		return KNOT_ENOMEM;
-	}
-
-	// Insert APEX first.
-	zone_node_t *apex_cpy = node_shallow_copy(z->apex, NULL);
-	if (apex_cpy == NULL) {
+	zone_tree_t *tree = zone_tree_create();
+	if (tree == NULL) {
 		return KNOT_ENOMEM;
 	}
-
-	// Normal additions need apex ... so we need to insert directly.
-	int ret = zone_tree_insert(out->nodes, apex_cpy);
-	if (ret != KNOT_EOK) {
-		node_free(&apex_cpy, NULL);
-		return ret;
-	}
-
-	out->apex = apex_cpy;
-
-	trie_it_t *itt = trie_it_begin(z->nodes);
-	if (itt == NULL) {
-		return KNOT_ENOMEM;
+	if (nsec3) {
+		to->nsec3_nodes = tree;
+	} else {
+		to->nodes = tree;
 	}
 
-	while (!trie_it_finished(itt)) {
-		const zone_node_t *to_cpy = (zone_node_t *)*trie_it_val(itt);
-		if (to_cpy == z->apex) {
-			// Inserted already.
-			trie_it_next(itt);
-			continue;
-		}
+	zone_tree_it_t it = { 0 };
+	int ret = zone_tree_it_begin(from, &it);
+	while (ret == KNOT_EOK && !zone_tree_it_finished(&it)) {
+		const zone_node_t *to_cpy = zone_tree_it_val(&it);
 		zone_node_t *to_add = node_shallow_copy(to_cpy, NULL);
 		if (to_add == NULL) {
-			trie_it_free(itt);
-			return KNOT_ENOMEM;
+			ret = KNOT_ENOMEM;
+			break;
 		}
 
-		int ret = add_node(out, to_add, true);
+		ret = zone_tree_insert(tree, &to_add);
 		if (ret != KNOT_EOK) {
 			node_free(&to_add, NULL);
-			trie_it_free(itt);
-			return ret;
-		}
-		trie_it_next(itt);
-	}
-
-	trie_it_free(itt);
-
-	return KNOT_EOK;
-}
-
-static int recreate_nsec3_tree(const zone_contents_t *z, zone_contents_t *out)
-{
-	out->nsec3_nodes = trie_create(NULL);
-	if (out->nsec3_nodes == NULL) {
-		return KNOT_ENOMEM;
-	}
-
-	trie_it_t *itt = trie_it_begin(z->nsec3_nodes);
-	if (itt == NULL) {
-		return KNOT_ENOMEM;
-	}
-	while (!trie_it_finished(itt)) {
-		const zone_node_t *to_cpy = (zone_node_t *)*trie_it_val(itt);
-		zone_node_t *to_add = node_shallow_copy(to_cpy, NULL);
-		if (to_add == NULL) {
-			trie_it_free(itt);
-			return KNOT_ENOMEM;
+			break;
 		}
 
-		int ret = add_nsec3_node(out, to_add);
-		if (ret != KNOT_EOK) {
-			trie_it_free(itt);
-			node_free(&to_add, NULL);
-			return ret;
+		if (nsec3) {
+			node_set_parent(to_add, to->apex);
+		} else if (to_cpy == from_apex) {
+			to->apex = to_add;
+		} else {
+			// Parents precede their children in the canonical order, already copied.
+			const uint8_t *parent = knot_wire_next_label(to_add->owner, NULL);
+			node_set_parent(to_add, zone_tree_get(tree, parent));
 		}
 
-		trie_it_next(itt);
+		zone_tree_it_next(&it);
 	}
+	zone_tree_it_free(&it);
 
-	trie_it_free(itt);
-
-	return KNOT_EOK;
+	return ret;
 }
 
 // Public API
@@ -725,7 +951,35 @@ int zone_contents_add_rr(zone_contents_t *z, const knot_rrset_t *rr,
 		return KNOT_EINVAL;
 	}
 
-	return insert_rr(z, rr, n, knot_rrset_is_nsec3rel(rr));
+	return insert_rr(z, rr, n, knot_rrset_is_nsec3rel(rr), NULL);
+}
+
+int zone_contents_append_rr(zone_contents_t *z, const knot_rrset_t *rr,
+                            zone_append_ctx_t *ctx)
+{
+	if (z == NULL || rr == NULL || ctx == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	bool nsec3 = knot_rrset_is_nsec3rel(rr);
+
+	zone_node_t *node = NULL;
+	zone_node_t *hint = NULL;
+	if (ctx->node != NULL && ctx->nsec3 == nsec3) {
+		if (knot_dname_is_equal(ctx->node->owner, rr->owner)) {
+			node = ctx->node;
+		} else if (!nsec3) {
+			hint = ctx->node;
+		}
+	}
+
+	int ret = insert_rr(z, rr, &node, nsec3, hint);
+	if (node != NULL) {
+		ctx->node = node;
+		ctx->nsec3 = nsec3;
+	}
+
+	return ret;
 }
 
 int zone_contents_remove_rr(zone_contents_t *z, const knot_rrset_t *rr,
@@ -749,7 +1003,7 @@ zone_node_t *zone_contents_get_node_for_rr(zone_contents_t *zone, const knot_rrs
 	                            get_node(zone, rrset->owner);
 	if (node == NULL) {
 		node = node_new(rrset->owner, NULL);
-		int ret = nsec3 ? add_nsec3_node(zone, node) : add_node(zone, node, true);
+		int ret = nsec3 ? add_nsec3_node(zone, &node) : add_node(zone, &node, true, NULL);
 		if (ret != KNOT_EOK) {
 			node_free(&node, NULL);
 			return NULL;
@@ -757,7 +1011,7 @@ zone_node_t *zone_contents_get_node_for_rr(zone_contents_t *zone, const knot_rrs
 
 		return node;
 	} else {
-		return node;
+		return touch_node(zone, node, nsec3) == KNOT_EOK ? node : NULL;
 	}
 }
 
@@ -777,8 +1031,13 @@ zone_node_t *zone_contents_find_node_for_rr(zone_contents_t *contents, const kno
 	}
 
 	const bool nsec3 = knot_rrset_is_nsec3rel(rrset);
-	return nsec3 ? get_nsec3_node(contents, rrset->owner) :
-	               get_node(contents, rrset->owner);
+	zone_node_t *node = nsec3 ? get_nsec3_node(contents, rrset->owner) :
+	                            get_node(contents, rrset->owner);
+	if (node != NULL && touch_node(contents, node, nsec3) != KNOT_EOK) {
+		return NULL;
+	}
+
+	return node;
 }
 
 int zone_contents_find_dname(const zone_contents_t *zone,
@@ -820,7 +1079,7 @@ int zone_contents_find_dname(const zone_contents_t *zone,
 		node = prev;
 		int matched_labels = knot_dname_matched_labels(node->owner, name);
 		while (matched_labels < knot_dname_labels(node->owner, NULL)) {
-			node = node->parent;
+			node = node_parent(node);
 			assert(node);
 		}
 
@@ -858,7 +1117,7 @@ int zone_contents_find_nsec3_for_name(const zone_contents_t *zone,
 	}
 
 	uint8_t nsec3_name[KNOT_DNAME_MAXLEN];
-	int ret = create_nsec3_name(nsec3_name, sizeof(nsec3_name), zone, name);
+	int ret = create_nsec3_name_cached(nsec3_name, sizeof(nsec3_name), zone, name);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -874,7 +1133,7 @@ int zone_contents_find_nsec3_for_name(const zone_contents_t *zone,
 		// set the previous node of the found node
 		assert(match);
 		assert(*nsec3_node != NULL);
-		*nsec3_previous = (*nsec3_node)->prev;
+		*nsec3_previous = node_prev(*nsec3_node);
 	} else {
 		*nsec3_previous = prev;
 	}
@@ -896,7 +1155,7 @@ int zone_contents_find_nsec3_for_name(const zone_contents_t *zone,
 		}
 
 		/* This RRSET was not a match, try the one from previous node. */
-		*nsec3_previous = (*nsec3_previous)->prev;
+		*nsec3_previous = node_prev(*nsec3_previous);
 		nsec3_rrs = node_rdataset(*nsec3_previous, KNOT_RRTYPE_NSEC3);
 		if (*nsec3_previous == original_prev || nsec3_rrs == NULL) {
 			// cycle
@@ -936,8 +1195,8 @@ static int adjust_nodes(zone_tree_t *nodes, zone_adjust_arg_t *adjust_arg,
 
 	int ret = zone_tree_apply(nodes, callback, adjust_arg);
 
-	if (adjust_arg->first_node) {
-		adjust_arg->first_node->prev = adjust_arg->previous_node;
+	if (ret == KNOT_EOK && adjust_arg->first_node) {
+		ret = set_prev(nodes, adjust_arg->first_node, adjust_arg->previous_node);
 	}
 
 	return ret;
@@ -1007,6 +1266,15 @@ static int contents_adjust(zone_contents_t *contents, bool normal)
 		return ret;
 	}
 
+	if (contents->referrers == NULL) {
+		contents->referrers = trie_create(NULL);
+		if (contents->referrers == NULL) {
+			return KNOT_ENOMEM;
+		}
+	} else {
+		trie_clear(contents->referrers);
+	}
+
 	return adjust_nodes(contents->nodes, &arg, adjust_additional);
 }
 
@@ -1020,39 +1288,849 @@ int zone_contents_adjust_full(zone_contents_t *contents)
 	return contents_adjust(contents, true);
 }
 
-int zone_contents_apply(zone_contents_t *contents,
-                        zone_contents_apply_cb_t function, void *data)
+void zone_adjust_changes_init(zone_adjust_changes_t *changes)
 {
-	if (contents == NULL) {
-		return KNOT_EINVAL;
+	if (changes != NULL) {
+		memset(changes, 0, sizeof(*changes));
 	}
-
-	zone_tree_func_t f = {
-		.func = function,
-		.data = data
-	};
-
-	return zone_tree_apply(contents->nodes, tree_apply_cb, &f);
 }
 
-int zone_contents_nsec3_apply(zone_contents_t *contents,
-                              zone_contents_apply_cb_t function, void *data)
+static int add_changed_name(trie_t **names, const knot_dname_t *name,
+                            unsigned flags, unsigned *old_flags)
 {
-	if (contents == NULL) {
-		return KNOT_EINVAL;
+	if (*names == NULL) {
+		*names = trie_create(NULL);
+		if (*names == NULL) {
+			return KNOT_ENOMEM;
+		}
 	}
 
-	zone_tree_func_t f = {
-		.func = function,
-		.data = data
-	};
+	uint8_t lf[KNOT_DNAME_MAXLEN];
+	knot_dname_lf(lf, name, NULL);
+
+	trie_val_t *val = trie_get_ins(*names, (char *)lf + 1, *lf);
+	if (val == NULL) {
+		return KNOT_ENOMEM;
+	}
+	if (old_flags != NULL) {
+		*old_flags = (uintptr_t)*val;
+	}
+	*val = (void *)((uintptr_t)*val | flags);
 
-	return zone_tree_apply(contents->nsec3_nodes, tree_apply_cb, &f);
+	return KNOT_EOK;
 }
 
-int zone_contents_shallow_copy(const zone_contents_t *from, zone_contents_t **to)
+static unsigned changed_lf(trie_t *names, const uint8_t *lf)
 {
-	if (from == NULL || to == NULL) {
+	if (names == NULL) {
+		return 0;
+	}
+
+	trie_val_t *val = trie_get_try(names, (char *)lf + 1, *lf);
+	return (val != NULL) ? (uintptr_t)*val : 0;
+}
+
+static unsigned changed_name(const zone_adjust_changes_t *changes,
+                             const knot_dname_t *name)
+{
+	uint8_t lf[KNOT_DNAME_MAXLEN];
+	knot_dname_lf(lf, name, NULL);
+
+	return changed_lf(changes->names, lf);
+}
+
+static bool removed_nsec3(const zone_adjust_changes_t *changes,
+                          const zone_node_t *node)
+{
+	return changes->removed_nsec3 != NULL &&
+	       trie_get_try(changes->removed_nsec3, (char *)&node, sizeof(node)) != NULL;
+}
+
+int zone_adjust_changes_add(zone_adjust_changes_t *changes,
+                            const zone_contents_t *contents,
+                            const knot_rrset_t *rr)
+{
+	if (changes == NULL || contents == NULL || contents->apex == NULL || rr == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	const knot_dname_t *apex = contents->apex->owner;
+	if (rr->type == KNOT_RRTYPE_NSEC3PARAM) {
+		changes->full = true;
+		return KNOT_EOK;
+	}
+
+	// NSEC3 nodes are linked from the normal nodes, only their chain changes.
+	if (knot_rrset_is_nsec3rel(rr)) {
+		return add_changed_name(&changes->nsec3_names, rr->owner, ADJUST_NAME, NULL);
+	}
+
+	if (knot_rrtype_additional_needed(rr->type)) {
+		if (changes->owners == NULL) {
+			changes->owners = trie_create(NULL);
+			if (changes->owners == NULL) {
+				return KNOT_ENOMEM;
+			}
+		}
+		if (trie_get_ins(changes->owners, (char *)rr->owner,
+		                 knot_dname_size(rr->owner)) == NULL) {
+			return KNOT_ENOMEM;
+		}
+	}
+
+	// Apex flags don't depend on its records, only its additionals may change.
+	if (knot_dname_is_equal(rr->owner, apex)) {
+		return add_changed_name(&changes->names, apex, ADJUST_NAME, NULL);
+	}
+
+	int labels = knot_dname_labels(rr->owner, NULL) - knot_dname_labels(apex, NULL);
+	if (labels <= 0 || !knot_dname_in(apex, rr->owner)) {
+		return KNOT_EOUTOFZONE;
+	}
+
+	const knot_dname_t *parent = knot_wire_next_label(rr->owner, NULL);
+	if (knot_dname_is_wildcard(rr->owner)) {
+		if (labels == 1) {
+			changes->all_additionals = true;
+		} else {
+			int ret = add_changed_name(&changes->names, parent, ADJUST_SUBTREE, NULL);
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
+		}
+	}
+
+	int ret = add_changed_name(&changes->names, rr->owner, ADJUST_NAME | ADJUST_SUBTREE, NULL);
+
+	// Ancestors may have been added or removed as empty non-terminals.
+	for (; ret == KNOT_EOK && labels > 1; labels--) {
+		unsigned old_flags = 0;
+		ret = add_changed_name(&changes->names, parent, ADJUST_NAME, &old_flags);
+		if (old_flags & ADJUST_NAME) {
+			break; // The rest already added.
+		}
+		parent = knot_wire_next_label(parent, NULL);
+	}
+
+	return ret;
+}
+
+int zone_adjust_changes_removed(zone_adjust_changes_t *changes,
+                                const zone_node_t *node)
+{
+	if (changes == NULL || node == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	if (changes->removed_nsec3 == NULL) {
+		changes->removed_nsec3 = trie_create(NULL);
+		if (changes->removed_nsec3 == NULL) {
+			return KNOT_ENOMEM;
+		}
+	}
+
+	// The nodes link the first halves.
+	node = binode_first(node);
+	trie_val_t *val = trie_get_ins(changes->removed_nsec3, (char *)&node, sizeof(node));
+	if (val == NULL) {
+		return KNOT_ENOMEM;
+	}
+	*val = (void *)node;
+
+	return KNOT_EOK;
+}
+
+void zone_adjust_changes_clear(zone_adjust_changes_t *changes)
+{
+	if (changes == NULL) {
+		return;
+	}
+
+	trie_free(changes->names);
+	trie_free(changes->nsec3_names);
+	trie_free(changes->removed_nsec3);
+	trie_free(changes->owners);
+	zone_adjust_changes_init(changes);
+}
+
+int zone_contents_update_referrers(zone_contents_t *contents,
+                                   const zone_node_t *node,
+                                   const knot_rrset_t *rr)
+{
+	if (contents == NULL || node == NULL || rr == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	// Not adjusted yet, the index is built by the full adjusting.
+	if (contents->referrers == NULL || !knot_rrtype_additional_needed(rr->type)) {
+		return KNOT_EOK;
+	}
+
+	for (uint16_t i = 0; i < rr->rrs.rr_count; i++) {
+		const knot_dname_t *name = knot_rdata_name(&rr->rrs, i, rr->type);
+		int ret = set_referrer(contents->referrers, name, node->owner,
+		                       node_refers(node, name));
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Adjust normal node after changes.
+ *
+ * Flags and previous pointers are checked, the NSEC3 node is looked up only
+ * if the node changed or its NSEC3 node was removed. The node is touched only
+ * if anything changes.
+ */
+static int adjust_changed_node(zone_node_t **tnode, void *data)
+{
+	zone_adjust_arg_t *args = data;
+	zone_node_t *node = *tnode;
+
+	// The previous node of the apex is kept unless known.
+	zone_node_t *prev = (args->previous_node != NULL) ?
+	                    binode_first(args->previous_node) : node->prev;
+
+	// The wildcard child flag is set from the children.
+	uint16_t flags = adjusted_flags(node, args->zone) |
+	                 (node->flags & NODE_FLAGS_WILDCARD_CHILD);
+
+	zone_node_t *nsec3_node = node->nsec3_node;
+	if (nsec3_node != NULL ? removed_nsec3(args->changes, nsec3_node) :
+	    (changed_name(args->changes, node->owner) & ADJUST_NAME)) {
+		int ret = find_nsec3_node(args->zone, node, &nsec3_node);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+		if (nsec3_node != NULL &&
+		    binode_node(nsec3_node, node->flags & NODE_FLAGS_SECOND)->prev == NULL) {
+			args->nsec3_linked++;
+		}
+	}
+
+	if (flags != node->flags || prev != node->prev || nsec3_node != node->nsec3_node) {
+		int ret = zone_tree_touch(args->zone->nodes, node);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+		node->flags = flags;
+		node->prev = prev;
+		node->nsec3_node = nsec3_node;
+	}
+
+	// check if this node is not a wildcard child of its parent
+	zone_node_t *parent = node_parent(node);
+	if (knot_dname_is_wildcard(node->owner) &&
+	    !(parent->flags & NODE_FLAGS_WILDCARD_CHILD)) {
+		int ret = zone_tree_touch(args->zone->nodes, parent);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+		parent->flags |= NODE_FLAGS_WILDCARD_CHILD;
+	}
+
+	// update remembered previous pointer only if authoritative
+	if (!(node->flags & NODE_FLAGS_NONAUTH) && node->rrset_count > 0) {
+		args->previous_node = node;
+	}
+
+	return KNOT_EOK;
+}
+
+/*! \brief Adjust NSEC3 node after changes, count the new ones. */
+static int adjust_changed_nsec3_node(zone_node_t **tnode, void *data)
+{
+	zone_adjust_arg_t *args = data;
+	zone_node_t *node = *tnode;
+
+	// Nodes added since the last adjusting don't have the previous node.
+	if (node->prev == NULL) {
+		args->nsec3_created++;
+	}
+
+	int ret = set_prev(args->zone->nsec3_nodes, node, args->previous_node);
+	args->previous_node = node;
+
+	return ret;
+}
+
+/*! \brief Link the node to its NSEC3 node if none or a removed one is linked. */
+static int adjust_unlinked_node(zone_node_t **tnode, void *data)
+{
+	zone_adjust_arg_t *args = data;
+	zone_node_t *node = *tnode;
+
+	if (node->nsec3_node != NULL && !removed_nsec3(args->changes, node->nsec3_node)) {
+		return KNOT_EOK;
+	}
+
+	zone_node_t *nsec3_node = NULL;
+	int ret = find_nsec3_node(args->zone, node, &nsec3_node);
+	if (ret != KNOT_EOK || nsec3_node == node->nsec3_node) {
+		return ret;
+	}
+
+	ret = zone_tree_touch(args->zone->nodes, node);
+	if (ret == KNOT_EOK) {
+		node->nsec3_node = nsec3_node;
+	}
+
+	return ret;
+}
+
+/*! \brief Compares names in the lookup format. */
+static int lf_cmp(const uint8_t *a, const uint8_t *b)
+{
+	int ret = memcmp(a + 1, b + 1, MIN(*a, *b));
+	return (ret != 0) ? ret : (int)*a - (int)*b;
+}
+
+/*! \brief Checks if the name is below the name (both in the lookup format). */
+static bool lf_below(const uint8_t *name, const uint8_t *parent)
+{
+	return *parent > 0 && *name > *parent &&
+	       memcmp(name + 1, parent + 1, *parent) == 0;
+}
+
+/*! \brief Checks if the node can be a previous node (authoritative, not empty). */
+static bool prev_candidate(const zone_node_t *node)
+{
+	return !(node->flags & NODE_FLAGS_NONAUTH) && node->rrset_count > 0;
+}
+
+/*!
+ * \brief Adjust the nodes from a changed name on.
+ *
+ * The walk starts after the node preceding the name, which has a valid
+ * previous node, and stops at the first unchanged node that can be a previous
+ * node, as the following nodes are linked correctly. The descendants of the
+ * nodes with changed flags are adjusted too. The walk continues from the first
+ * node when passing the last one.
+ *
+ * \param args    Adjusting parameters.
+ * \param tree    Zone tree to be adjusted.
+ * \param names   Changed names in the tree.
+ * \param name    Changed name to start from, in the lookup format.
+ * \param adjust  Node adjusting function.
+ * \param last    Last adjusted name before passing the last node (updated).
+ */
+static int adjust_changed_range(zone_adjust_arg_t *args, zone_tree_t *tree,
+                                trie_t *names, const uint8_t *name,
+                                zone_tree_apply_cb_t adjust, uint8_t *last)
+{
+	zone_tree_it_t it;
+	int ret = zone_tree_it_begin_before(tree, name, &it);
+	if (ret != KNOT_EOK) {
+		zone_tree_it_free(&it);
+		return (ret == KNOT_ENONODE) ? KNOT_EOK : ret;
+	}
+
+	uint8_t lf[KNOT_DNAME_MAXLEN];
+	zone_node_t *node = zone_tree_it_val(&it);
+	knot_dname_lf(lf, node->owner, NULL);
+
+	// The preceding node is a previous node or it links one. The last node
+	// precedes the first one, its link isn't valid before it's adjusted.
+	bool first = (lf_cmp(lf, name) >= 0);
+	args->previous_node = prev_candidate(node) ? node :
+	                      first ? NULL : node->prev;
+
+	bool wrapped = false;
+	uint8_t subtree[KNOT_DNAME_MAXLEN] = { 0 };
+	for (zone_tree_it_next(&it); ret == KNOT_EOK; zone_tree_it_next(&it)) {
+		if (zone_tree_it_finished(&it)) {
+			if (wrapped) {
+				break;
+			}
+			zone_tree_it_free(&it);
+			ret = zone_tree_it_begin(tree, &it);
+			wrapped = !first;
+			first = false;
+			if (ret != KNOT_EOK || zone_tree_it_finished(&it)) {
+				break;
+			}
+		}
+
+		node = zone_tree_it_val(&it);
+		knot_dname_lf(lf, node->owner, NULL);
+		if (wrapped && lf_cmp(lf, name) >= 0) {
+			break;
+		}
+
+		bool changed = (changed_lf(names, lf) & ADJUST_NAME) || lf_below(lf, subtree);
+		uint16_t flags = node->flags;
+		ret = adjust(&node, args);
+
+		// The flags are inherited, adjust the whole subtree.
+		const uint16_t inherited = NODE_FLAGS_DELEG | NODE_FLAGS_NONAUTH;
+		if ((flags & inherited) != (node->flags & inherited) &&
+		    !lf_below(lf, subtree)) {
+			memcpy(subtree, lf, *lf + 1);
+		}
+
+		if (!wrapped) {
+			memcpy(last, lf, *lf + 1);
+		}
+
+		if (!changed && args->previous_node == node) {
+			break;
+		}
+	}
+	zone_tree_it_free(&it);
+
+	return ret;
+}
+
+/*! \brief Adjust the nodes around the changed names in the tree. */
+static int adjust_changed_nodes(zone_adjust_arg_t *args, zone_tree_t *tree,
+                                trie_t *names, zone_tree_apply_cb_t adjust)
+{
+	if (names == NULL) {
+		return KNOT_EOK;
+	}
+
+	trie_it_t *it = trie_it_begin(names);
+	if (it == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	uint8_t last[KNOT_DNAME_MAXLEN] = { 0 };
+	int ret = KNOT_EOK;
+	for (; ret == KNOT_EOK && !trie_it_finished(it); trie_it_next(it)) {
+		size_t len = 0;
+		const char *key = trie_it_key(it, &len);
+		uint8_t name[KNOT_DNAME_MAXLEN];
+		name[0] = len;
+		memcpy(name + 1, key, len);
+
+		// Skip the names adjusted from the previous ones.
+		unsigned scope = (uintptr_t)*trie_it_val(it);
+		if (!(scope & ADJUST_NAME) || (*last > 0 && lf_cmp(name, last) <= 0)) {
+			continue;
+		}
+
+		ret = adjust_changed_range(args, tree, names, name, adjust, last);
+	}
+	trie_it_free(it);
+
+	return ret;
+}
+
+/*!
+ * \brief Checks if the additionals of the RRSet may have changed.
+ *
+ * The node itself or a node in the RDATA changed, or the flags or wildcards
+ * above a node in the RDATA changed.
+ */
+static bool additionals_changed(const zone_adjust_changes_t *changes,
+                                const zone_contents_t *zone,
+                                const zone_node_t *node,
+                                const struct rr_data *rr_data)
+{
+	if (changes->all_additionals ||
+	    (changed_name(changes, node->owner) & ADJUST_NAME)) {
+		return true;
+	}
+
+	int apex_labels = knot_dname_labels(zone->apex->owner, NULL);
+	for (uint16_t i = 0; i < rr_data->rrs.rr_count; i++) {
+		const knot_dname_t *name = knot_rdata_name(&rr_data->rrs, i, rr_data->type);
+		unsigned scope = ADJUST_NAME | ADJUST_SUBTREE;
+		for (int labels = knot_dname_labels(name, NULL); labels > apex_labels; labels--) {
+			if (changed_name(changes, name) & scope) {
+				return true;
+			}
+			scope = ADJUST_SUBTREE;
+			name = knot_wire_next_label(name, NULL);
+		}
+	}
+
+	return false;
+}
+
+static int adjust_changed_additional(zone_node_t **tnode, void *data)
+{
+	zone_adjust_arg_t *args = data;
+	zone_node_t *node = *tnode;
+
+	for (uint16_t i = 0; i < node->rrset_count; ++i) {
+		struct rr_data *rr_data = &node->rrs[i];
+		if (knot_rrtype_additional_needed(rr_data->type) &&
+		    additionals_changed(args->changes, args->zone, node, rr_data)) {
+			int ret = update_additionals(args->zone, node, i);
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+/*! \brief Adds the owners indexed for the RDATA names with the key prefix. */
+static int add_referrers(trie_t *referrers, const char *prefix, size_t len,
+                         trie_t *owners)
+{
+	trie_it_t *it = trie_it_begin_prefix(referrers, prefix, len);
+	if (it == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = KNOT_EOK;
+	for (; ret == KNOT_EOK && !trie_it_finished(it); trie_it_next(it)) {
+		size_t key_len = 0;
+		const char *key = trie_it_key(it, &key_len);
+		if (key_len < len || memcmp(key, prefix, len) != 0) {
+			break;
+		}
+
+		size_t owner_len = (uintptr_t)*trie_it_val(it);
+		if (trie_get_ins(owners, key + key_len - owner_len, owner_len) == NULL) {
+			ret = KNOT_ENOMEM;
+		}
+	}
+	trie_it_free(it);
+
+	return ret;
+}
+
+/*!
+ * \brief Discover additionals after changes.
+ *
+ * Only the owners of the changed RRSets with additionals and the owners
+ * referring to the changed names (or to any name below, if the flags or
+ * wildcards there may have changed) are checked.
+ */
+static int adjust_changed_additionals(zone_adjust_arg_t *args)
+{
+	const zone_adjust_changes_t *changes = args->changes;
+	zone_contents_t *zone = args->zone;
+
+	if (changes->all_additionals || zone->referrers == NULL) {
+		return zone_tree_walk(zone->nodes, adjust_changed_additional, args);
+	}
+
+	if (changes->names == NULL) {
+		return KNOT_EOK;
+	}
+
+	trie_t *owners = (changes->owners != NULL) ? trie_cow(changes->owners) :
+	                                             trie_create(NULL);
+	if (owners == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	trie_it_t *it = trie_it_begin(changes->names);
+	int ret = (it != NULL) ? KNOT_EOK : KNOT_ENOMEM;
+	for (; ret == KNOT_EOK && !trie_it_finished(it); trie_it_next(it)) {
+		size_t len = 0;
+		const char *name = trie_it_key(it, &len);
+		unsigned scope = (uintptr_t)*trie_it_val(it);
+
+		// The names below continue with a label instead of the separator.
+		char prefix[KNOT_DNAME_MAXLEN + 1];
+		memcpy(prefix, name, len);
+		prefix[len] = '\0';
+		ret = add_referrers(zone->referrers, prefix,
+		                    (scope & ADJUST_SUBTREE) ? len : len + 1, owners);
+	}
+	trie_it_free(it);
+
+	it = (ret == KNOT_EOK) ? trie_it_begin(owners) : NULL;
+	if (ret == KNOT_EOK && it == NULL) {
+		ret = KNOT_ENOMEM;
+	}
+	for (; ret == KNOT_EOK && !trie_it_finished(it); trie_it_next(it)) {
+		size_t len = 0;
+		const knot_dname_t *owner = (const knot_dname_t *)trie_it_key(it, &len);
+		zone_node_t *node = zone_tree_get(zone->nodes, owner);
+		if (node != NULL) {
+			ret = adjust_changed_additional(&node, args);
+		}
+	}
+	trie_it_free(it);
+	trie_free(owners);
+
+	return ret;
+}
+
+int zone_contents_adjust_incremental(zone_contents_t *contents,
+                                     const zone_adjust_changes_t *changes)
+{
+	if (contents == NULL || contents->apex == NULL || changes == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	if (changes->full) {
+		return zone_contents_adjust_full(contents);
+	}
+
+	int ret = load_nsec3param(contents);
+	if (ret != KNOT_EOK) {
+		log_zone_error(contents->apex->owner,
+		               "failed to load NSEC3 parameters (%s)",
+		               knot_strerror(ret));
+		return ret;
+	}
+
+	zone_adjust_arg_t arg = {
+		.zone = contents,
+		.changes = changes
+	};
+
+	ret = adjust_changed_nodes(&arg, contents->nodes, changes->names,
+	                           adjust_changed_node);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	ret = adjust_changed_nodes(&arg, contents->nsec3_nodes, changes->nsec3_names,
+	                           adjust_changed_nsec3_node);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	// Some new NSEC3 nodes don't belong to the changed nodes, or some
+	// unchanged nodes may be linked to the removed ones.
+	if (arg.nsec3_linked < arg.nsec3_created || changes->removed_nsec3 != NULL) {
+		ret = zone_tree_walk(contents->nodes, adjust_unlinked_node, &arg);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	ret = adjust_changed_additionals(&arg);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+#ifdef ENABLE_ADJUST_CHECK
+	ret = zone_contents_adjust_check(contents);
+#endif
+
+	return ret;
+}
+
+/*! \brief Adjusted node data saved for comparison. */
+typedef struct {
+	zone_node_t *parent;
+	zone_node_t *prev;
+	zone_node_t *nsec3_node;
+	additional_t **additionals;
+	uint32_t children;
+	uint16_t rrset_count;
+	uint16_t flags;
+} adjusted_node_t;
+
+typedef struct {
+	const zone_contents_t *zone;
+	adjusted_node_t *nodes;
+	size_t count;
+	size_t pos;
+	bool differ;
+} adjust_check_t;
+
+static int save_adjusted(zone_node_t **tnode, void *data)
+{
+	adjust_check_t *check = data;
+	zone_node_t *node = *tnode;
+
+	assert(check->count < zone_tree_count(check->zone->nodes) +
+	                      zone_tree_count(check->zone->nsec3_nodes));
+	adjusted_node_t *saved = &check->nodes[check->count++];
+	saved->parent = node->parent;
+	saved->prev = node->prev;
+	saved->nsec3_node = node->nsec3_node;
+	saved->children = node->children;
+	saved->flags = node->flags;
+
+	if (node->rrset_count == 0) {
+		return KNOT_EOK;
+	}
+
+	saved->additionals = calloc(node->rrset_count, sizeof(additional_t *));
+	if (saved->additionals == NULL) {
+		return KNOT_ENOMEM;
+	}
+	saved->rrset_count = node->rrset_count;
+
+	// Copy the current additionals, the changed ones will be replaced.
+	for (uint16_t i = 0; i < node->rrset_count; ++i) {
+		const additional_t *add = node->rrs[i].additional;
+		if (add == NULL) {
+			continue;
+		}
+
+		additional_t *copy = malloc(sizeof(*copy));
+		if (copy == NULL) {
+			return KNOT_ENOMEM;
+		}
+		copy->count = add->count;
+		copy->glues = malloc(add->count * sizeof(glue_t));
+		if (copy->glues == NULL) {
+			free(copy);
+			return KNOT_ENOMEM;
+		}
+		memcpy(copy->glues, add->glues, add->count * sizeof(glue_t));
+		saved->additionals[i] = copy;
+	}
+
+	return KNOT_EOK;
+}
+
+static int compare_adjusted(zone_node_t **tnode, void *data)
+{
+	adjust_check_t *check = data;
+	zone_node_t *node = *tnode;
+
+	assert(check->pos < check->count);
+	const adjusted_node_t *saved = &check->nodes[check->pos++];
+
+	bool equal = saved->parent == node->parent && saved->prev == node->prev &&
+	             saved->nsec3_node == node->nsec3_node &&
+	             saved->children == node->children && saved->flags == node->flags &&
+	             saved->rrset_count == node->rrset_count;
+	for (uint16_t i = 0; equal && i < node->rrset_count; ++i) {
+		equal = additionals_equal(saved->additionals[i], node->rrs[i].additional);
+	}
+
+	if (!equal) {
+		char buff[KNOT_DNAME_TXT_MAXLEN + 1];
+		char *owner = knot_dname_to_str(buff, node->owner, sizeof(buff));
+		log_zone_error(check->zone->apex->owner,
+		               "incrementally adjusted node differs, owner %s",
+		               (owner != NULL) ? owner : "");
+		check->differ = true;
+	}
+
+	return KNOT_EOK;
+}
+
+static bool referrers_equal(trie_t *a, trie_t *b)
+{
+	if (a == NULL || b == NULL) {
+		return a == b;
+	}
+
+	if (trie_weight(a) != trie_weight(b)) {
+		return false;
+	}
+
+	trie_it_t *it_a = trie_it_begin(a);
+	trie_it_t *it_b = trie_it_begin(b);
+	bool equal = (it_a != NULL && it_b != NULL);
+	while (equal && !trie_it_finished(it_a)) {
+		size_t len_a = 0, len_b = 0;
+		const char *key_a = trie_it_key(it_a, &len_a);
+		const char *key_b = trie_it_key(it_b, &len_b);
+		equal = (len_a == len_b && memcmp(key_a, key_b, len_a) == 0);
+		trie_it_next(it_a);
+		trie_it_next(it_b);
+	}
+	trie_it_free(it_a);
+	trie_it_free(it_b);
+
+	return equal;
+}
+
+int zone_contents_adjust_check(zone_contents_t *contents)
+{
+	if (contents == NULL || contents->apex == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	adjust_check_t check = {
+		.zone = contents,
+		.nodes = calloc(zone_tree_count(contents->nodes) +
+		                zone_tree_count(contents->nsec3_nodes),
+		                sizeof(adjusted_node_t))
+	};
+	if (check.nodes == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	size_t size = contents->size;
+
+	// The index is rebuilt by the full adjusting.
+	trie_t *referrers = contents->referrers;
+	contents->referrers = NULL;
+
+	int ret = zone_tree_walk(contents->nodes, save_adjusted, &check);
+	if (ret == KNOT_EOK) {
+		ret = zone_tree_walk(contents->nsec3_nodes, save_adjusted, &check);
+	}
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_adjust_full(contents);
+	}
+	if (ret == KNOT_EOK) {
+		(void)zone_tree_walk(contents->nodes, compare_adjusted, &check);
+		(void)zone_tree_walk(contents->nsec3_nodes, compare_adjusted, &check);
+		if (size != contents->size) {
+			log_zone_error(contents->apex->owner,
+			               "incrementally adjusted size differs, "
+			               "%zu instead of %zu", size, contents->size);
+			check.differ = true;
+		}
+		if (!referrers_equal(referrers, contents->referrers)) {
+			log_zone_error(contents->apex->owner,
+			               "incrementally updated referrers differ");
+			check.differ = true;
+		}
+	}
+	trie_free(referrers);
+
+	for (size_t i = 0; i < check.count; ++i) {
+		adjusted_node_t *saved = &check.nodes[i];
+		for (uint16_t j = 0; j < saved->rrset_count; ++j) {
+			additional_clear(saved->additionals[j]);
+		}
+		free(saved->additionals);
+	}
+	free(check.nodes);
+
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	return check.differ ? KNOT_ESEMCHECK : KNOT_EOK;
+}
+
+int zone_contents_apply(zone_contents_t *contents,
+                        zone_contents_apply_cb_t function, void *data)
+{
+	if (contents == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	zone_tree_func_t f = {
+		.func = function,
+		.data = data
+	};
+
+	return zone_tree_walk(contents->nodes, tree_apply_cb, &f);
+}
+
+int zone_contents_nsec3_apply(zone_contents_t *contents,
+                              zone_contents_apply_cb_t function, void *data)
+{
+	if (contents == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	zone_tree_func_t f = {
+		.func = function,
+		.data = data
+	};
+
+	return zone_tree_walk(contents->nsec3_nodes, tree_apply_cb, &f);
+}
+
+int zone_contents_shallow_copy(const zone_contents_t *from, zone_contents_t **to)
+{
+	if (from == NULL || to == NULL) {
 		return KNOT_EINVAL;
 	}
 
@@ -1066,29 +2144,99 @@ int zone_contents_shallow_copy(const zone_contents_t *from, zone_contents_t **to
 		return KNOT_ENOMEM;
 	}
 
-	int ret = recreate_normal_tree(from, contents);
+	int ret = copy_tree(from->nodes, from->apex, contents, false);
+	if (ret == KNOT_EOK && from->nsec3_nodes != NULL) {
+		ret = copy_tree(from->nsec3_nodes, from->apex, contents, true);
+	}
 	if (ret != KNOT_EOK) {
-		zone_tree_free(&contents->nodes);
+		zone_tree_deep_free(&contents->nodes);
+		zone_tree_deep_free(&contents->nsec3_nodes);
 		free(contents);
 		return ret;
 	}
 
-	if (from->nsec3_nodes) {
-		ret = recreate_nsec3_tree(from, contents);
-		if (ret != KNOT_EOK) {
+	// Unchanged RDATA are still shared with the arena.
+	contents->arena = zone_arena_ref(from->arena);
+
+	*to = contents;
+	return KNOT_EOK;
+}
+
+int zone_contents_cow(zone_contents_t *from, zone_contents_t **to)
+{
+	if (from == NULL || to == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	zone_contents_t *contents = calloc(1, sizeof(zone_contents_t));
+	if (contents == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	contents->nodes = zone_tree_cow(from->nodes);
+	if (contents->nodes == NULL) {
+		free(contents);
+		return KNOT_ENOMEM;
+	}
+
+	if (from->nsec3_nodes != NULL) {
+		contents->nsec3_nodes = zone_tree_cow(from->nsec3_nodes);
+		if (contents->nsec3_nodes == NULL) {
 			zone_tree_free(&contents->nodes);
-			zone_tree_free(&contents->nsec3_nodes);
 			free(contents);
-			return ret;
+			return KNOT_ENOMEM;
 		}
-	} else {
-		contents->nsec3_nodes = NULL;
 	}
 
+	// The apex is always changed, NSEC3 nodes and empty nodes change its children.
+	contents->apex = binode_node(from->apex, contents->nodes->flags & ZONE_TREE_BINO_SECOND);
+	int ret = zone_tree_touch(contents->nodes, contents->apex);
+	if (ret == KNOT_EOK && from->referrers != NULL) {
+		contents->referrers = trie_cow(from->referrers);
+		if (contents->referrers == NULL) {
+			ret = KNOT_ENOMEM;
+		}
+	}
+	if (ret != KNOT_EOK) {
+		zone_tree_cow_rollback(from->nodes, &contents->nodes, from->arena);
+		zone_tree_cow_rollback(from->nsec3_nodes, &contents->nsec3_nodes, from->arena);
+		free(contents);
+		return ret;
+	}
+
+	contents->size = from->size;
+
+	// Unchanged nodes and RDATA are still shared with the arena.
+	contents->arena = zone_arena_ref(from->arena);
+
 	*to = contents;
 	return KNOT_EOK;
 }
 
+void zone_contents_cow_commit(zone_contents_t **from, zone_contents_t *to)
+{
+	if (from == NULL || *from == NULL || to == NULL) {
+		return;
+	}
+
+	zone_tree_cow_commit(&(*from)->nodes, to->nodes, to->arena);
+	zone_tree_cow_commit(&(*from)->nsec3_nodes, to->nsec3_nodes, to->arena);
+
+	zone_contents_free(from);
+}
+
+void zone_contents_cow_rollback(zone_contents_t *from, zone_contents_t **to)
+{
+	if (from == NULL || to == NULL || *to == NULL) {
+		return;
+	}
+
+	zone_tree_cow_rollback(from->nodes, &(*to)->nodes, (*to)->arena);
+	zone_tree_cow_rollback(from->nsec3_nodes, &(*to)->nsec3_nodes, (*to)->arena);
+
+	zone_contents_free(to);
+}
+
 void zone_contents_free(zone_contents_t **contents)
 {
 	if (contents == NULL || *contents == NULL) {
@@ -1098,8 +2246,13 @@ void zone_contents_free(zone_contents_t **contents)
 	// free the zone tree, but only the structure
 	zone_tree_free(&(*contents)->nodes);
 	zone_tree_free(&(*contents)->nsec3_nodes);
+	trie_free((*contents)->referrers);
 
 	dnssec_nsec3_params_free(&(*contents)->nsec3_params);
+	answer_cache_free((*contents)->answer_cache);
+	nsec3_cache_free((*contents)->nsec3_cache);
+	xfr_cache_free((*contents)->xfr_cache);
+	zone_arena_unref((*contents)->arena);
 
 	free(*contents);
 	*contents = NULL;
@@ -1114,11 +2267,11 @@ void zone_contents_deep_free(zone_contents_t **contents)
 	if (*contents != NULL) {
 		// Delete NSEC3 tree
 		(void)zone_tree_apply((*contents)->nsec3_nodes,
-		                      destroy_node_rrsets_from_tree, NULL);
+		                      destroy_node_rrsets_from_tree, (*contents)->arena);
 
 		// Delete normal tree
 		(void)zone_tree_apply((*contents)->nodes,
-		                      destroy_node_rrsets_from_tree, NULL);
+		                      destroy_node_rrsets_from_tree, (*contents)->arena);
 	}
 
 	zone_contents_free(contents);
@@ -1170,3 +2323,189 @@ size_t zone_contents_measure_size(zone_contents_t *zone)
 	zone_contents_apply(zone, measure_size, &zone->size);
 	return zone->size;
 }
+
+typedef struct {
+	const zone_arena_t *arena;
+	zone_memory_t *mem;
+} measure_memory_ctx_t;
+
+/*! \brief Accounts an allocation as a typical allocator chunk. */
+static void measure_alloc(zone_memory_t *mem, size_t size)
+{
+	const size_t unit = 2 * sizeof(size_t);
+	size_t chunk = (size + sizeof(size_t) + unit - 1) & ~(unit - 1);
+
+	mem->bytes += MAX(chunk, 2 * unit);
+	mem->allocations++;
+}
+
+static int measure_memory(zone_node_t **tnode, void *data)
+{
+	measure_memory_ctx_t *ctx = data;
+	const zone_node_t *node = *tnode;
+	zone_memory_t *mem = ctx->mem;
+
+	mem->nodes++;
+
+	bool in_arena = (node->flags & NODE_FLAGS_ARENA);
+	if (!in_arena) {
+		measure_alloc(mem, 2 * sizeof(*node));
+		measure_alloc(mem, knot_dname_size(node->owner));
+		if (node->rrs != NULL) {
+			measure_alloc(mem, node->rrset_count * sizeof(struct rr_data));
+		}
+	}
+
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		const struct rr_data *data = &node->rrs[i];
+		if (!in_arena && data->rrs.data != NULL &&
+		    !zone_arena_owns(ctx->arena, data->rrs.data)) {
+			measure_alloc(mem, knot_rdataset_size(&data->rrs));
+		}
+		if (data->additional != NULL) {
+			measure_alloc(mem, sizeof(additional_t));
+			measure_alloc(mem, data->additional->count * sizeof(glue_t));
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+void zone_contents_measure_memory(const zone_contents_t *zone, zone_memory_t *mem)
+{
+	if (mem == NULL) {
+		return;
+	}
+
+	memset(mem, 0, sizeof(*mem));
+	if (zone == NULL) {
+		return;
+	}
+
+	measure_memory_ctx_t ctx = { zone->arena, mem };
+	(void)zone_tree_walk(zone->nodes, measure_memory, &ctx);
+	(void)zone_tree_walk(zone->nsec3_nodes, measure_memory, &ctx);
+
+	if (zone->arena != NULL) {
+		measure_alloc(mem, zone_arena_size(zone->arena));
+	}
+}
+
+/*!
+ * \brief Arena size of a node: binode, RRSet array, owner, and RDATA.
+ *
+ * One byte is reserved to align the RDATA following the owner.
+ */
+static size_t compact_node_size(const zone_node_t *node)
+{
+	size_t size = 2 * sizeof(*node) + node->rrset_count * sizeof(struct rr_data) +
+	              knot_dname_size(node->owner) + 1;
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		size += knot_rdataset_size(&node->rrs[i].rrs);
+	}
+
+	return size;
+}
+
+static int measure_compact_size(zone_node_t **tnode, void *data)
+{
+	size_t *size = data;
+	*size += (compact_node_size(*tnode) + 7) & ~(size_t)7;
+
+	return KNOT_EOK;
+}
+
+typedef struct {
+	zone_contents_t *zone;
+	bool nsec3;
+} compact_ctx_t;
+
+static int compact_node(zone_node_t **tnode, void *data)
+{
+	compact_ctx_t *ctx = data;
+	zone_node_t *old = *tnode;
+
+	uint8_t *pos = zone_arena_alloc(ctx->zone->arena, compact_node_size(old));
+	if (pos == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	zone_node_t *node = (zone_node_t *)pos;
+	*node = *old;
+	node->flags |= NODE_FLAGS_ARENA;
+	node->prev = NULL;
+	node->nsec3_node = NULL;
+	pos += 2 * sizeof(*node);
+
+	if (old->rrs != NULL) {
+		node->rrs = (struct rr_data *)pos;
+		pos += old->rrset_count * sizeof(struct rr_data);
+	}
+
+	size_t owner_size = knot_dname_size(old->owner);
+	memcpy(pos, old->owner, owner_size);
+	node->owner = pos;
+	pos += owner_size + (owner_size & 1);
+
+	// The second half is filled once a zone version shares the node.
+	memset(node + 1, 0, sizeof(*node));
+	node[1].owner = node->owner;
+	node[1].flags = NODE_FLAGS_ARENA | NODE_FLAGS_SECOND;
+
+	for (uint16_t i = 0; i < old->rrset_count; i++) {
+		struct rr_data *data = &node->rrs[i];
+		*data = old->rrs[i];
+		data->additional = NULL;
+
+		size_t size = knot_rdataset_size(&data->rrs);
+		if (size > 0) {
+			memcpy(pos, data->rrs.data, size);
+			data->rrs.data = (knot_rdata_t *)pos;
+			pos += size;
+		}
+	}
+
+	// Parents precede their children in the canonical order, already moved.
+	if (old == ctx->zone->apex) {
+		ctx->zone->apex = node;
+	} else if (ctx->nsec3) {
+		node->parent = binode_first(ctx->zone->apex);
+	} else {
+		const uint8_t *parent = knot_wire_next_label(node->owner, NULL);
+		node->parent = binode_first(zone_tree_get(ctx->zone->nodes, parent));
+		assert(node->parent != NULL);
+	}
+
+	node_free_rrsets(old, NULL);
+	node_free(&old, NULL);
+	*tnode = node;
+
+	return KNOT_EOK;
+}
+
+int zone_contents_compact(zone_contents_t *zone)
+{
+	if (zone == NULL || zone->arena != NULL) {
+		return KNOT_EINVAL;
+	}
+
+	size_t size = 0;
+	(void)zone_tree_walk(zone->nodes, measure_compact_size, &size);
+	(void)zone_tree_walk(zone->nsec3_nodes, measure_compact_size, &size);
+
+	zone->arena = zone_arena_new(size);
+	if (zone->arena == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	compact_ctx_t ctx = { .zone = zone, .nsec3 = false };
+	int ret = zone_tree_apply(zone->nodes, compact_node, &ctx);
+	if (ret == KNOT_EOK) {
+		ctx.nsec3 = true;
+		ret = zone_tree_apply(zone->nsec3_nodes, compact_node, &ctx);
+	}
+	assert(ret == KNOT_EOK); // The arena is large enough.
+
+	// Previous node, NSEC3 node, and additionals pointers.
+	return zone_contents_adjust_full(zone);
+}
@@ -26,7 +26,11 @@
 
 #include "dnssec/nsec.h"
 #include "libknot/rrtype/nsec3param.h"
+#include "knot/zone/answer-cache.h"
+#include "knot/zone/arena.h"
 #include "knot/zone/node.h"
+#include "knot/zone/nsec3-cache.h"
+#include "knot/zone/xfr-cache.h"
 #include "knot/zone/zone-tree.h"
 
 enum zone_contents_find_dname_result {
@@ -42,8 +46,47 @@ typedef struct zone_contents {
 
 	dnssec_nsec3_params_t nsec3_params;
 	size_t size;
+
+	trie_t *referrers;            /*!< RDATA names with additionals and their owners. */
+	answer_cache_t *answer_cache; /*!< Pre-rendered answers (optional). */
+	nsec3_cache_t *nsec3_cache;   /*!< Hashed names for NSEC3 proofs (optional). */
+	xfr_cache_t *xfr_cache;       /*!< Pre-rendered transfers (optional). */
+	zone_arena_t *arena;          /*!< Compacted nodes and RDATA (optional). */
+	uint64_t version;             /*!< Unique number assigned when published. */
 } zone_contents_t;
 
+/*!
+ * \brief Changes of zone contents since the last adjusting.
+ *
+ * Collected while changing an adjusted zone contents, so that only the nodes
+ * affected by the changes are adjusted again.
+ */
+typedef struct {
+	trie_t *names;          /*!< Changed names and their ancestors with scope flags. */
+	trie_t *nsec3_names;    /*!< Changed NSEC3 names. */
+	trie_t *removed_nsec3;  /*!< Removed NSEC3 nodes (pointer values, not dereferenced). */
+	trie_t *owners;         /*!< Owners of the changed RRSets with additionals. */
+	bool all_additionals;   /*!< Apex wildcard changed, rediscover all additionals. */
+	bool full;              /*!< NSEC3 parameters changed, full adjusting needed. */
+} zone_adjust_changes_t;
+
+/*!
+ * \brief Memory used by zone nodes and their data.
+ */
+typedef struct {
+	size_t nodes;       /*!< Number of nodes. */
+	size_t bytes;       /*!< Allocated bytes. */
+	size_t allocations; /*!< Number of allocations. */
+} zone_memory_t;
+
+/*!
+ * \brief Insertion cursor for records grouped by owner (e.g. AXFR).
+ */
+typedef struct {
+	zone_node_t *node;  /*!< Node of the last added record. */
+	bool nsec3;         /*!< The node is in the NSEC3 tree. */
+} zone_append_ctx_t;
+
 /*!
  * \brief Signature of callback for zone contents apply functions.
  */
@@ -69,6 +112,22 @@ zone_contents_t *zone_contents_new(const knot_dname_t *apex_name);
  */
 int zone_contents_add_rr(zone_contents_t *z, const knot_rrset_t *rr, zone_node_t **n);
 
+/*!
+ * \brief Add an RR to contents, faster if the records are grouped by owner.
+ *
+ * The node of the previous record is reused for the same owner. A new node
+ * gets its parent from the ancestors of the previous node if possible, which
+ * avoids the tree lookups when the records come in canonical order.
+ *
+ * \param z    Contents to add to.
+ * \param rr   The RR to add.
+ * \param ctx  Insertion cursor, zero initialized before the first record.
+ *
+ * \return KNOT_E*
+ */
+int zone_contents_append_rr(zone_contents_t *z, const knot_rrset_t *rr,
+                            zone_append_ctx_t *ctx);
+
 /*!
  * \brief Remove an RR from contents.
  *
@@ -190,9 +249,96 @@ int zone_contents_adjust_pointers(zone_contents_t *contents);
  */
 int zone_contents_adjust_full(zone_contents_t *contents);
 
+/*!
+ * \brief Initializes empty changes for incremental adjusting.
+ */
+void zone_adjust_changes_init(zone_adjust_changes_t *changes);
+
+/*!
+ * \brief Records a changed (added or removed) RRSet.
+ *
+ * \param changes   Changes.
+ * \param contents  Zone contents being changed.
+ * \param rr        Changed RRSet, must belong to the zone.
+ *
+ * \return KNOT_E*
+ */
+int zone_adjust_changes_add(zone_adjust_changes_t *changes,
+                            const zone_contents_t *contents,
+                            const knot_rrset_t *rr);
+
+/*!
+ * \brief Records an NSEC3 node being removed from the zone.
+ *
+ * \param changes  Changes.
+ * \param node     NSEC3 node to be removed.
+ *
+ * \return KNOT_E*
+ */
+int zone_adjust_changes_removed(zone_adjust_changes_t *changes,
+                                const zone_node_t *node);
+
+/*!
+ * \brief Clears the changes.
+ */
+void zone_adjust_changes_clear(zone_adjust_changes_t *changes);
+
+/*!
+ * \brief Updates the referrer index after an RRSet of the node was changed.
+ *
+ * The index links the RDATA names of the RRSets with additionals to their
+ * owners, so that incremental adjusting finds the additionals affected by
+ * the changed names. It's built by the full adjusting.
+ *
+ * \param contents  Zone contents being changed.
+ * \param node      Node with the changed RRSet.
+ * \param rr        Added or removed RRSet.
+ *
+ * \return KNOT_E*
+ */
+int zone_contents_update_referrers(zone_contents_t *contents,
+                                   const zone_node_t *node,
+                                   const knot_rrset_t *rr);
+
+/*!
+ * \brief Adjusts zone contents after changes.
+ *
+ * Sets the same as \ref zone_contents_adjust_full, but NSEC3 links and
+ * additionals are recomputed only for the nodes affected by the changes.
+ * The additionals are found by the changed owners and the referrer index,
+ * see \ref zone_contents_update_referrers. Node flags and previous pointers
+ * are checked only around the changed names, from their preceding nodes up
+ * to the following nodes linked to them, and below the nodes whose flags
+ * changed. Only the nodes whose data change are touched.
+ * The contents must have been adjusted before the changes were made.
+ *
+ * \param contents  Zone contents to be adjusted.
+ * \param changes   Changes since the last adjusting.
+ *
+ * \return KNOT_E*
+ */
+int zone_contents_adjust_incremental(zone_contents_t *contents,
+                                     const zone_adjust_changes_t *changes);
+
+/*!
+ * \brief Verifies adjusted zone contents against full adjusting.
+ *
+ * The contents are adjusted fully and the result is compared with the
+ * previous state.
+ *
+ * \param contents  Adjusted zone contents.
+ *
+ * \retval KNOT_EOK if no difference was found.
+ * \retval KNOT_ESEMCHECK if the contents were not adjusted correctly.
+ * \return KNOT_E* on other errors.
+ */
+int zone_contents_adjust_check(zone_contents_t *contents);
+
 /*!
  * \brief Applies the given function to each regular node in the zone.
  *
+ * The nodes aren't touched, so the function must not change them.
+ *
  * \param contents Nodes of this zone will be used as parameters for the function.
  * \param function Function to be applied to each node of the zone.
  * \param data Arbitrary data to be passed to the function.
@@ -203,6 +349,8 @@ int zone_contents_apply(zone_contents_t *contents,
 /*!
  * \brief Applies the given function to each NSEC3 node in the zone.
  *
+ * The nodes aren't touched, so the function must not change them.
+ *
  * \param contents NSEC3 nodes of this zone will be used as parameters for the
  *                 function.
  * \param function Function to be applied to each node of the zone.
@@ -229,6 +377,44 @@ int zone_contents_nsec3_apply(zone_contents_t *contents,
  */
 int zone_contents_shallow_copy(const zone_contents_t *from, zone_contents_t **to);
 
+/*!
+ * \brief Creates a copy-on-write copy of adjusted zone contents.
+ *
+ * The copy shares the nodes with the original, each of them using its own
+ * half of the binodes (see \ref zone_node_t). A node is copied only when
+ * touched in the copy, see \ref zone_tree_touch. The copy is adjusted, so it
+ * can be adjusted incrementally after changes. The original must not be
+ * changed until the copy is committed or rolled back.
+ *
+ * \param from Original adjusted zone.
+ * \param to Copy of the zone.
+ *
+ * \return KNOT_E*
+ */
+int zone_contents_cow(zone_contents_t *from, zone_contents_t **to);
+
+/*!
+ * \brief Finishes the contents copy once the original isn't read anymore.
+ *
+ * The nodes deleted from the copy are freed, the changed ones are copied into
+ * the other halves. RDATA are not freed. The original contents are freed.
+ *
+ * \param from Original zone, no longer used.
+ * \param to Copy of the zone.
+ */
+void zone_contents_cow_commit(zone_contents_t **from, zone_contents_t *to);
+
+/*!
+ * \brief Abandons the contents copy, reverting the changed nodes.
+ *
+ * The nodes created in the copy are freed, RDATA are not freed. The copy
+ * is freed.
+ *
+ * \param from Original zone.
+ * \param to Copy of the zone to be abandoned.
+ */
+void zone_contents_cow_rollback(zone_contents_t *from, zone_contents_t **to);
+
 /*!
  * \brief Deallocate directly owned data of zone contents.
  *
@@ -281,4 +467,30 @@ bool zone_contents_is_empty(const zone_contents_t *zone);
  */
 size_t zone_contents_measure_size(zone_contents_t *zone);
 
+/*!
+ * \brief Measure memory used by zone nodes and their data.
+ *
+ * Each allocation is accounted including an estimated allocator overhead
+ * (size header and two-word alignment). The whole arena is accounted to
+ * the contents referencing it.
+ *
+ * \param zone  Zone contents.
+ * \param mem   Output memory usage.
+ */
+void zone_contents_measure_memory(const zone_contents_t *zone, zone_memory_t *mem);
+
+/*!
+ * \brief Packs all nodes including owners and RDATA into one arena block.
+ *
+ * The contents must exclusively own their data and mustn't be compacted
+ * yet. The contents are adjusted again. The compacted nodes are immutable;
+ * zone updates modify their shallow copies, which share the RDATA with
+ * the arena.
+ *
+ * \param zone  Zone contents.
+ *
+ * \return KNOT_E*
+ */
+int zone_contents_compact(zone_contents_t *zone);
+
 /*! @} */
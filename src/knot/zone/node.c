@@ -14,6 +14,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
+
 #include "knot/zone/node.h"
 #include "libknot/libknot.h"
 #include "contrib/mempattern.h"
@@ -57,6 +59,11 @@ static int add_rrset_no_merge(zone_node_t *node, const knot_rrset_t *rrset,
 		return KNOT_EINVAL;
 	}
 
+	int ret = binode_prepare_change(node, mm);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
 	const size_t prev_nlen = node->rrset_count * sizeof(struct rr_data);
 	const size_t nlen = (node->rrset_count + 1) * sizeof(struct rr_data);
 	void *p = mm_realloc(mm, node->rrs, nlen, prev_nlen);
@@ -64,7 +71,7 @@ static int add_rrset_no_merge(zone_node_t *node, const knot_rrset_t *rrset,
 		return KNOT_ENOMEM;
 	}
 	node->rrs = p;
-	int ret = rr_data_from(rrset, node->rrs + node->rrset_count, mm);
+	ret = rr_data_from(rrset, node->rrs + node->rrset_count, mm);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -85,11 +92,11 @@ static bool ttl_changed(struct rr_data *node_data, const knot_rrset_t *rrset)
 
 zone_node_t *node_new(const knot_dname_t *owner, knot_mm_t *mm)
 {
-	zone_node_t *ret = mm_alloc(mm, sizeof(zone_node_t));
+	zone_node_t *ret = mm_alloc(mm, 2 * sizeof(zone_node_t));
 	if (ret == NULL) {
 		return NULL;
 	}
-	memset(ret, 0, sizeof(*ret));
+	memset(ret, 0, 2 * sizeof(*ret));
 
 	if (owner) {
 		ret->owner = knot_dname_copy(owner, mm);
@@ -102,6 +109,10 @@ zone_node_t *node_new(const knot_dname_t *owner, knot_mm_t *mm)
 	// Node is authoritative by default.
 	ret->flags = NODE_FLAGS_AUTH;
 
+	// The second half is filled once a zone version shares the node.
+	ret[1].owner = ret->owner;
+	ret[1].flags = NODE_FLAGS_AUTH | NODE_FLAGS_SECOND;
+
 	return ret;
 }
 
@@ -126,14 +137,103 @@ void node_free(zone_node_t **node, knot_mm_t *mm)
 		return;
 	}
 
-	if ((*node)->rrs != NULL) {
-		mm_free(mm, (*node)->rrs);
+	zone_node_t *first = binode_first(*node);
+	*node = NULL;
+	if (first->flags & NODE_FLAGS_ARENA) {
+		return;
 	}
 
-	knot_dname_free(&(*node)->owner, mm);
+	if (first[1].rrs != first->rrs) {
+		mm_free(mm, first[1].rrs);
+	}
+	mm_free(mm, first->rrs);
 
-	mm_free(mm, *node);
-	*node = NULL;
+	knot_dname_free(&first->owner, mm);
+
+	mm_free(mm, first);
+}
+
+int binode_prepare_change(zone_node_t *node, knot_mm_t *mm)
+{
+	if (node->rrs == NULL || node->rrs != binode_counterpart(node)->rrs) {
+		return KNOT_EOK;
+	}
+
+	if (node->rrset_count == 0) {
+		node->rrs = NULL;
+		return KNOT_EOK;
+	}
+
+	size_t size = node->rrset_count * sizeof(struct rr_data);
+	struct rr_data *rrs = mm_alloc(mm, size);
+	if (rrs == NULL) {
+		return KNOT_ENOMEM;
+	}
+	memcpy(rrs, node->rrs, size);
+	node->rrs = rrs;
+
+	return KNOT_EOK;
+}
+
+/*! \brief Checks if the additional is used by the node. */
+static bool has_additional(const zone_node_t *node, const additional_t *additional)
+{
+	for (uint16_t i = 0; i < node->rrset_count; ++i) {
+		if (node->rrs[i].additional == additional) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool binode_additional_shared(const zone_node_t *node, const additional_t *additional)
+{
+	return additional != NULL &&
+	       has_additional(binode_counterpart(node), additional);
+}
+
+/*! \brief Frees the RRSet array and additionals of \a node not used by \a keep. */
+static void free_unused(zone_node_t *node, const zone_node_t *keep,
+                        const zone_arena_t *arena)
+{
+	for (uint16_t i = 0; i < node->rrset_count; ++i) {
+		additional_t *additional = node->rrs[i].additional;
+		if (additional != NULL && (keep == NULL || !has_additional(keep, additional))) {
+			additional_clear(additional);
+		}
+	}
+
+	if (node->rrs != NULL && (keep == NULL || node->rrs != keep->rrs) &&
+	    !zone_arena_owns(arena, node->rrs)) {
+		free(node->rrs);
+	}
+}
+
+void binode_unify(zone_node_t *node, const zone_arena_t *arena)
+{
+	zone_node_t *other = binode_counterpart(node);
+	free_unused(other, node, arena);
+
+	uint16_t second = other->flags & NODE_FLAGS_SECOND;
+	*other = *node;
+	other->flags = (node->flags & ~NODE_FLAGS_SECOND) | second;
+}
+
+void binode_free(zone_node_t *node, const zone_arena_t *arena)
+{
+	if (node == NULL) {
+		return;
+	}
+
+	zone_node_t *first = binode_first(node);
+	free_unused(first + 1, first, arena);
+	free_unused(first, NULL, arena);
+
+	if (!(first->flags & NODE_FLAGS_ARENA)) {
+		knot_dname_free(&first->owner, NULL);
+		free(first);
+	}
 }
 
 zone_node_t *node_shallow_copy(const zone_node_t *src, knot_mm_t *mm)
@@ -148,7 +248,8 @@ zone_node_t *node_shallow_copy(const zone_node_t *src, knot_mm_t *mm)
 		return NULL;
 	}
 
-	dst->flags = src->flags;
+	dst->flags = src->flags & ~(NODE_FLAGS_ARENA | NODE_FLAGS_SECOND |
+	                             NODE_FLAGS_NEW | NODE_FLAGS_DELETED);
 
 	// copy RRSets
 	dst->rrset_count = src->rrset_count;
@@ -176,14 +277,18 @@ int node_add_rrset(zone_node_t *node, const knot_rrset_t *rrset, knot_mm_t *mm)
 
 	for (uint16_t i = 0; i < node->rrset_count; ++i) {
 		if (node->rrs[i].type == rrset->type) {
+			int ret = binode_prepare_change(node, mm);
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
+
 			struct rr_data *node_data = &node->rrs[i];
 			const bool ttl_change = ttl_changed(node_data, rrset);
 			if (ttl_change) {
 				node_data->ttl = rrset->ttl;
 			}
 
-			int ret = knot_rdataset_merge(&node_data->rrs,
-			                              &rrset->rrs, mm);
+			ret = knot_rdataset_merge(&node_data->rrs, &rrset->rrs, mm);
 			if (ret != KNOT_EOK) {
 				return ret;
 			} else {
@@ -204,6 +309,9 @@ void node_remove_rdataset(zone_node_t *node, uint16_t type)
 
 	for (int i = 0; i < node->rrset_count; ++i) {
 		if (node->rrs[i].type == type) {
+			if (binode_prepare_change(node, NULL) != KNOT_EOK) {
+				return;
+			}
 			memmove(node->rrs + i, node->rrs + i + 1,
 			        (node->rrset_count - i - 1) * sizeof(struct rr_data));
 			--node->rrset_count;
@@ -245,16 +353,16 @@ knot_rdataset_t *node_rdataset(const zone_node_t *node, uint16_t type)
 
 void node_set_parent(zone_node_t *node, zone_node_t *parent)
 {
-	if (node == NULL || node->parent == parent) {
+	if (node == NULL || node->parent == binode_first(parent)) {
 		return;
 	}
 
 	// decrease number of children of previous parent
 	if (node->parent != NULL) {
-		--node->parent->children;
+		--node_parent(node)->children;
 	}
 	// set the parent
-	node->parent = parent;
+	node->parent = binode_first(parent);
 
 	// increase the count of children of the new parent
 	if (parent != NULL) {
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "knot/zone/arena.h"
 #include "libknot/descriptor.h"
 #include "libknot/dname.h"
 #include "libknot/rrset.h"
@@ -26,6 +27,12 @@ struct rr_data;
 /*!
  * \brief Structure representing one node in a domain name tree, i.e. one domain
  *        name in a zone.
+ *
+ * Nodes are allocated in pairs, binodes. Two consecutive zone versions share
+ * the binodes, each of them using its own half, so that the new version
+ * changes only the nodes it touches. The pointers to other nodes always
+ * point to the first halves, use node_parent(), node_prev(), node_nsec3(),
+ * and glue_node() to get the half of the same zone version.
  */
 typedef struct zone_node {
 	knot_dname_t *owner; /*!< Domain name being the owner of this node. */
@@ -42,7 +49,7 @@ typedef struct zone_node {
 	struct zone_node *nsec3_node; /*! NSEC3 node corresponding to this node. */
 	uint32_t children; /*!< Count of children nodes in DNS hierarchy. */
 	uint16_t rrset_count; /*!< Number of RRSets stored in the node. */
-	uint8_t flags; /*!< \ref node_flags enum. */
+	uint16_t flags; /*!< \ref node_flags enum. */
 } zone_node_t;
 
 /*!< \brief Glue node context. */
@@ -79,9 +86,88 @@ enum node_flags {
 	/*! \brief Node is empty and will be deleted after update. */
 	NODE_FLAGS_EMPTY =           1 << 3,
 	/*! \brief Node has a wildcard child. */
-	NODE_FLAGS_WILDCARD_CHILD =  1 << 4
+	NODE_FLAGS_WILDCARD_CHILD =  1 << 4,
+	/*! \brief Node including its data is stored in the zone arena. */
+	NODE_FLAGS_ARENA =           1 << 5,
+	/*! \brief Node is the second half of a binode. */
+	NODE_FLAGS_SECOND =          1 << 6,
+	/*! \brief The other half was inserted into the zone version being updated. */
+	NODE_FLAGS_NEW =             1 << 7,
+	/*! \brief Node was deleted from the zone version being updated. */
+	NODE_FLAGS_DELETED =         1 << 8,
 };
 
+/*!
+ * \brief Returns the half of the binode used by the given zone version.
+ *
+ * \param node    Any half of the binode (can be NULL).
+ * \param second  Return the second half.
+ */
+static inline zone_node_t *binode_node(const zone_node_t *node, bool second)
+{
+	if (node == NULL) {
+		return NULL;
+	}
+
+	zone_node_t *first = (zone_node_t *)node;
+	if (node->flags & NODE_FLAGS_SECOND) {
+		first--;
+	}
+
+	return second ? first + 1 : first;
+}
+
+/*!
+ * \brief Returns the first half of the binode, as referenced by other nodes.
+ */
+static inline zone_node_t *binode_first(const zone_node_t *node)
+{
+	return binode_node(node, false);
+}
+
+/*!
+ * \brief Returns the other half of the binode.
+ */
+static inline zone_node_t *binode_counterpart(const zone_node_t *node)
+{
+	return binode_node(node, !(node->flags & NODE_FLAGS_SECOND));
+}
+
+/*!
+ * \brief Returns the parent of the node in the same zone version.
+ */
+static inline zone_node_t *node_parent(const zone_node_t *node)
+{
+	return binode_node(node->parent, node->flags & NODE_FLAGS_SECOND);
+}
+
+/*!
+ * \brief Returns the previous node in the same zone version.
+ */
+static inline zone_node_t *node_prev(const zone_node_t *node)
+{
+	return binode_node(node->prev, node->flags & NODE_FLAGS_SECOND);
+}
+
+/*!
+ * \brief Returns the NSEC3 node of the node in the same zone version.
+ */
+static inline zone_node_t *node_nsec3(const zone_node_t *node)
+{
+	return binode_node(node->nsec3_node, node->flags & NODE_FLAGS_SECOND);
+}
+
+/*!
+ * \brief Returns the glue node in the zone version of the given node.
+ *
+ * \param glue  Glue.
+ * \param node  Any node of the zone version the glue belongs to.
+ */
+static inline const zone_node_t *glue_node(const glue_t *glue, const zone_node_t *node)
+{
+	return binode_node(glue->node, node->flags & NODE_FLAGS_SECOND);
+}
+
 /*!
  * \brief Clears additional structure.
  *
@@ -95,7 +181,7 @@ void additional_clear(additional_t *additional);
  * \param owner  Node's owner, will be duplicated.
  * \param mm     Memory context to use.
  *
- * \return Newly created node or NULL if an error occurred.
+ * \return First half of the newly created binode or NULL if an error occurred.
  */
 zone_node_t *node_new(const knot_dname_t *owner, knot_mm_t *mm);
 
@@ -109,16 +195,61 @@ zone_node_t *node_new(const knot_dname_t *owner, knot_mm_t *mm);
 void node_free_rrsets(zone_node_t *node, knot_mm_t *mm);
 
 /*!
- * \brief Destroys the node structure.
+ * \brief Destroys the binode structure.
  *
- * Does not destroy the data within the node.
- * Also sets the given pointer to NULL.
+ * Does not destroy the data within the node, except for the RRSet arrays.
+ * An arena node is left to the arena. Also sets the given pointer to NULL.
  *
  * \param node  Node to be destroyed.
  * \param mm    Memory context to use.
  */
 void node_free(zone_node_t **node, knot_mm_t *mm);
 
+/*!
+ * \brief Makes the node writable without affecting the other half of the binode.
+ *
+ * The RRSet array shared with the other half is copied. Must be called
+ * before the node RRSets are changed in place.
+ *
+ * \param node  Node to be changed.
+ * \param mm    Memory context to use.
+ *
+ * \return KNOT_E*
+ */
+int binode_prepare_change(zone_node_t *node, knot_mm_t *mm);
+
+/*!
+ * \brief Checks if the additional is used by the other half of the binode too.
+ *
+ * \param node        Node with the additional.
+ * \param additional  Additional to check.
+ *
+ * \return True/False.
+ */
+bool binode_additional_shared(const zone_node_t *node, const additional_t *additional);
+
+/*!
+ * \brief Copies the node into the other half of the binode.
+ *
+ * The RRSet array and the additionals of the other half not used by the node
+ * are freed, unless stored in the arena. RDATA are never freed.
+ *
+ * \param node   Node to be copied.
+ * \param arena  Zone arena (can be NULL).
+ */
+void binode_unify(zone_node_t *node, const zone_arena_t *arena);
+
+/*!
+ * \brief Destroys the binode including the RRSet arrays and the additionals
+ *        of both halves.
+ *
+ * RDATA are not freed. Data stored in the arena are left to it.
+ *
+ * \param node   Any half of the binode.
+ * \param arena  Zone arena (can be NULL).
+ */
+void binode_free(zone_node_t *node, const zone_arena_t *arena);
+
 /*!
  * \brief Creates a shallow copy of node structure, RR data are shared.
  *
@@ -174,6 +305,8 @@ knot_rdataset_t *node_rdataset(const zone_node_t *node, uint16_t type);
 /*!
  * \brief Sets the parent of the node. Also adjusts children count of parent.
  *
+ * Both the parents must be in the same zone version as the node.
+ *
  * \param node Node to set the parent of.
  * \param parent Parent to set to the node.
  */
@@ -0,0 +1,146 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "knot/zone/nsec3-cache.h"
+#include "contrib/openbsd/siphash.h"
+#include "dnssec/random.h"
+
+/* Number of locks distributed amongst cache slots. */
+#define NSEC3_CACHE_LOCKS 64
+
+/*! \brief Cached NSEC3 hash. */
+typedef struct {
+	uint8_t name_len;  /* Zero if the slot is empty. */
+	uint8_t hash_len;
+	uint8_t hash[NSEC3_CACHE_MAX_HASH];
+	uint8_t name[KNOT_DNAME_MAXLEN];
+} nsec3_cache_entry_t;
+
+struct nsec3_cache {
+	SIPHASH_KEY key;
+	pthread_mutex_t locks[NSEC3_CACHE_LOCKS];
+	/* Parameters the hashes are computed with. */
+	dnssec_nsec3_algorithm_t algorithm;
+	uint16_t iterations;
+	uint8_t salt_len;
+	uint8_t salt[UINT8_MAX];
+	size_t size;
+	nsec3_cache_entry_t slots[];
+};
+
+nsec3_cache_t *nsec3_cache_new(size_t size, const dnssec_nsec3_params_t *params)
+{
+	if (size == 0 || params == NULL || params->salt.size > UINT8_MAX) {
+		return NULL;
+	}
+
+	nsec3_cache_t *cache = calloc(1, sizeof(*cache) + size * sizeof(cache->slots[0]));
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	(void)dnssec_random_buffer((uint8_t *)&cache->key, sizeof(cache->key));
+	for (size_t i = 0; i < NSEC3_CACHE_LOCKS; i++) {
+		pthread_mutex_init(&cache->locks[i], NULL);
+	}
+	cache->algorithm = params->algorithm;
+	cache->iterations = params->iterations;
+	cache->salt_len = params->salt.size;
+	if (params->salt.size > 0) {
+		memcpy(cache->salt, params->salt.data, params->salt.size);
+	}
+	cache->size = size;
+
+	return cache;
+}
+
+void nsec3_cache_free(nsec3_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < NSEC3_CACHE_LOCKS; i++) {
+		pthread_mutex_destroy(&cache->locks[i]);
+	}
+	free(cache);
+}
+
+static bool params_match(const nsec3_cache_t *cache,
+                         const dnssec_nsec3_params_t *params)
+{
+	return cache->algorithm == params->algorithm &&
+	       cache->iterations == params->iterations &&
+	       cache->salt_len == params->salt.size &&
+	       memcmp(cache->salt, params->salt.data, cache->salt_len) == 0;
+}
+
+static size_t slot_index(const nsec3_cache_t *cache, const knot_dname_t *name,
+                         size_t name_len)
+{
+	return SipHash24(&cache->key, name, name_len) % cache->size;
+}
+
+bool nsec3_cache_get(nsec3_cache_t *cache, const dnssec_nsec3_params_t *params,
+                     const knot_dname_t *name, uint8_t *hash, size_t *hash_len)
+{
+	if (cache == NULL || params == NULL || name == NULL || hash == NULL ||
+	    hash_len == NULL || !params_match(cache, params)) {
+		return false;
+	}
+
+	size_t name_len = knot_dname_size(name);
+	size_t idx = slot_index(cache, name, name_len);
+	const nsec3_cache_entry_t *entry = &cache->slots[idx];
+
+	bool found = false;
+	pthread_mutex_t *lock = &cache->locks[idx % NSEC3_CACHE_LOCKS];
+	pthread_mutex_lock(lock);
+	if (entry->name_len == name_len &&
+	    memcmp(entry->name, name, name_len) == 0) {
+		memcpy(hash, entry->hash, entry->hash_len);
+		*hash_len = entry->hash_len;
+		found = true;
+	}
+	pthread_mutex_unlock(lock);
+
+	return found;
+}
+
+void nsec3_cache_put(nsec3_cache_t *cache, const dnssec_nsec3_params_t *params,
+                     const knot_dname_t *name, const uint8_t *hash, size_t hash_len)
+{
+	if (cache == NULL || params == NULL || name == NULL || hash == NULL ||
+	    hash_len > NSEC3_CACHE_MAX_HASH || !params_match(cache, params)) {
+		return;
+	}
+
+	size_t name_len = knot_dname_size(name);
+	size_t idx = slot_index(cache, name, name_len);
+	nsec3_cache_entry_t *entry = &cache->slots[idx];
+
+	pthread_mutex_t *lock = &cache->locks[idx % NSEC3_CACHE_LOCKS];
+	pthread_mutex_lock(lock);
+	memcpy(entry->name, name, name_len);
+	memcpy(entry->hash, hash, hash_len);
+	entry->name_len = name_len;
+	entry->hash_len = hash_len;
+	pthread_mutex_unlock(lock);
+}
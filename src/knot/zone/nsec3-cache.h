@@ -0,0 +1,78 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dnssec/nsec.h"
+#include "libknot/consts.h"
+#include "libknot/dname.h"
+
+/*! \brief Maximal size of a cached raw NSEC3 hash. */
+#define NSEC3_CACHE_MAX_HASH 32
+
+/*! \brief Upper bound of the cache slots count. */
+#define NSEC3_CACHE_MAX_SIZE 4096
+
+typedef struct nsec3_cache nsec3_cache_t;
+
+/*!
+ * \brief Create an NSEC3 hash cache.
+ *
+ * The cache maps domain names to their raw NSEC3 hashes computed with given
+ * parameters. It is direct-mapped, a colliding insertion replaces the
+ * previous entry.
+ *
+ * \param size    Number of cache slots.
+ * \param params  NSEC3 parameters the cached hashes are computed with.
+ *
+ * \return New cache or NULL on error.
+ */
+nsec3_cache_t *nsec3_cache_new(size_t size, const dnssec_nsec3_params_t *params);
+
+/*!
+ * \brief Free the NSEC3 hash cache.
+ */
+void nsec3_cache_free(nsec3_cache_t *cache);
+
+/*!
+ * \brief Look up a cached NSEC3 hash.
+ *
+ * \param cache     NSEC3 hash cache.
+ * \param params    Current NSEC3 parameters (must match the cache ones).
+ * \param name      Domain name.
+ * \param hash      Output hash (at least NSEC3_CACHE_MAX_HASH long).
+ * \param hash_len  Output hash length.
+ *
+ * \return True if found.
+ */
+bool nsec3_cache_get(nsec3_cache_t *cache, const dnssec_nsec3_params_t *params,
+                     const knot_dname_t *name, uint8_t *hash, size_t *hash_len);
+
+/*!
+ * \brief Store an NSEC3 hash.
+ *
+ * \param cache     NSEC3 hash cache.
+ * \param params    NSEC3 parameters the hash was computed with.
+ * \param name      Domain name.
+ * \param hash      Raw NSEC3 hash.
+ * \param hash_len  Raw NSEC3 hash length.
+ */
+void nsec3_cache_put(nsec3_cache_t *cache, const dnssec_nsec3_params_t *params,
+                     const knot_dname_t *name, const uint8_t *hash, size_t hash_len);
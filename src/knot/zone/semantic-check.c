@@ -14,7 +14,9 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -22,6 +24,7 @@
 
 #include "dnssec/error.h"
 #include "contrib/base32hex.h"
+#include "contrib/macros.h"
 #include "contrib/string.h"
 #include "libknot/libknot.h"
 #include "knot/zone/semantic-check.h"
@@ -152,6 +155,10 @@ typedef struct {
 	const zone_node_t *next_nsec;
 	check_level_t level;
 	time_t time;
+	zone_tree_it_t *it;           /*!< Position of the range to be checked. */
+	size_t count;                 /*!< Number of nodes in the range. */
+	pthread_t thread;             /*!< Checking thread. */
+	int result;                   /*!< Checking result. */
 } semchecks_data_t;
 
 static int check_cname(const zone_node_t *node, semchecks_data_t *data);
@@ -710,7 +717,7 @@ static int check_nsec_bitmap(const zone_node_t *node, semchecks_data_t *data)
 	if (nsec) {
 		nsec_rrs = node_rdataset(node, KNOT_RRTYPE_NSEC);
 	} else if (node->nsec3_node != NULL) {
-		nsec_rrs = node_rdataset(node->nsec3_node, KNOT_RRTYPE_NSEC3);
+		nsec_rrs = node_rdataset(node_nsec3(node), KNOT_RRTYPE_NSEC3);
 	}
 	if (nsec_rrs == NULL) {
 		return KNOT_EOK;
@@ -755,6 +762,15 @@ static int check_nsec_bitmap(const zone_node_t *node, semchecks_data_t *data)
 	return KNOT_EOK;
 }
 
+/*!
+ * \brief Check if the node takes part in the NSEC chain.
+ */
+static bool nsec_chain_member(const zone_node_t *node)
+{
+	return !(node->flags & NODE_FLAGS_NONAUTH) && node->rrset_count > 0 &&
+	       node_rrtype_exists(node, KNOT_RRTYPE_NSEC);
+}
+
 /*!
  * \brief Run NSEC related semantic checks
  *
@@ -885,7 +901,8 @@ static int check_nsec3(const zone_node_t *node, semchecks_data_t *data)
 	if (!auth && !deleg) {
 		return KNOT_EOK;
 	}
-	if (node->nsec3_node == NULL) {
+	const zone_node_t *nsec3_node = node_nsec3(node);
+	if (nsec3_node == NULL) {
 		return KNOT_EOK;
 	}
 
@@ -893,9 +910,9 @@ static int check_nsec3(const zone_node_t *node, semchecks_data_t *data)
 	int ret = KNOT_EOK;
 
 	char buff[50 + KNOT_DNAME_TXT_MAXLEN];
-	char *info = nsec3_info(node->nsec3_node->owner, buff, sizeof(buff));
+	char *info = nsec3_info(nsec3_node->owner, buff, sizeof(buff));
 
-	knot_rrset_t nsec3_rrs = node_rrset(node->nsec3_node, KNOT_RRTYPE_NSEC3);
+	knot_rrset_t nsec3_rrs = node_rrset(nsec3_node, KNOT_RRTYPE_NSEC3);
 	if (knot_rrset_empty(&nsec3_rrs)) {
 		data->handler->cb(data->handler, data->zone, node,
 		                  SEM_ERR_NSEC3_NONE, info);
@@ -961,7 +978,7 @@ static int check_nsec3(const zone_node_t *node, semchecks_data_t *data)
 
 	const zone_node_t *next_nsec3 = zone_contents_find_nsec3_node(data->zone,
 	                                                              next_dname);
-	if (next_nsec3 == NULL || next_nsec3->prev != node->nsec3_node) {
+	if (next_nsec3 == NULL || node_prev(next_nsec3) != nsec3_node) {
 		uint8_t *next = NULL;
 		int32_t next_len = base32hex_encode_alloc(next_dname_str,
 		                                          next_dname_str_size,
@@ -976,17 +993,17 @@ static int check_nsec3(const zone_node_t *node, semchecks_data_t *data)
 		free(hash_info);
 	}
 
-	ret = check_rrsig(node->nsec3_node, data);
+	ret = check_rrsig(nsec3_node, data);
 	if (ret != KNOT_EOK) {
 		goto nsec3_cleanup;
 	}
 
 	// Check that the node only contains NSEC3 and RRSIG.
-	for (int i = 0; ret == KNOT_EOK && i < node->nsec3_node->rrset_count; i++) {
-		knot_rrset_t rrset = node_rrset_at(node->nsec3_node, i);
+	for (int i = 0; ret == KNOT_EOK && i < nsec3_node->rrset_count; i++) {
+		knot_rrset_t rrset = node_rrset_at(nsec3_node, i);
 		uint16_t type = rrset.type;
 		if (type != KNOT_RRTYPE_NSEC3 && type != KNOT_RRTYPE_RRSIG) {
-			data->handler->cb(data->handler, data->zone, node->nsec3_node,
+			data->handler->cb(data->handler, data->zone, nsec3_node,
 			                  SEM_ERR_NSEC3_EXTRA_RECORD, NULL);
 		}
 	}
@@ -1041,7 +1058,7 @@ static int check_cname(const zone_node_t *node, semchecks_data_t *data)
  */
 static int check_dname(const zone_node_t *node, semchecks_data_t *data)
 {
-	if (node->parent != NULL && node_rrtype_exists(node->parent, KNOT_RRTYPE_DNAME)) {
+	if (node->parent != NULL && node_rrtype_exists(node_parent(node), KNOT_RRTYPE_DNAME)) {
 		data->handler->fatal_error = true;
 		data->handler->cb(data->handler, data->zone, node,
 		                  SEM_ERR_DNAME_CHILDREN, NULL);
@@ -1096,6 +1113,191 @@ static int do_checks_in_tree(zone_node_t *node, void *data)
 	return ret;
 }
 
+/*!
+ * \brief Semantic error collected by a checking thread.
+ */
+typedef struct {
+	const zone_node_t *node;
+	sem_error_t error;
+	bool fatal;
+	char *data;
+} sem_record_t;
+
+/*!
+ * \brief Error handler collecting the errors of one range.
+ */
+typedef struct {
+	sem_handler_t handler;
+	sem_record_t *records;
+	size_t count;
+	size_t capacity;
+	bool failed;           /*!< Some error couldn't be stored. */
+} sem_buffer_t;
+
+static void buffer_error(sem_handler_t *handler, const zone_contents_t *zone,
+                         const zone_node_t *node, sem_error_t error, const char *data)
+{
+	UNUSED(zone);
+
+	sem_buffer_t *buffer = (sem_buffer_t *)handler;
+
+	if (buffer->count == buffer->capacity) {
+		size_t capacity = MAX(2 * buffer->capacity, 16);
+		sem_record_t *records = realloc(buffer->records,
+		                                capacity * sizeof(*records));
+		if (records == NULL) {
+			buffer->failed = true;
+			return;
+		}
+		buffer->records = records;
+		buffer->capacity = capacity;
+	}
+
+	sem_record_t *record = &buffer->records[buffer->count];
+	record->node = node;
+	record->error = error;
+	record->fatal = handler->fatal_error;
+	record->data = NULL;
+	if (data != NULL) {
+		record->data = strdup(data);
+		if (record->data == NULL) {
+			buffer->failed = true;
+			return;
+		}
+	}
+	buffer->count++;
+}
+
+static int do_checks_in_range(zone_node_t **node, void *data)
+{
+	return do_checks_in_tree(*node, data);
+}
+
+/*!
+ * \brief Find the last NSEC chain member preceding the node.
+ */
+static const zone_node_t *nsec_chain_prev(const zone_node_t *node,
+                                          const zone_node_t *apex)
+{
+	while (node != apex) {
+		node = node_prev(node);
+		if (nsec_chain_member(node)) {
+			return node;
+		}
+	}
+
+	return NULL;
+}
+
+/*!
+ * \brief Check one range of the zone tree (thread function).
+ */
+static void *check_range(void *data)
+{
+	semchecks_data_t *range = data;
+
+	/* Continue in the NSEC chain as if the preceding nodes were checked. */
+	const zone_node_t *first = zone_tree_it_val(range->it);
+	if ((range->level & NSEC) && first != range->zone->apex) {
+		const zone_node_t *prev = nsec_chain_prev(first, range->zone->apex);
+		if (prev != NULL) {
+			const knot_rdataset_t *nsec = node_rdataset(prev, KNOT_RRTYPE_NSEC);
+			range->next_nsec = zone_contents_find_node(range->zone,
+			                                           knot_nsec_next(nsec));
+		}
+	}
+
+	range->result = zone_tree_it_apply(range->it, range->count,
+	                                   do_checks_in_range, range);
+
+	return NULL;
+}
+
+/*!
+ * \brief Run the node checks on all zone nodes.
+ *
+ * The zone tree is split into ranges of the same size, each range is checked
+ * by a separate thread starting at its first node. The errors are collected
+ * per range and passed to the error handler afterwards, so they are reported
+ * in the canonical order.
+ *
+ * \param data     Semantic checks context data.
+ * \param threads  Number of checking threads.
+ */
+static int check_nodes(semchecks_data_t *data, unsigned threads)
+{
+	size_t count = zone_tree_count(data->zone->nodes);
+	threads = MIN(MAX(threads, 1), MAX(count, 1));
+
+	/* Single thread reports the errors directly. */
+	if (threads == 1) {
+		return zone_contents_apply(data->zone, do_checks_in_tree, data);
+	}
+
+	semchecks_data_t *ranges = calloc(threads, sizeof(*ranges));
+	sem_buffer_t *buffers = calloc(threads, sizeof(*buffers));
+	zone_tree_it_t *its = calloc(threads, sizeof(*its));
+	int ret = (ranges == NULL || buffers == NULL || its == NULL) ? KNOT_ENOMEM :
+	          zone_tree_split(data->zone->nodes, threads, its);
+	if (ret != KNOT_EOK) {
+		free(ranges);
+		free(buffers);
+		free(its);
+		return ret;
+	}
+
+	/* Prepare the ranges. */
+	size_t started = 0;
+	for (size_t i = 0; i < threads; i++) {
+		buffers[i].handler.cb = buffer_error;
+
+		ranges[i] = *data;
+		ranges[i].handler = &buffers[i].handler;
+		ranges[i].it = &its[i];
+		ranges[i].count = count * (i + 1) / threads - count * i / threads;
+
+		if (pthread_create(&ranges[i].thread, NULL, check_range, &ranges[i]) != 0) {
+			ret = KNOT_ENOMEM;
+			break;
+		}
+		started++;
+	}
+
+	/* Wait for the checking threads. */
+	for (size_t i = 0; i < started; i++) {
+		pthread_join(ranges[i].thread, NULL);
+		if (ret == KNOT_EOK) {
+			ret = ranges[i].result;
+		}
+		if (ret == KNOT_EOK && buffers[i].failed) {
+			ret = KNOT_ENOMEM;
+		}
+	}
+
+	/* Report the errors in the range order. */
+	for (size_t i = 0; i < threads; i++) {
+		for (size_t j = 0; j < buffers[i].count; j++) {
+			sem_record_t *record = &buffers[i].records[j];
+			if (ret == KNOT_EOK) {
+				data->handler->fatal_error |= record->fatal;
+				data->handler->cb(data->handler, data->zone, record->node,
+				                  record->error, record->data);
+			}
+			free(record->data);
+		}
+		free(buffers[i].records);
+		zone_tree_it_free(&its[i]);
+	}
+
+	data->next_nsec = ranges[threads - 1].next_nsec;
+
+	free(ranges);
+	free(buffers);
+	free(its);
+
+	return ret;
+}
+
 static void check_nsec3param(knot_rdataset_t *nsec3param, zone_contents_t *zone,
                              sem_handler_t *handler, semchecks_data_t *data)
 {
@@ -1149,7 +1351,7 @@ static void check_dnskey(zone_contents_t *zone, sem_handler_t *handler)
 }
 
 int sem_checks_process(zone_contents_t *zone, bool optional, sem_handler_t *handler,
-                       time_t time)
+                       time_t time, unsigned threads)
 {
 	if (zone == NULL || handler == NULL) {
 		return KNOT_EINVAL;
@@ -1178,7 +1380,7 @@ int sem_checks_process(zone_contents_t *zone, bool optional, sem_handler_t *hand
 		}
 	}
 
-	int ret = zone_contents_apply(zone, do_checks_in_tree, &data);
+	int ret = check_nodes(&data, threads);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -109,16 +109,19 @@ struct sem_handler {
 /*!
  * \brief Check zone for semantic errors.
  *
- * Errors are logged in error handler.
+ * Errors are logged in error handler. If more threads are used, the node
+ * checks run in parallel but the errors are still reported in the canonical
+ * order from the calling thread.
  *
  * \param zone      Zone to be searched / checked.
  * \param optional  To do also optional check.
  * \param handler   Semantic error handler.
  * \param time      Check zone at given time (rrsig expiration).
+ * \param threads   Number of checking threads.
  *
  * \retval KNOT_EOK no error found
  * \retval KNOT_ESEMCHECK found semantic error
  * \retval KNOT_EINVAL or other error
  */
 int sem_checks_process(zone_contents_t *zone, bool optional, sem_handler_t *handler,
-                       time_t time);
+                       time_t time, unsigned threads);
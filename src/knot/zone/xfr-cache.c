@@ -0,0 +1,219 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <urcu.h>
+
+#include "knot/zone/xfr-cache.h"
+#include "contrib/macros.h"
+#include "contrib/wire.h"
+#include "libknot/consts.h"
+#include "libknot/descriptor.h"
+#include "libknot/errcode.h"
+#include "libknot/packet/wire.h"
+
+/*! \brief Size of the message prefix (body length and ANCOUNT). */
+#define PREFIX_SIZE (2 * sizeof(uint16_t))
+
+struct xfr_cache {
+	size_t max_size;
+	size_t used;
+	xfr_stream_t *slots[XFR_CACHE_SLOTS];
+};
+
+static uint32_t stream_serial(uint16_t type, uint32_t serial)
+{
+	return (type == KNOT_RRTYPE_IXFR) ? serial : 0;
+}
+
+void xfr_stream_init(xfr_stream_t *stream, uint16_t type, uint32_t serial,
+                     uint16_t base_size)
+{
+	if (stream == NULL) {
+		return;
+	}
+
+	memset(stream, 0, sizeof(*stream));
+	stream->type = type;
+	stream->serial = stream_serial(type, serial);
+	stream->base_size = base_size;
+}
+
+int xfr_stream_append(xfr_stream_t *stream, const uint8_t *wire, size_t size,
+                      size_t max_size)
+{
+	if (stream == NULL || wire == NULL || size < stream->base_size ||
+	    size > KNOT_WIRE_MAX_PKTSIZE) {
+		return KNOT_EINVAL;
+	}
+
+	size_t body = size - stream->base_size;
+	if (stream->size + PREFIX_SIZE + body > max_size) {
+		return KNOT_ESPACE;
+	}
+
+	if (stream->size + PREFIX_SIZE + body > stream->capacity) {
+		size_t capacity = MAX(stream->size + PREFIX_SIZE + body,
+		                      2 * stream->capacity);
+		capacity = MIN(capacity, max_size);
+		uint8_t *data = realloc(stream->data, capacity);
+		if (data == NULL) {
+			return KNOT_ENOMEM;
+		}
+		stream->data = data;
+		stream->capacity = capacity;
+	}
+
+	uint8_t *pos = stream->data + stream->size;
+	wire_write_u16(pos, body);
+	wire_write_u16(pos + sizeof(uint16_t), knot_wire_get_ancount(wire));
+	memcpy(pos + PREFIX_SIZE, wire + stream->base_size, body);
+
+	stream->size += PREFIX_SIZE + body;
+	stream->messages += 1;
+	stream->max_body = MAX(stream->max_body, body);
+
+	return KNOT_EOK;
+}
+
+size_t xfr_stream_next(const xfr_stream_t *stream, size_t *pos,
+                       const uint8_t **body, uint16_t *ancount)
+{
+	if (stream == NULL || pos == NULL || body == NULL || ancount == NULL ||
+	    *pos + PREFIX_SIZE > stream->size) {
+		return 0;
+	}
+
+	const uint8_t *prefix = stream->data + *pos;
+	size_t size = wire_read_u16(prefix);
+	*ancount = wire_read_u16(prefix + sizeof(uint16_t));
+	*body = prefix + PREFIX_SIZE;
+	*pos += PREFIX_SIZE + size;
+
+	return size;
+}
+
+void xfr_stream_clear(xfr_stream_t *stream)
+{
+	if (stream == NULL) {
+		return;
+	}
+
+	free(stream->data);
+	xfr_stream_init(stream, stream->type, stream->serial, stream->base_size);
+}
+
+xfr_cache_t *xfr_cache_new(size_t max_size)
+{
+	if (max_size == 0) {
+		return NULL;
+	}
+
+	xfr_cache_t *cache = calloc(1, sizeof(*cache));
+	if (cache == NULL) {
+		return NULL;
+	}
+	cache->max_size = max_size;
+
+	return cache;
+}
+
+void xfr_cache_free(xfr_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < XFR_CACHE_SLOTS; i++) {
+		if (cache->slots[i] != NULL) {
+			free(cache->slots[i]->data);
+			free(cache->slots[i]);
+		}
+	}
+	free(cache);
+}
+
+size_t xfr_cache_available(const xfr_cache_t *cache)
+{
+	if (cache == NULL) {
+		return 0;
+	}
+
+	size_t used = __atomic_load_n(&cache->used, __ATOMIC_RELAXED);
+	return (used < cache->max_size) ? cache->max_size - used : 0;
+}
+
+const xfr_stream_t *xfr_cache_get(xfr_cache_t *cache, uint16_t type,
+                                  uint32_t serial)
+{
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	serial = stream_serial(type, serial);
+	for (size_t i = 0; i < XFR_CACHE_SLOTS; i++) {
+		xfr_stream_t *stream = rcu_dereference(cache->slots[i]);
+		if (stream == NULL) {
+			return NULL;
+		}
+		if (stream->type == type && stream->serial == serial) {
+			return stream;
+		}
+	}
+
+	return NULL;
+}
+
+int xfr_cache_put(xfr_cache_t *cache, xfr_stream_t *stream)
+{
+	if (cache == NULL || stream == NULL || stream->messages == 0) {
+		return KNOT_EINVAL;
+	}
+
+	/* Account the stream first, so that concurrent insertions can't overflow. */
+	size_t used = __atomic_add_fetch(&cache->used, stream->size, __ATOMIC_RELAXED);
+	if (used > cache->max_size) {
+		__atomic_sub_fetch(&cache->used, stream->size, __ATOMIC_RELAXED);
+		return KNOT_ESPACE;
+	}
+
+	xfr_stream_t *entry = malloc(sizeof(*entry));
+	if (entry == NULL) {
+		__atomic_sub_fetch(&cache->used, stream->size, __ATOMIC_RELAXED);
+		return KNOT_ENOMEM;
+	}
+	*entry = *stream;
+
+	/* Take the first free slot, unless the stream is cached already. */
+	int ret = KNOT_ESPACE;
+	for (size_t i = 0; i < XFR_CACHE_SLOTS; i++) {
+		xfr_stream_t *cur = rcu_cmpxchg_pointer(&cache->slots[i], NULL, entry);
+		if (cur == NULL) {
+			xfr_stream_init(stream, stream->type, stream->serial,
+			                stream->base_size);
+			return KNOT_EOK;
+		}
+		if (cur->type == entry->type && cur->serial == entry->serial) {
+			ret = KNOT_EEXIST;
+			break;
+		}
+	}
+
+	__atomic_sub_fetch(&cache->used, stream->size, __ATOMIC_RELAXED);
+	free(entry);
+	return ret;
+}
@@ -0,0 +1,146 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \file
+ *
+ * Cache of pre-rendered outgoing zone transfers.
+ *
+ * A transfer is stored as a stream of message bodies (the records following
+ * the question section), so that it can be replayed to any client asking for
+ * the same transfer of the same zone version. Message header, question, OPT
+ * and TSIG records are added per client.
+ *
+ * \addtogroup zone
+ * @{
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*! \brief Maximal number of cached transfers per zone version. */
+#define XFR_CACHE_SLOTS 16
+
+/*! \brief Message space reserved for per-client records (OPT, TSIG). */
+#define XFR_CACHE_RESERVE 1024
+
+/*! \brief Rendered transfer. */
+typedef struct {
+	uint16_t type;        /*!< Transfer type (AXFR or IXFR). */
+	uint32_t serial;      /*!< Starting serial for IXFR. */
+	uint16_t base_size;   /*!< Header and question size of the messages. */
+	uint16_t max_body;    /*!< Largest message body. */
+	size_t messages;      /*!< Number of messages. */
+	size_t size;          /*!< Size of the stream data. */
+	size_t capacity;      /*!< Allocated size of the stream data. */
+	uint8_t *data;        /*!< Message bodies with length and ANCOUNT prefix. */
+} xfr_stream_t;
+
+typedef struct xfr_cache xfr_cache_t;
+
+/*!
+ * \brief Initializes an empty transfer stream.
+ *
+ * \param stream     Stream to initialize.
+ * \param type       Transfer type.
+ * \param serial     Starting serial for IXFR, ignored for AXFR.
+ * \param base_size  Header and question size of the messages.
+ */
+void xfr_stream_init(xfr_stream_t *stream, uint16_t type, uint32_t serial,
+                     uint16_t base_size);
+
+/*!
+ * \brief Appends a rendered message to the stream.
+ *
+ * \param stream    Stream.
+ * \param wire      Complete message wire without OPT and TSIG.
+ * \param size      Message size.
+ * \param max_size  Maximal size of the stream data.
+ *
+ * \return KNOT_EOK, KNOT_ESPACE if the stream would be too large, or other error.
+ */
+int xfr_stream_append(xfr_stream_t *stream, const uint8_t *wire, size_t size,
+                      size_t max_size);
+
+/*!
+ * \brief Returns the next message body of the stream.
+ *
+ * \param stream   Stream.
+ * \param pos      Position in the stream, 0 for the first message.
+ * \param body     Output message body.
+ * \param ancount  Output ANCOUNT of the message.
+ *
+ * \return Body size, 0 if no more messages.
+ */
+size_t xfr_stream_next(const xfr_stream_t *stream, size_t *pos,
+                       const uint8_t **body, uint16_t *ancount);
+
+/*!
+ * \brief Frees the stream data.
+ */
+void xfr_stream_clear(xfr_stream_t *stream);
+
+/*!
+ * \brief Creates a transfer cache.
+ *
+ * The cache is bound to one zone contents version and only grows, streams
+ * are never replaced. Lookups and insertions are lock-free.
+ *
+ * \param max_size  Maximal size of all cached streams.
+ *
+ * \return New cache or NULL on error or if disabled.
+ */
+xfr_cache_t *xfr_cache_new(size_t max_size);
+
+/*!
+ * \brief Frees the cache including all cached streams.
+ */
+void xfr_cache_free(xfr_cache_t *cache);
+
+/*!
+ * \brief Returns the remaining space for new streams.
+ */
+size_t xfr_cache_available(const xfr_cache_t *cache);
+
+/*!
+ * \brief Looks up a cached stream.
+ *
+ * \param cache   Transfer cache.
+ * \param type    Transfer type.
+ * \param serial  Starting serial for IXFR, ignored for AXFR.
+ *
+ * \return Stream or NULL if not cached.
+ */
+const xfr_stream_t *xfr_cache_get(xfr_cache_t *cache, uint16_t type,
+                                  uint32_t serial);
+
+/*!
+ * \brief Stores a complete stream.
+ *
+ * On success, the stream data are moved into the cache and the stream
+ * is left empty.
+ *
+ * \param cache   Transfer cache.
+ * \param stream  Stream to store.
+ *
+ * \return KNOT_EOK, KNOT_EEXIST if already cached, KNOT_ESPACE if the cache
+ *         is full, or other error.
+ */
+int xfr_cache_put(xfr_cache_t *cache, xfr_stream_t *stream);
+
+/*! @} */
@@ -315,14 +315,14 @@ static int load_trees(zone_tree_t *nodes1, zone_tree_t *nodes2,
 
 	// Traverse one tree, compare every node, each RRSet with its rdata.
 	param.nodes = nodes2;
-	int ret = zone_tree_apply(nodes1, knot_zone_diff_node, &param);
+	int ret = zone_tree_walk(nodes1, knot_zone_diff_node, &param);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
 
 	// Some nodes may have been added. Add missing nodes to changeset.
 	param.nodes = nodes1;
-	return zone_tree_apply(nodes2, add_new_nodes, &param);
+	return zone_tree_walk(nodes2, add_new_nodes, &param);
 }
 
 int zone_contents_diff(const zone_contents_t *zone1, const zone_contents_t *zone2,
@@ -45,6 +45,8 @@ int zone_load_contents(conf_t *conf, const knot_dname_t *zone_name,
 		.cb = err_handler_logger
 	};
 
+	val = conf_zone_get(conf, C_LOAD_THREADS, zone_name);
+	zl.threads = conf_int(&val);
 	zl.err_handler = &handler;
 	zl.creator->master = !zone_load_can_bootstrap(conf, zone_name);
 
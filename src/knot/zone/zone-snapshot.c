@@ -0,0 +1,532 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "knot/zone/zone-snapshot.h"
+#include "knot/common/log.h"
+#include "knot/zone/semantic-check.h"
+#include "knot/zone/zonefile.h"
+#include "contrib/files.h"
+#include "contrib/macros.h"
+#include "contrib/string.h"
+#include "contrib/wire_ctx.h"
+
+/*
+ * Snapshot layout (all numbers in network byte order):
+ *
+ *   header:  magic "KNOTZSNP", u32 version, u64 zone file mtime seconds,
+ *            u32 zone file mtime nanoseconds, u64 zone file size, zone name
+ *   nodes:   owner, u16 RRSet count,
+ *            RRSets: u16 type, u32 TTL, u16 RR count, RRs: u16 length, RDATA
+ *   trailer: u64 node count, magic "KNOTZEND"
+ *
+ * Nodes of the normal tree precede the NSEC3 nodes, both in canonical order.
+ * Empty non-terminals are not stored.
+ */
+
+#define SNAPSHOT_MAGIC		"KNOTZSNP"
+#define SNAPSHOT_END_MAGIC	"KNOTZEND"
+#define SNAPSHOT_MAGIC_LEN	8
+#define SNAPSHOT_VERSION	2
+#define SNAPSHOT_TRAILER_LEN	(sizeof(uint64_t) + SNAPSHOT_MAGIC_LEN)
+
+#if defined(__APPLE__)
+#define st_mtim st_mtimespec
+#endif
+
+typedef struct {
+	FILE *file;
+	uint8_t *buf;
+	size_t buf_size;
+	uint64_t count;
+} snapshot_writer_t;
+
+static size_t node_size(const zone_node_t *node)
+{
+	size_t size = knot_dname_size(node->owner) + sizeof(uint16_t);
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		const knot_rdataset_t *rrs = &node->rrs[i].rrs;
+		size += 2 * sizeof(uint16_t) + sizeof(uint32_t);
+		for (uint16_t j = 0; j < rrs->rr_count; j++) {
+			size += sizeof(uint16_t) + knot_rdataset_at(rrs, j)->len;
+		}
+	}
+
+	return size;
+}
+
+static int write_node(zone_node_t *node, void *data)
+{
+	snapshot_writer_t *writer = data;
+
+	if (node->rrset_count == 0) {
+		return KNOT_EOK;
+	}
+
+	size_t size = node_size(node);
+	if (size > writer->buf_size) {
+		uint8_t *buf = realloc(writer->buf, size);
+		if (buf == NULL) {
+			return KNOT_ENOMEM;
+		}
+		writer->buf = buf;
+		writer->buf_size = size;
+	}
+
+	wire_ctx_t wire = wire_ctx_init(writer->buf, size);
+	wire_ctx_write(&wire, node->owner, knot_dname_size(node->owner));
+	wire_ctx_write_u16(&wire, node->rrset_count);
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		const struct rr_data *rr_data = &node->rrs[i];
+		wire_ctx_write_u16(&wire, rr_data->type);
+		wire_ctx_write_u32(&wire, rr_data->ttl);
+		wire_ctx_write_u16(&wire, rr_data->rrs.rr_count);
+		for (uint16_t j = 0; j < rr_data->rrs.rr_count; j++) {
+			const knot_rdata_t *rdata = knot_rdataset_at(&rr_data->rrs, j);
+			wire_ctx_write_u16(&wire, rdata->len);
+			wire_ctx_write(&wire, rdata->data, rdata->len);
+		}
+	}
+	assert(wire.error == KNOT_EOK && wire_ctx_available(&wire) == 0);
+
+	if (fwrite(writer->buf, size, 1, writer->file) != 1) {
+		return KNOT_EFILE;
+	}
+	writer->count++;
+
+	return KNOT_EOK;
+}
+
+static int write_contents(FILE *file, zone_contents_t *contents,
+                          const struct stat *source)
+{
+	const knot_dname_t *origin = contents->apex->owner;
+	size_t origin_size = knot_dname_size(origin);
+
+	uint8_t header[SNAPSHOT_MAGIC_LEN + 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t) +
+	               KNOT_DNAME_MAXLEN];
+	wire_ctx_t wire = wire_ctx_init(header, sizeof(header));
+	wire_ctx_write(&wire, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN);
+	wire_ctx_write_u32(&wire, SNAPSHOT_VERSION);
+	wire_ctx_write_u64(&wire, source->st_mtim.tv_sec);
+	wire_ctx_write_u32(&wire, source->st_mtim.tv_nsec);
+	wire_ctx_write_u64(&wire, source->st_size);
+	wire_ctx_write(&wire, origin, origin_size);
+	if (fwrite(header, wire_ctx_offset(&wire), 1, file) != 1) {
+		return KNOT_EFILE;
+	}
+
+	snapshot_writer_t writer = { .file = file };
+	int ret = zone_contents_apply(contents, write_node, &writer);
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_nsec3_apply(contents, write_node, &writer);
+	}
+	free(writer.buf);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	uint8_t trailer[SNAPSHOT_TRAILER_LEN];
+	wire = wire_ctx_init(trailer, sizeof(trailer));
+	wire_ctx_write_u64(&wire, writer.count);
+	wire_ctx_write(&wire, SNAPSHOT_END_MAGIC, SNAPSHOT_MAGIC_LEN);
+	if (fwrite(trailer, sizeof(trailer), 1, file) != 1) {
+		return KNOT_EFILE;
+	}
+
+	return KNOT_EOK;
+}
+
+int zone_snapshot_write(const char *path, zone_contents_t *contents,
+                        const struct stat *source)
+{
+	if (path == NULL || contents == NULL || source == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	FILE *file = NULL;
+	char *tmp_name = NULL;
+	int ret = open_tmp_file(path, &tmp_name, &file, S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	ret = write_contents(file, contents, source);
+	if (fclose(file) != 0 && ret == KNOT_EOK) {
+		ret = KNOT_EFILE;
+	}
+	if (ret != KNOT_EOK) {
+		unlink(tmp_name);
+		free(tmp_name);
+		return ret;
+	}
+
+	/* Swap temporary snapshot and new snapshot. */
+	if (rename(tmp_name, path) != 0) {
+		ret = knot_map_errno();
+		unlink(tmp_name);
+	}
+	free(tmp_name);
+
+	return ret;
+}
+
+static int read_header(wire_ctx_t *wire, const knot_dname_t *origin,
+                       const struct stat *source)
+{
+	char magic[SNAPSHOT_MAGIC_LEN];
+	wire_ctx_read(wire, magic, sizeof(magic));
+	uint32_t version = wire_ctx_read_u32(wire);
+	if (wire->error != KNOT_EOK || memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0) {
+		return KNOT_EMALF;
+	} else if (version != SNAPSHOT_VERSION) {
+		return KNOT_ENOTSUP;
+	}
+
+	uint64_t mtime = wire_ctx_read_u64(wire);
+	uint32_t mtime_nsec = wire_ctx_read_u32(wire);
+	uint64_t size = wire_ctx_read_u64(wire);
+	if (wire->error != KNOT_EOK) {
+		return KNOT_EMALF;
+	} else if (mtime != (uint64_t)source->st_mtim.tv_sec ||
+	           mtime_nsec != (uint32_t)source->st_mtim.tv_nsec ||
+	           size != (uint64_t)source->st_size) {
+		return KNOT_EEXPIRED;
+	}
+
+	size_t origin_size = knot_dname_size(origin);
+	if (wire_ctx_available(wire) < origin_size ||
+	    memcmp(wire->position, origin, origin_size) != 0) {
+		return KNOT_EEXPIRED;
+	}
+	wire_ctx_skip(wire, origin_size);
+
+	return KNOT_EOK;
+}
+
+typedef struct {
+	knot_rdata_t *buf;
+	size_t buf_size;
+} rdata_buf_t;
+
+static int read_rrset(wire_ctx_t *wire, knot_rrset_t *rrset, rdata_buf_t *buf)
+{
+	rrset->type = wire_ctx_read_u16(wire);
+	rrset->ttl = wire_ctx_read_u32(wire);
+	rrset->rrs.rr_count = wire_ctx_read_u16(wire);
+	if (wire->error != KNOT_EOK || rrset->rrs.rr_count == 0) {
+		return KNOT_EMALF;
+	}
+
+	/* Rebuild the RDATA set in the same canonical order. */
+	size_t offset = 0;
+	for (uint16_t i = 0; i < rrset->rrs.rr_count; i++) {
+		uint16_t len = wire_ctx_read_u16(wire);
+		if (wire->error != KNOT_EOK || wire_ctx_available(wire) < len) {
+			return KNOT_EMALF;
+		}
+
+		size_t size = offset + knot_rdata_size(len);
+		if (size > buf->buf_size) {
+			size_t new_size = MAX(size, 2 * buf->buf_size);
+			knot_rdata_t *new_buf = realloc(buf->buf, new_size);
+			if (new_buf == NULL) {
+				return KNOT_ENOMEM;
+			}
+			buf->buf = new_buf;
+			buf->buf_size = new_size;
+		}
+
+		knot_rdata_init((knot_rdata_t *)((uint8_t *)buf->buf + offset), len,
+		                wire->position);
+		wire_ctx_skip(wire, len);
+		offset = size;
+	}
+	rrset->rrs.data = buf->buf;
+
+	return KNOT_EOK;
+}
+
+static int read_nodes(wire_ctx_t *wire, zone_contents_t *contents)
+{
+	rdata_buf_t buf = { NULL };
+	uint64_t count = 0;
+
+	int ret = KNOT_EOK;
+	while (ret == KNOT_EOK && wire_ctx_available(wire) > SNAPSHOT_TRAILER_LEN) {
+		const uint8_t *end = wire->position + wire_ctx_available(wire);
+		int owner_size = knot_dname_wire_check(wire->position, end, NULL);
+		if (owner_size <= 0) {
+			ret = KNOT_EMALF;
+			break;
+		}
+		knot_dname_t *owner = wire->position;
+		wire_ctx_skip(wire, owner_size);
+
+		uint16_t rrset_count = wire_ctx_read_u16(wire);
+		if (wire->error != KNOT_EOK || rrset_count == 0) {
+			ret = KNOT_EMALF;
+			break;
+		}
+
+		zone_node_t *node = NULL;
+		for (uint16_t i = 0; ret == KNOT_EOK && i < rrset_count; i++) {
+			knot_rrset_t rrset;
+			knot_rrset_init(&rrset, owner, 0, KNOT_CLASS_IN, 0);
+			ret = read_rrset(wire, &rrset, &buf);
+			if (ret == KNOT_EOK) {
+				ret = zone_contents_add_rr(contents, &rrset, &node);
+			}
+		}
+		count++;
+	}
+	free(buf.buf);
+
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	char magic[SNAPSHOT_MAGIC_LEN];
+	uint64_t stored_count = wire_ctx_read_u64(wire);
+	wire_ctx_read(wire, magic, sizeof(magic));
+	if (wire->error != KNOT_EOK || stored_count != count ||
+	    memcmp(magic, SNAPSHOT_END_MAGIC, sizeof(magic)) != 0) {
+		return KNOT_EMALF;
+	}
+
+	return KNOT_EOK;
+}
+
+int zone_snapshot_read(const char *path, const knot_dname_t *origin,
+                       const struct stat *source, zone_contents_t **contents)
+{
+	if (path == NULL || origin == NULL || source == NULL || contents == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return knot_map_errno();
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		int ret = knot_map_errno();
+		close(fd);
+		return ret;
+	} else if (st.st_size == 0) {
+		close(fd);
+		return KNOT_EMALF;
+	}
+
+	uint8_t *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return knot_map_errno();
+	}
+	(void)madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+	wire_ctx_t wire = wire_ctx_init_const(data, st.st_size);
+	int ret = read_header(&wire, origin, source);
+	if (ret != KNOT_EOK) {
+		munmap(data, st.st_size);
+		return ret;
+	}
+
+	zone_contents_t *out = zone_contents_new(origin);
+	if (out == NULL) {
+		munmap(data, st.st_size);
+		return KNOT_ENOMEM;
+	}
+
+	ret = read_nodes(&wire, out);
+	munmap(data, st.st_size);
+	if (ret == KNOT_EOK && !node_rrtype_exists(out->apex, KNOT_RRTYPE_SOA)) {
+		ret = KNOT_EMALF;
+	}
+	if (ret != KNOT_EOK) {
+		zone_contents_deep_free(&out);
+		return ret;
+	}
+
+	*contents = out;
+
+	return KNOT_EOK;
+}
+
+static bool snapshot_enabled(conf_t *conf, const knot_dname_t *zone_name)
+{
+	conf_val_t val = conf_zone_get(conf, C_ZONEFILE_SNAPSHOT, zone_name);
+	return conf_bool(&val);
+}
+
+/*!
+ * \brief Checks if the zone file may include other files.
+ *
+ * Any line starting with the $INCLUDE directive counts, even inside
+ * a multi-line record. An unreadable file is treated as including.
+ */
+static bool zonefile_includes(const char *path)
+{
+	const char directive[] = "$INCLUDE";
+	const size_t directive_len = sizeof(directive) - 1;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return true;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return true;
+	} else if (st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	char *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return true;
+	}
+
+	bool found = false;
+	const char *end = data + st.st_size;
+	for (const char *pos = data; pos != NULL && pos < end; ) {
+		if (end - pos > directive_len &&
+		    strncasecmp(pos, directive, directive_len) == 0) {
+			found = true;
+			break;
+		}
+		pos = memchr(pos, '\n', end - pos);
+		if (pos != NULL) {
+			pos++;
+		}
+	}
+	munmap(data, st.st_size);
+
+	return found;
+}
+
+int zone_snapshot_load(conf_t *conf, const knot_dname_t *zone_name,
+                       zone_contents_t **contents)
+{
+	if (conf == NULL || zone_name == NULL || contents == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	if (!snapshot_enabled(conf, zone_name)) {
+		return KNOT_ENOENT;
+	}
+
+	char *zonefile = conf_zonefile(conf, zone_name);
+	char *path = sprintf_alloc("%s%s", zonefile, ZONE_SNAPSHOT_SUFFIX);
+	struct stat st;
+	int ret = (stat(zonefile, &st) == 0) ? KNOT_EOK : knot_map_errno();
+	free(zonefile);
+	if (path == NULL) {
+		return KNOT_ENOMEM;
+	} else if (ret != KNOT_EOK) {
+		free(path);
+		return ret;
+	}
+
+	zone_contents_t *out = NULL;
+	ret = zone_snapshot_read(path, zone_name, &st, &out);
+	free(path);
+	switch (ret) {
+	case KNOT_EOK:
+		break;
+	case KNOT_ENOENT:
+	case KNOT_EEXPIRED:
+		return KNOT_ENOENT;
+	default:
+		log_zone_warning(zone_name, "failed to load zone file snapshot (%s)",
+		                 knot_strerror(ret));
+		return KNOT_ENOENT;
+	}
+
+	ret = zone_contents_adjust_full(out);
+	if (ret != KNOT_EOK) {
+		zone_contents_deep_free(&out);
+		return ret;
+	}
+
+	/* Run the same semantic checks as the zone file loader. */
+	sem_handler_t handler = {
+		.cb = err_handler_logger
+	};
+	conf_val_t val = conf_zone_get(conf, C_SEM_CHECKS, zone_name);
+	bool optional = conf_bool(&val);
+	val = conf_zone_get(conf, C_LOAD_THREADS, zone_name);
+	ret = sem_checks_process(out, optional, &handler, time(NULL), conf_int(&val));
+	if (ret != KNOT_EOK) {
+		zone_contents_deep_free(&out);
+		return ret;
+	}
+
+	*contents = out;
+
+	return KNOT_EOK;
+}
+
+int zone_snapshot_store(conf_t *conf, const knot_dname_t *zone_name,
+                        zone_contents_t *contents, const struct stat *source)
+{
+	if (conf == NULL || zone_name == NULL || contents == NULL || source == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	if (!snapshot_enabled(conf, zone_name)) {
+		return KNOT_EOK;
+	}
+
+	char *zonefile = conf_zonefile(conf, zone_name);
+	char *path = sprintf_alloc("%s%s", zonefile, ZONE_SNAPSHOT_SUFFIX);
+	bool includes = zonefile_includes(zonefile);
+	free(zonefile);
+	if (path == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	// The changes of the included files wouldn't expire the snapshot.
+	if (includes) {
+		log_zone_debug(zone_name, "zone file snapshot not stored, "
+		               "zone file includes other files");
+		free(path);
+		return KNOT_EOK;
+	}
+
+	int ret = zone_snapshot_write(path, contents, source);
+	free(path);
+
+	if (ret != KNOT_EOK) {
+		log_zone_warning(zone_name, "failed to write zone file snapshot (%s)",
+		                 knot_strerror(ret));
+	}
+
+	return ret;
+}
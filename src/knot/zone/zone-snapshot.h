@@ -0,0 +1,108 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \file
+ *
+ * Binary zone file snapshot.
+ *
+ * The snapshot is a compact binary image of the zone contents stored next to
+ * the zone file. It is bound to the zone file by its modification time
+ * (including nanoseconds) and size, so it is only used if the zone file hasn't
+ * changed since the snapshot was written. Loading the snapshot avoids the zone
+ * file parsing. Zone files including other files aren't snapshotted.
+ *
+ * \addtogroup zone
+ *
+ * @{
+ */
+
+#pragma once
+
+#include <sys/stat.h>
+
+#include "knot/conf/conf.h"
+#include "knot/zone/contents.h"
+
+/*! \brief Snapshot file name suffix appended to the zone file name. */
+#define ZONE_SNAPSHOT_SUFFIX ".snap"
+
+/*!
+ * \brief Writes zone contents snapshot.
+ *
+ * \param path      Snapshot file name.
+ * \param contents  Zone contents.
+ * \param source    Zone file the contents correspond to.
+ *
+ * \return KNOT_E*
+ */
+int zone_snapshot_write(const char *path, zone_contents_t *contents,
+                        const struct stat *source);
+
+/*!
+ * \brief Reads zone contents snapshot.
+ *
+ * The contents are not adjusted.
+ *
+ * \param path      Snapshot file name.
+ * \param origin    Zone name.
+ * \param source    Zone file the snapshot must correspond to.
+ * \param contents  Output zone contents.
+ *
+ * \retval KNOT_ENOENT if the snapshot doesn't exist.
+ * \retval KNOT_EEXPIRED if the snapshot doesn't correspond to the zone file.
+ * \retval KNOT_ENOTSUP if the snapshot version isn't supported.
+ * \retval KNOT_EMALF if the snapshot is malformed.
+ * \return KNOT_E*
+ */
+int zone_snapshot_read(const char *path, const knot_dname_t *origin,
+                       const struct stat *source, zone_contents_t **contents);
+
+/*!
+ * \brief Loads zone contents from the snapshot of the zone file if configured.
+ *
+ * The contents are adjusted and semantically checked the same way as if
+ * loaded from the zone file.
+ *
+ * \param conf       Configuration.
+ * \param zone_name  Zone name.
+ * \param contents   Output zone contents.
+ *
+ * \retval KNOT_ENOENT if the snapshot isn't configured, doesn't exist, or is
+ *                     outdated.
+ * \return KNOT_E*
+ */
+int zone_snapshot_load(conf_t *conf, const knot_dname_t *zone_name,
+                       zone_contents_t **contents);
+
+/*!
+ * \brief Stores the snapshot of the zone file contents if configured.
+ *
+ * Nothing is stored if the zone file contains the $INCLUDE directive.
+ *
+ * The zone file must be stat()ed before it was parsed into \a contents so
+ * that changes made to the file during the parsing invalidate the snapshot.
+ *
+ * \param conf       Configuration.
+ * \param zone_name  Zone name.
+ * \param contents   Zone contents equal to the zone file contents.
+ * \param source     Zone file status before the contents were parsed.
+ *
+ * \return KNOT_E*
+ */
+int zone_snapshot_store(conf_t *conf, const knot_dname_t *zone_name,
+                        zone_contents_t *contents, const struct stat *source);
+
+/*! @} */
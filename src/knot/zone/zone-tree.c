@@ -16,15 +16,187 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "knot/zone/zone-tree.h"
 #include "libknot/consts.h"
 #include "libknot/errcode.h"
 #include "contrib/macros.h"
 
+/*! \brief Returns the node half used by the tree. */
+static zone_node_t *tree_node(const zone_tree_t *tree, const trie_val_t *val)
+{
+	return binode_node(*val, tree->flags & ZONE_TREE_BINO_SECOND);
+}
+
 zone_tree_t *zone_tree_create(void)
 {
-	return trie_create(NULL);
+	zone_tree_t *tree = calloc(1, sizeof(*tree));
+	if (tree == NULL) {
+		return NULL;
+	}
+
+	tree->trie = trie_create(NULL);
+	if (tree->trie == NULL) {
+		free(tree);
+		return NULL;
+	}
+
+	return tree;
+}
+
+/*! \brief Copies the tree half of the binode into the other one. */
+static int sync_node(trie_val_t *val, void *data)
+{
+	binode_unify(tree_node(data, val), NULL);
+	return KNOT_EOK;
+}
+
+zone_tree_t *zone_tree_cow(zone_tree_t *from)
+{
+	if (from == NULL) {
+		return NULL;
+	}
+
+	// Only the copies keep the other halves synchronized.
+	if (!(from->flags & ZONE_TREE_COW)) {
+		(void)trie_apply(from->trie, sync_node, from);
+	}
+
+	zone_tree_t *tree = calloc(1, sizeof(*tree));
+	if (tree == NULL) {
+		return NULL;
+	}
+
+	tree->trie = trie_cow(from->trie);
+	if (tree->trie == NULL) {
+		free(tree);
+		return NULL;
+	}
+	tree->flags = (from->flags ^ ZONE_TREE_BINO_SECOND) | ZONE_TREE_COW;
+
+	return tree;
+}
+
+int zone_tree_touch(zone_tree_t *tree, const zone_node_t *node)
+{
+	if (tree == NULL || node == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	if (!(tree->flags & ZONE_TREE_COW)) {
+		return KNOT_EOK;
+	}
+
+	uint8_t lf[KNOT_DNAME_MAXLEN];
+	knot_dname_lf(lf, node->owner, NULL);
+
+	trie_val_t *val = trie_get_cow(tree->trie, (char *)lf + 1, *lf);
+	if (val == NULL) {
+		return trie_get_try(tree->trie, (char *)lf + 1, *lf) == NULL ?
+		       KNOT_ENOENT : KNOT_ENOMEM;
+	}
+
+	return KNOT_EOK;
+}
+
+static int touch_node(trie_val_t *val, void *data)
+{
+	UNUSED(val);
+	UNUSED(data);
+	return KNOT_EOK;
+}
+
+int zone_tree_touch_all(zone_tree_t *tree)
+{
+	if (tree == NULL || !(tree->flags & ZONE_TREE_COW)) {
+		return KNOT_EOK;
+	}
+
+	return trie_apply_cow(tree->trie, touch_node, NULL);
+}
+
+typedef struct {
+	const zone_tree_t *tree;
+	const zone_arena_t *arena;
+} cow_finish_ctx_t;
+
+/*! \brief Copies the node changed in the new version into the old half. */
+static int commit_node(trie_val_t *val, void *data)
+{
+	cow_finish_ctx_t *ctx = data;
+	binode_unify(tree_node(ctx->tree, val), ctx->arena);
+	return KNOT_EOK;
+}
+
+/*! \brief Frees the node deleted from the new version. */
+static int commit_deleted_node(trie_val_t *val, void *data)
+{
+	cow_finish_ctx_t *ctx = data;
+	zone_node_t *node = binode_counterpart(tree_node(ctx->tree, val));
+	if (node->flags & NODE_FLAGS_DELETED) {
+		binode_free(node, ctx->arena);
+	}
+	return KNOT_EOK;
+}
+
+void zone_tree_cow_commit(zone_tree_t **from, zone_tree_t *to,
+                          const zone_arena_t *arena)
+{
+	if (to == NULL) {
+		return;
+	}
+
+	// The nodes changed in the new version are on the paths it copied.
+	cow_finish_ctx_t ctx = { to, arena };
+	(void)trie_apply_unshared(to->trie, commit_node, &ctx);
+
+	// And the deleted ones are on the same paths in the old version.
+	if (from != NULL && *from != NULL) {
+		ctx.tree = *from;
+		(void)trie_apply_unshared((*from)->trie, commit_deleted_node, &ctx);
+		zone_tree_free(from);
+	}
+}
+
+/*! \brief Reverts the node changed in the new version, frees a created one. */
+static int rollback_node(trie_val_t *val, void *data)
+{
+	cow_finish_ctx_t *ctx = data;
+	zone_node_t *node = tree_node(ctx->tree, val);
+	zone_node_t *old = binode_counterpart(node);
+	if (old->flags & NODE_FLAGS_NEW) {
+		binode_free(node, ctx->arena);
+	} else {
+		binode_unify(old, ctx->arena);
+	}
+	return KNOT_EOK;
+}
+
+/*! \brief Reverts the node possibly deleted from the new version. */
+static int rollback_old_node(trie_val_t *val, void *data)
+{
+	cow_finish_ctx_t *ctx = data;
+	binode_unify(tree_node(ctx->tree, val), ctx->arena);
+	return KNOT_EOK;
+}
+
+void zone_tree_cow_rollback(zone_tree_t *from, zone_tree_t **to,
+                            const zone_arena_t *arena)
+{
+	if (to == NULL || *to == NULL) {
+		return;
+	}
+
+	cow_finish_ctx_t ctx = { *to, arena };
+	(void)trie_apply_unshared((*to)->trie, rollback_node, &ctx);
+
+	if (from != NULL) {
+		ctx.tree = from;
+		(void)trie_apply_unshared(from->trie, rollback_old_node, &ctx);
+	}
+
+	zone_tree_free(to);
 }
 
 size_t zone_tree_count(const zone_tree_t *tree)
@@ -33,7 +205,7 @@ size_t zone_tree_count(const zone_tree_t *tree)
 		return 0;
 	}
 
-	return trie_weight(tree);
+	return trie_weight(tree->trie);
 }
 
 bool zone_tree_is_empty(const zone_tree_t *tree)
@@ -41,17 +213,27 @@ bool zone_tree_is_empty(const zone_tree_t *tree)
 	return zone_tree_count(tree) == 0;
 }
 
-int zone_tree_insert(zone_tree_t *tree, zone_node_t *node)
+int zone_tree_insert(zone_tree_t *tree, zone_node_t **node)
 {
-	if (tree == NULL || node == NULL) {
+	if (tree == NULL || node == NULL || *node == NULL) {
 		return KNOT_EINVAL;
 	}
 
-	assert(node->owner);
+	assert((*node)->owner);
 	uint8_t lf[KNOT_DNAME_MAXLEN];
-	knot_dname_lf(lf, node->owner, NULL);
+	knot_dname_lf(lf, (*node)->owner, NULL);
 
-	*trie_get_ins(tree, (char *)lf + 1, *lf) = node;
+	trie_val_t *val = trie_get_ins(tree->trie, (char *)lf + 1, *lf);
+	if (val == NULL) {
+		return KNOT_ENOMEM;
+	}
+	*val = binode_first(*node);
+	*node = tree_node(tree, val);
+
+	// The other half isn't used by the original tree.
+	if (tree->flags & ZONE_TREE_COW) {
+		binode_counterpart(*node)->flags |= NODE_FLAGS_NEW;
+	}
 
 	return KNOT_EOK;
 }
@@ -69,12 +251,12 @@ zone_node_t *zone_tree_get(zone_tree_t *tree, const knot_dname_t *owner)
 	uint8_t lf[KNOT_DNAME_MAXLEN];
 	knot_dname_lf(lf, owner, NULL);
 
-	trie_val_t *val = trie_get_try(tree, (char *)lf + 1, *lf);
+	trie_val_t *val = trie_get_try(tree->trie, (char *)lf + 1, *lf);
 	if (val == NULL) {
 		return NULL;
 	}
 
-	return *val;
+	return tree_node(tree, val);
 }
 
 int zone_tree_get_less_or_equal(zone_tree_t *tree,
@@ -94,15 +276,15 @@ int zone_tree_get_less_or_equal(zone_tree_t *tree,
 	knot_dname_lf(lf, owner, NULL);
 
 	trie_val_t *fval = NULL;
-	int ret = trie_get_leq(tree, (char *)lf + 1, *lf, &fval);
+	int ret = trie_get_leq(tree->trie, (char *)lf + 1, *lf, &fval);
 	if (fval != NULL) {
-		*found = (zone_node_t *)(*fval);
+		*found = tree_node(tree, fval);
 	}
 
 	int exact_match = 0;
 	if (ret == KNOT_EOK) {
 		if (fval != NULL) {
-			*previous = (*found)->prev;
+			*previous = node_prev(*found);
 		}
 		exact_match = 1;
 	} else if (ret == 1) {
@@ -114,9 +296,9 @@ int zone_tree_get_less_or_equal(zone_tree_t *tree,
 		 * cases like NSEC3, there is no such sort of thing (name wise).
 		 */
 		/*! \todo We could store rightmost node in zonetree probably. */
-		trie_it_t *i = trie_it_begin(tree);
-		*previous = *(zone_node_t **)trie_it_val(i); /* leftmost */
-		*previous = (*previous)->prev; /* rightmost */
+		trie_it_t *i = trie_it_begin(tree->trie);
+		*previous = tree_node(tree, trie_it_val(i)); /* leftmost */
+		*previous = node_prev(*previous); /* rightmost */
 		*found = NULL;
 		trie_it_free(i);
 	}
@@ -136,9 +318,9 @@ static void remove_node(zone_tree_t *tree, const knot_dname_t *owner)
 	uint8_t lf[KNOT_DNAME_MAXLEN];
 	knot_dname_lf(lf, owner, NULL);
 
-	trie_val_t *rval = trie_get_try(tree, (char *)lf + 1, *lf);
+	trie_val_t *rval = trie_get_try(tree->trie, (char *)lf + 1, *lf);
 	if (rval != NULL) {
-		trie_del(tree, (char *)lf + 1, *lf, NULL);
+		trie_del(tree->trie, (char *)lf + 1, *lf, NULL);
 	}
 }
 
@@ -158,7 +340,12 @@ void zone_tree_delete_empty(zone_tree_t *tree, zone_node_t *node)
 	}
 
 	if (node->rrset_count == 0 && node->children == 0) {
-		zone_node_t *parent_node = node->parent;
+		// The apex, also the parent of NSEC3 nodes, is always writable.
+		zone_node_t *parent_node = node_parent(node);
+		if (parent_node != NULL && parent_node->parent != NULL &&
+		    zone_tree_touch(tree, parent_node) != KNOT_EOK) {
+			return;
+		}
 		if (parent_node != NULL) {
 			parent_node->children--;
 			fix_wildcard_child(parent_node, node->owner);
@@ -170,10 +357,33 @@ void zone_tree_delete_empty(zone_tree_t *tree, zone_node_t *node)
 
 		// Delete node
 		remove_node(tree, node->owner);
-		node_free(&node, NULL);
+		if ((tree->flags & ZONE_TREE_COW) &&
+		    !(binode_counterpart(node)->flags & NODE_FLAGS_NEW)) {
+			// Still used by the original tree.
+			node->flags |= NODE_FLAGS_DELETED;
+		} else {
+			node_free(&node, NULL);
+		}
 	}
 }
 
+typedef struct {
+	const zone_tree_t *tree;
+	zone_tree_apply_cb_t func;
+	void *data;
+} tree_apply_ctx_t;
+
+/*! \brief Passes the node half used by the tree, stores a replaced node back. */
+static int tree_apply_cb(trie_val_t *val, void *data)
+{
+	tree_apply_ctx_t *ctx = data;
+	zone_node_t *node = tree_node(ctx->tree, val);
+	int ret = ctx->func(&node, ctx->data);
+	*val = binode_first(node);
+
+	return ret;
+}
+
 int zone_tree_apply(zone_tree_t *tree, zone_tree_apply_cb_t function, void *data)
 {
 	if (function == NULL) {
@@ -184,7 +394,147 @@ int zone_tree_apply(zone_tree_t *tree, zone_tree_apply_cb_t function, void *data
 		return KNOT_EOK;
 	}
 
-	return trie_apply(tree, (int (*)(trie_val_t *, void *))function, data);
+	tree_apply_ctx_t ctx = { tree, function, data };
+	if (tree->flags & ZONE_TREE_COW) {
+		return trie_apply_cow(tree->trie, tree_apply_cb, &ctx);
+	}
+
+	return trie_apply(tree->trie, tree_apply_cb, &ctx);
+}
+
+int zone_tree_walk(zone_tree_t *tree, zone_tree_apply_cb_t function, void *data)
+{
+	if (function == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	zone_tree_it_t it = { 0 };
+	int ret = zone_tree_it_begin(tree, &it);
+	if (ret == KNOT_EOK) {
+		ret = zone_tree_it_apply(&it, SIZE_MAX, function, data);
+	}
+	zone_tree_it_free(&it);
+
+	return ret;
+}
+
+int zone_tree_split(zone_tree_t *tree, size_t count, zone_tree_it_t *its)
+{
+	size_t total = zone_tree_count(tree);
+	if (its == NULL || count == 0 || count > total) {
+		return KNOT_EINVAL;
+	}
+
+	trie_it_t *it = trie_it_begin(tree->trie);
+	if (it == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	size_t pos = 0;
+	for (size_t i = 0; i < count; i++) {
+		for (size_t begin = total * i / count; pos < begin; pos++) {
+			trie_it_next(it);
+		}
+		its[i].tree = tree;
+		its[i].it = (i + 1 < count) ? trie_it_clone(it) : it;
+		if (its[i].it == NULL) {
+			for (size_t j = 0; j < i; j++) {
+				zone_tree_it_free(&its[j]);
+			}
+			trie_it_free(it);
+			return KNOT_ENOMEM;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+int zone_tree_it_apply(zone_tree_it_t *it, size_t limit,
+                       zone_tree_apply_cb_t function, void *data)
+{
+	if (it == NULL || function == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	for (; limit > 0 && !zone_tree_it_finished(it); limit--) {
+		zone_node_t *node = zone_tree_it_val(it);
+		int ret = function(&node, data);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+		zone_tree_it_next(it);
+	}
+
+	return KNOT_EOK;
+}
+
+int zone_tree_it_begin(zone_tree_t *tree, zone_tree_it_t *it)
+{
+	if (it == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	it->tree = tree;
+	it->it = NULL;
+	if (tree == NULL) {
+		return KNOT_EOK;
+	}
+
+	it->it = trie_it_begin(tree->trie);
+	return it->it == NULL ? KNOT_ENOMEM : KNOT_EOK;
+}
+
+int zone_tree_it_begin_before(zone_tree_t *tree, const uint8_t *lf,
+                              zone_tree_it_t *it)
+{
+	if (lf == NULL || *lf == 0 || it == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	it->tree = tree;
+	it->it = NULL;
+	if (zone_tree_is_empty(tree)) {
+		return KNOT_ENONODE;
+	}
+
+	// The names end with a label separator, none is between the name
+	// without the separator and the name itself.
+	it->it = trie_it_begin_leq(tree->trie, (char *)lf + 1, *lf - 1);
+	if (it->it != NULL && trie_it_finished(it->it)) {
+		// No name in the lookup format consists of the highest bytes only.
+		char last[KNOT_DNAME_MAXLEN];
+		memset(last, 0xff, sizeof(last));
+		trie_it_free(it->it);
+		it->it = trie_it_begin_leq(tree->trie, last, sizeof(last));
+	}
+
+	return it->it == NULL ? KNOT_ENOMEM : KNOT_EOK;
+}
+
+bool zone_tree_it_finished(zone_tree_it_t *it)
+{
+	return it->it == NULL || trie_it_finished(it->it);
+}
+
+zone_node_t *zone_tree_it_val(zone_tree_it_t *it)
+{
+	return tree_node(it->tree, trie_it_val(it->it));
+}
+
+void zone_tree_it_next(zone_tree_it_t *it)
+{
+	trie_it_next(it->it);
+}
+
+void zone_tree_it_free(zone_tree_it_t *it)
+{
+	if (it == NULL) {
+		return;
+	}
+
+	trie_it_free(it->it);
+	it->tree = NULL;
+	it->it = NULL;
 }
 
 void zone_tree_free(zone_tree_t **tree)
@@ -193,7 +543,8 @@ void zone_tree_free(zone_tree_t **tree)
 		return;
 	}
 
-	trie_free(*tree);
+	trie_free((*tree)->trie);
+	free(*tree);
 	*tree = NULL;
 }
 
@@ -214,6 +565,6 @@ void zone_tree_deep_free(zone_tree_t **tree)
 		return;
 	}
 
-	(void)zone_tree_apply(*tree, zone_tree_free_node, NULL);
+	(void)zone_tree_walk(*tree, zone_tree_free_node, NULL);
 	zone_tree_free(tree);
 }
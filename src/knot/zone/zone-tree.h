@@ -19,7 +19,30 @@
 #include "contrib/qp-trie/trie.h"
 #include "knot/zone/node.h"
 
-typedef trie_t zone_tree_t;
+/*! \brief Zone tree flags. */
+enum zone_tree_flags {
+	/*! \brief The tree uses the second halves of the binodes. */
+	ZONE_TREE_BINO_SECOND = 1 << 0,
+	/*! \brief The tree shares the binodes with the previous zone version. */
+	ZONE_TREE_COW         = 1 << 1,
+};
+
+/*!
+ * \brief Zone tree, the nodes are stored by their first halves.
+ *
+ * The nodes returned by the zone tree functions are always the halves used
+ * by the tree.
+ */
+typedef struct {
+	trie_t *trie;
+	uint16_t flags; /*!< \ref zone_tree_flags enum. */
+} zone_tree_t;
+
+/*! \brief Zone tree iterator. */
+typedef struct {
+	zone_tree_t *tree;
+	trie_it_t *it;
+} zone_tree_it_t;
 
 /*!
  * \brief Signature of callback for zone apply functions.
@@ -33,6 +56,73 @@ typedef int (*zone_tree_apply_cb_t)(zone_node_t **node, void *data);
  */
 zone_tree_t *zone_tree_create(void);
 
+/*!
+ * \brief Creates a new version of the zone tree sharing all the nodes.
+ *
+ * The copy uses the other halves of the binodes, so that they can be changed
+ * without affecting the readers of the original tree. If the original tree
+ * isn't a copy itself, the other halves are synchronized with it first.
+ *
+ * A node of the copy must be touched by \ref zone_tree_touch before it's
+ * changed, the nodes created by \ref zone_tree_insert are writable.
+ * The copy is finished by \ref zone_tree_cow_commit or abandoned by
+ * \ref zone_tree_cow_rollback.
+ *
+ * \param from  Zone tree to be copied.
+ *
+ * \return New zone tree or NULL.
+ */
+zone_tree_t *zone_tree_cow(zone_tree_t *from);
+
+/*!
+ * \brief Marks the node to be changed in a zone tree copy.
+ *
+ * Does nothing for a tree which isn't a copy.
+ *
+ * \param tree  Zone tree.
+ * \param node  Node of the tree.
+ *
+ * \retval KNOT_EOK
+ * \retval KNOT_ENOENT if the node isn't in the tree.
+ */
+int zone_tree_touch(zone_tree_t *tree, const zone_node_t *node);
+
+/*!
+ * \brief Marks all the nodes to be changed in a zone tree copy.
+ *
+ * \param tree  Zone tree.
+ *
+ * \return KNOT_E*
+ */
+int zone_tree_touch_all(zone_tree_t *tree);
+
+/*!
+ * \brief Finishes a zone tree copy after the original tree was abandoned.
+ *
+ * The nodes touched in the copy are copied into their other halves and
+ * the nodes deleted from the copy are freed, together with the data which
+ * aren't used anymore, except for RDATA. The original tree is freed.
+ *
+ * \param from   Original zone tree.
+ * \param to     Zone tree copy.
+ * \param arena  Zone arena (can be NULL).
+ */
+void zone_tree_cow_commit(zone_tree_t **from, zone_tree_t *to,
+                          const zone_arena_t *arena);
+
+/*!
+ * \brief Abandons a zone tree copy, reverting the touched nodes.
+ *
+ * The nodes created in the copy are freed, together with the data which
+ * aren't used by the original tree, except for RDATA. The copy is freed.
+ *
+ * \param from   Original zone tree (can be NULL).
+ * \param to     Zone tree copy.
+ * \param arena  Zone arena (can be NULL).
+ */
+void zone_tree_cow_rollback(zone_tree_t *from, zone_tree_t **to,
+                            const zone_arena_t *arena);
+
 /*!
  * \brief Return number of nodes in the zone tree.
  *
@@ -55,13 +145,13 @@ bool zone_tree_is_empty(const zone_tree_t *tree);
  * \brief Inserts the given node into the zone tree.
  *
  * \param tree Zone tree to insert the node into.
- * \param node Node to insert.
+ * \param node Node to insert, set to the half used by the tree.
  *
  * \retval KNOT_EOK
  * \retval KNOT_EINVAL
  * \retval KNOT_ENOMEM
  */
-int zone_tree_insert(zone_tree_t *tree, zone_node_t *node);
+int zone_tree_insert(zone_tree_t *tree, zone_node_t **node);
 
 /*!
  * \brief Finds node with the given owner in the zone tree.
@@ -100,6 +190,9 @@ int zone_tree_get_less_or_equal(zone_tree_t *tree,
 /*!
  * \brief Delete a node that has no RRSets and no children.
  *
+ * In a zone tree copy, a node shared with the original tree is freed
+ * by \ref zone_tree_cow_commit.
+ *
  * \param tree  The tree to remove from.
  * \param node  The node to remove.
  */
@@ -108,6 +201,9 @@ void zone_tree_delete_empty(zone_tree_t *tree, zone_node_t *node);
 /*!
  * \brief Applies the given function to each node in the zone in order.
  *
+ * All the nodes of a zone tree copy are touched, so that the function can
+ * change them. Use the iterator for read-only walks.
+ *
  * \param tree Zone tree to apply the function to.
  * \param function Function to be applied to each node of the zone.
  * \param data Arbitrary data to be passed to the function.
@@ -117,6 +213,103 @@ void zone_tree_delete_empty(zone_tree_t *tree, zone_node_t *node);
  */
 int zone_tree_apply(zone_tree_t *tree, zone_tree_apply_cb_t function, void *data);
 
+/*!
+ * \brief Applies the given function to each node in the zone in order
+ *        without touching the nodes.
+ *
+ * The function must not change the nodes of a zone tree copy.
+ *
+ * \param tree Zone tree to apply the function to (can be NULL).
+ * \param function Function to be applied to each node of the zone.
+ * \param data Arbitrary data to be passed to the function.
+ *
+ * \retval KNOT_EOK
+ * \retval KNOT_EINVAL
+ * \retval KNOT_ENOMEM
+ */
+int zone_tree_walk(zone_tree_t *tree, zone_tree_apply_cb_t function, void *data);
+
+/*!
+ * \brief Splits the zone tree into ranges of the same size.
+ *
+ * The range \a i starts at the node on position
+ * zone_tree_count(tree) * i / count and ends where the next one starts.
+ * The start of each range is found in a single pass over the tree, so that
+ * the ranges can be processed without walking the nodes before them.
+ *
+ * \param tree   Zone tree to be split.
+ * \param count  Number of ranges, at most the number of nodes.
+ * \param its    Output iterators positioned at the start of each range.
+ *
+ * \retval KNOT_EOK
+ * \retval KNOT_EINVAL
+ * \retval KNOT_ENOMEM
+ */
+int zone_tree_split(zone_tree_t *tree, size_t count, zone_tree_it_t *its);
+
+/*!
+ * \brief Applies the given function to the nodes from the iterator position.
+ *
+ * \param it        Iterator positioned at the first node to be processed.
+ * \param limit     Maximum number of nodes to be processed.
+ * \param function  Function to be applied to each node.
+ * \param data      Arbitrary data to be passed to the function.
+ *
+ * \retval KNOT_EOK
+ * \retval KNOT_EINVAL
+ */
+int zone_tree_it_apply(zone_tree_it_t *it, size_t limit,
+                       zone_tree_apply_cb_t function, void *data);
+
+/*!
+ * \brief Starts the zone tree iteration at the first node.
+ *
+ * \param tree  Zone tree to iterate over (can be NULL).
+ * \param it    Output iterator.
+ *
+ * \retval KNOT_EOK
+ * \retval KNOT_ENOMEM
+ */
+int zone_tree_it_begin(zone_tree_t *tree, zone_tree_it_t *it);
+
+/*!
+ * \brief Starts the zone tree iteration at the node preceding the name.
+ *
+ * The nodes are taken in the cyclic canonical order, the iteration starts
+ * at the last node if the name precedes all of them.
+ *
+ * \param tree  Zone tree to iterate over.
+ * \param lf    Name in the lookup format (see knot_dname_lf()).
+ * \param it    Output iterator.
+ *
+ * \retval KNOT_EOK
+ * \retval KNOT_EINVAL
+ * \retval KNOT_ENONODE if the tree is empty.
+ * \retval KNOT_ENOMEM
+ */
+int zone_tree_it_begin_before(zone_tree_t *tree, const uint8_t *lf,
+                              zone_tree_it_t *it);
+
+/*!
+ * \brief Checks if the iteration has gone past the last node.
+ */
+bool zone_tree_it_finished(zone_tree_it_t *it);
+
+/*!
+ * \brief Returns the current node of the iteration.
+ */
+zone_node_t *zone_tree_it_val(zone_tree_it_t *it);
+
+/*!
+ * \brief Moves the iteration to the next node.
+ */
+void zone_tree_it_next(zone_tree_it_t *it);
+
+/*!
+ * \brief Frees the iterator resources.
+ */
+void zone_tree_it_free(zone_tree_it_t *it);
+
 /*!
  * \brief Destroys the zone tree, not touching the saved data.
  *
@@ -21,6 +21,7 @@
 
 #include "knot/common/log.h"
 #include "knot/conf/module.h"
+#include "knot/conf/snapshot.h"
 #include "knot/dnssec/kasp/kasp_db.h"
 #include "knot/nameserver/process_query.h"
 #include "knot/query/requestor.h"
@@ -28,6 +29,7 @@
 #include "knot/zone/contents.h"
 #include "knot/zone/serial.h"
 #include "knot/zone/zone.h"
+#include "knot/zone/zone-snapshot.h"
 #include "knot/zone/zonefile.h"
 #include "libknot/libknot.h"
 #include "contrib/sockaddr.h"
@@ -142,6 +144,9 @@ static int flush_journal(conf_t *conf, zone_t *zone, bool allow_empty_zone)
 
 	free(zonefile);
 
+	/* Refresh zone file snapshot. */
+	(void)zone_snapshot_store(conf, zone->name, contents, &st);
+
 	/* Update zone file serial and journal. */
 	zone->zonefile.exists = true;
 	zone->zonefile.mtime = st.st_mtime;
@@ -370,7 +375,7 @@ int zone_journal_serial(conf_t *conf, zone_t *zone, bool *is_empty, uint32_t *se
 	int ret = open_journal(zone);
 	if (ret == KNOT_EOK) {
 		kserial_t ks;
-		journal_metadata_info(zone->journal, is_empty, NULL, NULL, NULL, &ks, NULL);
+		journal_metadata_info(zone->journal, is_empty, NULL, NULL, NULL, &ks, NULL, NULL);
 		*serial_to = (ks.valid ? ks.serial : 0);
 	}
 
@@ -383,6 +388,13 @@ zone_contents_t *zone_switch_contents(zone_t *zone, zone_contents_t *new_content
 		return NULL;
 	}
 
+	/* Identify the published version, the pointer may be reused later. */
+	static uint64_t last_version = 0;
+	if (new_contents != NULL) {
+		new_contents->version = __atomic_add_fetch(&last_version, 1,
+		                                           __ATOMIC_RELAXED);
+	}
+
 	zone_contents_t *old_contents;
 	zone_contents_t **current_contents = &zone->contents;
 	old_contents = rcu_xchg_pointer(current_contents, new_contents);
@@ -396,6 +408,11 @@ bool zone_is_slave(conf_t *conf, const zone_t *zone)
 		return false;
 	}
 
+	const conf_snap_zone_t *snap = conf_snapshot_zone(conf, zone->name);
+	if (snap != NULL) {
+		return snap->master_count > 0;
+	}
+
 	conf_val_t val = conf_zone_get(conf, C_MASTER, zone->name);
 	return conf_val_count(&val) > 0 ? true : false;
 }
@@ -560,26 +577,38 @@ int zone_update_enqueue(zone_t *zone, knot_pkt_t *pkt, knotd_qdata_params_t *par
 		return ret;
 	}
 
+	conf_val_t val = conf_zone_get(conf(), C_DDNS_BATCH_DELAY, zone->name);
+	time_t batch_delay = conf_int(&val);
+	val = conf_zone_get(conf(), C_DDNS_BATCH_SIZE, zone->name);
+	size_t batch_size = conf_int(&val);
+
 	pthread_mutex_lock(&zone->ddns_lock);
 
 	/* Enqueue created request. */
 	ptrlist_add(&zone->ddns_queue, req, NULL);
-	++zone->ddns_queue_size;
+	size_t queue_size = ++zone->ddns_queue_size;
 
 	pthread_mutex_unlock(&zone->ddns_lock);
 
-	/* Schedule UPDATE event. */
-	zone_events_schedule_now(zone, ZONE_EVENT_UPDATE);
+	/* Schedule UPDATE event, wait for more requests if batching. */
+	time_t now = time(NULL);
+	if (batch_delay > 0 && (batch_size == 0 || queue_size < batch_size)) {
+		zone_events_schedule_at(zone, ZONE_EVENT_UPDATE, now + batch_delay);
+	} else {
+		zone_events_schedule_at(zone, ZONE_EVENT_UPDATE, now);
+	}
 
 	return KNOT_EOK;
 }
 
-size_t zone_update_dequeue(zone_t *zone, list_t *updates)
+size_t zone_update_dequeue(zone_t *zone, list_t *updates, size_t max_count)
 {
 	if (zone == NULL || updates == NULL) {
 		return 0;
 	}
 
+	init_list(updates);
+
 	pthread_mutex_lock(&zone->ddns_lock);
 	if (EMPTY_LIST(zone->ddns_queue)) {
 		/* Lost race during reload. */
@@ -587,13 +616,32 @@ size_t zone_update_dequeue(zone_t *zone, list_t *updates)
 		return 0;
 	}
 
-	*updates = zone->ddns_queue;
-	size_t update_count = zone->ddns_queue_size;
-	init_list(&zone->ddns_queue);
-	zone->ddns_queue_size = 0;
+	size_t update_count = 0;
+	if (max_count == 0 || zone->ddns_queue_size <= max_count) {
+		add_tail_list(updates, &zone->ddns_queue);
+		init_list(&zone->ddns_queue);
+		update_count = zone->ddns_queue_size;
+	} else {
+		node_t *node = NULL, *nxt = NULL;
+		WALK_LIST_DELSAFE(node, nxt, zone->ddns_queue) {
+			if (update_count == max_count) {
+				break;
+			}
+			rem_node(node);
+			add_tail(updates, node);
+			update_count++;
+		}
+	}
+	zone->ddns_queue_size -= update_count;
+	bool remaining = zone->ddns_queue_size > 0;
 
 	pthread_mutex_unlock(&zone->ddns_lock);
 
+	/* Process the rest of the queue in the next batch. */
+	if (remaining) {
+		zone_events_schedule_now(zone, ZONE_EVENT_UPDATE);
+	}
+
 	return update_count;
 }
 
@@ -122,6 +122,8 @@ int zone_flush_journal(conf_t *conf, zone_t *zone);
 
 /*!
  * \brief Atomically switch the content of the zone.
+ *
+ * The new contents get a unique version number.
  */
 zone_contents_t *zone_switch_contents(zone_t *zone, zone_contents_t *new_contents);
 
@@ -156,11 +158,26 @@ int zone_master_try(conf_t *conf, zone_t *zone, zone_master_cb callback,
                     void *callback_data, const char *err_str);
 
 
-/*! \brief Enqueue UPDATE request for processing. */
+/*!
+ * \brief Enqueue UPDATE request for processing.
+ *
+ * The UPDATE event is scheduled with respect to the configured DDNS batching.
+ */
 int zone_update_enqueue(zone_t *zone, knot_pkt_t *pkt, knotd_qdata_params_t *params);
 
-/*! \brief Dequeue UPDATE request. Returns number of queued updates. */
-size_t zone_update_dequeue(zone_t *zone, list_t *updates);
+/*!
+ * \brief Dequeue UPDATE requests.
+ *
+ * If more than max_count requests are queued, the rest is left in the queue
+ * and the UPDATE event is scheduled again.
+ *
+ * \param zone       Zone.
+ * \param updates    Output list of dequeued requests.
+ * \param max_count  Maximum number of requests to dequeue (0 for all).
+ *
+ * \return Number of dequeued updates.
+ */
+size_t zone_update_dequeue(zone_t *zone, list_t *updates, size_t max_count);
 
 /*! \brief Write zone contents to zonefile, but into different directory. */
 int zone_dump_to_dir(conf_t *conf, zone_t *zone, const char *dir);
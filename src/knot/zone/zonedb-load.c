@@ -20,6 +20,7 @@
 #include "knot/common/log.h"
 #include "knot/conf/module.h"
 #include "knot/events/replan.h"
+#include "knot/zone/answer-cache.h"
 #include "knot/zone/timers.h"
 #include "knot/zone/zone-load.h"
 #include "knot/zone/zone.h"
@@ -27,6 +28,7 @@
 #include "knot/zone/zonedb.h"
 #include "knot/zone/zonefile.h"
 #include "libknot/libknot.h"
+#include "contrib/ucw/lists.h"
 
 static bool zone_file_updated(conf_t *conf, const zone_t *old_zone,
                               const knot_dname_t *zone_name)
@@ -321,6 +323,27 @@ static void remove_old_zonedb(conf_t *conf, knot_zonedb_t *db_old,
 	}
 }
 
+/*!
+ * \brief Replace the answer cache rendered with the previous configuration.
+ *
+ * The old cache is put into \a old_caches to be freed once no query uses it.
+ */
+static void flush_answer_cache(zone_t *zone, conf_t *conf, list_t *old_caches)
+{
+	zone_contents_t *contents = zone->contents;
+	if (contents == NULL) {
+		return;
+	}
+
+	conf_val_t val = conf_zone_get(conf, C_ANSWER_CACHE, zone->name);
+	answer_cache_t *cache = answer_cache_new(conf_int(&val));
+	cache = rcu_xchg_pointer(&contents->answer_cache, cache);
+	if (cache != NULL && ptrlist_add(old_caches, cache, NULL) == NULL) {
+		synchronize_rcu();
+		answer_cache_free(cache);
+	}
+}
+
 static bool zone_exists(const knot_dname_t *zone, void *data)
 {
 	assert(zone);
@@ -362,4 +385,17 @@ void zonedb_reload(conf_t *conf, server_t *server)
 
 	/* Remove old zone DB. */
 	remove_old_zonedb(conf, db_old, db_new);
+
+	/* Drop the answers rendered with the old configuration. */
+	list_t old_caches;
+	init_list(&old_caches);
+	knot_zonedb_foreach(db_new, flush_answer_cache, conf, &old_caches);
+	if (!EMPTY_LIST(old_caches)) {
+		synchronize_rcu();
+		ptrnode_t *node = NULL;
+		WALK_LIST(node, old_caches) {
+			answer_cache_free(node->d);
+		}
+		ptrlist_free(&old_caches, NULL);
+	}
 }
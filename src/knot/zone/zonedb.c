@@ -111,12 +111,20 @@ zone_t *knot_zonedb_find(knot_zonedb_t *db, const knot_dname_t *zone_name)
 	return *val;
 }
 
-zone_t *knot_zonedb_find_suffix(knot_zonedb_t *db, const knot_dname_t *zone_name)
+/*! \brief Check if the lookup format prefix ends on a label boundary. */
+static bool lf_label_boundary(const knot_dname_t *name, uint32_t lf_len,
+                              uint32_t prefix_len)
 {
-	if (db == NULL || zone_name == NULL) {
-		return NULL;
+	while (lf_len > prefix_len) {
+		lf_len -= *name + 1;
+		name = knot_wire_next_label(name, NULL);
 	}
 
+	return lf_len == prefix_len;
+}
+
+static zone_t *find_suffix_by_labels(knot_zonedb_t *db, const knot_dname_t *zone_name)
+{
 	uint8_t lf[KNOT_DNAME_MAXLEN];
 
 	while (true) {
@@ -133,6 +141,30 @@ zone_t *knot_zonedb_find_suffix(knot_zonedb_t *db, const knot_dname_t *zone_name
 	}
 }
 
+zone_t *knot_zonedb_find_suffix(knot_zonedb_t *db, const knot_dname_t *zone_name)
+{
+	if (db == NULL || zone_name == NULL) {
+		return NULL;
+	}
+
+	uint8_t lf[KNOT_DNAME_MAXLEN];
+	knot_dname_lf(lf, zone_name, NULL);
+
+	/* Zone keys are label-terminated, so the longest key prefix is the
+	 * deepest zone apex, unless a label contains a zero byte. */
+	uint32_t match_len = 0;
+	trie_val_t *val = trie_get_lpm(db->trie, (char *)lf + 1, *lf, &match_len);
+	if (val == NULL) {
+		/* The root zone key is a zero byte, not a prefix of other keys. */
+		val = trie_get_try(db->trie, "\0", 1);
+		return (val != NULL) ? *val : NULL;
+	} else if (!lf_label_boundary(zone_name, *lf, match_len)) {
+		return find_suffix_by_labels(db, zone_name);
+	}
+
+	return *val;
+}
+
 size_t knot_zonedb_size(const knot_zonedb_t *db)
 {
 	if (db == NULL) {
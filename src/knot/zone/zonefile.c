@@ -18,7 +18,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <time.h>
@@ -27,6 +29,7 @@
 
 #include "libknot/libknot.h"
 #include "contrib/files.h"
+#include "contrib/macros.h"
 #include "knot/common/log.h"
 #include "knot/dnssec/zone-nsec.h"
 #include "knot/zone/semantic-check.h"
@@ -38,15 +41,22 @@
 #define WARNING(zone, fmt, ...) log_zone_warning(zone, "zone loader, " fmt, ##__VA_ARGS__)
 #define NOTICE(zone, fmt, ...) log_zone_notice(zone, "zone loader, " fmt, ##__VA_ARGS__)
 
+/*! \brief Minimal zone file chunk size for parallel parsing. */
+#define ZONEFILE_CHUNK_MIN	(64 * 1024)
+
+static void log_scanner_error(const knot_dname_t *zname, const char *file,
+                              uint64_t line, bool fatal, int code)
+{
+	ERROR(zname, "%s in zone, file '%s', line %"PRIu64" (%s)",
+	      fatal ? "fatal error" : "error", file, line, zs_strerror(code));
+}
+
 static void process_error(zs_scanner_t *s)
 {
 	zcreator_t *zc = s->process.data;
-	const knot_dname_t *zname = zc->z->apex->owner;
 
-	ERROR(zname, "%s in zone, file '%s', line %"PRIu64" (%s)",
-	      s->error.fatal ? "fatal error" : "error",
-	      s->file.name, s->line_counter,
-	      zs_strerror(s->error.code));
+	log_scanner_error(zc->z->apex->owner, s->file.name, s->line_counter,
+	                  s->error.fatal, s->error.code);
 }
 
 static bool handle_err(zcreator_t *zc, const knot_rrset_t *rr, int ret, bool master)
@@ -76,7 +86,7 @@ static bool handle_err(zcreator_t *zc, const knot_rrset_t *rr, int ret, bool mas
 
 int zcreator_step(zcreator_t *zc, const knot_rrset_t *rr)
 {
-	if (zc == NULL || rr == NULL || rr->rrs.rr_count != 1) {
+	if (zc == NULL || rr == NULL || rr->rrs.rr_count == 0) {
 		return KNOT_EINVAL;
 	}
 
@@ -86,8 +96,7 @@ int zcreator_step(zcreator_t *zc, const knot_rrset_t *rr)
 		return KNOT_EOK;
 	}
 
-	zone_node_t *node = NULL;
-	int ret = zone_contents_add_rr(zc->z, rr, &node);
+	int ret = zone_contents_append_rr(zc->z, rr, &zc->last);
 	if (ret != KNOT_EOK) {
 		if (!handle_err(zc, rr, ret, zc->master)) {
 			// Fatal error
@@ -98,36 +107,44 @@ int zcreator_step(zcreator_t *zc, const knot_rrset_t *rr)
 	return KNOT_EOK;
 }
 
-/*! \brief Creates RR from parser input, passes it to handling function. */
-static void process_data(zs_scanner_t *scanner)
+/*! \brief Creates canonical RR from parser input. */
+static int scanner_rr(zs_scanner_t *scanner, knot_rrset_t *rr)
 {
-	zcreator_t *zc = scanner->process.data;
-	if (zc->ret != KNOT_EOK) {
-		scanner->state = ZS_STATE_STOP;
-		return;
-	}
-
 	knot_dname_t *owner = knot_dname_copy(scanner->r_owner, NULL);
 	if (owner == NULL) {
-		zc->ret = KNOT_ENOMEM;
-		return;
+		return KNOT_ENOMEM;
 	}
 
-	knot_rrset_t rr;
-	knot_rrset_init(&rr, owner, scanner->r_type, scanner->r_class, scanner->r_ttl);
+	knot_rrset_init(rr, owner, scanner->r_type, scanner->r_class, scanner->r_ttl);
 
-	int ret = knot_rrset_add_rdata(&rr, scanner->r_data, scanner->r_data_length, NULL);
+	int ret = knot_rrset_add_rdata(rr, scanner->r_data, scanner->r_data_length, NULL);
 	if (ret != KNOT_EOK) {
-		knot_rrset_clear(&rr, NULL);
-		zc->ret = ret;
-		return;
+		knot_rrset_clear(rr, NULL);
+		return ret;
 	}
 
 	/* Convert RDATA dnames to lowercase before adding to zone. */
-	ret = knot_rrset_rr_to_canonical(&rr);
+	ret = knot_rrset_rr_to_canonical(rr);
 	if (ret != KNOT_EOK) {
-		knot_rrset_clear(&rr, NULL);
-		zc->ret = ret;
+		knot_rrset_clear(rr, NULL);
+		return ret;
+	}
+
+	return KNOT_EOK;
+}
+
+/*! \brief Creates RR from parser input, passes it to handling function. */
+static void process_data(zs_scanner_t *scanner)
+{
+	zcreator_t *zc = scanner->process.data;
+	if (zc->ret != KNOT_EOK) {
+		scanner->state = ZS_STATE_STOP;
+		return;
+	}
+
+	knot_rrset_t rr;
+	zc->ret = scanner_rr(scanner, &rr);
+	if (zc->ret != KNOT_EOK) {
 		return;
 	}
 
@@ -184,11 +201,403 @@ int zonefile_open(zloader_t *loader, const char *source,
 	loader->source = strdup(source);
 	loader->creator = zc;
 	loader->semantic_checks = semantic_checks;
+	loader->threads = 1;
 	loader->time = time;
 
 	return KNOT_EOK;
 }
 
+/*! \brief Location of a $ORIGIN or $TTL directive in the zone file. */
+typedef struct {
+	const char *start;
+	size_t len;
+} zdirective_t;
+
+/*! \brief Scanner error postponed until the preceding chunks are processed. */
+typedef struct {
+	uint64_t line;            /*!< Line of the error. */
+	int code;                 /*!< Scanner error code. */
+	bool fatal;               /*!< Fatal error indication. */
+	size_t rrset_count;       /*!< Number of RRSets parsed before the error. */
+} zchunk_error_t;
+
+/*! \brief Zone file part parsed by a separate thread. */
+typedef struct {
+	const char *start;        /*!< Chunk start in the zone file. */
+	size_t len;               /*!< Chunk length. */
+	uint64_t line;            /*!< Line number of the chunk start. */
+	const zdirective_t *directives; /*!< Directives preceding the chunk. */
+	size_t directive_count;   /*!< Number of directives preceding the chunk. */
+	const knot_dname_t *zone; /*!< Zone name. */
+	const char *source;       /*!< Zone file name. */
+	zs_scanner_t scanner;     /*!< Chunk scanner. */
+	knot_rrset_t *rrsets;     /*!< Parsed RRSets in the zone file order. */
+	size_t count;             /*!< Number of parsed RRSets. */
+	size_t capacity;          /*!< Allocated RRSets. */
+	zchunk_error_t *errors;   /*!< Scanner errors in the zone file order. */
+	size_t error_count;       /*!< Number of scanner errors. */
+	size_t error_capacity;    /*!< Allocated scanner errors. */
+	pthread_t thread;         /*!< Parsing thread. */
+	int ret;                  /*!< Parsing result. */
+} zchunk_t;
+
+/*! \brief Context of the zone file splitting. */
+typedef struct {
+	zchunk_t *chunks;
+	size_t count;
+	zdirective_t *directives;
+	size_t directive_count;
+} zchunks_t;
+
+static bool is_directive(const char *pos, const char *end, const char *name)
+{
+	size_t len = strlen(name);
+	return (end - pos) > len && strncasecmp(pos, name, len) == 0 &&
+	       (pos[len] == ' ' || pos[len] == '\t');
+}
+
+static int add_directive(zchunks_t *ctx, const char *pos, const char *end)
+{
+	const char *eol = memchr(pos, '\n', end - pos);
+	eol = (eol != NULL) ? eol + 1 : end;
+
+	zdirective_t *directives = realloc(ctx->directives,
+	                                   (ctx->directive_count + 1) * sizeof(*directives));
+	if (directives == NULL) {
+		return KNOT_ENOMEM;
+	}
+	directives[ctx->directive_count].start = pos;
+	directives[ctx->directive_count].len = eol - pos;
+	ctx->directives = directives;
+	ctx->directive_count++;
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Splits the zone file into chunks of similar size.
+ *
+ * A chunk can only start with a record which has an explicit owner and which
+ * isn't inside parentheses, a quoted string or a comment. The $ORIGIN and $TTL
+ * directives are collected so that each chunk can start with the state of
+ * the preceding part of the file.
+ *
+ * \retval KNOT_ENOTSUP if the zone file contains $INCLUDE directive.
+ */
+static int split_input(zchunks_t *ctx, const char *data, size_t size)
+{
+	ctx->chunks[0].start = data;
+	ctx->chunks[0].line = 1;
+	size_t found = 1;
+
+	const char *end = data + size;
+	uint64_t line = 1;
+	unsigned depth = 0;
+	bool quoted = false, comment = false, line_start = true;
+
+	for (const char *pos = data; pos < end; pos++) {
+		if (line_start) {
+			line_start = false;
+			if (*pos == '$') {
+				if (is_directive(pos, end, "$INCLUDE")) {
+					return KNOT_ENOTSUP;
+				}
+				if (is_directive(pos, end, "$ORIGIN") ||
+				    is_directive(pos, end, "$TTL")) {
+					int ret = add_directive(ctx, pos, end);
+					if (ret != KNOT_EOK) {
+						return ret;
+					}
+				}
+			} else if (found < ctx->count && *pos != ' ' && *pos != '\t' &&
+			           *pos != ';' && *pos != '\r' && *pos != '\n' &&
+			           (pos - data) >= size * found / ctx->count) {
+				zchunk_t *chunk = &ctx->chunks[found++];
+				chunk->start = pos;
+				chunk->line = line;
+				chunk->directive_count = ctx->directive_count;
+			}
+		}
+
+		if (comment && *pos != '\n') {
+			continue;
+		}
+
+		switch (*pos) {
+		case '\\':
+			if (pos + 1 < end && *(++pos) == '\n') {
+				line++;
+			}
+			break;
+		case '"':
+			quoted = !quoted;
+			break;
+		case ';':
+			comment = !quoted;
+			break;
+		case '(':
+			depth += quoted ? 0 : 1;
+			break;
+		case ')':
+			depth -= (quoted || depth == 0) ? 0 : 1;
+			break;
+		case '\n':
+			line++;
+			comment = false;
+			line_start = (depth == 0 && !quoted);
+			break;
+		default:
+			break;
+		}
+	}
+
+	ctx->count = found;
+	for (size_t i = 0; i < found; i++) {
+		const char *chunk_end = (i + 1 < found) ? ctx->chunks[i + 1].start : end;
+		ctx->chunks[i].len = chunk_end - ctx->chunks[i].start;
+	}
+
+	return KNOT_EOK;
+}
+
+/*! \brief Stores parsed RR into the chunk, merges it with the previous one if possible. */
+static void process_chunk_data(zs_scanner_t *scanner)
+{
+	zchunk_t *chunk = scanner->process.data;
+	if (chunk->ret != KNOT_EOK) {
+		scanner->state = ZS_STATE_STOP;
+		return;
+	}
+
+	knot_rrset_t rr;
+	chunk->ret = scanner_rr(scanner, &rr);
+	if (chunk->ret != KNOT_EOK) {
+		return;
+	}
+
+	/* Extra SOA records are handled one by one when added to the zone. */
+	knot_rrset_t *last = (chunk->count > 0) ? &chunk->rrsets[chunk->count - 1] : NULL;
+	if (last != NULL && rr.type != KNOT_RRTYPE_SOA && last->type == rr.type &&
+	    last->rclass == rr.rclass && last->ttl == rr.ttl &&
+	    knot_dname_is_equal(last->owner, rr.owner)) {
+		chunk->ret = knot_rdataset_merge(&last->rrs, &rr.rrs, NULL);
+		knot_rrset_clear(&rr, NULL);
+		return;
+	}
+
+	if (chunk->count == chunk->capacity) {
+		size_t capacity = MAX(2 * chunk->capacity, 64);
+		knot_rrset_t *rrsets = realloc(chunk->rrsets, capacity * sizeof(*rrsets));
+		if (rrsets == NULL) {
+			knot_rrset_clear(&rr, NULL);
+			chunk->ret = KNOT_ENOMEM;
+			return;
+		}
+		chunk->rrsets = rrsets;
+		chunk->capacity = capacity;
+	}
+
+	chunk->rrsets[chunk->count++] = rr;
+}
+
+static void process_chunk_error(zs_scanner_t *s)
+{
+	zchunk_t *chunk = s->process.data;
+
+	if (chunk->error_count == chunk->error_capacity) {
+		size_t capacity = MAX(2 * chunk->error_capacity, 16);
+		zchunk_error_t *errors = realloc(chunk->errors, capacity * sizeof(*errors));
+		if (errors == NULL) {
+			chunk->ret = KNOT_ENOMEM;
+			s->state = ZS_STATE_STOP;
+			return;
+		}
+		chunk->errors = errors;
+		chunk->error_capacity = capacity;
+	}
+
+	chunk->errors[chunk->error_count++] = (zchunk_error_t) {
+		.line = s->line_counter,
+		.code = s->error.code,
+		.fatal = s->error.fatal,
+		.rrset_count = chunk->count,
+	};
+}
+
+/*!
+ * \brief Parses one zone file chunk (thread function).
+ */
+static void *parse_chunk(void *data)
+{
+	zchunk_t *chunk = data;
+	zs_scanner_t *s = &chunk->scanner;
+
+	/* Restore the state at the chunk start using the preceding directives. */
+	for (size_t i = 0; i < chunk->directive_count; i++) {
+		const zdirective_t *directive = &chunk->directives[i];
+		if (zs_set_input_string(s, directive->start, directive->len) != 0 ||
+		    zs_parse_all(s) != 0) {
+			// Already reported by the chunk containing the directive.
+			s->error.counter = 0;
+			chunk->ret = KNOT_EPARSEFAIL;
+			return NULL;
+		}
+	}
+
+	if (zs_set_input_string(s, chunk->start, chunk->len) != 0 ||
+	    zs_set_processing(s, process_chunk_data, process_chunk_error, chunk) != 0) {
+		chunk->ret = KNOT_EPARSEFAIL;
+		return NULL;
+	}
+	s->file.name = strdup(chunk->source);
+	s->line_counter = chunk->line;
+
+	(void)zs_parse_all(s);
+
+	return NULL;
+}
+
+static void chunk_deinit(zchunk_t *chunk)
+{
+	for (size_t i = 0; i < chunk->count; i++) {
+		knot_rrset_clear(&chunk->rrsets[i], NULL);
+	}
+	free(chunk->rrsets);
+	chunk->rrsets = NULL;
+	chunk->count = 0;
+	free(chunk->errors);
+	chunk->errors = NULL;
+	chunk->error_count = 0;
+	zs_deinit(&chunk->scanner);
+}
+
+/*!
+ * \brief Adds the chunk RRSets into the zone and reports the chunk errors.
+ *
+ * The errors are interleaved with the RRSets as they were parsed.
+ *
+ * \return True if sequential parsing would have stopped in this chunk.
+ */
+static bool process_chunk(zcreator_t *zc, zs_scanner_t *scanner, zchunk_t *chunk)
+{
+	size_t added = 0;
+	for (size_t i = 0; i < chunk->error_count; i++) {
+		const zchunk_error_t *err = &chunk->errors[i];
+		for (; zc->ret == KNOT_EOK && added < err->rrset_count; added++) {
+			zc->ret = zcreator_step(zc, &chunk->rrsets[added]);
+		}
+		if (zc->ret != KNOT_EOK) {
+			return true;
+		}
+
+		log_scanner_error(chunk->zone, chunk->source, err->line,
+		                  err->fatal, err->code);
+		if (scanner->error.counter == 0) {
+			scanner->error.code = err->code;
+			scanner->error.fatal = err->fatal;
+		}
+		scanner->error.counter++;
+		if (err->fatal) {
+			return true;
+		}
+	}
+
+	for (; zc->ret == KNOT_EOK && added < chunk->count; added++) {
+		zc->ret = zcreator_step(zc, &chunk->rrsets[added]);
+	}
+
+	return zc->ret != KNOT_EOK || chunk->ret != KNOT_EOK;
+}
+
+/*!
+ * \brief Parses the zone file in parallel if possible.
+ *
+ * The zone file is split into chunks parsed by separate threads into lists
+ * of RRSets. The RRSets are added into the zone in the zone file order, so
+ * the result and error reporting are the same as with sequential parsing.
+ *
+ * \return Zero if success, -1 if error (the same as zs_parse_all).
+ */
+static int parse_all(zloader_t *loader)
+{
+	zs_scanner_t *scanner = &loader->scanner;
+	size_t size = scanner->input.end - scanner->input.start;
+	size_t count = MIN(loader->threads, size / ZONEFILE_CHUNK_MIN);
+	if (count < 2) {
+		return zs_parse_all(scanner);
+	}
+
+	zcreator_t *zc = loader->creator;
+	char *origin = knot_dname_to_str_alloc(zc->z->apex->owner);
+	zchunks_t ctx = {
+		.chunks = calloc(count, sizeof(zchunk_t)),
+		.count = count,
+	};
+	if (ctx.chunks == NULL || origin == NULL) {
+		free(ctx.chunks);
+		free(origin);
+		scanner->error.code = ZS_ENOMEM;
+		return -1;
+	}
+
+	int ret = split_input(&ctx, scanner->input.start, size);
+	if (ret != KNOT_EOK || ctx.count < 2) {
+		free(ctx.chunks);
+		free(ctx.directives);
+		free(origin);
+		return zs_parse_all(scanner);
+	}
+
+	/* Start the parsing threads. */
+	size_t started = 0;
+	for (size_t i = 0; i < ctx.count; i++) {
+		zchunk_t *chunk = &ctx.chunks[i];
+		chunk->directives = ctx.directives;
+		chunk->zone = zc->z->apex->owner;
+		chunk->source = loader->source;
+		if (zs_init(&chunk->scanner, origin, KNOT_CLASS_IN, 3600) != 0) {
+			zc->ret = KNOT_ENOMEM;
+			break;
+		}
+		if (pthread_create(&chunk->thread, NULL, parse_chunk, chunk) != 0) {
+			zs_deinit(&chunk->scanner);
+			zc->ret = KNOT_ENOMEM;
+			break;
+		}
+		started++;
+	}
+
+	/* Add the parsed records and report the errors in the zone file order
+	 * up to the point where sequential parsing would have stopped. */
+	bool stopped = false, failed = false;
+	for (size_t i = 0; i < started; i++) {
+		zchunk_t *chunk = &ctx.chunks[i];
+		pthread_join(chunk->thread, NULL);
+
+		if (!stopped) {
+			stopped = process_chunk(zc, scanner, chunk);
+			if (chunk->ret != KNOT_EOK) {
+				failed = true;
+				if (chunk->ret != KNOT_EPARSEFAIL && zc->ret == KNOT_EOK) {
+					zc->ret = chunk->ret;
+				}
+			}
+		}
+
+		chunk_deinit(chunk);
+	}
+
+	free(ctx.chunks);
+	free(ctx.directives);
+	free(origin);
+
+	if (failed && scanner->error.counter == 0 && zc->ret == KNOT_EOK) {
+		scanner->error.code = ZS_EINVAL;
+	}
+
+	return (failed || scanner->error.counter > 0) ? -1 : 0;
+}
+
 zone_contents_t *zonefile_load(zloader_t *loader)
 {
 	if (!loader) {
@@ -199,7 +608,7 @@ zone_contents_t *zonefile_load(zloader_t *loader)
 	const knot_dname_t *zname = zc->z->apex->owner;
 
 	assert(zc);
-	int ret = zs_parse_all(&loader->scanner);
+	int ret = parse_all(loader);
 	if (ret != 0 && loader->scanner.error.counter == 0) {
 		ERROR(zname, "failed to load zone, file '%s' (%s)",
 		      loader->source, zs_strerror(loader->scanner.error.code));
@@ -233,7 +642,7 @@ zone_contents_t *zonefile_load(zloader_t *loader)
 	}
 
 	ret = sem_checks_process(zc->z, loader->semantic_checks,
-	                         loader->err_handler, loader->time);
+	                         loader->err_handler, loader->time, loader->threads);
 
 	if (ret != KNOT_EOK) {
 		ERROR(zname, "failed to load zone, file '%s' (%s)",
@@ -26,9 +26,10 @@
  * \brief Zone creator structure.
  */
 typedef struct zcreator {
-	zone_contents_t *z;  /*!< Created zone. */
-	bool master;         /*!< True if server is a primary master for the zone. */
-	int ret;             /*!< Return value. */
+	zone_contents_t *z;      /*!< Created zone. */
+	bool master;             /*!< True if server is a primary master for the zone. */
+	int ret;                 /*!< Return value. */
+	zone_append_ctx_t last;  /*!< Node of the last processed record. */
 } zcreator_t;
 
 /*!
@@ -37,6 +38,7 @@ typedef struct zcreator {
 typedef struct {
 	char *source;                /*!< Zone source file. */
 	bool semantic_checks;        /*!< Do semantic checks. */
+	unsigned threads;            /*!< Number of parsing and checking threads. */
 	sem_handler_t *err_handler;  /*!< Semantic checks error handler. */
 	zcreator_t *creator;         /*!< Loader context. */
 	zs_scanner_t scanner;        /*!< Zone scanner. */
@@ -94,10 +96,10 @@ int zonefile_write(const char *path, zone_contents_t *zone);
 void zonefile_close(zloader_t *loader);
 
 /*!
- * \brief Adds one RR into zone.
+ * \brief Adds RRs into zone.
  *
  * \param zl  Zone loader.
- * \param rr  RR to add.
+ * \param rr  RRSet to add (an extra SOA must be added as a single RR).
  *
  * \return KNOT_E*
  */
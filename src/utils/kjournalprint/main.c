@@ -68,6 +68,31 @@ static int reconfigure_mapsize(const char *journal_path, size_t *mapsize)
 	return KNOT_EOK;
 }
 
+// open the journal DB, with all its shards if sharded
+static int open_journal_db(journal_db_t **jdb, const char *path)
+{
+	int ret = journal_db_init(jdb, path, 1, JOURNAL_MODE_ROBUST, 0);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	if ((*jdb)->shard_count == 0) {
+		ret = reconfigure_mapsize((*jdb)->path, &(*jdb)->fslimit);
+	}
+	for (unsigned i = 0; i < (*jdb)->shard_count && ret == KNOT_EOK; i++) {
+		journal_db_t *shard = (*jdb)->shards[i];
+		ret = reconfigure_mapsize(shard->path, &shard->fslimit);
+	}
+	if (ret == KNOT_EOK) {
+		ret = journal_open_db(jdb);
+	}
+	if (ret != KNOT_EOK) {
+		journal_db_close(jdb);
+	}
+
+	return ret;
+}
+
 static void print_changeset(const changeset_t *chs, bool color)
 {
 	printf(color ? YLW : "");
@@ -149,23 +174,11 @@ int print_journal(char *path, knot_dname_t *name, uint32_t limit, bool color, bo
 	int ret;
 	journal_db_t *jdb = NULL;
 
-	ret = journal_db_init(&jdb, path, 1, JOURNAL_MODE_ROBUST);
+	ret = open_journal_db(&jdb, path);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
 
-	ret = reconfigure_mapsize(jdb->path, &jdb->fslimit);
-	if (ret != KNOT_EOK) {
-		journal_db_close(&jdb);
-		return ret;
-	}
-
-	ret = journal_open_db(&jdb);
-	if (ret != KNOT_EOK) {
-		journal_db_close(&jdb);
-		return ret;
-	}
-
 	if (!journal_exists(&jdb, name)) {
 		fprintf(stderr, "This zone does not exist in DB %s\n", path);
 		ret = KNOT_ENOENT;
@@ -185,7 +198,9 @@ int print_journal(char *path, knot_dname_t *name, uint32_t limit, bool color, bo
 	bool has_bootstrap;
 	kserial_t merged_serial, serial_from, last_flushed, serial_to;
 	uint64_t occupied;
-	journal_metadata_info(j, &has_bootstrap, &merged_serial, &serial_from, &last_flushed, &serial_to, &occupied);
+	journal_chunk_stats_t chunks;
+	journal_metadata_info(j, &has_bootstrap, &merged_serial, &serial_from, &last_flushed,
+	                      &serial_to, &occupied, debugmode ? &chunks : NULL);
 
 	bool alternative_from = (has_bootstrap || merged_serial.valid);
 	bool is_empty = (!alternative_from && !serial_from.valid);
@@ -246,6 +261,9 @@ int print_journal(char *path, knot_dname_t *name, uint32_t limit, bool color, bo
 
 	if (debugmode) {
 		printf("Occupied: %"PRIu64" KiB\n", occupied / 1024);
+		printf("Chunks: %"PRIu64" (compressed %"PRIu64")  size: %"PRIu64" B"
+		       "  stored: %"PRIu64" B\n", chunks.chunks, chunks.compressed,
+		       chunks.raw_size, chunks.stored_size);
 	}
 
 pj_finally:
@@ -259,23 +277,11 @@ pj_finally:
 int list_zones(char *path)
 {
 	journal_db_t *jdb = NULL;
-	int ret = journal_db_init(&jdb, path, 1, JOURNAL_MODE_ROBUST);
+	int ret = open_journal_db(&jdb, path);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
 
-	ret = reconfigure_mapsize(jdb->path, &jdb->fslimit);
-	if (ret != KNOT_EOK) {
-		journal_db_close(&jdb);
-		return ret;
-	}
-
-	ret = journal_open_db(&jdb);
-	if (ret != KNOT_EOK) {
-		journal_db_close(&jdb);
-		return ret;
-	}
-
 	list_t zones;
 	init_list(&zones);
 	ret = journal_db_list_zones(&jdb, &zones);
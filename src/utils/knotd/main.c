@@ -39,6 +39,7 @@
 #include "knot/conf/conf.h"
 #include "knot/conf/migration.h"
 #include "knot/conf/module.h"
+#include "knot/conf/snapshot.h"
 #include "knot/common/log.h"
 #include "knot/common/process.h"
 #include "knot/common/stats.h"
@@ -515,6 +516,13 @@ int main(int argc, char **argv)
 	conf_activate_modules(conf(), NULL, conf()->query_modules,
 	                      &conf()->query_plan);
 
+	/* Compile per-zone configuration for query processing. */
+	ret = conf_snapshot_build(conf());
+	if (ret != KNOT_EOK) {
+		log_warning("failed to compile zone configuration (%s)",
+		            knot_strerror(ret));
+	}
+
 	/* Check and create PID file. */
 	long pid = (long)getpid();
 	if (daemonize) {
@@ -18,6 +18,7 @@
 #include <libgen.h>
 #include <stdio.h>
 
+#include "contrib/strtonum.h"
 #include "contrib/time.h"
 #include "libknot/libknot.h"
 #include "knot/common/log.h"
@@ -35,6 +36,8 @@ static void print_help(void)
 	       "                              (default filename without .zone)\n"
 	       " -t, --time <timestamp>      Current time specification.\n"
 	       "                              (default current UNIX time)\n"
+	       " -j, --jobs <num>            Number of loading threads.\n"
+	       "                              (default 1)\n"
 	       " -v, --verbose               Enable debug output.\n"
 	       " -h, --help                  Print the program help.\n"
 	       " -V, --version               Print the program version.\n"
@@ -46,12 +49,14 @@ int main(int argc, char *argv[])
 {
 	const char *origin = NULL;
 	bool verbose = false;
+	uint16_t jobs = 1;
 	knot_time_t check_time = (knot_time_t)time(NULL);
 
 	/* Long options. */
 	struct option opts[] = {
 		{ "origin",  required_argument, NULL, 'o' },
 		{ "time",    required_argument, NULL, 't' },
+		{ "jobs",    required_argument, NULL, 'j' },
 		{ "verbose", no_argument,       NULL, 'v' },
 		{ "help",    no_argument,       NULL, 'h' },
 		{ "version", no_argument,       NULL, 'V' },
@@ -60,7 +65,7 @@ int main(int argc, char *argv[])
 
 	/* Parse command line arguments */
 	int opt = 0;
-	while ((opt = getopt_long(argc, argv, "o:t:vVh", opts, NULL)) != -1) {
+	while ((opt = getopt_long(argc, argv, "o:t:j:vVh", opts, NULL)) != -1) {
 		switch (opt) {
 		case 'o':
 			origin = optarg;
@@ -81,6 +86,12 @@ int main(int argc, char *argv[])
 				return EXIT_FAILURE;
 			}
 			break;
+		case 'j':
+			if (str_to_u16(optarg, &jobs) != KNOT_EOK || jobs == 0) {
+				fprintf(stderr, "Invalid number of jobs\n");
+				return EXIT_FAILURE;
+			}
+			break;
 		default:
 			print_help();
 			return EXIT_FAILURE;
@@ -121,7 +132,7 @@ int main(int argc, char *argv[])
 
 	knot_dname_t *dname = knot_dname_from_str_alloc(zonename);
 	free(zonename);
-	int ret = zone_check(filename, dname, stdout, (time_t)check_time);
+	int ret = zone_check(filename, dname, stdout, (time_t)check_time, jobs);
 	knot_dname_free(&dname, NULL);
 
 	log_close();
@@ -60,7 +60,7 @@ static void print_statistics(err_handler_stats_t *stats)
 }
 
 int zone_check(const char *zone_file, const knot_dname_t *zone_name,
-               FILE *outfile, time_t time)
+               FILE *outfile, time_t time, unsigned threads)
 {
 	err_handler_stats_t stats = {
 		.handler = { .cb = err_callback },
@@ -72,6 +72,7 @@ int zone_check(const char *zone_file, const knot_dname_t *zone_name,
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
+	zl.threads = threads;
 	zl.err_handler = (sem_handler_t *)&stats;
 	zl.creator->master = true;
 
@@ -102,6 +102,20 @@ static bool str_key_get_leq(trie_t *trie, char **keys, size_t i, size_t size)
 
 }
 
+static int count_val(trie_val_t *val, void *d)
+{
+	++*(size_t *)d;
+	return KNOT_EOK;
+}
+
+static int find_touched(trie_val_t *val, void *d)
+{
+	if (*val != NULL && strcmp(*val, "touched") == 0) {
+		*(trie_val_t **)d = val;
+	}
+	return KNOT_EOK;
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -172,6 +186,64 @@ int main(int argc, char *argv[])
 	}
 	ok(passed, "trie: find lesser or equal for all keys");
 
+	/* Longest prefix match. */
+	passed = true;
+	for (unsigned i = 0; passed && i < key_count; ++i) {
+		/* Key extended with a random suffix. */
+		char ext[KEY_MAXLEN * 2];
+		size_t key_len = strlen(keys[i]) + 1;
+		memcpy(ext, keys[i], key_len);
+		size_t ext_len = key_len + rand() % KEY_MAXLEN;
+		for (size_t j = key_len; j < ext_len; ++j) {
+			ext[j] = alphabet[rand() % strlen(alphabet)];
+		}
+		uint32_t match_len = 0;
+		val = trie_get_lpm(trie, ext, ext_len, &match_len);
+		passed = (val != NULL && match_len == key_len &&
+		          strcmp(*val, keys[i]) == 0);
+		/* Truncated key has no stored prefix (all keys are equally long). */
+		val = trie_get_lpm(trie, keys[i], key_len - 1, NULL);
+		passed = passed && (val == NULL);
+	}
+	ok(passed, "trie: longest prefix match for all keys");
+
+	/* Nested prefixes. */
+	trie_t *nested = trie_create(NULL);
+	const char *prefixes[] = { "", "com", "com.example", "com.example.www" };
+	for (unsigned i = 0; i < sizeof(prefixes) / sizeof(*prefixes); ++i) {
+		*trie_get_ins(nested, prefixes[i], strlen(prefixes[i])) = (void *)prefixes[i];
+	}
+	*trie_get_ins(nested, "com.exa", 7) = "com.exa";
+	*trie_get_ins(nested, "org", 3) = "org";
+	const struct {
+		const char *key;
+		const char *match;
+	} lpm_cases[] = {
+		{ "com.example.www.x", "com.example.www" },
+		{ "com.example.ww",    "com.example" },
+		{ "com.example",       "com.example" },
+		{ "com.examp",         "com.exa" },
+		{ "com.ex",            "com" },
+		{ "co",                "" },
+		{ "net",               "" },
+		{ "org.x",             "org" },
+	};
+	passed = true;
+	for (unsigned i = 0; i < sizeof(lpm_cases) / sizeof(*lpm_cases); ++i) {
+		uint32_t match_len = 0;
+		val = trie_get_lpm(nested, lpm_cases[i].key, strlen(lpm_cases[i].key),
+		                   &match_len);
+		if (val == NULL || strcmp(*val, lpm_cases[i].match) != 0 ||
+		    match_len != strlen(lpm_cases[i].match)) {
+			diag("trie: lpm mismatch for '%s'", lpm_cases[i].key);
+			passed = false;
+		}
+	}
+	trie_del(nested, "", 0, NULL);
+	passed = passed && trie_get_lpm(nested, "net", 3, NULL) == NULL;
+	trie_free(nested);
+	ok(passed, "trie: longest prefix match for nested keys");
+
 	/* Sorted iteration. */
 	char key_buf[KEY_MAXLEN] = {'\0'};
 	size_t iterated = 0;
@@ -192,6 +264,182 @@ int main(int argc, char *argv[])
 	is_int(inserted, iterated, "trie: sorted iteration");
 	trie_it_free(it);
 
+	/* Iterator clone continues from the same element. */
+	it = trie_it_begin(trie);
+	for (size_t i = 0; i < inserted / 2; ++i) {
+		trie_it_next(it);
+	}
+	trie_it_t *clone = trie_it_clone(it);
+	passed = (clone != NULL);
+	size_t rest = 0;
+	while (passed && !trie_it_finished(it)) {
+		passed = !trie_it_finished(clone) &&
+		         trie_it_val(it) == trie_it_val(clone);
+		trie_it_next(it);
+		trie_it_next(clone);
+		++rest;
+	}
+	passed = passed && trie_it_finished(clone) && rest == inserted - inserted / 2;
+	trie_it_free(clone);
+	trie_it_free(it);
+	ok(passed, "trie: iterator clone");
+
+	/* Copy-on-write clone. */
+	trie_t *cow = trie_cow(trie);
+	ok(cow != NULL && trie_weight(cow) == inserted, "trie: cow clone");
+
+	/* Modify the clone: delete every other key, redirect the rest. */
+	passed = true;
+	size_t cow_weight = inserted;
+	for (unsigned i = 0; i < key_count; ++i) {
+		const char *key = keys[i];
+		uint32_t len = strlen(key) + 1;
+		if (i % 2 == 0) {
+			if (trie_del(cow, key, len, NULL) == KNOT_EOK) {
+				--cow_weight;
+			}
+		} else {
+			val = trie_get_cow(cow, key, len);
+			if (val == NULL) {
+				passed = false;
+				break;
+			}
+			*val = NULL;
+		}
+	}
+	val = trie_get_ins(cow, "cow", 4);
+	passed = passed && val != NULL && *val == NULL;
+	*val = "cow";
+	ok(passed && trie_weight(cow) == cow_weight + 1, "trie: cow modification");
+
+	/* The original must stay intact. */
+	passed = trie_weight(trie) == inserted && trie_get_try(trie, "cow", 4) == NULL;
+	for (unsigned i = 0; passed && i < key_count; ++i) {
+		val = trie_get_try(trie, keys[i], strlen(keys[i]) + 1);
+		passed = (val != NULL && strcmp(*val, keys[i]) == 0);
+	}
+	ok(passed, "trie: cow original unchanged");
+
+	/* The clone must survive the original. */
+	trie_free(trie);
+	trie = cow;
+	passed = true;
+	for (unsigned i = 0; passed && i < key_count; ++i) {
+		val = trie_get_try(trie, keys[i], strlen(keys[i]) + 1);
+		if (i % 2 == 0 && (i == 0 || strcmp(keys[i], keys[i - 1]) != 0)) {
+			passed = (val == NULL);
+		} else if (i % 2 == 1) {
+			passed = (val != NULL && *val == NULL);
+		}
+	}
+	val = trie_get_try(trie, "cow", 4);
+	ok(passed && val != NULL && strcmp(*val, "cow") == 0, "trie: cow clone independent");
+
+	/* Only the paths touched since the clone are unshared. */
+	cow = trie_cow(trie);
+	size_t unshared = 0;
+	trie_apply_unshared(cow, count_val, &unshared);
+	passed = (unshared == 0);
+	val = trie_get_cow(cow, "cow", 4);
+	*val = "touched";
+	unshared = 0;
+	trie_apply_unshared(cow, count_val, &unshared);
+	passed = passed && unshared > 0 && unshared < trie_weight(cow);
+	val = NULL;
+	trie_apply_unshared(cow, find_touched, &val);
+	passed = passed && val != NULL;
+	unshared = 0;
+	trie_apply_unshared(trie, count_val, &unshared);
+	passed = passed && unshared > 0 && unshared < trie_weight(trie);
+	val = trie_get_try(trie, "cow", 4);
+	passed = passed && val != NULL && strcmp(*val, "cow") == 0;
+	ok(passed, "trie: apply unshared");
+	trie_free(cow);
+
+	/* Iteration continues while the visited paths are unshared. */
+	cow = trie_cow(trie);
+	size_t visited = 0;
+	passed = true;
+	it = trie_it_begin(cow);
+	while (it != NULL && !trie_it_finished(it)) {
+		size_t len = 0;
+		const char *key = trie_it_key(it, &len);
+		passed = passed && trie_get_cow(cow, key, len) != NULL;
+		++visited;
+		trie_it_next(it);
+	}
+	trie_it_free(it);
+	ok(passed && visited == trie_weight(cow), "trie: iteration with unsharing");
+	trie_free(cow);
+
+	/* Prefix iteration. */
+	passed = true;
+	for (size_t plen = 0; plen <= 3; ++plen) {
+		const char *prefix = keys[key_count / 2];
+		size_t expected = (strncmp("cow", prefix, plen) == 0) ? 1 : 0;
+		for (unsigned i = 0; i < key_count; ++i) {
+			if (strncmp(keys[i], prefix, plen) == 0 &&
+			    (i == 0 || strcmp(keys[i - 1], keys[i]) != 0) &&
+			    trie_get_try(trie, keys[i], strlen(keys[i]) + 1) != NULL) {
+				++expected;
+			}
+		}
+		size_t found = 0;
+		it = trie_it_begin_prefix(trie, prefix, plen);
+		while (it != NULL && !trie_it_finished(it)) {
+			size_t len = 0;
+			const char *key = trie_it_key(it, &len);
+			if (len < plen || memcmp(key, prefix, plen) != 0) {
+				break;
+			}
+			++found;
+			trie_it_next(it);
+		}
+		trie_it_free(it);
+		passed = passed && found == expected;
+	}
+	it = trie_it_begin_prefix(trie, "z", 1);
+	passed = passed && it != NULL && trie_it_finished(it);
+	trie_it_free(it);
+	ok(passed, "trie: prefix iteration");
+
+	/* Iteration from lesser or equal. */
+	passed = true;
+	for (unsigned i = 0; i < key_count && passed; ++i) {
+		char key_buf[KEY_MAXLEN];
+		size_t key_len = strlen(keys[i]) + 1;
+		memcpy(key_buf, keys[i], key_len);
+		key_buf[key_len - 2] -= (i % 2); /* Before or equal to the key. */
+
+		trie_val_t *val = NULL;
+		int ret = trie_get_leq(trie, key_buf, key_len, &val);
+		it = trie_it_begin_leq(trie, key_buf, key_len);
+		if (it == NULL || (ret == KNOT_ENOENT) != trie_it_finished(it) ||
+		    (val != NULL && *trie_it_val(it) != *val)) {
+			passed = false;
+		} else if (val != NULL) {
+			/* The next key follows the searched one. */
+			size_t len = 0;
+			trie_it_next(it);
+			passed = trie_it_finished(it) ||
+			         strcmp(trie_it_key(it, &len), key_buf) > 0;
+		}
+		trie_it_free(it);
+	}
+	ok(passed, "trie: iteration from lesser or equal");
+
+	/* The highest bytes follow all the keys. */
+	trie_val_t last = NULL;
+	it = trie_it_begin(trie);
+	for (; !trie_it_finished(it); trie_it_next(it)) {
+		last = *trie_it_val(it);
+	}
+	trie_it_free(it);
+	char high[KEY_MAXLEN];
+	memset(high, 0xff, sizeof(high));
+	int ret = trie_get_leq(trie, high, sizeof(high), &val);
+	ok(ret == 1 && *val == last, "trie: lesser or equal for high bytes");
+
 	/* Cleanup */
 	for (unsigned i = 0; i < key_count; ++i) {
 		free(keys[i]);
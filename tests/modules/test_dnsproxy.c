@@ -0,0 +1,321 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <tap/basic.h>
+#include <unistd.h>
+
+#include "libknot/libknot.h"
+#include "contrib/net.h"
+#include "contrib/sockaddr.h"
+#include "contrib/wire.h"
+#include "knot/modules/dnsproxy/upstream.h"
+
+#define QUERIES 16
+#define TIMEOUT_MS 200
+
+/*! \brief Fake upstream server. */
+typedef struct {
+	int fd;
+	bool tcp;
+	int count;                  /*!< Number of queries to answer. */
+	uint16_t ids[QUERIES];      /*!< Received message IDs. */
+	pthread_t thread;
+} server_t;
+
+/*! \brief Collected completions. */
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int done;
+	int ret[QUERIES];
+	uint16_t id[QUERIES];
+	size_t len[QUERIES];
+} result_t;
+
+typedef struct {
+	result_t *res;
+	int idx;
+} query_t;
+
+static const uint8_t QUESTION[] = {
+	0x07, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0x00, /* example. */
+	0x00, 0x01, 0x00, 0x01                         /* A IN */
+};
+
+static size_t make_query(uint8_t *wire, uint16_t id)
+{
+	memset(wire, 0, KNOT_WIRE_HEADER_SIZE);
+	knot_wire_set_id(wire, id);
+	knot_wire_set_qdcount(wire, 1);
+	memcpy(wire + KNOT_WIRE_HEADER_SIZE, QUESTION, sizeof(QUESTION));
+
+	return KNOT_WIRE_HEADER_SIZE + sizeof(QUESTION);
+}
+
+/*! \brief Read a query, TCP connections are blocking. */
+static ssize_t server_recv(server_t *srv, int fd, uint8_t *buf,
+                           struct sockaddr_storage *from, socklen_t *from_len)
+{
+	if (!srv->tcp) {
+		return recvfrom(fd, buf, KNOT_WIRE_MAX_PKTSIZE, 0,
+		                (struct sockaddr *)from, from_len);
+	}
+
+	uint8_t frame[sizeof(uint16_t)];
+	if (recv(fd, frame, sizeof(frame), MSG_WAITALL) != sizeof(frame)) {
+		return -1;
+	}
+	size_t len = wire_read_u16(frame);
+	if (recv(fd, buf, len, MSG_WAITALL) != len) {
+		return -1;
+	}
+
+	return len;
+}
+
+static void *server_run(void *arg)
+{
+	server_t *srv = arg;
+	uint8_t buf[KNOT_WIRE_MAX_PKTSIZE];
+
+	/* The upstream spreads TCP queries over several connections. */
+	struct pollfd pfd[1 + UPSTREAM_TCP_CONNS] = {
+		{ .fd = srv->fd, .events = POLLIN }
+	};
+	nfds_t nfds = 1;
+
+	int answered = 0;
+	while (answered < srv->count && poll(pfd, nfds, -1) > 0) {
+		for (nfds_t i = 0; i < nfds; i++) {
+			if (!(pfd[i].revents & (POLLIN | POLLHUP))) {
+				continue;
+			}
+			if (srv->tcp && i == 0) {
+				int fd = accept(srv->fd, NULL, NULL);
+				if (fd >= 0 && nfds < 1 + UPSTREAM_TCP_CONNS) {
+					pfd[nfds++] = (struct pollfd) { .fd = fd, .events = POLLIN };
+				}
+				continue;
+			}
+
+			struct sockaddr_storage from;
+			socklen_t from_len = sizeof(from);
+			ssize_t len = server_recv(srv, pfd[i].fd, buf, &from, &from_len);
+			if (len < KNOT_WIRE_HEADER_SIZE) {
+				pfd[i].events = 0;
+				continue;
+			}
+
+			srv->ids[answered++] = knot_wire_get_id(buf);
+			knot_wire_set_qr(buf);
+
+			if (srv->tcp) {
+				uint8_t frame[sizeof(uint16_t)];
+				wire_write_u16(frame, len);
+				(void)send(pfd[i].fd, frame, sizeof(frame), 0);
+				(void)send(pfd[i].fd, buf, len, 0);
+			} else {
+				(void)sendto(pfd[i].fd, buf, len, 0,
+				             (struct sockaddr *)&from, from_len);
+			}
+		}
+	}
+
+	for (nfds_t i = 1; i < nfds; i++) {
+		close(pfd[i].fd);
+	}
+
+	return NULL;
+}
+
+static int server_start(server_t *srv, bool tcp, int count,
+                        struct sockaddr_storage *addr)
+{
+	memset(srv, 0, sizeof(*srv));
+	srv->tcp = tcp;
+	srv->count = count;
+
+	sockaddr_set(addr, AF_INET, "127.0.0.1", 0);
+	srv->fd = net_bound_socket(tcp ? SOCK_STREAM : SOCK_DGRAM,
+	                           (struct sockaddr *)addr, 0);
+	if (srv->fd < 0) {
+		return srv->fd;
+	}
+	if (tcp && listen(srv->fd, UPSTREAM_TCP_CONNS) != 0) {
+		return KNOT_ERROR;
+	}
+
+	/* The bound socket is non-blocking. */
+	int flags = fcntl(srv->fd, F_GETFL);
+	(void)fcntl(srv->fd, F_SETFL, flags & ~O_NONBLOCK);
+
+	socklen_t addr_len = sizeof(*addr);
+	(void)getsockname(srv->fd, (struct sockaddr *)addr, &addr_len);
+
+	if (count > 0 && pthread_create(&srv->thread, NULL, server_run, srv) != 0) {
+		return KNOT_ERROR;
+	}
+
+	return KNOT_EOK;
+}
+
+static void server_stop(server_t *srv)
+{
+	if (srv->count > 0) {
+		pthread_join(srv->thread, NULL);
+	}
+	close(srv->fd);
+}
+
+static void query_done(int ret, const uint8_t *answer, size_t answer_len, void *data)
+{
+	query_t *q = data;
+	result_t *res = q->res;
+
+	pthread_mutex_lock(&res->lock);
+	res->ret[q->idx] = ret;
+	res->len[q->idx] = answer_len;
+	if (answer != NULL) {
+		res->id[q->idx] = knot_wire_get_id(answer);
+	}
+	res->done += 1;
+	pthread_cond_signal(&res->cond);
+	pthread_mutex_unlock(&res->lock);
+}
+
+static void result_wait(result_t *res, int count)
+{
+	pthread_mutex_lock(&res->lock);
+	while (res->done < count) {
+		pthread_cond_wait(&res->cond, &res->lock);
+	}
+	pthread_mutex_unlock(&res->lock);
+}
+
+static void test_forward(bool tcp)
+{
+	const char *proto = tcp ? "TCP" : "UDP";
+
+	server_t srv;
+	struct sockaddr_storage remote, via = { AF_UNSPEC };
+	int ret = server_start(&srv, tcp, QUERIES, &remote);
+	ok(ret == KNOT_EOK, "%s: start fake upstream", proto);
+
+	upstream_t *up = upstream_new(&remote, &via, 5000);
+	ok(up != NULL, "%s: create upstream", proto);
+
+	result_t res = { .lock = PTHREAD_MUTEX_INITIALIZER,
+	                 .cond = PTHREAD_COND_INITIALIZER };
+	query_t q[QUERIES];
+	bool accepted = true;
+	for (int i = 0; i < QUERIES; i++) {
+		uint8_t wire[KNOT_WIRE_MAX_PKTSIZE];
+		size_t len = make_query(wire, 1000 + i);
+		q[i] = (query_t) { &res, i };
+		if (upstream_send(up, wire, len, tcp, query_done, &q[i]) != KNOT_EOK) {
+			accepted = false;
+		}
+	}
+	ok(accepted, "%s: queries accepted", proto);
+
+	result_wait(&res, QUERIES);
+	server_stop(&srv);
+
+	bool answered = true;
+	for (int i = 0; i < QUERIES; i++) {
+		if (res.ret[i] != KNOT_EOK || res.id[i] != 1000 + i ||
+		    res.len[i] != KNOT_WIRE_HEADER_SIZE + sizeof(QUESTION)) {
+			answered = false;
+		}
+	}
+	ok(answered, "%s: answers delivered with the client IDs", proto);
+
+	int sequential = 0;
+	for (int i = 1; i < QUERIES; i++) {
+		if (srv.ids[i] == (uint16_t)(srv.ids[i - 1] + 1)) {
+			sequential += 1;
+		}
+	}
+	ok(sequential < QUERIES / 2, "%s: upstream IDs are not sequential", proto);
+
+	upstream_free(up);
+}
+
+static void test_timeout(void)
+{
+	server_t srv;
+	struct sockaddr_storage remote, via = { AF_UNSPEC };
+	int ret = server_start(&srv, false, 0, &remote);
+	ok(ret == KNOT_EOK, "timeout: start silent upstream");
+
+	upstream_t *up = upstream_new(&remote, &via, TIMEOUT_MS);
+	ok(up != NULL, "timeout: create upstream");
+
+	result_t res = { .lock = PTHREAD_MUTEX_INITIALIZER,
+	                 .cond = PTHREAD_COND_INITIALIZER };
+	query_t q = { &res, 0 };
+	uint8_t wire[KNOT_WIRE_MAX_PKTSIZE];
+	size_t len = make_query(wire, 1);
+	ret = upstream_send(up, wire, len, false, query_done, &q);
+	ok(ret == KNOT_EOK, "timeout: query accepted");
+
+	result_wait(&res, 1);
+	ok(res.ret[0] == KNOT_ETIMEOUT && res.len[0] == 0,
+	   "timeout: query failed with timeout");
+
+	/* Unfinished queries are completed on free. */
+	q.idx = 1;
+	ret = upstream_send(up, wire, len, false, query_done, &q);
+	ok(ret == KNOT_EOK, "free: query accepted");
+	upstream_free(up);
+	ok(res.done == 2 && res.ret[1] != KNOT_EOK, "free: pending query failed");
+
+	server_stop(&srv);
+}
+
+static void test_malformed(void)
+{
+	struct sockaddr_storage remote, via = { AF_UNSPEC };
+	sockaddr_set(&remote, AF_INET, "127.0.0.1", 53);
+	upstream_t *up = upstream_new(&remote, &via, TIMEOUT_MS);
+
+	uint8_t wire[KNOT_WIRE_MAX_PKTSIZE];
+	size_t len = make_query(wire, 1);
+	knot_wire_set_qdcount(wire, 0);
+	int ret = upstream_send(up, wire, len, false, query_done, NULL);
+	ok(ret != KNOT_EOK, "malformed: query without question refused");
+
+	ret = upstream_send(up, wire, KNOT_WIRE_HEADER_SIZE - 1, false, query_done, NULL);
+	ok(ret != KNOT_EOK, "malformed: truncated query refused");
+
+	upstream_free(up);
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	test_forward(false);
+	test_forward(true);
+	test_timeout();
+	test_malformed();
+
+	return 0;
+}
@@ -18,7 +18,9 @@
 #include <assert.h>
 
 #include "knot/modules/onlinesign/nsec_next.h"
+#include "knot/modules/onlinesign/rrsig_cache.h"
 #include "libknot/consts.h"
+#include "libknot/descriptor.h"
 #include "libknot/dname.h"
 #include "libknot/errcode.h"
 
@@ -57,10 +59,55 @@ static void _test_nsec_next(const char *msg,
 	_test_nsec_next(msg, input, apex, expected); \
 }
 
+static void test_rrsig_cache(void)
+{
+	const knot_dname_t *owner = (const knot_dname_t *)"\x03""www""\x07""example""\x03""com";
+	const uint8_t addr[4] = { 192, 0, 2, 1 };
+	const uint8_t other_addr[4] = { 192, 0, 2, 2 };
+	const uint8_t sig[] = "fake signature";
+
+	knot_rrset_t *cover = knot_rrset_new(owner, KNOT_RRTYPE_A, KNOT_CLASS_IN, 3600, NULL);
+	knot_rrset_t *other = knot_rrset_new(owner, KNOT_RRTYPE_A, KNOT_CLASS_IN, 3600, NULL);
+	knot_rrset_t *rrsig = knot_rrset_new(owner, KNOT_RRTYPE_RRSIG, KNOT_CLASS_IN, 3600, NULL);
+	assert(cover && other && rrsig);
+	knot_rrset_add_rdata(cover, addr, sizeof(addr), NULL);
+	knot_rrset_add_rdata(other, other_addr, sizeof(other_addr), NULL);
+	knot_rrset_add_rdata(rrsig, sig, sizeof(sig), NULL);
+
+	ok(rrsig_cache_new(0) == NULL, "rrsig_cache, disabled");
+
+	rrsig_cache_t *cache = rrsig_cache_new(16);
+	ok(cache != NULL, "rrsig_cache, create");
+
+	rrsig_cache_key_t key, other_key;
+	rrsig_cache_key_init(cache, &key, owner, cover, 1234);
+	rrsig_cache_key_init(cache, &other_key, owner, other, 1234);
+	ok(key.hash != other_key.hash, "rrsig_cache, RDATA affects key");
+
+	knot_rrset_t *out = knot_rrset_new(owner, KNOT_RRTYPE_RRSIG, KNOT_CLASS_IN, 3600, NULL);
+	ok(!rrsig_cache_get(cache, &key, 100, out, NULL), "rrsig_cache, miss");
+
+	is_int(KNOT_EOK, rrsig_cache_put(cache, &key, rrsig, 200), "rrsig_cache, put");
+	ok(rrsig_cache_get(cache, &key, 100, out, NULL) &&
+	   knot_rdataset_eq(&out->rrs, &rrsig->rrs), "rrsig_cache, hit");
+	ok(!rrsig_cache_get(cache, &other_key, 100, out, NULL), "rrsig_cache, other RDATA");
+	rrsig_cache_key_init(cache, &other_key, owner, cover, 4321);
+	ok(!rrsig_cache_get(cache, &other_key, 100, out, NULL), "rrsig_cache, other key tag");
+	ok(!rrsig_cache_get(cache, &key, 200, out, NULL), "rrsig_cache, reuse time passed");
+
+	rrsig_cache_free(cache);
+	knot_rrset_free(&out, NULL);
+	knot_rrset_free(&rrsig, NULL);
+	knot_rrset_free(&other, NULL);
+	knot_rrset_free(&cover, NULL);
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
 
+	test_rrsig_cache();
+
 	// adding a single zero-byte label
 
 	test_nsec_next(
@@ -14,6 +14,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <pthread.h>
 #include <tap/basic.h>
 
 #include "dnssec/crypto.h"
@@ -26,25 +27,13 @@
 //#define ENABLE_TIMED_TESTS
 #define RRL_SIZE 196613
 #define RRL_THREADS 8
-#define RRL_INSERTS (RRL_SIZE/(5*RRL_THREADS)) /* lf = 1/5 */
-#define RRL_LOCKS 64
-
-/* Disabled as default as it depends on random input.
- * Table may be consistent even if some collision occur (and they may occur).
- * Note: Disabled due to reported problems when running on VMs due to time
- * flow inconsistencies. Should work alright on a host machine.
- */
-#ifdef ENABLE_TIMED_TESTS
-struct bucketmap {
-	unsigned i;
-	uint64_t x;
-};
 
 /*! \brief Unit runnable. */
 struct runnable_data {
 	int passed;
+	uint32_t rate;
 	rrl_table_t *rrl;
-	struct sockaddr_storage *addr;
+	struct sockaddr_storage addr;
 	rrl_req_t *rq;
 	knot_dname_t *zone;
 };
@@ -52,47 +41,39 @@ struct runnable_data {
 static void* rrl_runnable(void *arg)
 {
 	struct runnable_data *d = (struct runnable_data *)arg;
-	struct sockaddr_storage addr;
-	memcpy(&addr, d->addr, sizeof(struct sockaddr_storage));
-	int lock = -1;
-	uint32_t now = time(NULL);
-	struct bucketmap *m = malloc(RRL_INSERTS * sizeof(struct bucketmap));
-	for (unsigned i = 0; i < RRL_INSERTS; ++i) {
-		m[i].i = dnssec_random_uint32_t();
-		((struct sockaddr_in *) &addr)->sin_addr.s_addr = m[i].i;
-		rrl_item_t *b = rrl_hash(d->rrl, &addr, d->rq, d->zone, now, &lock);
-		rrl_unlock(d->rrl, lock);
-		m[i].x = b->netblk;
-	}
-	for (unsigned i = 0; i < RRL_INSERTS; ++i) {
-		((struct sockaddr_in *) &addr)->sin_addr.s_addr = m[i].i;
-		rrl_item_t *b = rrl_hash(d->rrl, &addr, d->rq, d->zone, now, &lock);
-		rrl_unlock(d->rrl, lock);
-		if (b->netblk != m[i].x) {
+	for (unsigned i = 0; i < d->rate * RRL_CAPACITY; ++i) {
+		if (rrl_query(d->rrl, &d->addr, d->rq, d->zone, NULL) != KNOT_EOK) {
 			d->passed = 0;
 		}
 	}
-	free(m);
 	return NULL;
 }
 
-static void rrl_hopscotch(struct runnable_data* rd)
+static bool rrl_concurrent(rrl_table_t *rrl, uint32_t rate, rrl_req_t *rq,
+                           knot_dname_t *zone)
 {
-	rd->passed = 1;
 	pthread_t thr[RRL_THREADS];
+	struct runnable_data rd[RRL_THREADS];
 	for (unsigned i = 0; i < RRL_THREADS; ++i) {
-		pthread_create(thr + i, NULL, &rrl_runnable, rd);
+		rd[i] = (struct runnable_data) { 1, rate, rrl, { 0 }, rq, zone };
+		char addr_str[SOCKADDR_STRLEN];
+		(void)snprintf(addr_str, sizeof(addr_str), "10.0.%u.1", i);
+		sockaddr_set(&rd[i].addr, AF_INET, addr_str, 0);
+		pthread_create(thr + i, NULL, &rrl_runnable, rd + i);
 	}
+
+	bool passed = true;
 	for (unsigned i = 0; i < RRL_THREADS; ++i) {
 		pthread_join(thr[i], NULL);
+		passed = passed && rd[i].passed;
 	}
+	return passed;
 }
-#endif
 
 int main(int argc, char *argv[])
 {
 #ifdef ENABLE_TIMED_TESTS
-	plan(10);
+	plan(9);
 #else
 	plan(5);
 #endif
@@ -134,11 +115,7 @@ int main(int argc, char *argv[])
 	rrl_setrate(rrl, rate);
 	is_int(rate, rrl_rate(rrl), "rrl: setrate");
 
-	/* 3. setlocks */
-	ret = rrl_setlocks(rrl, RRL_LOCKS);
-	is_int(KNOT_EOK, ret, "rrl: setlocks");
-
-	/* 4. N unlimited requests. */
+	/* 3. N unlimited requests. */
 	knot_dname_t *zone = knot_dname_from_str_alloc("rrl.");
 
 	struct sockaddr_storage addr;
@@ -156,41 +133,35 @@ int main(int argc, char *argv[])
 	is_int(0, ret, "rrl: unlimited IPv4/v6 requests");
 
 #ifdef ENABLE_TIMED_TESTS
-	/* 5. limited request */
+	/* 4. limited request */
 	ret = rrl_query(rrl, &addr, &rq, zone, NULL);
 	is_int(KNOT_ELIMIT, ret, "rrl: throttled IPv4 request");
 
-	/* 6. limited IPv6 request */
+	/* 5. limited IPv6 request */
 	ret = rrl_query(rrl, &addr6, &rq, zone, NULL);
 	is_int(KNOT_ELIMIT, ret, "rrl: throttled IPv6 request");
 #endif
 
-	/* 7. invalid values. */
+	/* 6. invalid values. */
 	ret = 0;
 	rrl_create(0);            // NULL
 	ret += rrl_setrate(0, 0); // 0
 	ret += rrl_rate(0);       // 0
-	ret += rrl_setlocks(0,0); // -1
 	ret += rrl_query(0, 0, 0, 0, NULL); // -1
 	ret += rrl_query(rrl, 0, 0, 0, NULL); // -1
 	ret += rrl_query(rrl, (void*)0x1, 0, 0, NULL); // -1
 	ret += rrl_destroy(0); // -1
-	is_int(-88, ret, "rrl: not crashed while executing functions on NULL context");
+	is_int(-66, ret, "rrl: not crashed while executing functions on NULL context");
+
+	/* 7. concurrent flows */
+	ok(rrl_concurrent(rrl, rate, &rq, zone), "rrl: unlimited concurrent flows");
 
 #ifdef ENABLE_TIMED_TESTS
-	/* 8. hopscotch test */
-	struct runnable_data rd = {
-		1, rrl, &addr, &rq, zone
-	};
-	rrl_hopscotch(&rd);
-	ok(rd.passed, "rrl: hashtable is ~ consistent");
-
-	/* 9. reseed */
+	/* 8. reseed */
 	is_int(0, rrl_reseed(rrl), "rrl: reseed");
 
-	/* 10. hopscotch after reseed. */
-	rrl_hopscotch(&rd);
-	ok(rd.passed, "rrl: hashtable is ~ consistent");
+	/* 9. concurrent flows after reseed. */
+	ok(rrl_concurrent(rrl, rate, &rq, zone), "rrl: unlimited concurrent flows");
 #endif
 
 	knot_dname_free(&zone, NULL);
@@ -14,6 +14,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <tap/basic.h>
@@ -182,6 +183,47 @@ static void test_acl_allowed(void)
 	ret = acl_allowed(conf(), &acl, ACL_ACTION_TRANSFER, &addr, &key0);
 	ok(ret == true, "IPv6 address from range, no key, action match");
 
+	/* Compiled configuration must give the same results. */
+	ret = conf_snapshot_build(conf());
+	is_int(KNOT_EOK, ret, "Compile zone configuration");
+	const conf_snap_zone_t *snap = conf_snapshot_zone(conf(), zone_name);
+	ok(snap != NULL && snap->acl_count == 6, "Get compiled zone ACL");
+
+	const struct {
+		int family;
+		const char *addr;
+		acl_action_t action;
+		knot_tsig_key_t *key;
+	} cases[] = {
+		{ AF_INET6, "2001::1",   ACL_ACTION_NONE,     &key1 },
+		{ AF_INET6, "2001::1",   ACL_ACTION_TRANSFER, &key1 },
+		{ AF_INET6, "2001::2",   ACL_ACTION_TRANSFER, &key1 },
+		{ AF_INET6, "2001::1",   ACL_ACTION_TRANSFER, &key0 },
+		{ AF_INET6, "2001::1",   ACL_ACTION_TRANSFER, &key2 },
+		{ AF_INET6, "2001::1",   ACL_ACTION_NOTIFY,   &key1 },
+		{ AF_INET,  "240.0.0.1", ACL_ACTION_NOTIFY,   &key0 },
+		{ AF_INET,  "240.0.0.1", ACL_ACTION_NOTIFY,   &key1 },
+		{ AF_INET,  "240.0.0.2", ACL_ACTION_NOTIFY,   &key0 },
+		{ AF_INET,  "240.0.0.2", ACL_ACTION_UPDATE,   &key0 },
+		{ AF_INET,  "240.0.0.3", ACL_ACTION_UPDATE,   &key0 },
+		{ AF_INET,  "1.1.1.1",   ACL_ACTION_UPDATE,   &key3 },
+		{ AF_INET,  "100.0.0.1", ACL_ACTION_TRANSFER, &key0 },
+		{ AF_INET6, "::1",       ACL_ACTION_TRANSFER, &key0 },
+	};
+
+	for (size_t i = 0; snap != NULL && i < sizeof(cases) / sizeof(*cases); i++) {
+		check_sockaddr_set(&addr, cases[i].family, cases[i].addr, 0);
+		knot_tsig_key_t tsig1 = *cases[i].key, tsig2 = *cases[i].key;
+		acl = conf_zone_get(conf(), C_ACL, zone_name);
+		bool exp = acl_allowed(conf(), &acl, cases[i].action, &addr, &tsig1);
+		bool res = acl_allowed_snap(snap->acl, snap->acl_count,
+		                            cases[i].action, &addr, &tsig2);
+		ok(exp == res && tsig1.secret.size == tsig2.secret.size &&
+		   (tsig1.secret.size == 0 ||
+		    memcmp(tsig1.secret.data, tsig2.secret.data, tsig1.secret.size) == 0),
+		   "Compiled ACL, case %zu", i);
+	}
+
 	conf_free(conf());
 	knot_dname_free(&zone_name, NULL);
 	knot_dname_free(&key1_name, NULL);
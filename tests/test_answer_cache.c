@@ -0,0 +1,94 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <tap/basic.h>
+
+#include "libknot/libknot.h"
+#include "knot/zone/answer-cache.h"
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	uint8_t wire[ANSWER_CACHE_MAX_WIRE + 1];
+	uint8_t out[ANSWER_CACHE_MAX_WIRE];
+	size_t out_len = 0;
+	for (size_t i = 0; i < sizeof(wire); i++) {
+		wire[i] = i;
+	}
+
+	ok(answer_cache_new(0) == NULL, "answer cache: disabled");
+
+	answer_cache_t *cache = answer_cache_new(2);
+	ok(cache != NULL, "answer cache: create");
+
+	answer_cache_key_t key = {
+		.qname = (const knot_dname_t *)"\x03""www""\x07""example""\x03""com",
+		.qtype = KNOT_RRTYPE_A,
+		.max_size = 512,
+		.flags = ANSWER_CACHE_EDNS
+	};
+
+	/* Empty cache. */
+	ok(!answer_cache_get(cache, &key, out, &out_len), "answer cache: miss");
+
+	/* Store and retrieve. */
+	int ret = answer_cache_put(cache, &key, wire, 100);
+	is_int(KNOT_EOK, ret, "answer cache: put");
+	ok(answer_cache_get(cache, &key, out, &out_len) && out_len == 100 &&
+	   memcmp(out, wire, out_len) == 0, "answer cache: hit");
+	ret = answer_cache_put(cache, &key, wire, 50);
+	is_int(KNOT_EEXIST, ret, "answer cache: put existing");
+
+	/* Key mismatches. */
+	answer_cache_key_t other = key;
+	other.qtype = KNOT_RRTYPE_AAAA;
+	ok(!answer_cache_get(cache, &other, out, &out_len), "answer cache: other qtype");
+	other = key;
+	other.max_size = 1232;
+	ok(!answer_cache_get(cache, &other, out, &out_len), "answer cache: other size");
+	other = key;
+	other.flags |= ANSWER_CACHE_DO;
+	ok(!answer_cache_get(cache, &other, out, &out_len), "answer cache: other flags");
+	other = key;
+	other.qname = (const knot_dname_t *)"\x03""ftp""\x07""example""\x03""com";
+	ok(!answer_cache_get(cache, &other, out, &out_len), "answer cache: other qname");
+
+	/* Size limits. */
+	other.max_size = UINT16_MAX;
+	ret = answer_cache_put(cache, &other, wire, ANSWER_CACHE_MAX_WIRE + 1);
+	is_int(KNOT_ESPACE, ret, "answer cache: too large answer");
+	other.max_size = 100;
+	ret = answer_cache_put(cache, &other, wire, 101);
+	is_int(KNOT_ESPACE, ret, "answer cache: answer over max size");
+
+	/* Fill up the cache. */
+	other = key;
+	other.qtype = KNOT_RRTYPE_MX;
+	ret = answer_cache_put(cache, &other, wire, 10);
+	is_int(KNOT_EOK, ret, "answer cache: put second");
+	other.qtype = KNOT_RRTYPE_TXT;
+	ret = answer_cache_put(cache, &other, wire, 10);
+	is_int(KNOT_ESPACE, ret, "answer cache: full");
+	ok(answer_cache_get(cache, &key, out, &out_len) && out_len == 100,
+	   "answer cache: hit after full");
+
+	answer_cache_free(cache);
+	answer_cache_free(NULL);
+
+	return 0;
+}
@@ -0,0 +1,259 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <poll.h>
+#include <tap/basic.h>
+#include <tap/files.h>
+#include <unistd.h>
+
+#include "test_conf.h"
+#include "contrib/net.h"
+#include "contrib/sockaddr.h"
+#include "knot/nameserver/update.h"
+#include "knot/server/server.h"
+#include "knot/updates/zone-update.h"
+#include "libknot/libknot.h"
+#include "zscanner/scanner.h"
+
+#define BATCH_SIZE 3
+
+static const char *zone_str =
+	"test. 600 IN SOA ns.test. m.test. 1 900 300 4800 900\n"
+	"test. IN TXT \"test\"\n";
+
+static knot_rrset_t rrset;
+
+static void process_rr(zs_scanner_t *scanner)
+{
+	knot_rrset_init(&rrset, scanner->r_owner, scanner->r_type, scanner->r_class,
+	                scanner->r_ttl);
+
+	int ret = knot_rrset_add_rdata(&rrset, scanner->r_data,
+	                               scanner->r_data_length, NULL);
+	(void)ret;
+	assert(ret == KNOT_EOK);
+}
+
+static void parse_rr(zs_scanner_t *sc, const char *str)
+{
+	if (zs_set_input_string(sc, str, strlen(str)) != 0 ||
+	    zs_parse_all(sc) != 0) {
+		assert(0);
+	}
+}
+
+static void load_zone(zone_t *zone, zs_scanner_t *sc)
+{
+	zone_update_t update;
+	int ret = zone_update_init(&update, zone, UPDATE_FULL);
+	assert(ret == KNOT_EOK);
+
+	const char *line = zone_str;
+	while (*line != '\0') {
+		const char *end = strchr(line, '\n') + 1;
+		char buf[128] = { 0 };
+		memcpy(buf, line, end - line);
+		parse_rr(sc, buf);
+		ret = zone_update_add(&update, &rrset);
+		assert(ret == KNOT_EOK);
+		knot_rdataset_clear(&rrset.rrs, NULL);
+		line = end;
+	}
+
+	ret = zone_update_commit(conf(), &update);
+	assert(ret == KNOT_EOK);
+	(void)ret;
+}
+
+/*! \brief Enqueues an UPDATE with the given records, deletions start with '-'. */
+static void enqueue_update(zone_t *zone, zs_scanner_t *sc, uint16_t id,
+                           const char *rrs[], knotd_qdata_params_t *params)
+{
+	knot_pkt_t *pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	assert(pkt);
+	knot_wire_set_id(pkt->wire, id);
+	knot_wire_set_opcode(pkt->wire, KNOT_OPCODE_UPDATE);
+	int ret = knot_pkt_put_question(pkt, zone->name, KNOT_CLASS_IN, KNOT_RRTYPE_SOA);
+	assert(ret == KNOT_EOK);
+	ret = knot_pkt_begin(pkt, KNOT_AUTHORITY);
+	assert(ret == KNOT_EOK);
+
+	for (const char **rr = rrs; *rr != NULL; rr++) {
+		bool removal = (**rr == '-');
+		parse_rr(sc, *rr + removal);
+		if (removal) {
+			rrset.rclass = KNOT_CLASS_NONE;
+			rrset.ttl = 0;
+		}
+		ret = knot_pkt_put(pkt, KNOT_COMPR_HINT_NONE, &rrset, 0);
+		assert(ret == KNOT_EOK);
+		knot_rdataset_clear(&rrset.rrs, NULL);
+	}
+
+	knot_pkt_t *query = knot_pkt_new(pkt->wire, pkt->size, NULL);
+	ret = knot_pkt_parse(query, 0);
+	assert(ret == KNOT_EOK);
+
+	ret = zone_update_enqueue(zone, query, params);
+	assert(ret == KNOT_EOK);
+	(void)ret;
+
+	knot_pkt_free(&query);
+	knot_pkt_free(&pkt);
+}
+
+static bool zone_has_rr(zone_t *zone, zs_scanner_t *sc, const char *str)
+{
+	parse_rr(sc, str);
+	const zone_node_t *node = zone_contents_find_node(zone->contents, rrset.owner);
+	const knot_rdataset_t *rrs = node_rdataset(node, rrset.type);
+	bool found = rrs != NULL &&
+	             knot_rdataset_member(rrs, knot_rdataset_at(&rrset.rrs, 0));
+	knot_rdataset_clear(&rrset.rrs, NULL);
+
+	return found;
+}
+
+static void test_batch(zone_t *zone, zs_scanner_t *sc)
+{
+	/* Responses are sent from the server socket to the client one. */
+	struct sockaddr_storage server = { 0 };
+	sockaddr_set(&server, AF_INET, "127.0.0.1", 0);
+	int server_fd = net_bound_socket(SOCK_DGRAM, (struct sockaddr *)&server, 0);
+	struct sockaddr_storage client = { 0 };
+	sockaddr_set(&client, AF_INET, "127.0.0.1", 0);
+	int client_fd = net_bound_socket(SOCK_DGRAM, (struct sockaddr *)&client, 0);
+	socklen_t addr_len = sizeof(client);
+	getsockname(client_fd, (struct sockaddr *)&client, &addr_len);
+	ok(server_fd >= 0 && client_fd >= 0, "ddns: bind sockets");
+
+	knotd_qdata_params_t params = {
+		.remote = &client,
+		.socket = server_fd
+	};
+
+	const char *first[] = {
+		"a.test. IN A 192.0.2.1\n",
+		NULL
+	};
+	/* Applies two records before the out-of-zone one fails. */
+	const char *second[] = {
+		"-test. IN TXT \"test\"\n",
+		"b.test. IN A 192.0.2.2\n",
+		"other. IN A 192.0.2.2\n",
+		NULL
+	};
+	const char *third[] = {
+		"c.test. IN A 192.0.2.3\n",
+		"test. IN TXT \"third\"\n",
+		NULL
+	};
+	enqueue_update(zone, sc, 1, first, &params);
+	enqueue_update(zone, sc, 2, second, &params);
+	enqueue_update(zone, sc, 3, third, &params);
+
+	uint32_t serial = zone_contents_serial(zone->contents);
+	updates_execute(conf(), zone);
+
+	uint16_t rcodes[BATCH_SIZE + 1] = { 0 };
+	size_t received = 0;
+	for (int i = 0; i < BATCH_SIZE; i++) {
+		struct pollfd pfd = { .fd = client_fd, .events = POLLIN };
+		if (poll(&pfd, 1, 1000) != 1) {
+			break;
+		}
+		uint8_t wire[KNOT_WIRE_MAX_PKTSIZE];
+		ssize_t len = recv(client_fd, wire, sizeof(wire), 0);
+		if (len < KNOT_WIRE_HEADER_SIZE) {
+			break;
+		}
+		uint16_t id = knot_wire_get_id(wire);
+		if (id >= 1 && id <= BATCH_SIZE) {
+			rcodes[id] = knot_wire_get_rcode(wire);
+			received++;
+		}
+	}
+	is_int(BATCH_SIZE, received, "ddns: all responses sent");
+	is_int(KNOT_RCODE_NOERROR, rcodes[1], "ddns: first update succeeded");
+	is_int(KNOT_RCODE_NOTZONE, rcodes[2], "ddns: failed update has its own rcode");
+	is_int(KNOT_RCODE_NOERROR, rcodes[3], "ddns: last update succeeded");
+
+	ok(zone_contents_serial(zone->contents) != serial, "ddns: batch committed");
+	ok(zone_has_rr(zone, sc, "a.test. IN A 192.0.2.1\n"), "ddns: first update applied");
+	ok(zone_has_rr(zone, sc, "c.test. IN A 192.0.2.3\n") &&
+	   zone_has_rr(zone, sc, "test. IN TXT \"third\"\n"), "ddns: last update applied");
+	ok(!zone_has_rr(zone, sc, "b.test. IN A 192.0.2.2\n"), "ddns: failed addition dropped");
+	ok(zone_has_rr(zone, sc, "test. IN TXT \"test\"\n"), "ddns: failed removal dropped");
+
+	close(client_fd);
+	close(server_fd);
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	char *temp_dir = test_mkdtemp();
+	ok(temp_dir != NULL, "make temporary directory");
+
+	char conf_str[512];
+	snprintf(conf_str, sizeof(conf_str),
+	         "acl:\n"
+	         " - id: update\n"
+	         "   address: 127.0.0.1\n"
+	         "   action: update\n"
+	         "zone:\n"
+	         " - domain: test.\n"
+	         "   acl: update\n"
+	         "   ddns-batch-size: %d\n"
+	         "template:\n"
+	         " - id: default\n"
+	         "   storage: %s\n",
+	         BATCH_SIZE, temp_dir);
+
+	/* Load test configuration. */
+	int ret = test_conf(conf_str, NULL);
+	is_int(KNOT_EOK, ret, "load configuration");
+
+	server_t server;
+	ret = server_init(&server, 1);
+	is_int(KNOT_EOK, ret, "server init");
+
+	knot_dname_t *apex = knot_dname_from_str_alloc("test");
+	assert(apex);
+	zone_t *zone = zone_new(apex);
+	zone->journal_db = &server.journal_db;
+
+	zs_scanner_t sc;
+	if (zs_init(&sc, "test.", KNOT_CLASS_IN, 3600) != 0 ||
+	    zs_set_processing(&sc, process_rr, NULL, NULL) != 0) {
+		assert(0);
+	}
+
+	load_zone(zone, &sc);
+	test_batch(zone, &sc);
+
+	zs_deinit(&sc);
+	zone_free(&zone);
+	server_deinit(&server);
+	knot_dname_free(&apex, NULL);
+	conf_free(conf());
+	test_rm_rf(temp_dir);
+	free(temp_dir);
+
+	return 0;
+}
@@ -0,0 +1,234 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <tap/basic.h>
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "libknot/errcode.h"
+#include "knot/common/evsched.h"
+
+#define EVENTS 500
+#define SPREAD_MS 300
+
+/*!
+ * Event firing log.
+ */
+typedef struct fire_log {
+	pthread_mutex_t mx;
+	pthread_cond_t cond;
+	unsigned count;
+	bool early;	/*!< Some event fired before its time. */
+	bool twice;	/*!< Some event fired more than once. */
+} fire_log_t;
+
+typedef struct {
+	fire_log_t *log;
+	uint64_t due;	/*!< Expected firing time. */
+	unsigned fired;
+} test_event_t;
+
+static uint64_t now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void event_fired(event_t *ev)
+{
+	test_event_t *data = ev->data;
+	fire_log_t *log = data->log;
+
+	pthread_mutex_lock(&log->mx);
+	log->early = log->early || now_ms() < data->due;
+	log->twice = log->twice || data->fired > 0;
+	data->fired += 1;
+	log->count += 1;
+	pthread_cond_broadcast(&log->cond);
+	pthread_mutex_unlock(&log->mx);
+}
+
+/*! Wait till the given number of events fired, give up after the timeout. */
+static unsigned wait_fired(fire_log_t *log, unsigned count, uint64_t timeout)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	uint64_t until = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000 + timeout;
+
+	pthread_mutex_lock(&log->mx);
+	while (log->count < count) {
+		struct timespec ts = { .tv_sec = until / 1000,
+		                       .tv_nsec = (until % 1000) * 1000000L };
+		if (pthread_cond_timedwait(&log->cond, &log->mx, &ts) != 0) {
+			break;
+		}
+	}
+	unsigned fired = log->count;
+	pthread_mutex_unlock(&log->mx);
+
+	return fired;
+}
+
+static event_t *create_event(evsched_t *sched, test_event_t *data,
+                             fire_log_t *log)
+{
+	data->log = log;
+	data->due = 0;
+	data->fired = 0;
+	return evsched_event_create(sched, event_fired, data);
+}
+
+static void schedule_event(event_t *ev, uint32_t dt)
+{
+	test_event_t *data = ev->data;
+	data->due = now_ms() + dt;
+	evsched_schedule(ev, dt);
+}
+
+static void interrupt_handle(int s)
+{
+}
+
+int main(void)
+{
+	plan_lazy();
+
+	struct sigaction sa;
+	sa.sa_handler = interrupt_handle;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	sigaction(SIGALRM, &sa, NULL); // Interrupt
+
+	evsched_t sched;
+	int ret = evsched_init(&sched, NULL);
+	ok(ret == KNOT_EOK, "create scheduler");
+	evsched_start(&sched);
+
+	fire_log_t log = {
+		.mx = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+	};
+
+	// immediate event
+
+	test_event_t single_data;
+	event_t *single = create_event(&sched, &single_data, &log);
+	ok(single != NULL, "create event");
+	schedule_event(single, 0);
+	ok(wait_fired(&log, 1, 1000) == 1 && single_data.fired == 1,
+	   "immediate event fired");
+
+	// many events spread over several wheel levels
+
+	test_event_t *datas = calloc(EVENTS, sizeof(*datas));
+	event_t **events = calloc(EVENTS, sizeof(*events));
+	bool created = (datas != NULL && events != NULL);
+	for (int i = 0; created && i < EVENTS; i++) {
+		events[i] = create_event(&sched, &datas[i], &log);
+		created = (events[i] != NULL);
+	}
+	ok(created, "create events");
+	if (!created) {
+		return 1;
+	}
+
+	pthread_mutex_lock(&log.mx);
+	log.count = 0;
+	pthread_mutex_unlock(&log.mx);
+
+	// First planned far away, then rescheduled, some are canceled.
+	for (int i = 0; i < EVENTS; i++) {
+		schedule_event(events[i], 3600 * 1000 + random() % SPREAD_MS);
+	}
+	for (int i = 0; i < EVENTS; i++) {
+		schedule_event(events[i], SPREAD_MS / 2 + random() % SPREAD_MS);
+	}
+	unsigned canceled = 0;
+	for (int i = 1; i < EVENTS; i += 10) {
+		evsched_cancel(events[i]);
+		canceled++;
+	}
+
+	unsigned expected = EVENTS - canceled;
+	unsigned fired = wait_fired(&log, expected, SPREAD_MS + 1000);
+	ok(fired == expected, "all scheduled events fired");
+
+	bool canceled_fired = false;
+	for (int i = 1; i < EVENTS; i += 10) {
+		canceled_fired = canceled_fired || datas[i].fired > 0;
+	}
+	ok(!canceled_fired, "canceled events not fired");
+	ok(!log.early, "no event fired early");
+	ok(!log.twice, "no event fired twice");
+
+	// rescheduling of a distant event to a closer time
+
+	pthread_mutex_lock(&log.mx);
+	log.count = 0;
+	pthread_mutex_unlock(&log.mx);
+
+	schedule_event(single, 3600 * 1000);
+	schedule_event(events[0], 24 * 3600 * 1000);
+	schedule_event(events[1], 100);
+	ok(wait_fired(&log, 1, 1000) == 1 && datas[1].fired == 1 &&
+	   single_data.fired == 1 && datas[0].fired == 1, "distant events pending");
+
+	single_data.fired = 0;
+	schedule_event(single, 50);
+	ok(wait_fired(&log, 2, 1000) == 2 && single_data.fired == 1,
+	   "rescheduled event fired");
+
+	// clock stepped backwards, as if the wheel was an hour ahead
+
+	pthread_mutex_lock(&log.mx);
+	log.count = 0;
+	pthread_mutex_unlock(&log.mx);
+
+	schedule_event(events[2], 200);
+	pthread_mutex_lock(&sched.lock);
+	sched.wheel_time += 3600 * 1000;
+	pthread_mutex_unlock(&sched.lock);
+	single_data.fired = 0;
+	datas[2].fired = 0;
+	schedule_event(single, 0);
+	ok(wait_fired(&log, 1, 1000) >= 1 && single_data.fired == 1,
+	   "immediate event fired after clock step");
+	ok(wait_fired(&log, 2, 1000) == 2 && datas[2].fired == 1,
+	   "pending event fired after clock step");
+
+	// scheduled events are freed with the scheduler
+
+	evsched_stop(&sched);
+	evsched_join(&sched);
+
+	evsched_event_free(single);
+	for (int i = 1; i < EVENTS; i++) {
+		evsched_event_free(events[i]);
+	}
+	evsched_deinit(&sched);
+
+	free(events);
+	free(datas);
+	pthread_mutex_destroy(&log.mx);
+	pthread_cond_destroy(&log.cond);
+
+	return 0;
+}
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <limits.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <tap/basic.h>
@@ -55,6 +56,20 @@ static void set_conf(int zonefile_sync, size_t journal_usage)
 	assert(ret == KNOT_EOK);
 }
 
+static void set_conf_compression(bool compression)
+{
+	char conf_str[512];
+	snprintf(conf_str, sizeof(conf_str),
+	         "zone:\n"
+	         " - domain: %s\n"
+	         "   zonefile-sync: 1000\n"
+	         "   journal-compression: %s\n",
+	         (const char *)(apex + 1), compression ? "on" : "off");
+	int ret = test_conf(conf_str, NULL);
+	(void)ret;
+	assert(ret == KNOT_EOK);
+}
+
 static void unset_conf(void)
 {
 	conf_update(NULL, CONF_UPD_FNONE);
@@ -246,7 +261,7 @@ static void test_journal_db(void)
 {
 	int ret, ret2 = KNOT_EOK;
 
-	ret = journal_db_init(&db, test_dir_name, 2 * 1024 * 1024, JOURNAL_MODE_ASYNC);
+	ret = journal_db_init(&db, test_dir_name, 2 * 1024 * 1024, JOURNAL_MODE_ASYNC, 1);
 	is_int(KNOT_EOK, ret, "journal: init db (%d)", ret);
 
 	ret = journal_open_db(&db);
@@ -255,12 +270,12 @@ static void test_journal_db(void)
 	journal_db_close(&db);
 	ok(db == NULL, "journal: close and destroy db");
 
-	ret = journal_db_init(&db, test_dir_name, 4 * 1024 * 1024, JOURNAL_MODE_ASYNC);
+	ret = journal_db_init(&db, test_dir_name, 4 * 1024 * 1024, JOURNAL_MODE_ASYNC, 1);
 	if (ret == KNOT_EOK) ret2 = journal_open_db(&db);
 	ok(ret == KNOT_EOK && ret2 == KNOT_EOK, "journal: open with bigger mapsize (%d, %d)", ret, ret2);
 	journal_db_close(&db);
 
-	ret = journal_db_init(&db, test_dir_name, 1024 * 1024, JOURNAL_MODE_ASYNC);
+	ret = journal_db_init(&db, test_dir_name, 1024 * 1024, JOURNAL_MODE_ASYNC, 1);
 	if (ret == KNOT_EOK) ret2 = journal_open_db(&db);
 	ok(ret == KNOT_EOK && ret2 == KNOT_EOK, "journal: open with smaller mapsize (%d, %d)", ret, ret2);
 	journal_db_close(&db);
@@ -276,7 +291,7 @@ static void test_store_load(void)
 	j = journal_new();
 	ok(j != NULL, "journal: new");
 
-	ret = journal_db_init(&db, test_dir_name, (512 + 1024) * 1024, JOURNAL_MODE_ASYNC);
+	ret = journal_db_init(&db, test_dir_name, (512 + 1024) * 1024, JOURNAL_MODE_ASYNC, 1);
 	if (ret == KNOT_EOK) ret2 = journal_open(j, &db, apex);
 	is_int(KNOT_EOK, ret, "journal: open (%d, %d)", ret, ret2);
 
@@ -661,7 +676,7 @@ static void test_stress_base(journal_t *j, size_t update_size, size_t file_size)
 	journal_close(j);
 	journal_db_close(&db);
 	db = NULL;
-	ret = journal_db_init(&db, test_dir_name, file_size, JOURNAL_MODE_ASYNC);
+	ret = journal_db_init(&db, test_dir_name, file_size, JOURNAL_MODE_ASYNC, 1);
 	assert(ret == KNOT_EOK);
 	ret = journal_open_db(&db);
 	assert(ret == KNOT_EOK);
@@ -708,6 +723,317 @@ static void test_stress(journal_t *j)
 	test_stress_base(j, 4000, 10 * 1024 * 1024);
 }
 
+#define GROUP_THREADS 8
+#define GROUP_STORES 20
+
+typedef struct {
+	journal_t *j;
+	knot_dname_t *apex;
+	changeset_t ch;
+	int ret;
+} group_ctx_t;
+
+static void *group_store(void *arg)
+{
+	group_ctx_t *ctx = arg;
+
+	for (uint32_t serial = 0; serial < GROUP_STORES && ctx->ret == KNOT_EOK; serial++) {
+		changeset_set_soa_serials(&ctx->ch, serial, serial + 1, ctx->apex);
+		ctx->ret = journal_store_changeset(ctx->j, &ctx->ch);
+	}
+
+	return NULL;
+}
+
+static void group_init(group_ctx_t *ctx, int id, bool bootstrap)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "zone%d.test.", id);
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->apex = knot_dname_from_str_alloc(name);
+	ctx->j = journal_new();
+	int ret = journal_open(ctx->j, &db, ctx->apex);
+	(void)ret;
+	assert(ret == KNOT_EOK);
+	changeset_init(&ctx->ch, ctx->apex);
+	init_random_changeset(&ctx->ch, 0, 1, 20, ctx->apex, bootstrap);
+}
+
+static void group_deinit(group_ctx_t *ctx)
+{
+	changeset_clear(&ctx->ch);
+	journal_close(ctx->j);
+	journal_free(&ctx->j);
+	knot_dname_free(&ctx->apex, NULL);
+}
+
+/*! \brief Test concurrent stores sharing robust DB transactions. */
+static void test_group_commit(void)
+{
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/group", test_dir_name);
+
+	journal_close(j);
+	journal_db_close(&db);
+	int ret = journal_db_init(&db, path, 10 * 1024 * 1024, JOURNAL_MODE_ROBUST, 1);
+	assert(ret == KNOT_EOK);
+	ret = journal_open_db(&db);
+	assert(ret == KNOT_EOK);
+
+	set_conf(1000, 5 * 1024 * 1024);
+
+	/* Concurrent stores into different journals. */
+	group_ctx_t ctx[GROUP_THREADS];
+	pthread_t threads[GROUP_THREADS];
+	for (int i = 0; i < GROUP_THREADS; i++) {
+		group_init(&ctx[i], i, false);
+	}
+	for (int i = 0; i < GROUP_THREADS; i++) {
+		pthread_create(&threads[i], NULL, group_store, &ctx[i]);
+	}
+	bool stored = true, loaded = true;
+	for (int i = 0; i < GROUP_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+		stored = stored && ctx[i].ret == KNOT_EOK;
+
+		list_t l;
+		init_list(&l);
+		ret = journal_load_changesets(ctx[i].j, &l, 0);
+		loaded = loaded && ret == KNOT_EOK && list_size(&l) == GROUP_STORES &&
+		         test_continuity(&l) == KNOT_EOK;
+		changesets_free(&l);
+		group_deinit(&ctx[i]);
+	}
+	ok(stored, "journal: concurrent robust stores");
+	ok(loaded, "journal: load concurrently stored changesets");
+
+	/* A failing store in a group commit doesn't affect the others. */
+	group_init(&ctx[0], GROUP_THREADS, true);
+	group_init(&ctx[1], GROUP_THREADS + 1, false);
+	ret = journal_store_changeset(ctx[0].j, &ctx[0].ch);
+	ok(ret == KNOT_EOK, "journal: store zone in journal");
+
+	changeset_set_soa_serials(&ctx[0].ch, 5, 6, ctx[0].apex);
+	list_t l0, l1;
+	init_list(&l0);
+	init_list(&l1);
+	add_tail(&l0, &ctx[0].ch.n);
+	add_tail(&l1, &ctx[1].ch.n);
+	store_req_t reqs[] = {
+		{ .j = ctx[0].j, .changesets = &l0 },
+		{ .j = ctx[1].j, .changesets = &l1 },
+	};
+	list_t batch;
+	init_list(&batch);
+	add_tail(&batch, &reqs[0].n);
+	add_tail(&batch, &reqs[1].n);
+	store_batch(db, &batch);
+	ok(reqs[0].ret == KNOT_ERANGE && reqs[1].ret == KNOT_EOK,
+	   "journal: group commit with a failing store");
+
+	list_t l;
+	init_list(&l);
+	ret = journal_load_changesets(ctx[1].j, &l, 0);
+	ok(ret == KNOT_EOK && list_size(&l) == 1, "journal: load group committed changeset");
+	changesets_free(&l);
+	init_list(&l);
+	ret = journal_load_changesets(ctx[0].j, &l, 5);
+	ok(ret == KNOT_ENOENT, "journal: failed store reverted");
+	changesets_free(&l);
+
+	group_deinit(&ctx[0]);
+	group_deinit(&ctx[1]);
+
+	/* Each zone of a group commit is charged for its own part of the usage. */
+	group_init(&ctx[0], GROUP_THREADS + 2, false);
+	group_init(&ctx[1], GROUP_THREADS + 3, false);
+	group_init(&ctx[2], GROUP_THREADS + 4, false);
+	changeset_clear(&ctx[0].ch);
+	changeset_init(&ctx[0].ch, ctx[0].apex);
+	init_random_changeset(&ctx[0].ch, 0, 1, 2000, ctx[0].apex, false);
+	init_list(&l0);
+	init_list(&l1);
+	add_tail(&l0, &ctx[0].ch.n);
+	add_tail(&l1, &ctx[1].ch.n);
+	store_req_t sized[] = {
+		{ .j = ctx[0].j, .changesets = &l0,
+		  .size = changeset_serialized_size(&ctx[0].ch) },
+		{ .j = ctx[1].j, .changesets = &l1,
+		  .size = changeset_serialized_size(&ctx[1].ch) },
+	};
+	init_list(&batch);
+	add_tail(&batch, &sized[0].n);
+	add_tail(&batch, &sized[1].n);
+	store_batch(db, &batch);
+	ok(sized[0].ret == KNOT_EOK && sized[1].ret == KNOT_EOK,
+	   "journal: group commit of different sizes");
+
+	uint64_t occupied[2] = { 0 };
+	journal_metadata_info(ctx[0].j, NULL, NULL, NULL, NULL, NULL, &occupied[0], NULL);
+	journal_metadata_info(ctx[1].j, NULL, NULL, NULL, NULL, NULL, &occupied[1], NULL);
+	ok(occupied[0] > occupied[1] && occupied[1] > 0,
+	   "journal: group commit usage estimated per zone");
+
+	ret = journal_store_changeset(ctx[2].j, &ctx[2].ch);
+	journal_metadata_info(ctx[0].j, NULL, NULL, NULL, NULL, NULL, &occupied[0], NULL);
+	journal_metadata_info(ctx[1].j, NULL, NULL, NULL, NULL, NULL, &occupied[1], NULL);
+	ok(ret == KNOT_EOK && occupied[0] > occupied[1] && occupied[1] > 0,
+	   "journal: group commit usage charged per zone");
+
+	group_deinit(&ctx[0]);
+	group_deinit(&ctx[1]);
+	group_deinit(&ctx[2]);
+
+	unset_conf();
+
+	ret = journal_open(j, &db, apex);
+	assert(ret == KNOT_EOK);
+}
+
+#define SHARDS 4
+#define SHARD_ZONES 16
+
+/*! \brief Test zones spread over the journal DB shards. */
+static void test_shards(void)
+{
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/sharded", test_dir_name);
+
+	journal_close(j);
+	journal_db_close(&db);
+	int ret = journal_db_init(&db, path, 2 * 1024 * 1024, JOURNAL_MODE_ASYNC,
+	                          JOURNAL_MAX_SHARDS + 1);
+	ok(ret == KNOT_EINVAL && db == NULL, "journal: too many shards");
+	ret = journal_db_init(&db, path, 2 * 1024 * 1024, JOURNAL_MODE_ASYNC, SHARDS);
+	ok(ret == KNOT_EOK && db->shard_count == SHARDS, "journal: init sharded DB");
+	ok(!journal_db_is_open(db), "journal: sharded DB not open");
+
+	set_conf(1000, 1024 * 1024);
+
+	/* Store into journals in different shards. */
+	group_ctx_t ctx[SHARD_ZONES];
+	bool stored = true, assigned = true;
+	size_t used[SHARDS] = { 0 };
+	for (int i = 0; i < SHARD_ZONES; i++) {
+		group_init(&ctx[i], i, false);
+		stored = stored && journal_store_changeset(ctx[i].j, &ctx[i].ch) == KNOT_EOK;
+
+		bool found = false;
+		for (int k = 0; k < SHARDS; k++) {
+			if (ctx[i].j->db == db->shards[k]) {
+				used[k]++;
+				found = true;
+			}
+		}
+		assigned = assigned && found;
+	}
+	ok(stored, "journal: store into sharded DB");
+	ok(assigned && journal_db_is_open(db), "journal: journals in shards");
+	size_t shards_used = 0;
+	for (int k = 0; k < SHARDS; k++) {
+		shards_used += (used[k] > 0);
+	}
+	ok(shards_used > 1, "journal: zones spread over shards");
+	for (int i = 0; i < SHARD_ZONES; i++) {
+		group_deinit(&ctx[i]);
+	}
+
+	list_t zones;
+	init_list(&zones);
+	ret = journal_db_list_zones(&db, &zones);
+	ok(ret == KNOT_EOK && list_size(&zones) == SHARD_ZONES, "journal: list zones in shards");
+	ptrlist_deep_free(&zones, NULL);
+	journal_db_close(&db);
+
+	/* Reopen with detected shards. */
+	ret = journal_db_init(&db, path, 2 * 1024 * 1024, JOURNAL_MODE_ASYNC, 0);
+	ok(ret == KNOT_EOK && db->shard_count == SHARDS, "journal: detect shards");
+	bool exist = true, loaded = true;
+	for (int i = 0; i < SHARD_ZONES; i++) {
+		group_init(&ctx[i], i, false);
+		exist = exist && journal_exists(&db, ctx[i].apex);
+
+		list_t l;
+		init_list(&l);
+		ret = journal_load_changesets(ctx[i].j, &l, 0);
+		loaded = loaded && ret == KNOT_EOK && list_size(&l) == 1;
+		changesets_free(&l);
+		group_deinit(&ctx[i]);
+	}
+	ok(exist, "journal: zones exist in shards");
+	ok(loaded, "journal: load from shards");
+	ok(!journal_exists(&db, (knot_dname_t *)apex), "journal: other zone not in shards");
+
+	/* Refuse a different number of shards than on the disk. */
+	journal_db_t *other = NULL;
+	ret = journal_db_init(&other, path, 2 * 1024 * 1024, JOURNAL_MODE_ASYNC, 1);
+	ok(ret == KNOT_EEXIST && other == NULL, "journal: sharded DB opened as single");
+	ret = journal_db_init(&other, path, 2 * 1024 * 1024, JOURNAL_MODE_ASYNC, SHARDS + 1);
+	ok(ret == KNOT_EEXIST && other == NULL, "journal: changed number of shards");
+	ret = journal_db_init(&other, test_dir_name, 2 * 1024 * 1024, JOURNAL_MODE_ASYNC, SHARDS);
+	ok(ret == KNOT_EEXIST && other == NULL, "journal: single DB opened as sharded");
+
+	unset_conf();
+
+	ret = journal_open(j, &db, apex);
+	assert(ret == KNOT_EOK);
+}
+
+/*! \brief Test compressed changeset chunks mixed with plain ones. */
+static void test_compression(void)
+{
+#ifdef ENABLE_ZLIB
+	changeset_t plain, compressed;
+	changeset_init(&plain, apex);
+	changeset_init(&compressed, apex);
+	init_random_changeset(&plain, 0, 1, 10, apex, false);
+	init_random_changeset(&compressed, 1, 2, 4000, apex, false);
+
+	set_conf_compression(false);
+	int ret = journal_store_changeset(j, &plain);
+	ok(ret == KNOT_EOK, "journal: store plain changeset");
+
+	journal_chunk_stats_t stats;
+	journal_metadata_info(j, NULL, NULL, NULL, NULL, NULL, NULL, &stats);
+	ok(stats.chunks == 1 && stats.compressed == 0 && stats.raw_size == stats.stored_size,
+	   "journal: plain chunk statistics");
+
+	unset_conf();
+	set_conf_compression(true);
+	ret = journal_store_changeset(j, &compressed);
+	ok(ret == KNOT_EOK, "journal: store compressed changeset");
+
+	journal_metadata_info(j, NULL, NULL, NULL, NULL, NULL, NULL, &stats);
+	ok(stats.chunks > 2 && stats.compressed == stats.chunks - 1 &&
+	   stats.stored_size < stats.raw_size, "journal: compressed chunk statistics");
+
+	list_t l, k;
+	init_list(&l);
+	init_list(&k);
+	add_tail(&k, &plain.n);
+	add_tail(&k, &compressed.n);
+	ret = journal_load_changesets(j, &l, 0);
+	ok(ret == KNOT_EOK && changesets_list_eq(&l, &k), "journal: load compressed changesets");
+	changesets_free(&l);
+
+	/* Compressed chunks readable regardless of the configuration. */
+	unset_conf();
+	set_conf_compression(false);
+	init_list(&l);
+	ret = journal_load_changesets(j, &l, 1);
+	ok(ret == KNOT_EOK && list_size(&l) == 1 && changesets_eq((changeset_t *)TAIL(l), &compressed),
+	   "journal: load compressed changeset with compression disabled");
+	changesets_free(&l);
+
+	changeset_clear(&plain);
+	changeset_clear(&compressed);
+	unset_conf();
+#else
+	skip_block(6, "journal compression not available");
+#endif
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -722,6 +1048,12 @@ int main(int argc, char *argv[])
 
 	test_stress(j);
 
+	test_group_commit();
+
+	test_shards();
+
+	test_compression();
+
 	journal_close(j);
 	journal_free(&j);
 	journal_db_close(&db);
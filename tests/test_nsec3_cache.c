@@ -0,0 +1,73 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <tap/basic.h>
+
+#include "libknot/libknot.h"
+#include "knot/zone/nsec3-cache.h"
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	dnssec_nsec3_params_t params = {
+		.algorithm = DNSSEC_NSEC3_ALGORITHM_SHA1,
+		.iterations = 10,
+		.salt = { .size = 4, .data = (uint8_t *)"abcd" }
+	};
+	dnssec_nsec3_params_t other = params;
+	other.salt.data = (uint8_t *)"abce";
+
+	const knot_dname_t *name1 = (const knot_dname_t *)"\x01""*""\x07""example""\x03""com";
+	const knot_dname_t *name2 = (const knot_dname_t *)"\x03""www""\x07""example""\x03""com";
+	const uint8_t hash1[20] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+	const uint8_t hash2[20] = { 10, 9, 8, 7, 6, 5, 4, 3, 2, 1 };
+	uint8_t out[NSEC3_CACHE_MAX_HASH];
+	size_t out_len = 0;
+
+	ok(nsec3_cache_new(0, &params) == NULL, "nsec3 cache: zero size");
+
+	nsec3_cache_t *cache = nsec3_cache_new(1, &params);
+	ok(cache != NULL, "nsec3 cache: create");
+
+	ok(!nsec3_cache_get(cache, &params, name1, out, &out_len),
+	   "nsec3 cache: miss on empty");
+
+	nsec3_cache_put(cache, &params, name1, hash1, sizeof(hash1));
+	ok(nsec3_cache_get(cache, &params, name1, out, &out_len) &&
+	   out_len == sizeof(hash1) && memcmp(out, hash1, out_len) == 0,
+	   "nsec3 cache: hit");
+	ok(!nsec3_cache_get(cache, &params, name2, out, &out_len),
+	   "nsec3 cache: miss on other name");
+	ok(!nsec3_cache_get(cache, &other, name1, out, &out_len),
+	   "nsec3 cache: miss on other salt");
+
+	nsec3_cache_put(cache, &other, name2, hash2, sizeof(hash2));
+	ok(!nsec3_cache_get(cache, &other, name2, out, &out_len),
+	   "nsec3 cache: no store with other salt");
+
+	nsec3_cache_put(cache, &params, name2, hash2, sizeof(hash2));
+	ok(nsec3_cache_get(cache, &params, name2, out, &out_len) &&
+	   out_len == sizeof(hash2) && memcmp(out, hash2, out_len) == 0,
+	   "nsec3 cache: replaced entry");
+	ok(!nsec3_cache_get(cache, &params, name1, out, &out_len),
+	   "nsec3 cache: replaced entry evicted");
+
+	nsec3_cache_free(cache);
+
+	return 0;
+}
@@ -15,13 +15,19 @@
  */
 
 #include <assert.h>
+#include <poll.h>
+#include <pthread.h>
 #include <tap/basic.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <urcu.h>
 
 #include "libknot/descriptor.h"
 #include "libknot/packet/wire.h"
 #include "knot/nameserver/process_query.h"
+#include "knot/nameserver/query_module.h"
+#include "knot/server/defer.h"
 #include "test_server.h"
 #include "contrib/sockaddr.h"
 #include "contrib/ucw/mempool.h"
@@ -71,6 +77,278 @@ static void exec_query(knot_layer_t *layer, const char *name,
 	knot_pkt_free(&answer);
 }
 
+/* Root zone large enough for a multi-message AXFR. */
+static zone_contents_t *create_large_root(const knot_rrset_t *soa)
+{
+	zone_contents_t *contents = zone_contents_new(ROOT_DNAME);
+	assert(contents);
+	zone_node_t *node = NULL;
+	int ret = zone_contents_add_rr(contents, soa, &node);
+	assert(ret == KNOT_EOK);
+
+	uint8_t txt[256] = { 255 };
+	memset(txt + 1, 'x', 255);
+	for (unsigned i = 0; i < 500; i++) {
+		uint8_t owner[16];
+		int len = snprintf((char *)owner + 1, sizeof(owner) - 1, "n%u", i);
+		owner[0] = len;
+		owner[len + 1] = '\0';
+		knot_rrset_t *rr = knot_rrset_new(owner, KNOT_RRTYPE_TXT,
+		                                  KNOT_CLASS_IN, 3600, NULL);
+		assert(rr);
+		ret = knot_rrset_add_rdata(rr, txt, sizeof(txt), NULL);
+		assert(ret == KNOT_EOK);
+		node = NULL;
+		ret = zone_contents_add_rr(contents, rr, &node);
+		assert(ret == KNOT_EOK);
+		knot_rrset_free(&rr, NULL);
+	}
+
+	ret = zone_contents_adjust_full(contents);
+	assert(ret == KNOT_EOK);
+
+	return contents;
+}
+
+struct commit_ctx {
+	zone_t *zone;
+	zone_contents_t *contents;
+	zone_contents_t *old;
+	bool done;
+};
+
+/* Publish new zone contents and wait for the readers, like a zone commit. */
+static void *commit_thread(void *arg)
+{
+	struct commit_ctx *ctx = arg;
+	ctx->old = zone_switch_contents(ctx->zone, ctx->contents);
+	synchronize_rcu();
+	__atomic_store_n(&ctx->done, true, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+/* Zone commit while an AXFR is suspended between messages. */
+static void test_suspended_axfr(server_t *server, knot_mm_t *mm,
+                                knotd_qdata_params_t *params)
+{
+	/* Allow transfers to the test client. */
+	const char *conf_str = "server:\n identity: bogus.ns\n"
+	                       "acl:\n - id: xfr\n   address: 127.0.0.1\n"
+	                       "   action: transfer\n"
+	                       "zone:\n - domain: .\n   zonefile-sync: -1\n"
+	                       "   acl: xfr\n";
+	int ret = test_conf(conf_str, NULL);
+	is_int(KNOT_EOK, ret, "ns: transfer configuration");
+
+	zone_t *zone = knot_zonedb_find(server->zone_db, ROOT_DNAME);
+	knot_rrset_t soa = node_rrset(zone->contents->apex, KNOT_RRTYPE_SOA);
+	zone_contents_t *first = create_large_root(&soa);
+	zone_contents_t *second = create_large_root(&soa);
+	zone_contents_t *old = zone_switch_contents(zone, first);
+	zone_contents_deep_free(&old);
+
+	knot_layer_t proc;
+	memset(&proc, 0, sizeof(proc));
+	knot_layer_init(&proc, mm, process_query_layer());
+	knot_layer_begin(&proc, params);
+
+	knot_pkt_t *query = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, mm);
+	knot_pkt_t *answer = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, mm);
+	knot_pkt_put_question(query, ROOT_DNAME, KNOT_CLASS_IN, KNOT_RRTYPE_AXFR);
+	knot_pkt_parse(query, 0);
+	knot_layer_consume(&proc, query);
+
+	/* First message, the rest is pending. */
+	knot_layer_produce(&proc, answer);
+	ok(proc.state == KNOT_STATE_PRODUCE &&
+	   knot_wire_get_rcode(answer->wire) == KNOT_RCODE_NOERROR,
+	   "ns: suspended AXFR first message");
+
+	/* Commit must not wait for the suspended transfer. */
+	struct commit_ctx ctx = { .zone = zone, .contents = second };
+	pthread_t thread;
+	ret = pthread_create(&thread, NULL, commit_thread, &ctx);
+	assert(ret == 0);
+	for (int i = 0; i < 500 && !__atomic_load_n(&ctx.done, __ATOMIC_ACQUIRE); i++) {
+		usleep(10000);
+	}
+	ok(__atomic_load_n(&ctx.done, __ATOMIC_ACQUIRE),
+	   "ns: zone commit during suspended AXFR");
+
+	/* The transferred version is gone, the transfer must not continue. */
+	if (ctx.done) {
+		pthread_join(thread, NULL);
+		zone_contents_deep_free(&ctx.old);
+		knot_layer_produce(&proc, answer);
+		if (proc.state == KNOT_STATE_FAIL) {
+			knot_layer_produce(&proc, answer);
+		}
+		ok(proc.state == KNOT_STATE_DONE &&
+		   knot_wire_get_rcode(answer->wire) == KNOT_RCODE_SERVFAIL,
+		   "ns: suspended AXFR aborted after zone change");
+		knot_layer_finish(&proc);
+	} else {
+		knot_layer_finish(&proc);
+		pthread_join(thread, NULL);
+		zone_contents_deep_free(&ctx.old);
+		skip("ns: zone commit blocked");
+	}
+
+	knot_pkt_free(&answer);
+	knot_pkt_free(&query);
+}
+
+struct defer_test {
+	int begin;
+	int end;
+	knotd_defer_t *defer;
+};
+
+static unsigned count_begin(unsigned state, knot_pkt_t *pkt, knotd_qdata_t *qdata,
+                            knotd_mod_t *mod)
+{
+	((struct defer_test *)mod)->begin += 1;
+	return state;
+}
+
+static unsigned count_end(unsigned state, knot_pkt_t *pkt, knotd_qdata_t *qdata,
+                          knotd_mod_t *mod)
+{
+	((struct defer_test *)mod)->end += 1;
+	return state;
+}
+
+/* Defer the query, answer with the RCODE it's resumed with. */
+static unsigned defer_hook(unsigned state, knot_pkt_t *pkt, knotd_qdata_t *qdata,
+                           knotd_mod_t *mod)
+{
+	int *rcode = knotd_qdata_resumed(qdata);
+	if (rcode != NULL) {
+		qdata->rcode = *rcode;
+		return KNOT_STATE_FAIL;
+	}
+
+	((struct defer_test *)mod)->defer = knotd_qdata_defer(qdata);
+	return state;
+}
+
+/* Run the query, return the layer state. */
+static int defer_exec(knot_mm_t *mm, knotd_qdata_params_t *params,
+                      knot_pkt_t *query, knot_pkt_t *answer)
+{
+	knot_layer_t proc;
+	memset(&proc, 0, sizeof(proc));
+	knot_layer_init(&proc, mm, process_query_layer());
+	knot_layer_begin(&proc, params);
+
+	knot_pkt_clear(answer);
+	knot_pkt_parse(query, 0);
+	knot_layer_consume(&proc, query);
+	knot_layer_produce(&proc, answer);
+	int state = proc.state;
+	knot_layer_finish(&proc);
+
+	return state;
+}
+
+/* Defer the query and resume it with the RCODE, return the resumed query. */
+static knotd_defer_t *defer_query(knot_mm_t *mm, knotd_qdata_params_t *params,
+                                  struct defer_test *test, int rcode)
+{
+	knot_pkt_t *query = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, mm);
+	knot_pkt_t *answer = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, mm);
+	knot_pkt_put_question(query, ROOT_DNAME, KNOT_CLASS_IN, KNOT_RRTYPE_SOA);
+
+	memset(test, 0, sizeof(*test));
+	params->defer = NULL;
+	int state = defer_exec(mm, params, query, answer);
+	ok(state == KNOT_STATE_NOOP && test->defer != NULL &&
+	   params->defer == test->defer && test->end == 0,
+	   "ns: query deferred without answer");
+
+	int *data = malloc(sizeof(*data));
+	*data = rcode;
+	knotd_defer_resume(test->defer, data);
+
+	defer_queue_t *queue = params->defer_queue;
+	struct pollfd pfd = { .fd = defer_queue_fd(queue), .events = POLLIN };
+	ok(poll(&pfd, 1, 0) == 1, "ns: resumed query signalled");
+	knotd_defer_t *defer = defer_queue_pop(queue);
+	ok(defer == test->defer && defer_queue_pop(queue) == NULL &&
+	   poll(&pfd, 1, 0) == 0, "ns: resumed query taken");
+
+	knot_pkt_free(&answer);
+	knot_pkt_free(&query);
+
+	return defer;
+}
+
+/* Query deferred by a module and processed again once resumed. */
+static void test_deferred_query(knot_mm_t *mm, knotd_qdata_params_t *params)
+{
+	struct defer_test test = { 0 };
+	struct query_plan *plan = query_plan_create(NULL);
+	query_plan_step(plan, KNOTD_STAGE_BEGIN, count_begin, &test);
+	query_plan_step(plan, KNOTD_STAGE_BEGIN, defer_hook, &test);
+	query_plan_step(plan, KNOTD_STAGE_END, count_end, &test);
+	struct query_plan *orig_plan = conf()->query_plan;
+	conf()->query_plan = plan;
+
+	knotd_qdata_params_t defer_params = *params;
+	defer_params.defer_queue = defer_queue_new();
+
+	/* Not deferrable without a queue. */
+	knot_pkt_t *query = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, mm);
+	knot_pkt_t *answer = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, mm);
+	knot_pkt_put_question(query, ROOT_DNAME, KNOT_CLASS_IN, KNOT_RRTYPE_SOA);
+	int state = defer_exec(mm, params, query, answer);
+	ok(state == KNOT_STATE_DONE && test.defer == NULL && test.end == 1,
+	   "ns: query not deferred without queue");
+
+	/* Resumed in the deferring hook, the END hooks run. */
+	knotd_defer_t *defer = defer_query(mm, &defer_params, &test, KNOT_RCODE_NOTIMPL);
+	knot_pkt_t *resumed = knot_pkt_new(defer->query, defer->query_len, mm);
+	test.begin = 0;
+	state = defer_exec(mm, &defer_params, resumed, answer);
+	ok(state == KNOT_STATE_DONE &&
+	   knot_wire_get_rcode(answer->wire) == KNOT_RCODE_NOTIMPL &&
+	   knot_wire_get_id(answer->wire) == knot_wire_get_id(query->wire),
+	   "ns: resumed query answered by the deferring hook");
+	ok(test.begin == 0 && test.end == 1,
+	   "ns: resumed query skips the hooks before, runs the END hooks");
+	knot_pkt_free(&resumed);
+	defer_free(defer);
+
+	/* Resumed after the deferring hook is gone. */
+	defer = defer_query(mm, &defer_params, &test, KNOT_RCODE_NOTIMPL);
+	struct query_plan *new_plan = query_plan_create(NULL);
+	query_plan_step(new_plan, KNOTD_STAGE_BEGIN, count_begin, &test);
+	conf()->query_plan = new_plan;
+	resumed = knot_pkt_new(defer->query, defer->query_len, mm);
+	state = defer_exec(mm, &defer_params, resumed, answer);
+	ok(state == KNOT_STATE_DONE &&
+	   knot_wire_get_rcode(answer->wire) == KNOT_RCODE_SERVFAIL,
+	   "ns: resumed query without its hook fails");
+	knot_pkt_free(&resumed);
+	defer_free(defer);
+
+	/* Resumed after the owner is gone. */
+	conf()->query_plan = plan;
+	memset(&test, 0, sizeof(test));
+	defer_params.defer = NULL;
+	state = defer_exec(mm, &defer_params, query, answer);
+	ok(state == KNOT_STATE_NOOP && test.defer != NULL, "ns: query deferred again");
+	defer_queue_free(defer_params.defer_queue);
+	knotd_defer_resume(test.defer, NULL);
+
+	conf()->query_plan = orig_plan;
+	query_plan_free(new_plan);
+	query_plan_free(plan);
+	knot_pkt_free(&answer);
+	knot_pkt_free(&query);
+}
+
 /* \internal Helpers */
 #define WIRE_COPY(dst, dst_len, src, src_len) \
 	memcpy(dst, src, src_len); \
@@ -178,6 +456,10 @@ int main(int argc, char *argv[])
 	knot_layer_finish(&proc);
 	ok(proc.state == KNOT_STATE_NOOP, "ns: processing end" );
 
+	test_suspended_axfr(&server, &mm, &params);
+
+	test_deferred_query(&mm, &params);
+
 	/* Cleanup. */
 	mp_delete((struct mempool *)mm.ctx);
 	server_deinit(&server);
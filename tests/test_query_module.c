@@ -18,6 +18,7 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include "test_conf.h"
 #include "libknot/libknot.h"
 #include "knot/nameserver/query_module.h"
 #include "libknot/packet/pkt.h"
@@ -35,6 +36,51 @@ unsigned state_visit(unsigned state, knot_pkt_t *pkt, knotd_qdata_t *qdata,
 	return state + 1;
 }
 
+static void test_stats(knot_mm_t *mm)
+{
+	int ret = test_conf("server:\n  udp-workers: 2\n  tcp-workers: 2\n", NULL);
+	is_int(KNOT_EOK, ret, "stats: prepare configuration");
+
+	knotd_mod_t mod = { .mm = mm, .config = conf() };
+
+	ret = knotd_mod_stats_add(&mod, "single", 1, NULL);
+	is_int(KNOT_EOK, ret, "stats: add single counter");
+	ret = knotd_mod_stats_add(&mod, "multi", 3, NULL);
+	is_int(KNOT_EOK, ret, "stats: add counter array");
+	ok(mod.stats_count == 2 && mod.stats_threads == 4, "stats: thread shards");
+
+	/* Every worker thread and a foreign thread (id out of range). */
+	for (unsigned thr_id = 0; thr_id <= mod.stats_threads + 1; thr_id++) {
+		knotd_mod_stats_incr(&mod, thr_id, 0, 0, 2);
+		knotd_mod_stats_incr(&mod, thr_id, 1, 2, 3);
+		knotd_mod_stats_decr(&mod, thr_id, 1, 2, 1);
+	}
+
+	uint64_t single = mod_stats_get(&mod, mod.stats_info + 0, 0);
+	is_int(12, single, "stats: single counter summed over shards");
+	uint64_t multi0 = mod_stats_get(&mod, mod.stats_info + 1, 0);
+	uint64_t multi2 = mod_stats_get(&mod, mod.stats_info + 1, 2);
+	ok(multi0 == 0 && multi2 == 12, "stats: counter array summed over shards");
+
+	knotd_mod_stats_store(&mod, 1, 0, 0, 5);
+	single = mod_stats_get(&mod, mod.stats_info + 0, 0);
+	is_int(5, single, "stats: stored value replaces all shards");
+	knotd_mod_stats_store(&mod, mod.stats_threads + 1, 1, 2, 7);
+	multi2 = mod_stats_get(&mod, mod.stats_info + 1, 2);
+	is_int(7, multi2, "stats: stored value from a foreign thread");
+
+	bool aligned = true;
+	for (unsigned i = 0; i <= mod.stats_threads; i++) {
+		aligned = aligned && ((uintptr_t)mod.stats_vals[i] % 64 == 0);
+	}
+	ok(aligned, "stats: shards aligned to cache lines");
+
+	knotd_mod_stats_free(&mod);
+	ok(mod.stats_info == NULL && mod.stats_vals == NULL, "stats: free");
+
+	conf_free(conf());
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -85,6 +131,9 @@ int main(int argc, char *argv[])
 	/* Free the query plan. */
 	query_plan_free(plan);
 
+	/* Statistics counters. */
+	test_stats(&mm);
+
 	/* Cleanup. */
 	mp_delete((struct mempool *)mm.ctx);
 
@@ -113,6 +113,32 @@ static void test_connected(struct knot_requestor *requestor,
 	knot_request_free(req, requestor->mm);
 }
 
+static void test_multi(knot_mm_t *mm,
+                       const struct sockaddr_storage *dst,
+                       const struct sockaddr_storage *src)
+{
+	enum { COUNT = 3 };
+	struct knot_requestor requestors[COUNT];
+	struct knot_request *reqs[COUNT];
+	int results[COUNT];
+
+	/* Execute concurrently. */
+	for (int i = 0; i < COUNT; ++i) {
+		knot_requestor_init(&requestors[i], &dummy_module, NULL, mm);
+		reqs[i] = make_query(&requestors[i], dst, src);
+	}
+	int ret = knot_requestor_exec_multi(requestors, reqs, results, COUNT, TIMEOUT);
+	is_int(KNOT_EOK, ret, "requestor: multi/exec");
+
+	bool all_ok = true;
+	for (int i = 0; i < COUNT; ++i) {
+		all_ok = all_ok && (results[i] == KNOT_EOK);
+		knot_request_free(reqs[i], mm);
+		knot_requestor_clear(&requestors[i]);
+	}
+	ok(all_ok, "requestor: multi/results");
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -149,6 +175,9 @@ int main(int argc, char *argv[])
 	/* Test requestor in connected environment. */
 	test_connected(&requestor, &server, &client);
 
+	/* Test multiple concurrent requests. */
+	test_multi(&mm, &server, &client);
+
 	/* Terminate responder. */
 	int conn = net_connected_socket(SOCK_STREAM, (struct sockaddr *)&server, NULL);
 	assert(conn > 0);
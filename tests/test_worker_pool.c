@@ -20,6 +20,7 @@
 #include <pthread.h>
 #include <sched.h>
 #include <signal.h>
+#include <stdbool.h>
 #include <time.h>
 
 #include "knot/worker/pool.h"
@@ -61,6 +62,150 @@ static void task_counting(task_t *task)
 	pthread_mutex_unlock(&log->mx);
 }
 
+/*!
+ * Execution order log of prioritized tasks.
+ */
+typedef struct order_log {
+	unsigned count;
+	unsigned prio[WORKER_PRIO_COUNT];
+} order_log_t;
+
+typedef struct {
+	task_t task;
+	order_log_t *log;
+} order_task_t;
+
+/*!
+ * Prioritized task, logs its priority class (single-threaded pool).
+ */
+static void task_ordered(task_t *task)
+{
+	order_task_t *ordered = (order_task_t *)task;
+	ordered->log->prio[ordered->log->count++] = task->prio;
+}
+
+/*!
+ * Blocking task, waits till released.
+ */
+typedef struct task_gate {
+	pthread_mutex_t mx;
+	pthread_cond_t cond;
+	bool entered;
+	bool open;
+} task_gate_t;
+
+static void task_blocking(task_t *task)
+{
+	task_gate_t *gate = task->ctx;
+
+	pthread_mutex_lock(&gate->mx);
+	gate->entered = true;
+	pthread_cond_broadcast(&gate->cond);
+	while (!gate->open) {
+		pthread_cond_wait(&gate->cond, &gate->mx);
+	}
+	pthread_mutex_unlock(&gate->mx);
+}
+
+static void test_priorities(void)
+{
+	worker_pool_t *pool = worker_pool_create(1);
+	ok(pool != NULL, "priorities: create worker pool");
+	if (!pool) {
+		return;
+	}
+
+	order_log_t log = { 0 };
+	order_task_t tasks[WORKER_PRIO_COUNT];
+	for (int i = 0; i < WORKER_PRIO_COUNT; i++) {
+		// Assigned from the lowest priority class.
+		tasks[i].task.run = task_ordered;
+		tasks[i].task.prio = WORKER_PRIO_COUNT - 1 - i;
+		tasks[i].log = &log;
+		worker_pool_assign(pool, &tasks[i].task);
+	}
+
+	worker_pool_stats_t stats;
+	worker_pool_stats(pool, WORKER_PRIO_LOW, &stats);
+	ok(stats.queued == 1 && stats.executed == 0, "priorities: stats before start");
+
+	worker_pool_start(pool);
+	worker_pool_wait(pool);
+
+	bool ordered = (log.count == WORKER_PRIO_COUNT);
+	for (int i = 0; ordered && i < WORKER_PRIO_COUNT; i++) {
+		ordered = (log.prio[i] == i);
+	}
+	ok(ordered, "priorities: execution order");
+
+	bool counted = true;
+	for (int i = 0; i < WORKER_PRIO_COUNT; i++) {
+		worker_pool_stats(pool, i, &stats);
+		counted = counted && stats.queued == 0 && stats.executed == 1 &&
+		          stats.wait_max_usec <= stats.wait_usec;
+	}
+	ok(counted, "priorities: stats after execution");
+
+	worker_pool_stop(pool);
+	worker_pool_join(pool);
+	worker_pool_destroy(pool);
+}
+
+static void test_stealing(task_log_t *log)
+{
+	worker_pool_t *pool = worker_pool_create(THREADS);
+	ok(pool != NULL, "stealing: create worker pool");
+	if (!pool) {
+		return;
+	}
+
+	task_gate_t gate = {
+		.mx = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+	};
+
+	worker_pool_start(pool);
+
+	// Occupy one worker, its queue must be processed by the others.
+	task_t blocking = { .run = task_blocking, .ctx = &gate };
+	worker_pool_assign(pool, &blocking);
+	pthread_mutex_lock(&gate.mx);
+	while (!gate.entered) {
+		pthread_cond_wait(&gate.cond, &gate.mx);
+	}
+	pthread_mutex_unlock(&gate.mx);
+
+	task_t task = { .run = task_counting, .ctx = log };
+	for (int i = 0; i < TASKS_BATCH; i++) {
+		worker_pool_assign(pool, &task);
+	}
+
+	unsigned executed = 0;
+	for (int i = 0; i < 5000 && executed < TASKS_BATCH; i++) {
+		struct timespec delay = { 0, 1000000 };
+		nanosleep(&delay, NULL);
+		pthread_mutex_lock(&log->mx);
+		executed = log->executed;
+		pthread_mutex_unlock(&log->mx);
+	}
+	ok(executed == TASKS_BATCH, "stealing: executed count with a blocked worker");
+
+	pthread_mutex_lock(&gate.mx);
+	gate.open = true;
+	pthread_cond_broadcast(&gate.cond);
+	pthread_mutex_unlock(&gate.mx);
+
+	worker_pool_wait(pool);
+	executed_reset(log);
+
+	worker_pool_stop(pool);
+	worker_pool_join(pool);
+	worker_pool_destroy(pool);
+
+	pthread_mutex_destroy(&gate.mx);
+	pthread_cond_destroy(&gate.cond);
+}
+
 static void interrupt_handle(int s)
 {
 }
@@ -146,6 +291,11 @@ int main(void)
 	worker_pool_join(pool);
 	worker_pool_destroy(pool);
 
+	// priority classes and work stealing
+
+	test_priorities();
+	test_stealing(&log);
+
 	pthread_mutex_destroy(&log.mx);
 
 	return 0;
@@ -17,6 +17,7 @@
 #include <tap/basic.h>
 
 #include "knot/worker/queue.h"
+#include "libknot/errcode.h"
 
 int main(void)
 {
@@ -34,21 +35,22 @@ int main(void)
 
 	// enqueue
 
-	worker_queue_enqueue(&queue, &task_one);
-	ok(1, "enqueue first");
-	worker_queue_enqueue(&queue, &task_two);
-	ok(1, "enqueue second");
+	ok(worker_queue_enqueue(&queue, &task_one) == KNOT_EOK, "enqueue first");
+	ok(worker_queue_enqueue(&queue, &task_two) == KNOT_EOK, "enqueue second");
+	ok(worker_queue_size(&queue) == 2, "queue size");
 
 	// dequeue
 
-	ok(worker_queue_dequeue(&queue) == &task_one, "dequeue first");
+	struct timespec queued = { 0 };
+	ok(worker_queue_dequeue_timed(&queue, &queued) == &task_one &&
+	   (queued.tv_sec != 0 || queued.tv_nsec != 0), "dequeue first with time");
 	ok(worker_queue_dequeue(&queue) == &task_two, "dequeue second");
 	ok(worker_queue_dequeue(&queue) == NULL, "dequeue from empty");
+	ok(worker_queue_size(&queue) == 0, "empty queue size");
 
 	// deinit
 
-	worker_queue_enqueue(&queue, &task_three);
-	ok(1, "enqueue third");
+	ok(worker_queue_enqueue(&queue, &task_three) == KNOT_EOK, "enqueue third");
 
 	worker_queue_deinit(&queue);
 	ok(1, "queue deinit");
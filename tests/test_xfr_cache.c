@@ -0,0 +1,114 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <tap/basic.h>
+
+#include "libknot/libknot.h"
+#include "knot/zone/xfr-cache.h"
+
+#define BASE_SIZE 29
+
+static void fill_message(uint8_t *wire, size_t size, uint16_t ancount)
+{
+	for (size_t i = 0; i < size; i++) {
+		wire[i] = i;
+	}
+	knot_wire_set_ancount(wire, ancount);
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	uint8_t wire[1000];
+
+	/* Stream recording. */
+	xfr_stream_t stream;
+	xfr_stream_init(&stream, KNOT_RRTYPE_AXFR, 5, BASE_SIZE);
+	ok(stream.serial == 0 && stream.messages == 0, "xfr cache: empty AXFR stream");
+
+	fill_message(wire, 500, 10);
+	int ret = xfr_stream_append(&stream, wire, 500, 10000);
+	is_int(KNOT_EOK, ret, "xfr cache: append message");
+	fill_message(wire, 100, 2);
+	ret = xfr_stream_append(&stream, wire, 100, 10000);
+	is_int(KNOT_EOK, ret, "xfr cache: append second message");
+	ret = xfr_stream_append(&stream, wire, BASE_SIZE - 1, 10000);
+	is_int(KNOT_EINVAL, ret, "xfr cache: append short message");
+	ret = xfr_stream_append(&stream, wire, 1000, stream.size + 500);
+	is_int(KNOT_ESPACE, ret, "xfr cache: append over limit");
+	ok(stream.messages == 2 && stream.max_body == 500 - BASE_SIZE,
+	   "xfr cache: stream counters");
+
+	/* Stream replay. */
+	size_t pos = 0;
+	const uint8_t *body = NULL;
+	uint16_t ancount = 0;
+	size_t size = xfr_stream_next(&stream, &pos, &body, &ancount);
+	fill_message(wire, 500, 10);
+	ok(size == 500 - BASE_SIZE && ancount == 10 &&
+	   memcmp(body, wire + BASE_SIZE, size) == 0, "xfr cache: first message");
+	size = xfr_stream_next(&stream, &pos, &body, &ancount);
+	ok(size == 100 - BASE_SIZE && ancount == 2 && pos == stream.size,
+	   "xfr cache: second message");
+	ok(xfr_stream_next(&stream, &pos, &body, &ancount) == 0, "xfr cache: end of stream");
+
+	/* Cache. */
+	ok(xfr_cache_new(0) == NULL, "xfr cache: disabled");
+	xfr_cache_t *cache = xfr_cache_new(stream.size + 100);
+	ok(cache != NULL && xfr_cache_available(cache) == stream.size + 100,
+	   "xfr cache: create");
+	ok(xfr_cache_get(cache, KNOT_RRTYPE_AXFR, 0) == NULL, "xfr cache: miss");
+
+	size_t stream_size = stream.size;
+	ret = xfr_cache_put(cache, &stream);
+	is_int(KNOT_EOK, ret, "xfr cache: put");
+	ok(stream.data == NULL && stream.size == 0, "xfr cache: stream moved");
+	const xfr_stream_t *cached = xfr_cache_get(cache, KNOT_RRTYPE_AXFR, 1);
+	ok(cached != NULL && cached->messages == 2 && cached->size == stream_size,
+	   "xfr cache: hit");
+	ok(xfr_cache_available(cache) == 100, "xfr cache: space used");
+
+	/* Same transfer again. */
+	xfr_stream_init(&stream, KNOT_RRTYPE_AXFR, 0, BASE_SIZE);
+	fill_message(wire, 50, 1);
+	(void)xfr_stream_append(&stream, wire, 50, 100);
+	ret = xfr_cache_put(cache, &stream);
+	is_int(KNOT_EEXIST, ret, "xfr cache: put existing");
+	ok(xfr_cache_available(cache) == 100, "xfr cache: space kept");
+
+	/* IXFR keyed by serial. */
+	stream.type = KNOT_RRTYPE_IXFR;
+	stream.serial = 7;
+	ret = xfr_cache_put(cache, &stream);
+	is_int(KNOT_EOK, ret, "xfr cache: put IXFR");
+	ok(xfr_cache_get(cache, KNOT_RRTYPE_IXFR, 7) != NULL &&
+	   xfr_cache_get(cache, KNOT_RRTYPE_IXFR, 8) == NULL, "xfr cache: IXFR serial");
+
+	/* Cache full. */
+	xfr_stream_init(&stream, KNOT_RRTYPE_IXFR, 8, BASE_SIZE);
+	fill_message(wire, 200, 1);
+	(void)xfr_stream_append(&stream, wire, 200, 1000);
+	ret = xfr_cache_put(cache, &stream);
+	is_int(KNOT_ESPACE, ret, "xfr cache: full");
+	xfr_stream_clear(&stream);
+
+	xfr_cache_free(cache);
+	xfr_cache_free(NULL);
+
+	return 0;
+}
@@ -69,7 +69,7 @@ static int ztree_iter_data(zone_node_t **node, void *data)
 
 int main(int argc, char *argv[])
 {
-	plan(5);
+	plan(10);
 
 	ztree_init_data();
 
@@ -80,7 +80,8 @@ int main(int argc, char *argv[])
 	/* 2. insert test */
 	unsigned passed = 1;
 	for (unsigned i = 0; i < NCOUNT; ++i) {
-		if (zone_tree_insert(t, NODE + i) != KNOT_EOK) {
+		zone_node_t *node = NODE + i;
+		if (zone_tree_insert(t, &node) != KNOT_EOK) {
 			passed = 0;
 			break;
 		}
@@ -111,7 +112,62 @@ int main(int argc, char *argv[])
 	int ret = zone_tree_apply(t, ztree_iter_data, &i);
 	ok (ret == KNOT_EOK, "ztree: ordered traversal");
 
+	/* 6. split traversal */
+	zone_tree_it_t its[NCOUNT - 1];
+	ret = zone_tree_split(t, NCOUNT - 1, its);
+	ok(ret == KNOT_EOK, "ztree: split");
+	i = 0;
+	for (unsigned k = 0; k < NCOUNT - 1; k++) {
+		size_t size = NCOUNT * (k + 1) / (NCOUNT - 1) - NCOUNT * k / (NCOUNT - 1);
+		if (ret == KNOT_EOK && i != NCOUNT * k / (NCOUNT - 1)) {
+			ret = KNOT_ERROR;
+		}
+		if (ret == KNOT_EOK) {
+			ret = zone_tree_it_apply(&its[k], size, ztree_iter_data, &i);
+		}
+		zone_tree_it_free(&its[k]);
+	}
+	ok(ret == KNOT_EOK && i == NCOUNT, "ztree: split traversal");
+
 	zone_tree_free(&t);
+
+	/* 8. copy-on-write */
+	t = zone_tree_create();
+	zone_node_t *first = node_new(NAME[2], NULL);
+	zone_node_t *second = node_new(NAME[1], NULL);
+	(void)zone_tree_insert(t, &first);
+	(void)zone_tree_insert(t, &second);
+	zone_tree_t *copy = zone_tree_cow(t);
+	node = zone_tree_get(copy, NAME[2]);
+	ret = zone_tree_touch(copy, node);
+	if (ret == KNOT_EOK) {
+		node->children = 1;
+	}
+	ok(ret == KNOT_EOK && node != first && binode_first(node) == first &&
+	   first->children == 0, "ztree: copy-on-write");
+
+	/* 9. commit */
+	zone_tree_cow_commit(&t, copy, NULL);
+	ok(t == NULL && first->children == 1 &&
+	   zone_tree_get(copy, NAME[1])->owner == second->owner, "ztree: commit");
+
+	/* 10. rollback */
+	t = zone_tree_cow(copy);
+	node = zone_tree_get(t, NAME[2]);
+	ret = zone_tree_touch(t, node);
+	if (ret == KNOT_EOK) {
+		node->children = 2;
+	}
+	zone_node_t *added = node_new(NAME[3], NULL);
+	if (ret == KNOT_EOK) {
+		ret = zone_tree_insert(t, &added);
+	}
+	zone_tree_cow_rollback(copy, &t, NULL);
+	ok(ret == KNOT_EOK && t == NULL && node == first &&
+	   binode_counterpart(first)->children == 1 && first->children == 1 &&
+	   zone_tree_get(copy, NAME[3]) == NULL, "ztree: rollback");
+
+	zone_tree_deep_free(&copy);
 	ztree_free_data();
 	return 0;
 }
@@ -0,0 +1,251 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tap/basic.h>
+
+#include "knot/updates/apply.h"
+#include "knot/zone/zonefile.h"
+#include "libknot/libknot.h"
+
+static const char *zone_str =
+"$ORIGIN example.\n"
+"$TTL 3600\n"
+"@ SOA ns hostmaster 1 3600 600 86400 300\n"
+"@ NS ns\n"
+"@ MX 10 mail\n"
+"@ NSEC3PARAM 1 0 10 ABCD\n"
+"ns A 192.0.2.1\n"
+"mail A 192.0.2.2\n"
+"a.b.c TXT \"empty non-terminals\" \"above\"\n"
+"sub NS ns.sub\n"
+"sub NS ns.other\n"
+"ns.sub A 192.0.2.4\n"
+"*.wild A 192.0.2.5\n"
+"x.wild MX 10 host.wild\n"
+"other MX 10 y.wild\n"
+"DUQP1N5U9E4QDCKJ6GD7KUT83GI8H3GG NSEC3 1 0 10 ABCD 2T7B4G4VSA5SMI47K61MV5BV1A22BOJR A\n";
+
+static void err_cb(sem_handler_t *handler, const zone_contents_t *zone,
+                   const zone_node_t *node, sem_error_t error, const char *data)
+{
+}
+
+static zone_contents_t *load(const char *path, const knot_dname_t *origin)
+{
+	sem_handler_t handler = { .cb = err_cb };
+
+	zloader_t zl;
+	if (zonefile_open(&zl, path, origin, false, 0) != KNOT_EOK) {
+		return NULL;
+	}
+	zl.err_handler = &handler;
+	zl.creator->master = true;
+
+	zone_contents_t *contents = zonefile_load(&zl);
+	zonefile_close(&zl);
+
+	return contents;
+}
+
+static knot_rrset_t *make_rr(const char *owner_str, uint16_t type, const char *rdata_str)
+{
+	knot_dname_t *owner = knot_dname_from_str_alloc(owner_str);
+	knot_rrset_t *rr = knot_rrset_new(owner, type, KNOT_CLASS_IN, 3600, NULL);
+	knot_dname_free(&owner, NULL);
+	if (rr == NULL) {
+		return NULL;
+	}
+
+	uint8_t rdata[KNOT_DNAME_MAXLEN + 2] = { 0 };
+	uint16_t rdlen = 0;
+	if (type == KNOT_RRTYPE_A) {
+		rdata[0] = 192; rdata[2] = 2; rdata[3] = atoi(rdata_str);
+		rdlen = 4;
+	} else {
+		// NS, MX with zero preference, or NSEC3 records with the zone parameters.
+		size_t offset = (type == KNOT_RRTYPE_MX) ? 2 : 0;
+		if (type == KNOT_RRTYPE_NSEC3 || type == KNOT_RRTYPE_NSEC3PARAM) {
+			const uint8_t nsec3[] = { 1, 0, 0, 10, 2, 0xab, 0xcd, 0 };
+			memcpy(rdata, nsec3, sizeof(nsec3));
+			rdlen = sizeof(nsec3) - (type == KNOT_RRTYPE_NSEC3PARAM);
+		} else {
+			knot_dname_t *name = knot_dname_from_str(rdata + offset, rdata_str,
+			                                         sizeof(rdata) - offset);
+			rdlen = offset + knot_dname_size(name);
+		}
+	}
+
+	if (knot_rrset_add_rdata(rr, rdata, rdlen, NULL) != KNOT_EOK) {
+		knot_rrset_free(&rr, NULL);
+	}
+
+	return rr;
+}
+
+/*! \brief Applies a single change onto an adjusted copy and cross-checks it. */
+static void test_change(zone_contents_t **contents, bool add, const char *owner,
+                        uint16_t type, const char *rdata, const char *msg)
+{
+	zone_contents_t *copy = NULL;
+	int ret = apply_prepare_zone_copy(*contents, &copy);
+	if (ret != KNOT_EOK) {
+		ok(0, "zone adjust: %s (copy %s)", msg, knot_strerror(ret));
+		return;
+	}
+
+	apply_ctx_t ctx;
+	apply_init_ctx(&ctx, copy, APPLY_INCREMENTAL_ADJUST);
+
+	knot_rrset_t *rr = make_rr(owner, type, rdata);
+	ret = (rr == NULL) ? KNOT_ENOMEM :
+	      add ? apply_add_rr(&ctx, rr) : apply_remove_rr(&ctx, rr);
+	knot_rrset_free(&rr, NULL);
+	if (ret == KNOT_EOK) {
+		ret = apply_finalize(&ctx);
+	}
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_adjust_check(copy);
+	}
+	is_int(KNOT_EOK, ret, "zone adjust: %s", msg);
+
+	if (ret != KNOT_EOK) {
+		update_rollback(&ctx);
+		zone_contents_cow_rollback(*contents, &copy);
+		return;
+	}
+
+	zone_contents_cow_commit(contents, copy);
+	update_cleanup(&ctx);
+	*contents = copy;
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	char *tmpdir = test_tmpdir();
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/example.zone", tmpdir);
+
+	knot_dname_t *origin = knot_dname_from_str_alloc("example.");
+
+	FILE *f = fopen(path, "w");
+	if (f != NULL) {
+		fputs(zone_str, f);
+		fclose(f);
+	}
+
+	zone_contents_t *zone = load(path, origin);
+	ok(zone != NULL, "zone adjust: load zone");
+	if (zone == NULL) {
+		return 1;
+	}
+	is_int(KNOT_EOK, zone_contents_adjust_check(zone), "zone adjust: loaded zone");
+
+	/* Change tracking. */
+	zone_adjust_changes_t changes;
+	zone_adjust_changes_init(&changes);
+	knot_rrset_t *rr = make_rr("a.b.c.example.", KNOT_RRTYPE_A, "1");
+	ok(zone_adjust_changes_add(&changes, zone, rr) == KNOT_EOK &&
+	   trie_weight(changes.names) == 3 && !changes.full && !changes.all_additionals,
+	   "zone adjust: track name and ancestors");
+	knot_rrset_free(&rr, NULL);
+	rr = make_rr("*.example.", KNOT_RRTYPE_A, "1");
+	ok(zone_adjust_changes_add(&changes, zone, rr) == KNOT_EOK &&
+	   changes.all_additionals, "zone adjust: track wildcard below apex");
+	knot_rrset_free(&rr, NULL);
+	rr = make_rr("other.test.", KNOT_RRTYPE_A, "1");
+	is_int(KNOT_EOUTOFZONE, zone_adjust_changes_add(&changes, zone, rr),
+	       "zone adjust: track out-of-zone name");
+	knot_rrset_free(&rr, NULL);
+	zone_adjust_changes_clear(&changes);
+	ok(changes.names == NULL && changes.nsec3_names == NULL &&
+	   changes.removed_nsec3 == NULL, "zone adjust: clear changes");
+
+	/* Names and records. */
+	test_change(&zone, true, "mail.example.", KNOT_RRTYPE_A, "3", "add record");
+	test_change(&zone, true, "new.example.", KNOT_RRTYPE_A, "6", "add name");
+	test_change(&zone, true, "d.e.f.example.", KNOT_RRTYPE_A, "7", "add name below new ENTs");
+	test_change(&zone, false, "d.e.f.example.", KNOT_RRTYPE_A, "7", "remove name with ENTs");
+	test_change(&zone, false, "mail.example.", KNOT_RRTYPE_A, "2", "remove record");
+	test_change(&zone, false, "mail.example.", KNOT_RRTYPE_A, "3", "remove MX target");
+	test_change(&zone, true, "mail.example.", KNOT_RRTYPE_A, "2", "add MX target");
+	test_change(&zone, true, "other.example.", KNOT_RRTYPE_MX, "MAIL.example.",
+	            "add upper-case MX target");
+	test_change(&zone, false, "mail.example.", KNOT_RRTYPE_A, "2",
+	            "remove upper-case MX target");
+	test_change(&zone, true, "mail.example.", KNOT_RRTYPE_A, "2",
+	            "add upper-case MX target back");
+	test_change(&zone, true, "example.", KNOT_RRTYPE_NS, "new.example.", "add apex NS");
+	test_change(&zone, true, "zz.example.", KNOT_RRTYPE_A, "12", "add last name");
+	test_change(&zone, true, "a.example.", KNOT_RRTYPE_A, "13", "add first name");
+	test_change(&zone, true, "a.example.", KNOT_RRTYPE_A, "14", "add record to first name");
+	test_change(&zone, false, "zz.example.", KNOT_RRTYPE_A, "12", "remove last name");
+	test_change(&zone, false, "a.example.", KNOT_RRTYPE_A, "13", "remove record of first name");
+	test_change(&zone, false, "a.example.", KNOT_RRTYPE_A, "14", "remove first name");
+
+	/* Delegations and glue. */
+	test_change(&zone, true, "ns.other.example.", KNOT_RRTYPE_A, "8", "add glue");
+	test_change(&zone, true, "other.example.", KNOT_RRTYPE_NS, "ns.other.example.",
+	            "add delegation");
+	test_change(&zone, true, "deep.ns.sub.example.", KNOT_RRTYPE_A, "9",
+	            "add name below delegation");
+	test_change(&zone, false, "sub.example.", KNOT_RRTYPE_NS, "ns.sub.example.",
+	            "remove delegation NS");
+	test_change(&zone, false, "sub.example.", KNOT_RRTYPE_NS, "ns.other.example.",
+	            "remove delegation");
+	test_change(&zone, false, "ns.other.example.", KNOT_RRTYPE_A, "8", "remove glue");
+	test_change(&zone, true, "zz.example.", KNOT_RRTYPE_NS, "ns.zz.example.",
+	            "add last delegation");
+	test_change(&zone, true, "ns.zz.example.", KNOT_RRTYPE_A, "15", "add last glue");
+	test_change(&zone, false, "zz.example.", KNOT_RRTYPE_NS, "ns.zz.example.",
+	            "remove last delegation");
+	test_change(&zone, false, "ns.zz.example.", KNOT_RRTYPE_A, "15", "remove last name");
+
+	/* Wildcards. */
+	test_change(&zone, false, "*.wild.example.", KNOT_RRTYPE_A, "5", "remove wildcard");
+	test_change(&zone, true, "*.wild.example.", KNOT_RRTYPE_A, "5", "add wildcard");
+	test_change(&zone, true, "*.example.", KNOT_RRTYPE_A, "10", "add wildcard below apex");
+	test_change(&zone, true, "host.wild.example.", KNOT_RRTYPE_A, "11",
+	            "add name covered by wildcard");
+
+	/* NSEC3 chain. */
+	test_change(&zone, true, "2T7B4G4VSA5SMI47K61MV5BV1A22BOJR.example.",
+	            KNOT_RRTYPE_NSEC3, NULL, "add NSEC3 node");
+	test_change(&zone, true, "00000000000000000000000000000000.example.",
+	            KNOT_RRTYPE_NSEC3, NULL, "add first NSEC3 node");
+	test_change(&zone, true, "VVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVV.example.",
+	            KNOT_RRTYPE_NSEC3, NULL, "add last NSEC3 node");
+	test_change(&zone, false, "00000000000000000000000000000000.example.",
+	            KNOT_RRTYPE_NSEC3, NULL, "remove first NSEC3 node");
+	test_change(&zone, false, "DUQP1N5U9E4QDCKJ6GD7KUT83GI8H3GG.example.",
+	            KNOT_RRTYPE_NSEC3, NULL, "remove NSEC3 node");
+	test_change(&zone, true, "DUQP1N5U9E4QDCKJ6GD7KUT83GI8H3GG.example.",
+	            KNOT_RRTYPE_NSEC3, NULL, "add linked NSEC3 node");
+	test_change(&zone, false, "VVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVV.example.",
+	            KNOT_RRTYPE_NSEC3, NULL, "remove last NSEC3 node");
+	test_change(&zone, false, "example.", KNOT_RRTYPE_NSEC3PARAM, NULL, "remove NSEC3PARAM");
+
+	remove(path);
+	zone_contents_deep_free(&zone);
+	knot_dname_free(&origin, NULL);
+	test_tmpdir_free(tmpdir);
+
+	return 0;
+}
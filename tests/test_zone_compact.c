@@ -0,0 +1,241 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tap/basic.h>
+
+#include "knot/updates/apply.h"
+#include "knot/zone/zonefile.h"
+#include "libknot/libknot.h"
+
+static const char *zone_str =
+"$ORIGIN example.\n"
+"$TTL 3600\n"
+"@ SOA ns hostmaster 1 3600 600 86400 300\n"
+"@ NS ns\n"
+"@ MX 10 mail\n"
+"@ NSEC3PARAM 1 0 10 ABCD\n"
+"ns A 192.0.2.1\n"
+"ns AAAA 2001:db8::1\n"
+"mail A 192.0.2.2\n"
+"mail A 192.0.2.3\n"
+"a.b.c TXT \"empty non-terminals\" \"above\"\n"
+"sub NS ns.sub\n"
+"sub NS ns.other.\n"
+"ns.sub A 192.0.2.4\n"
+"*.wild CNAME mail\n"
+"DUQP1N5U9E4QDCKJ6GD7KUT83GI8H3GG NSEC3 1 0 10 ABCD 2T7B4G4VSA5SMI47K61MV5BV1A22BOJR A\n";
+
+static void err_cb(sem_handler_t *handler, const zone_contents_t *zone,
+                   const zone_node_t *node, sem_error_t error, const char *data)
+{
+}
+
+static zone_contents_t *load(const char *path, const knot_dname_t *origin)
+{
+	sem_handler_t handler = { .cb = err_cb };
+
+	zloader_t zl;
+	if (zonefile_open(&zl, path, origin, false, 0) != KNOT_EOK) {
+		return NULL;
+	}
+	zl.err_handler = &handler;
+	zl.creator->master = true;
+
+	zone_contents_t *contents = zonefile_load(&zl);
+	zonefile_close(&zl);
+
+	return contents;
+}
+
+static bool same_owner(const zone_node_t *a, const zone_node_t *b)
+{
+	if (a == NULL || b == NULL) {
+		return a == b;
+	}
+
+	return knot_dname_is_equal(a->owner, b->owner);
+}
+
+/*! \brief Compares node data and the adjusted pointers. */
+static int compare_node(zone_node_t **node_ptr, void *data)
+{
+	const zone_node_t *node = *node_ptr;
+	const zone_node_t *other = zone_tree_get(data, node->owner);
+	if (other == NULL || other->rrset_count != node->rrset_count ||
+	    (other->flags & ~NODE_FLAGS_ARENA) != (node->flags & ~NODE_FLAGS_ARENA) ||
+	    other->children != node->children || !same_owner(other->parent, node->parent) ||
+	    !same_owner(other->prev, node->prev) ||
+	    !same_owner(other->nsec3_node, node->nsec3_node)) {
+		return KNOT_ENOENT;
+	}
+
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		knot_rrset_t rrset = node_rrset_at(node, i);
+		knot_rrset_t other_rrset = node_rrset(other, rrset.type);
+		if (!knot_rrset_equal(&rrset, &other_rrset, KNOT_RRSET_COMPARE_WHOLE)) {
+			return KNOT_ENOENT;
+		}
+
+		const additional_t *add = node->rrs[i].additional;
+		const additional_t *other_add = other->rrs[i].additional;
+		if ((add == NULL) != (other_add == NULL) ||
+		    (add != NULL && add->count != other_add->count)) {
+			return KNOT_ENOENT;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static bool contents_equal(zone_contents_t *a, zone_contents_t *b)
+{
+	return zone_tree_count(a->nodes) == zone_tree_count(b->nodes) &&
+	       zone_tree_count(a->nsec3_nodes) == zone_tree_count(b->nsec3_nodes) &&
+	       zone_tree_walk(a->nodes, compare_node, b->nodes) == KNOT_EOK &&
+	       zone_tree_walk(a->nsec3_nodes, compare_node, b->nsec3_nodes) == KNOT_EOK;
+}
+
+static int check_arena_node(zone_node_t **node, void *data)
+{
+	return ((*node)->flags & NODE_FLAGS_ARENA) &&
+	       zone_arena_owns(data, *node) ? KNOT_EOK : KNOT_ENOENT;
+}
+
+static knot_rrset_t *make_rr(const char *owner_str, uint16_t type, const char *rdata,
+                             uint16_t rdlen)
+{
+	knot_dname_t *owner = knot_dname_from_str_alloc(owner_str);
+	knot_rrset_t *rr = knot_rrset_new(owner, type, KNOT_CLASS_IN, 3600, NULL);
+	knot_dname_free(&owner, NULL);
+	if (rr != NULL && knot_rrset_add_rdata(rr, (const uint8_t *)rdata, rdlen, NULL) != KNOT_EOK) {
+		knot_rrset_free(&rr, NULL);
+	}
+
+	return rr;
+}
+
+/*! \brief Applies changes to a copy of the contents, frees the original on commit. */
+static zone_contents_t *update(zone_contents_t **contents, bool commit)
+{
+	zone_contents_t *copy = NULL;
+	if (apply_prepare_zone_copy(*contents, &copy) != KNOT_EOK) {
+		return NULL;
+	}
+
+	apply_ctx_t ctx;
+	apply_init_ctx(&ctx, copy, 0);
+
+	knot_rrset_t *add = make_rr("mail.example.", KNOT_RRTYPE_A, "\xc0\x00\x02\x09", 4);
+	knot_rrset_t *add_new = make_rr("new.example.", KNOT_RRTYPE_A, "\xc0\x00\x02\x0a", 4);
+	knot_rrset_t *rem = make_rr("ns.example.", KNOT_RRTYPE_AAAA,
+	                            "\x20\x01\x0d\xb8\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x01", 16);
+	int ret = apply_add_rr(&ctx, add);
+	if (ret == KNOT_EOK) {
+		ret = apply_add_rr(&ctx, add_new);
+	}
+	if (ret == KNOT_EOK) {
+		ret = apply_remove_rr(&ctx, rem);
+	}
+	if (ret == KNOT_EOK) {
+		ret = apply_finalize(&ctx);
+	}
+	knot_rrset_free(&add, NULL);
+	knot_rrset_free(&add_new, NULL);
+	knot_rrset_free(&rem, NULL);
+
+	if (ret != KNOT_EOK || !commit) {
+		update_rollback(&ctx);
+		zone_contents_cow_rollback(*contents, &copy);
+		return NULL;
+	}
+
+	zone_contents_cow_commit(contents, copy);
+	update_cleanup(&ctx);
+	return copy;
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	char *tmpdir = test_tmpdir();
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/example.zone", tmpdir);
+
+	knot_dname_t *origin = knot_dname_from_str_alloc("example.");
+
+	FILE *f = fopen(path, "w");
+	if (f != NULL) {
+		fputs(zone_str, f);
+		fclose(f);
+	}
+
+	zone_contents_t *ref = load(path, origin);
+	zone_contents_t *zone = load(path, origin);
+	ok(ref != NULL && zone != NULL, "zone compact: load zone");
+	if (ref == NULL || zone == NULL) {
+		return 1;
+	}
+
+	/* Compaction. */
+	zone_memory_t before, after;
+	zone_contents_measure_memory(zone, &before);
+	ok(before.nodes == zone_tree_count(zone->nodes) + zone_tree_count(zone->nsec3_nodes) &&
+	   before.bytes > 0 && before.allocations > before.nodes,
+	   "zone compact: measure memory");
+
+	int ret = zone_contents_compact(zone);
+	is_int(KNOT_EOK, ret, "zone compact: compact");
+	is_int(KNOT_EINVAL, zone_contents_compact(zone), "zone compact: compact again");
+
+	zone_contents_measure_memory(zone, &after);
+	ok(after.nodes == before.nodes && after.allocations < before.allocations &&
+	   after.bytes < before.bytes, "zone compact: less memory (%zu -> %zu bytes)",
+	   before.bytes, after.bytes);
+	ok(zone_tree_walk(zone->nodes, check_arena_node, zone->arena) == KNOT_EOK &&
+	   zone_tree_walk(zone->nsec3_nodes, check_arena_node, zone->arena) == KNOT_EOK &&
+	   zone_arena_owns(zone->arena, zone->apex), "zone compact: nodes in arena");
+	ok(contents_equal(ref, zone) && contents_equal(zone, ref),
+	   "zone compact: contents and adjusted pointers equal");
+
+	/* Failed update of the compacted contents. */
+	ok(update(&zone, false) == NULL, "zone compact: rolled back update");
+	ok(contents_equal(ref, zone), "zone compact: unchanged after rollback");
+
+	/* Successful update, the old version is freed first. */
+	zone_contents_t *ref_new = update(&ref, true);
+	zone_contents_t *zone_new = update(&zone, true);
+	ok(ref_new != NULL && zone_new != NULL && ref == NULL && zone == NULL,
+	   "zone compact: update");
+	ok(zone_new != NULL && zone_new->arena != NULL && ref_new != NULL &&
+	   contents_equal(ref_new, zone_new) && contents_equal(zone_new, ref_new),
+	   "zone compact: updated contents equal");
+
+	/* Another version, then free all. */
+	zone_contents_t *zone_next = update(&zone_new, true);
+	ok(zone_next != NULL, "zone compact: next update");
+	zone_contents_deep_free(&zone_next);
+	zone_contents_deep_free(&ref_new);
+
+	remove(path);
+	knot_dname_free(&origin, NULL);
+	test_tmpdir_free(tmpdir);
+
+	return 0;
+}
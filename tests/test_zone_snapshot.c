@@ -0,0 +1,232 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <tap/basic.h>
+
+#include "knot/zone/zone-snapshot.h"
+#include "knot/zone/zonefile.h"
+#include "libknot/libknot.h"
+#include "test_conf.h"
+
+static const char *zone_str =
+"$ORIGIN example.\n"
+"$TTL 3600\n"
+"@ SOA ns hostmaster 1 3600 600 86400 300\n"
+"@ NS ns\n"
+"@ MX 10 mail\n"
+"ns A 192.0.2.1\n"
+"ns AAAA 2001:db8::1\n"
+"mail 60 A 192.0.2.2\n"
+"mail A 192.0.2.3\n"
+"a.b.c TXT \"empty non-terminals\" \"above\"\n"
+"sub NS ns.sub\n"
+"ns.sub A 192.0.2.4\n"
+"*.wild CNAME mail\n"
+"DUQP1N5U9E4QDCKJ6GD7KUT83GI8H3GG NSEC3 1 0 10 ABCD 2T7B4G4VSA5SMI47K61MV5BV1A22BOJR A\n";
+
+static void err_cb(sem_handler_t *handler, const zone_contents_t *zone,
+                   const zone_node_t *node, sem_error_t error, const char *data)
+{
+}
+
+static zone_contents_t *load(const char *path, const knot_dname_t *origin)
+{
+	sem_handler_t handler = { .cb = err_cb };
+
+	zloader_t zl;
+	if (zonefile_open(&zl, path, origin, false, 0) != KNOT_EOK) {
+		return NULL;
+	}
+	zl.err_handler = &handler;
+	zl.creator->master = true;
+
+	zone_contents_t *contents = zonefile_load(&zl);
+	zonefile_close(&zl);
+
+	return contents;
+}
+
+static int compare_node(zone_node_t **node_ptr, void *data)
+{
+	const zone_node_t *node = *node_ptr;
+	const zone_node_t *other_node = zone_tree_get(data, node->owner);
+	if (other_node == NULL || other_node->rrset_count != node->rrset_count) {
+		return KNOT_ENOENT;
+	}
+
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		knot_rrset_t rrset = node_rrset_at(node, i);
+		knot_rrset_t other_rrset = node_rrset(other_node, rrset.type);
+		if (!knot_rrset_equal(&rrset, &other_rrset, KNOT_RRSET_COMPARE_WHOLE)) {
+			return KNOT_ENOENT;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static bool tree_equal(zone_tree_t *a, zone_tree_t *b)
+{
+	if (zone_tree_count(a) != zone_tree_count(b)) {
+		return false;
+	}
+
+	return zone_tree_apply(a, compare_node, b) == KNOT_EOK;
+}
+
+static bool contents_equal(zone_contents_t *a, zone_contents_t *b)
+{
+	return tree_equal(a->nodes, b->nodes) &&
+	       tree_equal(a->nsec3_nodes, b->nsec3_nodes);
+}
+
+static bool write_file(const char *path, const void *data, size_t len)
+{
+	FILE *f = fopen(path, "w");
+	if (f == NULL) {
+		return false;
+	}
+	bool ok = fwrite(data, len, 1, f) == 1;
+	fclose(f);
+
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	char *tmpdir = test_tmpdir();
+	char path[1024], snap_path[1100];
+	snprintf(path, sizeof(path), "%s/example.zone", tmpdir);
+	snprintf(snap_path, sizeof(snap_path), "%s" ZONE_SNAPSHOT_SUFFIX, path);
+
+	knot_dname_t *origin = knot_dname_from_str_alloc("example.");
+
+	ok(write_file(path, zone_str, strlen(zone_str)), "zone snapshot: write zone file");
+	zone_contents_t *text = load(path, origin);
+	ok(text != NULL, "zone snapshot: load zone file");
+
+	struct stat st;
+	ok(stat(path, &st) == 0, "zone snapshot: stat zone file");
+
+	/* Write and read back. */
+	int ret = zone_snapshot_write(snap_path, text, &st);
+	is_int(KNOT_EOK, ret, "zone snapshot: write");
+
+	zone_contents_t *snap = NULL;
+	ret = zone_snapshot_read(snap_path, origin, &st, &snap);
+	is_int(KNOT_EOK, ret, "zone snapshot: read");
+	ok(ret == KNOT_EOK && contents_equal(text, snap),
+	   "zone snapshot: contents equal");
+	ok(ret == KNOT_EOK && zone_contents_adjust_full(snap) == KNOT_EOK,
+	   "zone snapshot: adjust");
+	zone_contents_deep_free(&snap);
+
+	/* Missing snapshot. */
+	char missing[1200];
+	snprintf(missing, sizeof(missing), "%s.missing", snap_path);
+	ret = zone_snapshot_read(missing, origin, &st, &snap);
+	is_int(KNOT_ENOENT, ret, "zone snapshot: missing");
+
+	/* Changed zone file. */
+	struct stat changed = st;
+	changed.st_mtime++;
+	ret = zone_snapshot_read(snap_path, origin, &changed, &snap);
+	is_int(KNOT_EEXPIRED, ret, "zone snapshot: zone file changed");
+	changed = st;
+	changed.st_mtim.tv_nsec = (st.st_mtim.tv_nsec + 1) % 1000000000;
+	ret = zone_snapshot_read(snap_path, origin, &changed, &snap);
+	is_int(KNOT_EEXPIRED, ret, "zone snapshot: zone file changed within a second");
+	changed = st;
+	changed.st_size++;
+	ret = zone_snapshot_read(snap_path, origin, &changed, &snap);
+	is_int(KNOT_EEXPIRED, ret, "zone snapshot: zone file size changed");
+
+	/* Different zone. */
+	knot_dname_t *other = knot_dname_from_str_alloc("example.com.");
+	ret = zone_snapshot_read(snap_path, other, &st, &snap);
+	is_int(KNOT_EEXPIRED, ret, "zone snapshot: different zone");
+	knot_dname_free(&other, NULL);
+
+	/* Truncated snapshot. */
+	FILE *f = fopen(snap_path, "r");
+	uint8_t buf[8192];
+	size_t len = (f != NULL) ? fread(buf, 1, sizeof(buf), f) : 0;
+	if (f != NULL) {
+		fclose(f);
+	}
+	ok(len > 0 && len < sizeof(buf), "zone snapshot: read file");
+
+	bool truncated_ok = true;
+	for (size_t cut = 1; cut < len; cut += 7) {
+		write_file(snap_path, buf, len - cut);
+		ret = zone_snapshot_read(snap_path, origin, &st, &snap);
+		if (ret != KNOT_EMALF && ret != KNOT_EEXPIRED) {
+			truncated_ok = false;
+			zone_contents_deep_free(&snap);
+		}
+	}
+	ok(truncated_ok, "zone snapshot: truncated");
+
+	/* Corrupted snapshot. */
+	buf[0] ^= 0xff;
+	write_file(snap_path, buf, len);
+	ret = zone_snapshot_read(snap_path, origin, &st, &snap);
+	is_int(KNOT_EMALF, ret, "zone snapshot: bad magic");
+	buf[0] ^= 0xff;
+	buf[len - 1] ^= 0xff;
+	write_file(snap_path, buf, len);
+	ret = zone_snapshot_read(snap_path, origin, &st, &snap);
+	is_int(KNOT_EMALF, ret, "zone snapshot: bad trailer");
+
+	/* Stored only for zone files without includes. */
+	char conf_str[2048], *abs_path = realpath(path, NULL);
+	snprintf(conf_str, sizeof(conf_str),
+	         "zone:\n"
+	         "  - domain: example.\n"
+	         "    file: %s\n"
+	         "    zonefile-snapshot: on\n", abs_path);
+	free(abs_path);
+	ret = test_conf(conf_str, NULL);
+	is_int(KNOT_EOK, ret, "zone snapshot: configure");
+	remove(snap_path);
+	ret = zone_snapshot_store(conf(), origin, text, &st);
+	ok(ret == KNOT_EOK && stat(snap_path, &changed) == 0,
+	   "zone snapshot: store");
+
+	char include_str[2048];
+	snprintf(include_str, sizeof(include_str), "%s$include %s/other.zone\n",
+	         zone_str, tmpdir);
+	write_file(path, include_str, strlen(include_str));
+	remove(snap_path);
+	ret = zone_snapshot_store(conf(), origin, text, &st);
+	ok(ret == KNOT_EOK && stat(snap_path, &changed) != 0,
+	   "zone snapshot: not stored with include");
+	conf_free(conf());
+
+	remove(snap_path);
+	remove(path);
+	zone_contents_deep_free(&text);
+	knot_dname_free(&origin, NULL);
+	test_tmpdir_free(tmpdir);
+
+	return 0;
+}
@@ -95,6 +95,11 @@ int main(int argc, char *argv[])
 	}
 	ok(nr_passed == ZONE_COUNT, "zonedb: find zones for subnames");
 
+	/* Label with a zero byte must not match a sibling zone prefix. */
+	const knot_dname_t *binary = (const knot_dname_t *)"\x03""a\x00""b""\x03""com";
+	ok(knot_zonedb_find_suffix(db, binary) == zones[1],
+	   "zonedb: find zone for binary label");
+
 	/* Remove all zones. */
 	nr_passed = 0;
 	for (unsigned i = 0; i < ZONE_COUNT; ++i) {
@@ -0,0 +1,258 @@
+/*  Copyright (C) 2017 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <tap/basic.h>
+
+#include "knot/zone/zonefile.h"
+#include "libknot/libknot.h"
+
+#define RECORDS 20000
+
+static void err_cb(sem_handler_t *handler, const zone_contents_t *zone,
+                   const zone_node_t *node, sem_error_t error, const char *data)
+{
+}
+
+/*! \brief Writes a zone file using the syntax relevant for the splitting. */
+static int write_zone(const char *path, bool include)
+{
+	FILE *f = fopen(path, "w");
+	if (f == NULL) {
+		return KNOT_EFILE;
+	}
+
+	fprintf(f, "$ORIGIN example.\n$TTL 300\n"
+	           "@ SOA ns hostmaster ( 1 ; serial (\n 3600 600\n 86400 300 )\n"
+	           "@ NS ns\nns A 192.0.2.1\n");
+	if (include) {
+		fprintf(f, "$INCLUDE example.zone.inc\n");
+	}
+
+	for (int i = 0; i < RECORDS; i++) {
+		if (i % 2000 == 0) {
+			fprintf(f, "$ORIGIN sub%i.example.\n$TTL %i\n", i / 2000, 100 + i);
+		}
+		switch (i % 5) {
+		case 0:
+			fprintf(f, "H%i A 10.0.%i.%i\n  AAAA ::%x\n", i, i % 256, i / 256, i);
+			break;
+		case 1:
+			fprintf(f, "h%i 60 TXT \"quoted ; ( not a comment\" \"x\\\"y\"\n", i);
+			break;
+		case 2:
+			fprintf(f, "h%i MX ( 10 ; comment with ) paren\n   mail%i )\n", i, i);
+			break;
+		case 3:
+			fprintf(f, "; comment line (\nh%i IN 42 A 10.1.%i.1\n", i, i % 256);
+			break;
+		default:
+			fprintf(f, "h%i A 10.2.0.%i\nh%i A 10.2.1.%i\nh%i 77 A 10.2.2.%i\n",
+			        i, i % 256, i, i % 256, i, i % 256);
+			break;
+		}
+	}
+
+	fclose(f);
+
+	return KNOT_EOK;
+}
+
+static zone_contents_t *load(const char *path, const knot_dname_t *origin,
+                             unsigned threads)
+{
+	sem_handler_t handler = { .cb = err_cb };
+
+	zloader_t zl;
+	if (zonefile_open(&zl, path, origin, false, 0) != KNOT_EOK) {
+		return NULL;
+	}
+	zl.threads = threads;
+	zl.err_handler = &handler;
+	zl.creator->master = true;
+
+	zone_contents_t *contents = zonefile_load(&zl);
+	zonefile_close(&zl);
+
+	return contents;
+}
+
+static int compare_node(zone_node_t *node, void *data)
+{
+	const zone_contents_t *other = data;
+
+	const zone_node_t *other_node = zone_contents_find_node(other, node->owner);
+	if (other_node == NULL || other_node->rrset_count != node->rrset_count) {
+		return KNOT_ENOENT;
+	}
+
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		knot_rrset_t rrset = node_rrset_at(node, i);
+		knot_rrset_t other_rrset = node_rrset(other_node, rrset.type);
+		if (!knot_rrset_equal(&rrset, &other_rrset, KNOT_RRSET_COMPARE_WHOLE)) {
+			return KNOT_ENOENT;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static bool contents_equal(zone_contents_t *a, zone_contents_t *b)
+{
+	return zone_tree_count(a->nodes) == zone_tree_count(b->nodes) &&
+	       zone_contents_apply(a, compare_node, b) == KNOT_EOK;
+}
+
+static int compare_parent(zone_node_t *node, void *data)
+{
+	const zone_node_t *other = zone_contents_find_node(data, node->owner);
+	if (other == NULL || other->children != node->children ||
+	    (other->parent == NULL) != (node->parent == NULL) ||
+	    (node->parent != NULL &&
+	     !knot_dname_is_equal(other->parent->owner, node->parent->owner))) {
+		return KNOT_ENOENT;
+	}
+
+	return KNOT_EOK;
+}
+
+typedef struct {
+	zone_contents_t *zone;
+	zone_append_ctx_t ctx;
+	int pass;    /* 0 all types, 1 only A, 2 except A */
+	bool plain;  /* No insertion cursor. */
+	int ret;
+} append_data_t;
+
+static int append_node(zone_node_t *node, void *data)
+{
+	append_data_t *d = data;
+
+	for (uint16_t i = 0; i < node->rrset_count && d->ret == KNOT_EOK; i++) {
+		knot_rrset_t rrset = node_rrset_at(node, i);
+		if ((d->pass == 1 && rrset.type != KNOT_RRTYPE_A) ||
+		    (d->pass == 2 && rrset.type == KNOT_RRTYPE_A)) {
+			continue;
+		}
+		zone_node_t *n = NULL;
+		d->ret = d->plain ? zone_contents_add_rr(d->zone, &rrset, &n) :
+		                    zone_contents_append_rr(d->zone, &rrset, &d->ctx);
+	}
+
+	return d->ret;
+}
+
+/*! \brief Copies the contents record by record, optionally in two passes. */
+static zone_contents_t *append_copy(zone_contents_t *from, bool plain, bool two_passes)
+{
+	append_data_t data = {
+		.zone = zone_contents_new(from->apex->owner),
+		.pass = two_passes ? 1 : 0,
+		.plain = plain,
+	};
+	if (data.zone == NULL) {
+		return NULL;
+	}
+
+	for (; data.pass < (two_passes ? 3 : 1); data.pass++) {
+		(void)zone_contents_apply(from, append_node, &data);
+	}
+
+	if (data.ret != KNOT_EOK) {
+		zone_contents_deep_free(&data.zone);
+	}
+
+	return data.zone;
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	char *tmpdir = test_tmpdir();
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/example.zone", tmpdir);
+
+	knot_dname_t *origin = knot_dname_from_str_alloc("example.");
+
+	/* Parallel parsing gives the same contents. */
+	int ret = write_zone(path, false);
+	ok(ret == KNOT_EOK, "zonefile: write zone");
+
+	zone_contents_t *seq = load(path, origin, 1);
+	ok(seq != NULL, "zonefile: sequential load");
+	ok(seq != NULL && zone_tree_count(seq->nodes) > RECORDS,
+	   "zonefile: all records loaded");
+
+	unsigned threads[] = { 2, 3, 8 };
+	for (int i = 0; i < sizeof(threads) / sizeof(*threads); i++) {
+		zone_contents_t *par = load(path, origin, threads[i]);
+		ok(par != NULL && seq != NULL && contents_equal(seq, par) &&
+		   contents_equal(par, seq), "zonefile: parallel load, %u threads",
+		   threads[i]);
+		zone_contents_deep_free(&par);
+	}
+
+	/* Appending records grouped by owner keeps the tree structure. */
+	zone_contents_t *ref = (seq != NULL) ? append_copy(seq, true, false) : NULL;
+	for (int i = 0; i < 2; i++) {
+		zone_contents_t *copy = (ref != NULL) ? append_copy(seq, false, i == 1) : NULL;
+		ok(copy != NULL && contents_equal(ref, copy) && contents_equal(copy, ref) &&
+		   zone_contents_apply(ref, compare_parent, copy) == KNOT_EOK &&
+		   zone_contents_apply(copy, compare_parent, ref) == KNOT_EOK,
+		   "zonefile: append records%s", (i == 1) ? ", two passes" : "");
+		zone_contents_deep_free(&copy);
+	}
+	zone_contents_deep_free(&ref);
+	zone_contents_deep_free(&seq);
+
+	/* Zone file with $INCLUDE is parsed sequentially. */
+	char inc_path[1100];
+	snprintf(inc_path, sizeof(inc_path), "%s.inc", path);
+	FILE *inc = fopen(inc_path, "w");
+	ok(inc != NULL, "zonefile: write include");
+	if (inc != NULL) {
+		fprintf(inc, "included A 192.0.2.2\n");
+		fclose(inc);
+	}
+	ret = write_zone(path, true);
+	ok(ret == KNOT_EOK, "zonefile: write zone with include");
+
+	zone_contents_t *par = load(path, origin, 4);
+	knot_dname_t *included = knot_dname_from_str_alloc("included.example.");
+	ok(par != NULL && zone_contents_find_node(par, included) != NULL,
+	   "zonefile: parallel load with include");
+	knot_dname_free(&included, NULL);
+	zone_contents_deep_free(&par);
+
+	/* Syntax error is detected in any chunk. */
+	FILE *f = fopen(path, "a");
+	if (f != NULL) {
+		fprintf(f, "broken A 1.2.3\n");
+		fclose(f);
+	}
+	par = load(path, origin, 4);
+	ok(par == NULL, "zonefile: parallel load with error");
+	zone_contents_deep_free(&par);
+
+	remove(inc_path);
+	remove(path);
+	knot_dname_free(&origin, NULL);
+	test_tmpdir_free(tmpdir);
+
+	return 0;
+}